@@ -0,0 +1,129 @@
+#include "../std/std.h"
+
+#include "../inc/ir.h"
+#include "../inc/ir-dataflow.h"
+#include "../inc/architecture.h"
+#include "../inc/arena.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+
+/*Solves liveness and reaching definitions over a generated function: a long
+  chain of blocks, each branching around the next and some looping back,
+  with every block reading registers set by blocks well before it*/
+
+enum {
+    regsPerBlock = 4,
+    reachBack = 16,
+    loopEvery = 8
+};
+
+static operand instrNone (void) {
+    return operandCreate(operandUndefined);
+}
+
+static void generate (irCtx* ir, irFn* fn, int blockNo, reg** vregs) {
+    irBlock** blocks = malloc((blockNo+1)*sizeof(irBlock*));
+
+    for (int i = 0; i < blockNo; i++)
+        blocks[i] = irBlockCreate(ir, fn);
+
+    blocks[blockNo] = fn->epilogue;
+    irJump(fn->entryPoint, blocks[0]);
+
+    for (int i = 0; i < blockNo; i++) {
+        irBlock* block = blocks[i];
+
+        for (int j = 0; j < regsPerBlock; j++) {
+            int n = i*regsPerBlock + j;
+            vregs[n] = regAlloc(8);
+
+            /*Set from a register of a block some way back, or a constant*/
+            operand src = i >= reachBack ? operandCreateReg(vregs[n - reachBack*regsPerBlock])
+                                         : operandCreateLiteral(n);
+            irInstrCreate(block, instrMove, operandCreateReg(vregs[n]), src, instrNone());
+
+            if (j > 0) {
+                irInstr* add = irInstrCreate(block, instrBOP, operandCreateReg(vregs[n]),
+                                             operandCreateReg(vregs[n]), operandCreateReg(vregs[n-1]));
+                add->bop = bopAdd;
+            }
+        }
+
+        irInstrCreate(block, instrCompare, instrNone(),
+                      operandCreateReg(vregs[i*regsPerBlock]), operandCreateLiteral(0));
+
+        /*Every so often, loop back instead of skipping ahead*/
+        irBlock* other = i % loopEvery == loopEvery-1 ? blocks[i - loopEvery/2]
+                                                     : blocks[min(i+2, blockNo)];
+        irBranch(block, operandCreateFlags(conditionEqual), blocks[i+1], other);
+    }
+
+    free(blocks);
+}
+
+static double measure (irFn* fn, bool reaching, int* bits, int* passes) {
+    clock_t start = clock();
+
+    if (reaching) {
+        irReachingDefs defs;
+        irReachingDefsInit(&defs, fn, 8);
+        *bits = defs.flow.bitno;
+        *passes = defs.flow.passes;
+        irReachingDefsFree(&defs);
+
+    } else {
+        irLiveness live;
+        irLivenessInit(&live, fn, 8);
+        *bits = live.flow.bitno;
+        *passes = live.flow.passes;
+        irLivenessFree(&live);
+    }
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main (int argc, char** argv) {
+    int blockNo = argc > 1 ? atoi(argv[1]) : 2000;
+    int rounds = 5;
+
+    arena a;
+    arenaInit(&a, 64*1024);
+    arenaSetCurrent(&a);
+
+    architecture arch;
+    archInit(&arch);
+    archSetup(&arch, osLinux, 8);
+
+    irCtx ir;
+    irInit(&ir, "bench-dataflow.tmp.s", &arch);
+
+    irFn* fn = irFnCreate(&ir, "bench", 0);
+    reg** vregs = malloc(blockNo*regsPerBlock*sizeof(reg*));
+    generate(&ir, fn, blockNo, vregs);
+
+    for (int problem = 0; problem < 2; problem++) {
+        double best = 0;
+        int bits = 0, passes = 0;
+
+        for (int i = 0; i < rounds; i++) {
+            double time = measure(fn, problem == 1, &bits, &passes);
+            best = i == 0 || time < best ? time : best;
+        }
+
+        printf("%-9s %5d blocks %6d bits %3d passes %8.2f ms\n",
+               problem == 1 ? "reaching" : "liveness", fn->blocks.length, bits, passes, best*1000);
+    }
+
+    free(vregs);
+    irFree(&ir);
+    archFree(&arch);
+    arenaFree(&a);
+
+    remove("bench-dataflow.tmp.s");
+
+    return 0;
+}
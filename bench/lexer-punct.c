@@ -0,0 +1,73 @@
+#include "../std/std.h"
+
+#include "../inc/lexer.h"
+#include "../inc/scan.h"
+#include "../inc/atom.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+/*Lexes a generated source dense in operators and keywords, with no
+  comments, so that token classification dominates*/
+
+static const char* chunk =
+    "static int f(int* p,int n){int s=0;for(int i=0;i<n;i++){s+=p[i]<<2;s^=~p[i]>>1;"
+    "if(s>=n&&s!=0||!p)continue;else s-=p->x?i%3:i/2;s*=s<=n;s|=s&1;s&=-s;}"
+    "while(n-->0)s<<=1,s>>=1;do{s%=7;s/=2;}while(--n>=0);return s==0?sizeof(int):s;}\n"
+    "struct s{union{char c;bool b;};const int x;};typedef struct s s_t;extern void g(...);\n";
+
+static const char* generate (int size) {
+    const char* filename = "bench-lexer-punct.tmp.c";
+    FILE* file = fopen(filename, "w");
+
+    for (int written = 0; written < size; written += strlen(chunk))
+        fputs(chunk, file);
+
+    fclose(file);
+    return filename;
+}
+
+static double lexAll (const char* filename, int* tokens) {
+    clock_t start = clock();
+
+    atomTable atoms;
+    atomTableInit(&atoms, 1024);
+
+    lexerCtx* lexer = lexerInit(filename, &atoms);
+    *tokens = 0;
+
+    do {
+        lexerNext(lexer);
+        (*tokens)++;
+    } while (lexer->token != tokenEOF);
+
+    lexerEnd(lexer);
+    atomTableFree(&atoms);
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main (int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 32 << 20;
+    int rounds = 5;
+
+    scanInit();
+    const char* filename = generate(size);
+
+    double best = 0;
+    int tokens = 0;
+
+    for (int i = 0; i < rounds; i++) {
+        double time = lexAll(filename, &tokens);
+        best = i == 0 || time < best ? time : best;
+    }
+
+    printf("%8.1f MB/s  %8.1f Mtokens/s  (%d tokens, %.3fs)\n",
+           size / best / (1 << 20), tokens / best / 1e6, tokens, best);
+
+    remove(filename);
+
+    return 0;
+}
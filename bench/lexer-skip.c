@@ -0,0 +1,166 @@
+#include "../std/std.h"
+
+#include "../inc/lexer.h"
+#include "../inc/stream.h"
+#include "../inc/scan.h"
+#include "../inc/atom.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+/*Lexes a generated, comment heavy source with each scanning implementation
+  the CPU supports and reports the throughput of each.
+
+  The insignificants are also skipped on their own, both with the kernels
+  and with the per character streamNext loops the lexer used before them,
+  as a baseline.*/
+
+static const char* chunk =
+    "/*\n"
+    " * A block comment, as found before most functions. Long enough that\n"
+    " * the scanning width matters more than the per comment overhead.\n"
+    " */\n"
+    "\n"
+    "static int function (int x, int y) {\n"
+    "        // Indented line comment describing what happens next\n"
+    "        if (x < y)\n"
+    "                return x*y;\n"
+    "\n"
+    "        /*Another comment, inline this time*/\n"
+    "        return x + y; // Trailing comment\n"
+    "}\n"
+    "\n";
+
+static const char* generate (int size) {
+    const char* filename = "bench-lexer-skip.tmp.c";
+    FILE* file = fopen(filename, "w");
+
+    for (int written = 0; written < size; written += strlen(chunk))
+        fputs(chunk, file);
+
+    fclose(file);
+    return filename;
+}
+
+static double lexAll (const char* filename, int* tokens) {
+    clock_t start = clock();
+
+    atomTable atoms;
+    atomTableInit(&atoms, 1024);
+
+    lexerCtx* lexer = lexerInit(filename, &atoms);
+    *tokens = 0;
+
+    do {
+        lexerNext(lexer);
+        (*tokens)++;
+    } while (lexer->token != tokenEOF);
+
+    lexerEnd(lexer);
+    atomTableFree(&atoms);
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*Walk the whole stream, skipping whitespace and comments as
+  lexerSkipInsignificants does and stepping over anything else*/
+static double skipAll (const char* filename, bool bytewise) {
+    clock_t start = clock();
+
+    streamCtx* stream = streamInit(filename);
+    const char* end = streamGetEnd(stream);
+
+    while (stream->current != 0) {
+        char c = streamNext(stream);
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (bytewise)
+                while (   stream->current == ' ' || stream->current == '\t'
+                       || stream->current == '\n' || stream->current == '\r')
+                    streamNext(stream);
+
+            /*Only runs are worth the bulk scan, as in the lexer*/
+            else if (   stream->current == ' ' || stream->current == '\t'
+                     || stream->current == '\n' || stream->current == '\r')
+                streamSkipTo(stream, scanWhitespace(streamGetPtr(stream), end));
+
+        } else if (c == '/' && stream->current == '/') {
+            if (bytewise)
+                while (   stream->current != '\n' && stream->current != '\r'
+                       && stream->current != 0)
+                    streamNext(stream);
+
+            else
+                streamSkipTo(stream, scanFind(streamGetPtr(stream), end, '\n', '\r'));
+
+        } else if (c == '/' && stream->current == '*') {
+            streamNext(stream);
+
+            do {
+                if (bytewise)
+                    while (stream->current != '*' && stream->current != 0)
+                        streamNext(stream);
+
+                else
+                    streamSkipTo(stream, scanFind(streamGetPtr(stream), end, '*', '*'));
+
+                if (stream->current == 0)
+                    break;
+
+                streamNext(stream);
+            } while (stream->current != '/');
+
+            streamNext(stream);
+        }
+    }
+
+    streamEnd(stream);
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main (int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 64 << 20;
+    int rounds = 5;
+
+    const char* filename = generate(size);
+
+    for (scanImpl impl = scanScalar; impl <= scanAVX2; impl++) {
+        if (!scanSelect(impl)) {
+            printf("%-10s unsupported\n", scanImplGetStr(impl));
+            continue;
+        }
+
+        /*Best of a few rounds, the first also warming the page cache*/
+        double best = 0, bestSkip = 0;
+        int tokens = 0;
+
+        for (int i = 0; i < rounds; i++) {
+            double time = lexAll(filename, &tokens);
+            best = i == 0 || time < best ? time : best;
+
+            time = skipAll(filename, false);
+            bestSkip = i == 0 || time < bestSkip ? time : bestSkip;
+        }
+
+        printf("%-10s %8.1f MB/s  (%d tokens, %.3fs), skipping alone %8.1f MB/s\n",
+               scanImplGetStr(impl), size / best / (1 << 20), tokens, best,
+               size / bestSkip / (1 << 20));
+    }
+
+    double bestSkip = 0;
+
+    for (int i = 0; i < rounds; i++) {
+        double time = skipAll(filename, true);
+        bestSkip = i == 0 || time < bestSkip ? time : bestSkip;
+    }
+
+    printf("%-10s %*s skipping alone %8.1f MB/s\n",
+           "streamNext", 40, "", size / bestSkip / (1 << 20));
+
+    remove(filename);
+
+    return 0;
+}
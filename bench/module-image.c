@@ -0,0 +1,108 @@
+#include "../std/std.h"
+
+#include "../inc/compiler.h"
+#include "../inc/parser.h"
+#include "../inc/architecture.h"
+#include "../inc/scan.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+/*Parses a module using a large header, first from source, then with a
+  module image directory twice: once to write the header's image, and
+  once to load it in place of parsing*/
+
+enum {
+    structs = 400,
+    functions = 2000
+};
+
+static void generate (void) {
+    FILE* file = fopen("bench-image.tmp.h", "w");
+
+    for (int i = 0; i < structs; i++)
+        fprintf(file, "typedef struct s%d {int a; char* b; int c;} s%d;\n", i, i);
+
+    for (int i = 0; i < functions; i++)
+        fprintf(file, "int f%d (s%d* x, int y) {\n"
+                      "    int z = y*%d + x->a;\n"
+                      "    for (int i = 0; i < y; i++)\n"
+                      "        z += x->b[i] ? f%d(x, x->c) : 1;\n"
+                      "    return z;\n"
+                      "}\n", i, i % structs, i, i);
+
+    fclose(file);
+
+    file = fopen("bench-image.tmp.c", "w");
+    fprintf(file, "using \"bench-image.tmp.h\";\n");
+    fclose(file);
+}
+
+static void cleanup (const char* dir) {
+    /*The image is named by the hash of the header*/
+    moduleCache cache;
+    moduleCacheInit(&cache, dir);
+    moduleCacheEntry* entry = moduleCacheGetEntry(&cache, "bench-image.tmp.h");
+
+    if (entry) {
+        char* filename = malloc(strlen(dir) + 32);
+        sprintf(filename, "%s/%016llx.fcm", dir, (unsigned long long) entry->hash);
+        remove(filename);
+        free(filename);
+    }
+
+    moduleCacheFree(&cache);
+
+    remove("bench-image.tmp.h");
+    remove("bench-image.tmp.c");
+}
+
+static double seconds (clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double run (architecture* arch, vector* searchPaths, const char* dir) {
+    compilerCtx comp;
+    compilerInit(&comp, arch, searchPaths);
+    comp.moduleCache.dir = dir;
+
+    clock_t start = clock();
+    parserResult res = parser("bench-image.tmp.c", "", &comp);
+    double time = seconds(start);
+
+    if (res.errors || res.warnings)
+        printf("errors: %d, warnings: %d\n", res.errors, res.warnings);
+
+    compilerEnd(&comp);
+    return time;
+}
+
+int main (int argc, char** argv) {
+    const char* dir = argc > 1 ? argv[1] : ".";
+
+    scanInit();
+    generate();
+
+    architecture arch;
+    archInit(&arch);
+    archSetup(&arch, osLinux, 8);
+
+    vector searchPaths;
+    vectorInit(&searchPaths, 1);
+    vectorPush(&searchPaths, "");
+
+    double parsed = run(&arch, &searchPaths, 0),
+           written = run(&arch, &searchPaths, dir),
+           loaded = run(&arch, &searchPaths, dir);
+
+    printf("parsed in %.3fs, parsed and written in %.3fs, loaded in %.3fs\n",
+           parsed, written, loaded);
+
+    vectorFree(&searchPaths);
+    archFree(&arch);
+    cleanup(dir);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "../std/std.h"
+
+#include "../inc/compiler.h"
+#include "../inc/parser.h"
+#include "../inc/architecture.h"
+#include "../inc/sym.h"
+#include "../inc/scan.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+/*Parses a module using a layered graph of headers, each of which uses
+  every header in the layer below (so every path down is a diamond), then
+  looks up the deepest symbols and some that don't exist at all from the
+  top module's scope*/
+
+enum {
+    layers = 8,
+    width = 6,
+    symbolsPerModule = 40
+};
+
+static void generate (void) {
+    char filename[64];
+
+    for (int layer = 0; layer < layers; layer++) {
+        for (int n = 0; n < width; n++) {
+            sprintf(filename, "bench-using-%d-%d.tmp.h", layer, n);
+            FILE* file = fopen(filename, "w");
+
+            if (layer < layers-1)
+                for (int m = 0; m < width; m++)
+                    fprintf(file, "using \"bench-using-%d-%d.tmp.h\";\n", layer+1, m);
+
+            for (int i = 0; i < symbolsPerModule; i++)
+                fprintf(file, "int sym_%d_%d_%d;\n", layer, n, i);
+
+            fclose(file);
+        }
+    }
+
+    FILE* file = fopen("bench-using.tmp.c", "w");
+
+    for (int m = 0; m < width; m++)
+        fprintf(file, "using \"bench-using-0-%d.tmp.h\";\n", m);
+
+    fclose(file);
+}
+
+static void cleanup (void) {
+    char filename[64];
+
+    for (int layer = 0; layer < layers; layer++) {
+        for (int n = 0; n < width; n++) {
+            sprintf(filename, "bench-using-%d-%d.tmp.h", layer, n);
+            remove(filename);
+        }
+    }
+
+    remove("bench-using.tmp.c");
+}
+
+static double seconds (clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main (int argc, char** argv) {
+    int lookups = argc > 1 ? atoi(argv[1]) : 200000;
+
+    scanInit();
+    generate();
+
+    architecture arch;
+    archInit(&arch);
+    archSetup(&arch, osLinux, 8);
+
+    vector searchPaths;
+    vectorInit(&searchPaths, 1);
+    vectorPush(&searchPaths, "");
+
+    compilerCtx comp;
+    compilerInit(&comp, &arch, &searchPaths);
+
+    clock_t start = clock();
+    parserResult res = parser("bench-using.tmp.c", "", &comp);
+    double parseTime = seconds(start);
+
+    /*Half hits at the bottom of the graph, half misses*/
+    const char* names[64];
+    char name[64];
+
+    for (int i = 0; i < 64; i++) {
+        if (i % 2)
+            sprintf(name, "sym_%d_%d_%d", layers-1, i % width, i % symbolsPerModule);
+
+        else
+            sprintf(name, "missing_%d", i);
+
+        names[i] = atomGetStr(&comp.atoms, name);
+    }
+
+    int found = 0;
+    start = clock();
+
+    for (int i = 0; i < lookups; i++)
+        found += symFind(res.scope, names[i % 64]) != 0;
+
+    double lookupTime = seconds(start);
+
+    printf("%d modules: parsed in %.3fs, %8.1f ns/lookup (%d/%d found)\n",
+           comp.moduleList.length, parseTime, lookupTime / lookups * 1e9, found, lookups);
+
+    compilerEnd(&comp);
+    vectorFree(&searchPaths);
+    archFree(&arch);
+    cleanup();
+
+    return 0;
+}
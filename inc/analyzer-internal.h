@@ -6,13 +6,14 @@ typedef struct ast ast;
 typedef struct sym sym;
 typedef struct type type;
 typedef struct architecture architecture;
+typedef struct sourceManager sourceManager;
 
 /**
  * Analyzer context specific to a function
  */
 typedef struct analyzerFnCtx {
     sym* fn;
-    type* returnType;
+    const type* returnType;
 } analyzerFnCtx;
 
 /**
@@ -23,6 +24,8 @@ typedef struct analyzerFnCtx {
 typedef struct analyzerCtx {
     ///An array of built-in types
     sym** types;
+    ///Files and their locations, for errors
+    const sourceManager* sources;
     ///Architecture, used only for compile time evaluation of array sizes and,
     ///in turn, enum constants
     const architecture* arch;
@@ -56,4 +59,4 @@ void analyzerCompoundInit (analyzerCtx* ctx, ast* Node, const type* DT);
 
 void analyzerDecl (analyzerCtx* ctx, ast* Node, bool module);
 const type* analyzerType (analyzerCtx* ctx, ast* Node);
-type* analyzerParamList (analyzerCtx* ctx, ast* Node, type* returnType);
+const type* analyzerParamList (analyzerCtx* ctx, ast* Node, const type* returnType);
@@ -1,6 +1,7 @@
 typedef struct ast ast;
 typedef struct sym sym;
 typedef struct architecture architecture;
+typedef struct sourceManager sourceManager;
 
 /**
  * Semantic analysis result
@@ -19,4 +20,4 @@ typedef struct analyzerResult {
  * Assumes a well formed AST in terms of fields filled and constraints on
  * what fills them upheld.
  */
-analyzerResult analyzer (ast* Tree, sym** Types, const architecture* arch);
+analyzerResult analyzer (ast* Tree, sym** Types, const sourceManager* sources, const architecture* arch);
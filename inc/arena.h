@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "stddef.h"
+
+typedef struct arenaBlock arenaBlock;
+
+/**
+ * A region that objects are bump allocated from and then freed all at
+ * once, by arenaFree. Nothing allocated from an arena can be freed (or
+ * realloc'd) individually.
+ *
+ * The AST, symbols and types live in arenas: one per module, owned by its
+ * parserResult, and one for the compiler as a whole. They allocate from
+ * whichever is current, @see arenaSetCurrent.
+ */
+typedef struct arena {
+    arenaBlock* blocks;
+    char *next, *end;
+    size_t blockSize;
+
+    ///Statistics: bytes handed out, bytes malloc'd and number of allocations
+    size_t allocated, reserved;
+    int allocations;
+} arena;
+
+arena* arenaInit (arena* a, size_t blockSize);
+void arenaFree (arena* a);
+
+/**
+ * Returns zeroed memory, suitably aligned for any object
+ */
+void* arenaAlloc (arena* a, size_t size);
+
+char* arenaStrdup (arena* a, const char* str);
+char* arenaStrndup (arena* a, const char* str, int length);
+
+/**
+ * Move everything allocated from one arena into another, to be freed
+ * with it. The arena moved from is left empty.
+ */
+void arenaAdopt (arena* a, arena* from);
+
+/**
+ * Was ptr allocated from the arena? Linear in the number of blocks.
+ */
+bool arenaOwns (const arena* a, const void* ptr);
+
+/**
+ * Set the arena that the AST, symbols and types are allocated from on
+ * this thread, returning the previous one
+ */
+arena* arenaSetCurrent (arena* a);
+arena* arenaGetCurrent (void);
@@ -1,32 +1,18 @@
+#include "vector.h"
 #include "operand.h"
+#include "ir.h"
 
 #include "stdint.h"
 #include "stdio.h"
 
 typedef struct asmCtx asmCtx;
-typedef struct irBlock irBlock;
-typedef struct irCtx irCtx;
 typedef enum regIndex regIndex;
 
-typedef enum boperation {
-    bopUndefined,
-    bopAdd,
-    bopSub,
-    bopMul,
-    bopBitAnd,
-    bopBitOr,
-    bopBitXor,
-    bopShR,
-    bopShL
-} boperation;
-
-typedef enum uoperation {
-    uopUndefined,
-    uopInc,
-    uopDec,
-    uopNeg,
-    uopBitwiseNot
-} uoperation;
+/**
+ * Write an instruction out as assembly. By now its registers must all be
+ * physical, @see irAllocRegs
+ */
+void asmInstr (asmCtx* ctx, const irInstr* instr);
 
 void asmFilePrologue (asmCtx* ctx);
 void asmFileEpilogue (asmCtx* ctx);
@@ -34,8 +20,12 @@ void asmFileEpilogue (asmCtx* ctx);
 void asmFnLinkageBegin (FILE* file, const char* name);
 void asmFnLinkageEnd (FILE* file, const char* name);
 
-void asmFnPrologue (irCtx* ir, irBlock* block, int localSize);
-void asmFnEpilogue (irCtx* ir, irBlock* block);
+/**
+ * Create the stack frame, with room for localSize bytes, and save the given
+ * (callee save) registers. The epilogue restores them and pops the frame.
+ */
+void asmFnPrologue (irCtx* ir, irBlock* block, int localSize, const vector/*<regIndex>*/* savedRegs);
+void asmFnEpilogue (irCtx* ir, irBlock* block, const vector/*<regIndex>*/* savedRegs);
 
 /**
  * Save and restore a register using the stack
@@ -77,6 +67,7 @@ void asmPopN (irCtx* ir, irBlock* block, int n);
 
 void asmMove (irCtx* ir, irBlock* block, operand Dest, operand Src);
 void asmConditionalMove (irCtx* ir, irBlock* block, operand Cond, operand Dest, operand Src);
+void asmSignExtend (irCtx* ir, irBlock* block, operand Dest, operand Src);
 void asmRepStos (irCtx* ir, irBlock* block, operand RAX, operand RCX, operand RDI,
                  operand Dest, int length, operand Src);
 
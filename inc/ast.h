@@ -11,6 +11,11 @@
 typedef struct type type;
 typedef struct ast ast;
 
+enum {
+    ///Number of children stored inside an AST node, before going to the arena
+    astInlineChildren = 4
+};
+
 /**
  * Kind of AST node. Adding a new one requires:
  *  - Deciding if it is a value tag
@@ -110,33 +115,31 @@ typedef enum literalTag {
  *      - Any child is itself a DeclExpr, other than
  *         - The right child of a BOP[o=Assign],
  *         - The right child of an Index,
- *         - The linked list children of a Call.
+ *         - The children of a Call.
  *      - After parsing, if the DeclExpr declares a symbol it will be
  *        stored in symbol.
  *
- * Owns:
- *   - All children
- *      - Except for the right child of an astUsing.
- *   - dt
- *   - literal
+ * Nodes, along with their dt and literal, are allocated from the current
+ * arena (that of the module being parsed) and freed with it. Identifier
+ * literals are atoms. @see arenaSetCurrent
  */
 typedef struct ast {
     astTag tag;
 
     tokenLocation location;
 
-    /*Linked list for container nodes like a module or parameter list and children of containers*/
-    ast* firstChild;
-    ast* lastChild;
-    ast* nextSibling;
-    ast* prevSibling;
-    int children;
+    /*Children of container nodes like a module or parameter list, in order.
+      child points to inlineChildren until there are more than fit there,
+      then to a buffer in the arena.*/
+    ast** child;
+    int children, childCapacity;
+    ast* inlineChildren[astInlineChildren];
 
     /*Binary tree*/
     ast* l;
     opTag o;
     ast* r;      /*Always used for unary operators*/
-    type* dt;    /*Result data type*/
+    const type* dt;    /*Result data type*/
 
     sym* symbol;
 
@@ -144,7 +147,8 @@ typedef struct ast {
         /*(DeclExpr) astLiteral[lit=Ident]*/
         storageTag storage;
         /*(DeclExpr) astBOP[o=Assign]
-          astMarker[m=ArrayDesignator]*/
+          astMarker[m=ArrayDesignator]
+          astFnImpl: if the body was skipped, its length in locations*/
         intptr_t constant;
     };
 
@@ -160,7 +164,6 @@ typedef struct ast {
 } ast;
 
 ast* astCreate (astTag tag, tokenLocation location);
-void astDestroy (ast* Node);
 
 ast* astCreateInvalid (tokenLocation location);
 ast* astCreateMarker (tokenLocation location, markerTag marker);
@@ -186,11 +189,20 @@ ast* astCreateCall (tokenLocation location, ast* function);
 ast* astCreateCast (tokenLocation location, ast* result, ast* r);
 ast* astCreateSizeof (tokenLocation location, ast* r);
 ast* astCreateLiteral (tokenLocation location, literalTag litTag);
-ast* astCreateLiteralIdent (tokenLocation location, char* ident);
+ast* astCreateLiteralIdent (tokenLocation location, const char* ident);
 ast* astCreateAssert (tokenLocation location, ast* expr);
 
+/**
+ * Append a child, growing the child array (in the current arena) if full
+ */
 void astAddChild (ast* Parent, ast* Child);
 
+/**
+ * Return the first / last child, or null if there are none
+ */
+ast* astFirstChild (const ast* Node);
+ast* astLastChild (const ast* Node);
+
 bool astIsValueTag (astTag tag);
 
 /**
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "arena.h"
+
+/**
+ * An atom table interns strings: every distinct spelling is stored once
+ * and always handed back as the same pointer. Atoms can therefore be
+ * compared for equality with ==.
+ *
+ * Atoms are null terminated, owned by the table and live until atomTableFree.
+ */
+typedef struct atomTable {
+    int size, elements;
+    const char** atoms;
+    int* lengths;
+    unsigned int* hashes;
+    ///The strings themselves
+    arena strings;
+} atomTable;
+
+atomTable* atomTableInit (atomTable* table, int size);
+void atomTableFree (atomTable* table);
+
+/**
+ * Intern a string of a given length. str need not be null terminated.
+ */
+const char* atomGet (atomTable* table, const char* str, int length);
+
+/**
+ * Intern a null terminated string
+ */
+const char* atomGetStr (atomTable* table, const char* str);
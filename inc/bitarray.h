@@ -1,8 +1,10 @@
 #pragma once
 
+#include "../std/std.h"
+
 #include "stdint.h"
 
-typedef intmax_t bitarrayWord;
+typedef uintmax_t bitarrayWord;
 
 /**
  * A packed array of bits aka bitmap, bitset, bitfield etc
@@ -23,3 +25,37 @@ bool bitarrayUnset (bitarray* bits, int index);
  * Return non-zero if the bit was set
  */
 bitarrayWord bitarrayTest (const bitarray* bits, int index);
+
+/*==== Whole arrays ====*/
+
+/**
+ * The operations on whole arrays work a word at a time. Arrays given
+ * together must have the same number of bits.
+ */
+
+void bitarrayClear (bitarray* bits);
+void bitarraySetAll (bitarray* bits);
+
+void bitarrayCopy (bitarray* dest, const bitarray* src);
+bool bitarrayEqual (const bitarray* l, const bitarray* r);
+
+/**
+ * dest = dest | src, dest & src and dest & ~src, respectively
+ * @return Whether dest changed
+ */
+bool bitarrayUnion (bitarray* dest, const bitarray* src);
+bool bitarrayIntersect (bitarray* dest, const bitarray* src);
+bool bitarrayDifference (bitarray* dest, const bitarray* src);
+
+/**
+ * The first set bit at or after index, or -1 if there are none. To visit
+ * every set bit:
+ *
+ *     for (int i = bitarrayNext(bits, 0); i >= 0; i = bitarrayNext(bits, i+1))
+ */
+int bitarrayNext (const bitarray* bits, int index);
+
+/**
+ * Number of bits set
+ */
+int bitarrayCount (const bitarray* bits);
@@ -3,8 +3,14 @@
 #include "../std/std.h"
 
 #include "hashmap.h"
+#include "vector.h"
+#include "atom.h"
+#include "arena.h"
+#include "source.h"
+#include "type.h"
+#include "module.h"
+#include "ir-peephole.h"
 
-typedef struct vector vector;
 typedef struct architecture architecture;
 typedef struct sym sym;
 
@@ -27,9 +33,37 @@ typedef struct compilerCtx {
     sym** types;
 
     hashmap/*<parserResult*>*/ modules;
+    ///The same, in the order they were parsed
+    vector/*<parserResult*>*/ moduleList;
+
+    ///Anything not belonging to a particular module, e.g. the global scope
+    ///and built in types
+    arena arena;
+
+    ///Identifiers of every module, shared so that symbols can be compared
+    ///by pointer
+    atomTable atoms;
+
+    ///Every type of every module, each distinct one made only once
+    typeTable typeTable;
+
+    ///Every file parsed and the locations they were given
+    sourceManager sources;
+
+    ///Images of used modules, loaded in place of parsing them. Off unless
+    ///given a directory.
+    moduleCache moduleCache;
 
     const architecture* arch;
     const vector/*<char*>*/* searchPaths;
+    ///Threads that the functions of a module may be generated on
+    int threads;
+    ///Skip the function bodies of used modules, parsing them only once
+    ///something refers to the function. @see parserBodies
+    bool interfaces;
+
+    ///Times each peephole rule fired, over every module emitted
+    irPeepholeStats peephole;
 
     int errors, warnings;
 } compilerCtx;
@@ -38,3 +72,8 @@ void compilerInit (compilerCtx* ctx, const architecture* arch, const vector/*<ch
 void compilerEnd (compilerCtx* ctx);
 
 void compiler (compilerCtx* ctx, const char* input, const char* output);
+
+/**
+ * Print the memory used by each module, and in total, per line of source
+ */
+void compilerPrintStats (const compilerCtx* ctx);
@@ -16,7 +16,12 @@ typedef enum debugMode {
     debugSilent
 } debugMode;
 
+/**
+ * Set the log for this thread. Debug output, internal errors and
+ * diagnostics are all written to it.
+ */
 void debugInit (FILE* log);
+FILE* debugGetLog (void);
 
 debugMode debugSetMode (debugMode mode);
 
@@ -56,4 +61,5 @@ void reportNode (const ast* Node);
 void reportRegs (void);
 void reportOperand (const architecture* arch, const operand* R);
 
-extern int internalErrors;
+///Counted per thread
+extern _Thread_local int internalErrors;
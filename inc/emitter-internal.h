@@ -1,4 +1,5 @@
 #include "operand.h"
+#include "hashmap.h"
 
 typedef struct ast ast;
 typedef struct architecture architecture;
@@ -7,12 +8,19 @@ typedef struct irFn irFn;
 typedef struct irCtx irCtx;
 typedef enum regIndex regIndex;
 
+typedef struct emitterInlined emitterInlined;
+
 typedef struct emitterCtx {
     irCtx* ir;
     const architecture* arch;
 
     irFn* curFn;
+    ///The function or lambda that curFn was generated from
+    const sym* curFnSymbol;
     irBlock *returnTo, *breakTo, *continueTo;
+
+    ///The innermost body being generated in place of a call, if any
+    emitterInlined* inlined;
 } emitterCtx;
 
 /*==== emitter-helpers.c ==== Emitter helper functions ====*/
@@ -41,10 +49,52 @@ void emitterZeroMem (emitterCtx* ctx, irBlock* block, operand L);
 
 int emitterFnAllocateStack (const architecture* arch, sym* fn);
 
+/**
+ * Lay out the params and locals of a function below a stack frame of the
+ * given size, without changing the symbols.
+ * @param offsets Filled with the offset of each symbol
+ * @return The new size of the frame
+ */
+int emitterFnInlineStack (const architecture* arch, const sym* fn, int stacksize, intmap* offsets);
+
 /*==== emitter.c ==== Code generation for blocks and statements ====*/
 
 irBlock* emitterCode (emitterCtx* ctx, irBlock* block, const ast* Node, irBlock* continuation);
 
+/*==== emitter-inline.c ==== Generating small functions at their calls ====*/
+
+/**
+ * A function or lambda body being generated in place of a call to it
+ */
+typedef struct emitterInlined {
+    const sym* fn;
+    ///Offsets in the caller's frame given to the params and locals
+    intmap/*<const sym*, int>*/ offsets;
+    ///Params given a lambda literal and only ever called: the lambda is
+    ///inlined at those calls instead
+    intmap/*<const sym*, const ast*>*/ lambdas;
+    ///Where the value of any return goes
+    operand result;
+    int depth;
+    emitterInlined* parent;
+} emitterInlined;
+
+/**
+ * The impl or lambda literal to generate in place of a call, or null if
+ * the call should be made normally.
+ */
+const ast* emitterInlineTarget (const emitterCtx* ctx, const ast* Node);
+
+operand emitterInline (emitterCtx* ctx, irBlock** block, const ast* Node, const ast* impl);
+
+void emitterInlineReturn (emitterCtx* ctx, irBlock** block, const ast* Node);
+
+/**
+ * The frame offset of a param or auto variable, which differs from the one
+ * it was given if it is from an inlined body.
+ */
+int emitterSymbolOffset (const emitterCtx* ctx, const sym* Symbol);
+
 /*==== emitter-decl.c ====*/
 
 void emitterDecl (emitterCtx* ctx, irBlock** block, const ast* Node);
@@ -78,6 +128,13 @@ operand emitterValue (emitterCtx* ctx, irBlock** block, const ast* Node, emitter
  */
 operand emitterValueSuggest (emitterCtx* ctx, irBlock** block, const ast* Node, const operand* request);
 
+/**
+ * Generate a returned call as a jump, reusing this fn's frame, if possible.
+ * Recursion just jumps back to the entry point. The block is terminated if
+ * this returns true, otherwise nothing is generated.
+ */
+bool emitterTailCall (emitterCtx* ctx, irBlock* block, const ast* Node);
+
 operand emitterSymbol (emitterCtx* ctx, const sym* Symbol);
 
 void emitterCompoundInit (emitterCtx* ctx, irBlock** block, const ast* Node, operand base);
@@ -1,4 +1,11 @@
 typedef struct ast ast;
 typedef struct architecture architecture;
+typedef struct irPeepholeStats irPeepholeStats;
 
-void emitter (const ast* Tree, const char* output, const architecture* arch);
+/**
+ * Generate the assembly for a module. Its functions are generated on up to
+ * the given number of threads, with the same output whatever the number.
+ * @param peephole If not null, added to with the times each peephole rule fired
+ */
+void emitter (const ast* Tree, const char* output, const architecture* arch, int threads,
+              irPeepholeStats* peephole);
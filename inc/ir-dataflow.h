@@ -0,0 +1,162 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "vector.h"
+#include "hashmap.h"
+#include "bitarray.h"
+
+typedef struct reg reg;
+typedef struct irInstr irInstr;
+typedef struct irBlock irBlock;
+typedef struct irFn irFn;
+
+/**
+ * Dataflow problems over the blocks of a function, solved iteratively.
+ *
+ * Each block has a gen and kill set, given by the client, and an in and
+ * out set, solved for. The sets are dense bitarrays over whatever the
+ * client numbers: virtual registers, definitions etc. The transfer
+ * function of a block is
+ *
+ *     out = gen | (in & ~kill)        (forward)
+ *     in  = gen | (out & ~kill)       (backward)
+ *
+ * and where control flow joins, the sets are met by union or intersection.
+ * Where it starts (entry of the prologue, or exit of the blocks with no
+ * successors) the sets are empty.
+ */
+
+typedef enum irDataflowDirection {
+    dataflowForward,
+    dataflowBackward
+} irDataflowDirection;
+
+typedef enum irDataflowMeet {
+    meetUnion,
+    meetIntersection
+} irDataflowMeet;
+
+typedef struct irDataflow {
+    irFn* fn;
+    irDataflowDirection direction;
+    irDataflowMeet meet;
+    int bitno;
+
+    ///Every block of the fn, in the order they will be emitted and then
+    ///any left out of that order. Visited in reverse for backward problems.
+    vector/*<irBlock*>*/ order;
+
+    ///By nthChild
+    bitarray *gen, *kill, *in, *out;
+
+    ///Passes over the blocks the last solve took
+    int passes;
+} irDataflow;
+
+/**
+ * The sets start empty, except in and out of an intersection problem which
+ * start full
+ */
+irDataflow* irDataflowInit (irDataflow* flow, irFn* fn, irDataflowDirection direction,
+                            irDataflowMeet meet, int bitno);
+void irDataflowFree (irDataflow* flow);
+
+/**
+ * Iterate until in and out stop changing
+ * @return The number of passes over the blocks it took, also kept in passes
+ */
+int irDataflowSolve (irDataflow* flow);
+
+/**
+ * Print the in and out sets of each block, in order, through debugMsg.
+ * Members are printed as they are named by the callback.
+ */
+typedef void (*irDataflowNamer)(const void* client, int index);
+void irDataflowDump (const irDataflow* flow, const void* client, irDataflowNamer namer);
+
+/*==== Liveness ====*/
+
+/**
+ * Which virtual registers are live (may yet be read before being written)
+ * at each point of a function. A backward union problem.
+ */
+typedef struct irLiveness {
+    irDataflow flow;
+    int wordsize;
+
+    ///The virtual registers named in the fn, by index
+    vector/*<reg*>*/ regs;
+    ///Index of each register plus one
+    intmap/*<intptr_t>*/ indices;
+    ///The widest each register is named at, by index. A narrower write
+    ///keeps the rest of it.
+    int* sizes;
+} irLiveness;
+
+/**
+ * Number the registers of a function and solve for their liveness. The
+ * function must not change until freed.
+ */
+irLiveness* irLivenessInit (irLiveness* live, irFn* fn, int wordsize);
+void irLivenessFree (irLiveness* live);
+
+/**
+ * Index of a virtual register in the sets, -1 if not named by the fn
+ */
+int irLivenessGetIndex (const irLiveness* live, const reg* vreg);
+
+/**
+ * The registers live just before the nth instruction of a block, or if n is
+ * the instruction count, before its terminal
+ * @param result Of bitno live->flow.bitno, overwritten
+ */
+void irLivenessAt (const irLiveness* live, const irBlock* block, int n, bitarray* result);
+
+/**
+ * Step back over an instruction: what it writes is dead before it (unless
+ * also read), and what it reads is live
+ */
+void irLivenessTransfer (const irLiveness* live, irInstr* instr, bitarray* bits);
+
+void irLivenessDump (const irLiveness* live);
+
+/*==== Reaching definitions ====*/
+
+/**
+ * Which instructions writing a virtual register may have been the last to
+ * do so, at each point of a function. A forward union problem.
+ *
+ * An instruction that keeps some of what was there (a conditional or
+ * partial write) doesn't stop the definitions before it reaching on.
+ */
+typedef struct irReachingDefs {
+    irDataflow flow;
+    int wordsize;
+
+    ///Every instruction writing a virtual register, by index
+    vector/*<irInstr*>*/ defs;
+    ///The register written by each
+    vector/*<reg*>*/ defRegs;
+    ///Whether each keeps some of what was there, so doesn't replace the others
+    bool* partial;
+    ///Index of each instruction plus one
+    intmap/*<intptr_t>*/ indices;
+    ///The indices of the definitions of each register
+    intmap/*<vector<intptr_t>*>*/ regDefs;
+} irReachingDefs;
+
+irReachingDefs* irReachingDefsInit (irReachingDefs* reaching, irFn* fn, int wordsize);
+void irReachingDefsFree (irReachingDefs* reaching);
+
+/**
+ * Index of an instruction in the sets, -1 if it defines no register
+ */
+int irReachingDefsGetIndex (const irReachingDefs* reaching, const irInstr* instr);
+
+/**
+ * The definitions reaching the nth instruction of a block, @see irLivenessAt
+ */
+void irReachingDefsAt (const irReachingDefs* reaching, const irBlock* block, int n, bitarray* result);
+
+void irReachingDefsDump (const irReachingDefs* reaching);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../std/std.h"
+
+typedef struct irCtx irCtx;
+
+/**
+ * The rules of the peephole pass, @see irPeephole
+ */
+typedef enum irPeepholeRule {
+    ///mov x, x
+    peepholeMoveSelf,
+    ///mov x, y; mov y, x => mov x, y
+    peepholeMoveBack,
+    ///mov r, x; mov r, y => mov r, y
+    peepholeMoveOverwritten,
+    ///mov r, x; mov y, r => mov y, x (or push), if r is written before read again
+    peepholeMoveForward,
+    ///push x; pop y => mov y, x, or nothing if the same
+    peepholePushPop,
+    ///add x, 0 and the like, if the flags aren't read
+    peepholeNoOp,
+    ///mov x, c; cmov x, c => mov x, c
+    peepholeCondMoveSame,
+    ///mov x, 0; cmov x, 1 => mov x, 0; set x
+    peepholeSetCond,
+    peepholeRuleNo
+} irPeepholeRule;
+
+typedef struct irPeepholeStats {
+    ///Times each rule fired, by irPeepholeRule
+    int fired[peepholeRuleNo];
+} irPeepholeStats;
+
+/**
+ * Rewrite short sequences of instructions within each block into fewer or
+ * cheaper ones, by a table of rules. Runs once registers are allocated,
+ * just before irEmit.
+ * @param stats If not null, added to
+ */
+void irPeephole (irCtx* ctx, irPeepholeStats* stats);
+
+/**
+ * Print the times each rule fired, to the debug log
+ */
+void irPeepholePrintStats (const irPeepholeStats* stats);
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "vector.h"
+#include "hashmap.h"
+
+typedef struct reg reg;
+typedef struct irInstr irInstr;
+typedef struct irBlock irBlock;
+typedef struct irFn irFn;
+
+/*==== Dominators ====*/
+
+/**
+ * The dominator tree of a function, and the dominance frontier of each
+ * block, after Cooper, Harvey & Kennedy. Only the blocks reachable from
+ * the prologue are covered.
+ */
+typedef struct irDominators {
+    irFn* fn;
+
+    ///Reachable blocks in reverse postorder, so every block after its
+    ///immediate dominator
+    vector/*<irBlock*>*/ order;
+
+    ///By nthChild: the immediate dominator (null for the prologue and the
+    ///unreachable), position in order (-1 if unreachable), children in the
+    ///tree, and frontier
+    irBlock** idoms;
+    int* postorder;
+    vector/*<irBlock*>*/ *children, *frontiers;
+} irDominators;
+
+irDominators* irDominatorsInit (irDominators* doms, irFn* fn);
+void irDominatorsFree (irDominators* doms);
+
+bool irBlockIsReachable (const irDominators* doms, const irBlock* block);
+
+/**
+ * Does every path from the prologue to b go through a (a dominating itself)
+ */
+bool irBlockDominates (const irDominators* doms, const irBlock* a, const irBlock* b);
+
+/*==== Natural loops ====*/
+
+/**
+ * A natural loop: the target of one or more back edges (from a block it
+ * dominates), and every block that can reach one of them without going
+ * through it. Back edges to the same header make one loop.
+ */
+typedef struct irLoop {
+    irBlock* header;
+    ///The header first
+    vector/*<irBlock*>*/ blocks;
+    ///By nthChild, as numbered when found
+    bool* contains;
+    ///The sources of the back edges
+    vector/*<irBlock*>*/ latches;
+} irLoop;
+
+/**
+ * Find the loops of the function, smallest first, so any loop comes
+ * before those it is nested in
+ */
+void irLoopsFind (const irDominators* doms, vector/*<irLoop*>*/* loops);
+void irLoopDestroy (irLoop* loop);
+
+/*==== SSA ====*/
+
+/**
+ * Static single assignment form of the virtual registers of a function.
+ *
+ * The IR itself is left as it is, as nothing after this understands phis.
+ * Instead the form is kept alongside: every definition (an instruction
+ * writing a register, or a phi where definitions meet) is numbered, and
+ * every read of a register is linked to the one definition that reaches it.
+ * Phis are only placed where the register is live (pruned SSA).
+ */
+typedef enum irSSADefTag {
+    ssaUndefined,
+    ///The value the register had on entry, as read before any write
+    ssaEntry,
+    ssaInstr,
+    ssaPhi
+} irSSADefTag;
+
+typedef struct irSSADef irSSADef;
+
+typedef struct irSSADef {
+    irSSADefTag tag;
+    int n;
+
+    reg* vreg;
+    irBlock* block;
+
+    ///ssaInstr. If the instruction keeps some of what was there (a partial
+    ///or conditional write), prior is the definition it modifies.
+    irInstr* instr;
+    irSSADef* prior;
+
+    ///ssaPhi: the definition coming from each pred, in order of block->preds
+    vector/*<irSSADef*>*/ args;
+
+    ///Blocks with instructions or phis reading this, once each
+    vector/*<irBlock*>*/ users;
+} irSSADef;
+
+typedef struct irSSA {
+    irDominators doms;
+    int wordsize;
+
+    vector/*<irSSADef*>*/ defs;
+
+    ///Phis by nthChild
+    vector/*<irSSADef*>*/* phis;
+
+    ///The definition read, by where in an instruction the register is named
+    ///(the reg** given by irInstrGetRegs)
+    intmap/*<irSSADef*>*/ uses;
+    ///The definition made by each instruction writing a register
+    intmap/*<irSSADef*>*/ instrDefs;
+} irSSA;
+
+irSSA* irSSAInit (irSSA* ssa, irFn* fn, int wordsize);
+void irSSAFree (irSSA* ssa);
+
+/**
+ * The definition read by the register operand at where, null if where is
+ * not read (or is in an unreachable block)
+ */
+irSSADef* irSSAGetUse (const irSSA* ssa, reg* const* where);
+
+/**
+ * The definition made by an instruction, null if it writes no register
+ */
+irSSADef* irSSAGetDef (const irSSA* ssa, const irInstr* instr);
+
+void irSSADump (const irSSA* ssa);
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "vector.h"
 #include "ast.h"
 #include "operand.h"
@@ -7,23 +9,86 @@
 typedef struct sym sym;
 typedef struct architecture architecture;
 typedef struct asmCtx asmCtx;
+typedef enum regIndex regIndex;
 
 typedef struct irBlock irBlock;
 
 /*====  ====*/
 
+typedef enum boperation {
+    bopUndefined,
+    bopAdd,
+    bopSub,
+    bopMul,
+    bopBitAnd,
+    bopBitOr,
+    bopBitXor,
+    bopShR,
+    bopShL
+} boperation;
+
+typedef enum uoperation {
+    uopUndefined,
+    uopInc,
+    uopDec,
+    uopNeg,
+    uopBitwiseNot
+} uoperation;
+
+/**
+ * Instructions are those of the target, with the operands it allows
+ * (the asm* functions take care of that), but kept apart so that they can
+ * be inspected and rewritten. They are only written out as assembly by
+ * irEmit.
+ *
+ * Operands are in dest, l and r, each left undefined where not used.
+ */
 typedef enum irInstrTag {
     instrUndefined,
+    ///dest = l
     instrMove,
+    ///dest = l, zero or sign extended to the size of dest
+    instrMoveZeroExt,
+    instrMoveSignExt,
+    ///dest = l if r, a flags operand
+    instrConditionalMove,
+    ///dest, a byte, = 1 if r, a flags operand, else 0
+    instrSetCond,
+    ///dest = the address of l
+    instrEvalAddress,
+    ///Set the flags comparing l and r
+    instrCompare,
+    ///dest = l bop r, where l is dest but for a multiplication by a literal
     instrBOP,
-    instrUOP
+    ///dest = uop l, where l is dest
+    instrUOP,
+    ///RAX, RDX = RDX:RAX / l, RDX:RAX % l
+    instrDivision,
+    instrPush,
+    instrPop,
+    ///Fill RCX words at RDI with RAX, l being the size of a word
+    instrRepStos,
+    ///The first part of a termCallIndirect, @see irCallIndirect
+    instrCallIndirect,
+    ///dest, a physical register, is taken or given back, @see irBlockTakeReg
+    instrTakeReg,
+    instrGiveBackReg
 } irInstrTag;
 
 typedef struct irInstr {
     irInstrTag tag;
-    opTag op;
+
+    union {
+        /*instrBOP*/
+        boperation bop;
+        /*instrUOP*/
+        uoperation uop;
+    };
 
     operand dest, l, r;
+
+    ///instrConditionalMove: jumped to if the condition fails
+    char* label;
 } irInstr;
 
 /*====  ====*/
@@ -34,7 +99,10 @@ typedef enum irTermTag {
     termBranch,
     termCall,
     termCallIndirect,
-    termReturn
+    termReturn,
+    ///Leave this fn's frame then jump to another, which returns to our
+    ///caller in our place, @see irTailCall
+    termTailCall
 } irTermTag;
 
 typedef struct irTerm {
@@ -48,11 +116,12 @@ typedef struct irTerm {
             irBlock *ifTrue, *ifFalse;
             operand cond;
         };
-        /*termCall termCallIndirect*/
+        /*termCall termCallIndirect termTailCall*/
         struct {
+            ///Null for a termTailCall
             irBlock* ret;
             union {
-                /*termCall*/
+                /*termCall termTailCall*/
                 sym* toAsSym;
                 /*termCallIndirect*/
                 operand toAsOperand;
@@ -96,9 +165,6 @@ typedef struct irBlock {
 
     char* label;
 
-    char* str;
-    int length, capacity;
-
     ///Index in the parent Fn's vector
     int nthChild;
 
@@ -109,10 +175,13 @@ typedef struct irBlock {
 
 typedef struct irFn {
     char* name;
-    ///prologue and epilogue manage the stack frame and register saving
-    ///created and managed internally. entryPoint is what the emitter should
-    ///fill, using epilogue as a continuation / return point
+    ///prologue and epilogue manage the stack frame and register saving,
+    ///written by irAllocRegs once the registers used are known. entryPoint
+    ///is what the emitter should fill, using epilogue as a continuation /
+    ///return point
     irBlock *prologue, *entryPoint, *epilogue;
+    ///Bytes of stack for locals, not counting any spill slots
+    int stacksize;
     ///Includes and owns the above blocks, as well as all others
     vector/*<irBlock*>*/ blocks;
 } irFn;
@@ -121,7 +190,8 @@ typedef struct irCtx {
     vector/*<irFn*>*/ fns;
     vector/*<irStaticData*>*/ data, rodata;
 
-    int labelNo;
+    ///Labels are numbered within a unit, and prefixed with its number
+    int unit, labelNo;
 
     asmCtx* asm;
     const architecture* arch;
@@ -130,13 +200,87 @@ typedef struct irCtx {
 void irInit (irCtx* ctx, const char* output, const architecture* arch);
 void irFree (irCtx* ctx);
 
+/**
+ * A unit is part of a module, e.g. a function, generated in its own
+ * context so that the units can be generated in any order, or at once.
+ * It shares the module's asm context, but labels, functions and data are
+ * its own until merged back into the module.
+ */
+void irUnitInit (irCtx* unit, const irCtx* module, int unitNo);
+
+/**
+ * Move the functions and data of a unit onto the end of the module's,
+ * in that order, and free the unit
+ */
+void irUnitMerge (irCtx* module, irCtx* unit);
+
+char* irCreateLabel (irCtx* ctx);
+
 void irEmit (irCtx* ctx);
 
 /**If no name is provided, one will be allocated*/
 irFn* irFnCreate (irCtx* ctx, const char* name, int stacksize);
 irBlock* irBlockCreate (irCtx* ctx, irFn* fn);
 
-void irBlockOut (irBlock* block, const char* format, ...);
+/*==== Instructions ====*/
+
+/**
+ * Append an instruction to a block. Register operands are fixed at the size
+ * their registers are allocated as now, as a register may be resized later.
+ */
+irInstr* irInstrCreate (irBlock* block, irInstrTag tag, operand dest, operand l, operand r);
+
+/**
+ * Free an instruction already taken out of its block
+ */
+void irInstrDestroy (irInstr* instr);
+
+enum {
+    ///Registers named by a single instruction, at most
+    irInstrMaxRegs = 8
+};
+
+/**
+ * A virtual register named by an instruction, and what the instruction
+ * does with it
+ */
+typedef struct irRegUse {
+    ///Where in the instruction's operands, so that it can be replaced
+    reg** where;
+    int size;
+    bool read, written;
+} irRegUse;
+
+/**
+ * Find the virtual registers an instruction names, in the order of its
+ * operands. Registers forming an address are only read, at the word size.
+ * Directives name none.
+ *
+ * A write narrower than the register keeps the rest of it, so may need to
+ * be treated as a read as well. That is left to the caller, which knows
+ * how wide the register really is.
+ * @return The number of uses written, at most irInstrMaxRegs
+ */
+int irInstrGetRegs (irInstr* instr, int wordsize, irRegUse* uses);
+
+/**
+ * Is the dest written, rather than only read (a compare, push etc.)
+ */
+bool irInstrWritesDest (const irInstr* instr);
+
+bool irInstrSetsFlags (const irInstr* instr);
+
+/**
+ * Does the function take the address of a stack slot (or otherwise read
+ * the frame pointer as a value), so that a pointer might reach one
+ */
+bool irFnTakesFrameAddress (const irFn* fn);
+
+/**
+ * Are the flags as left by the nth instruction of a block read, by a later
+ * instruction or the branch ending it, before anything else sets them
+ */
+bool irBlockFlagsRead (const irBlock* block, int n);
 
 /*==== Static data ====*/
 
@@ -150,8 +294,23 @@ void irBranch (irBlock* block, operand cond, irBlock* ifTrue, irBlock* ifFalse);
 void irCall (irBlock* block, sym* to, irBlock* ret);
 void irCallIndirect (irBlock* block, operand to, irBlock* ret);
 
+/**
+ * End the block by jumping to a fn instead of calling it, once the frame is
+ * gone, as if called by this fn's caller. The args must already be where
+ * this fn's own were, and its block has no succs.
+ */
+void irTailCall (irBlock* block, sym* to);
+
 /*==== ====*/
 
+/**
+ * The order that a function's blocks are emitted in: every block after its
+ * predecessors, loops aside, starting from the prologue. Blocks that never
+ * reach the epilogue follow, if reachable from the prologue, and the rest
+ * are left out.
+ */
+void irFnOrderBlocks (const irFn* fn, vector/*<irBlock*>*/* order);
+
 int irBlockGetPredNo (irFn* fn, irBlock* block);
 int irBlockGetSuccNo (irBlock* block);
 
@@ -160,6 +319,78 @@ int irBlockGetSuccNo (irBlock* block);
 void irBlockDelete (irFn* fn, irBlock* block);
 void irBlocksCombine (irFn* fn, irBlock* pred, irBlock* succ);
 
+/**
+ * Replace the branch ending a block with a jump to wherever it goes when
+ * its condition is as given
+ */
+void irBlockResolveBranch (irBlock* block, bool cond);
+
+/**
+ * Make a block go to another block wherever it went to from
+ */
+void irBlockRedirect (irBlock* block, irBlock* from, irBlock* to);
+
+/**
+ * Take out and free the nth instruction of a block, keeping the order of
+ * the rest
+ */
+void irBlockRemoveInstr (irBlock* block, int n);
+
+/**
+ * Remove the instructions writing a virtual register that is dead after
+ * them, until none are left
+ * @return The number removed
+ */
+int irFnDeleteDeadInstrs (irFn* fn, int wordsize);
+
 /*==== ====*/
 
 void irBlockLevelAnalysis (irCtx* ctx);
+
+/**
+ * Sparse conditional constant propagation over the virtual registers of
+ * each function, in SSA form. Registers found to be constant are replaced
+ * by the constant where an instruction allows it, branches that can only
+ * go one way become jumps, and blocks that can never run are deleted, along
+ * with definitions that end up unread. Run before irBlockLevelAnalysis,
+ * which tidies up after it.
+ */
+void irConstantPropagation (irCtx* ctx);
+
+/**
+ * Local value numbering: within each block, an instruction computing a
+ * value some virtual register already holds (arithmetic, an address, or a
+ * load from memory not written since) becomes a move from that register,
+ * and reads of registers holding the same value are made of the same one.
+ * Arithmetic on literals, including those it forwards from memory, is
+ * folded, which irConstantPropagation can't see. Run after irBlockLevelAnalysis, for larger blocks, and before irAllocRegs.
+ */
+void irValueNumbering (irCtx* ctx);
+
+/**
+ * Loop invariant code motion: instructions in a loop computing the same
+ * value every iteration, with no side effects, are moved to a preheader
+ * inserted before it. Loads are only moved if nothing in the loop may write
+ * what they read. Run before irAllocRegs.
+ */
+void irLoopInvariantCodeMotion (irCtx* ctx);
+
+/*==== Register allocation ====*/
+
+/**
+ * Mark a physical register as holding a value from here until given back,
+ * or if never given back, until the end of the block. Virtual registers
+ * live at any point in between won't be assigned it.
+ */
+void irBlockTakeReg (irBlock* block, regIndex r);
+void irBlockGiveBackReg (irBlock* block, regIndex r);
+
+/**
+ * Assign registers to the virtual registers of each function, by linear scan
+ * over their live intervals, then write the prologues and epilogues.
+ *
+ * Virtual registers live across a call only get callee save registers, and
+ * those that don't fit are spilled to stack slots (or if only ever set to a
+ * constant, rematerialized). Only the callee save registers used are saved.
+ */
+void irAllocRegs (irCtx* ctx);
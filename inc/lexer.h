@@ -1,6 +1,9 @@
 #pragma once
 
 #include "stream.h"
+#include "source.h"
+
+typedef struct atomTable atomTable;
 
 typedef enum tokenTag {
     tokenUndefined,
@@ -62,23 +65,81 @@ typedef enum punctTag {
     punctModulo, punctModuloAssign
 } punctTag;
 
+/**
+ * A token as stored by lexerTokenize. The tags are narrowed to keep the
+ * array dense, the characters are found in the stream at location less the
+ * lexer's base (after the opening quote of a string or character).
+ */
+typedef struct token {
+    unsigned char tag, keyword, punct;
+    int length;
+    tokenLocation location;
+    const char* atom;
+} token;
+
 typedef struct lexerCtx {
     streamCtx* stream;
-    int line, lineChar;
+    atomTable* atoms;
+    ///Location of the start of the stream, @see sourceAddFile. Token
+    ///locations are offsets from it.
+    tokenLocation base;
+    tokenLocation location;
 
     tokenTag token;
     keywordTag keyword;
     punctTag punct;
 
+    /*The token's characters, pointing into the stream. Not terminated.
+      Strings and characters exclude the quotes, escapes are left as is.*/
+    const char* slice;
+    int length;
+
+    ///Interned spelling of identifiers, null for other tokens
+    const char* atom;
+
+    /*Scratch space for lexerGetStr*/
     char* buffer;
     int bufferSize;
-    int length;
+
+    ///Every token in the stream, ending in tokenEOF, or null if the lexer
+    ///is still working directly from the stream. See lexerTokenize.
+    token* tokens;
+    int tokenNo, tokenCapacity;
+    ///Index of the current token
+    int cursor;
 } lexerCtx;
 
-lexerCtx* lexerInit (const char* filename);
+/**
+ * Identifiers are interned in the given atom table
+ */
+lexerCtx* lexerInit (const char* filename, atomTable* atoms);
 void lexerEnd (lexerCtx* ctx);
 
 void lexerNext (lexerCtx* ctx);
 
+/**
+ * Lex the whole stream into ctx->tokens up front. Must be called before
+ * the first lexerNext; from then on lexerNext walks the array.
+ */
+void lexerTokenize (lexerCtx* ctx);
+
+/**
+ * Look n tokens ahead of the current one, saturating at tokenEOF.
+ * Only available after lexerTokenize.
+ */
+const token* lexerPeek (const lexerCtx* ctx, int n);
+
+/**
+ * Make the first token at or after a location the current one, going
+ * back or forward. Only available after lexerTokenize.
+ */
+void lexerSeek (lexerCtx* ctx, tokenLocation location);
+
+/**
+ * Copy the current token into a NUL terminated string, owned by the
+ * lexer and valid until the next call
+ */
+const char* lexerGetStr (lexerCtx* ctx);
+
 const char* keywordTagGetStr (keywordTag tag);
 const char* punctTagGetStr (punctTag tag);
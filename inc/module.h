@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "hashmap.h"
+#include "source.h"
+
+#include "stdint.h"
+
+typedef struct ast ast;
+typedef struct sym sym;
+typedef struct compilerCtx compilerCtx;
+
+/**
+ * Module images: precompiled interfaces for `using`.
+ *
+ * Once a used module has been parsed without complaint, its AST and
+ * symbol tree are saved to <dir>/<hash>.fcm, the hash being that of its
+ * source. The next time it is used, by this compilation or a later one,
+ * the image is loaded in place of lexing and parsing it, as long as every
+ * module it uses (all the way down) is also unchanged.
+ *
+ * An image is flat tables of fixed size records that refer to each other
+ * by index, so it contains no pointers and needs no fix-up to be read. A
+ * symbol of another module is referred to by the path of children leading
+ * to it from that module's scope. Loading builds the AST and symbols in the
+ * current arena, as the parser would have.
+ */
+typedef struct moduleImage moduleImage;
+
+typedef enum moduleCacheState {
+    moduleUnchecked,
+    ///Being checked: a module reached again through a cycle of using
+    moduleChecking,
+    moduleValid,
+    moduleInvalid
+} moduleCacheState;
+
+/**
+ * What the cache knows of a source file
+ */
+typedef struct moduleCacheEntry {
+    uint64_t hash;
+    ///Contents of the file, until it is parsed or loaded
+    char* source;
+    int length;
+
+    ///Whether the image can be loaded, and if so the image itself
+    moduleCacheState state;
+    moduleImage* image;
+} moduleCacheEntry;
+
+typedef struct moduleCache {
+    ///Directory that images are kept in, or null to not use images
+    const char* dir;
+    ///By full filename
+    hashmap/*<moduleCacheEntry*>*/ entries;
+} moduleCache;
+
+/**
+ * A module used by another, as recorded in the user's image
+ */
+typedef struct moduleDep {
+    ///As written in the using statement
+    const char* name;
+    uint64_t hash;
+    const sym* scope;
+} moduleDep;
+
+moduleCache* moduleCacheInit (moduleCache* cache, const char* dir);
+void moduleCacheFree (moduleCache* cache);
+
+/**
+ * Read and hash a file the first time it is asked for. Null if the file
+ * can't be read.
+ */
+moduleCacheEntry* moduleCacheGetEntry (moduleCache* cache, const char* fullname);
+
+/**
+ * Read the image of the module with a given hash, null if there is none
+ * or it was made by a version of the compiler with a different image
+ * format, for a different word size or global scope, or skipping function
+ * bodies where this compilation doesn't (or the reverse)
+ */
+moduleImage* moduleImageRead (const moduleCache* cache, uint64_t hash, const compilerCtx* comp);
+void moduleImageFree (moduleImage* image);
+
+int moduleImageGetLines (const moduleImage* image);
+int moduleImageGetDepNo (const moduleImage* image);
+const char* moduleImageGetDepName (const moduleImage* image, int n);
+uint64_t moduleImageGetDepHash (const moduleImage* image, int n);
+
+/**
+ * Build the module in an empty scope, its file's locations starting at
+ * base. deps must be the modules named by the image, in order, already
+ * parsed or loaded.
+ * @return The module's AST, or null if the image doesn't fit the modules
+ *         it uses. Nothing will have been added to the scope.
+ */
+ast* moduleImageLoad (const moduleImage* image, compilerCtx* comp, sym* scope,
+                      const moduleDep* deps, tokenLocation base);
+
+/**
+ * Save the image of a module, straight after it has been parsed (before
+ * the analyzer has been anywhere near it). Skipped if the module has
+ * anything the image can't express, like a symbol it redeclared that has
+ * since moved on to yet another module.
+ * @return Whether the image was written
+ */
+bool moduleImageWrite (const moduleCache* cache, uint64_t hash, compilerCtx* comp,
+                       const ast* tree, const sym* scope, tokenLocation base, int lines,
+                       const moduleDep* deps, int depNo);
@@ -52,7 +52,8 @@ typedef struct operand {
         const char* label;
     };
 
-    ///In bytes, for mem operands
+    ///In bytes, for mem operands. A register operand is the size its
+    ///register is allocated as, unless given one here.
     int size;
 
     bool array;
@@ -17,6 +17,17 @@ typedef struct config {
     bool fail;
     configMode mode;
     bool deleteAsm;
+    ///Print the memory used per module
+    bool memStats;
+    ///Parse used modules as interfaces, their function bodies only if needed
+    bool interfaces;
+    ///Print the times each peephole rule fired
+    bool peepholeStats;
+    ///Compile the inputs as this many parallel jobs, or if zero, in
+    ///sequence sharing their modules
+    int jobs;
+    ///Directory to keep images of used modules in, if any
+    char* moduleCache;
 
     architecture arch;
 
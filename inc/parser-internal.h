@@ -3,6 +3,7 @@
 #include "../std/std.h"
 
 #include "lexer.h"
+#include "source.h"
 
 typedef struct vector vector;
 typedef struct ast ast;
@@ -10,18 +11,14 @@ typedef struct sym sym;
 typedef struct compilerCtx compilerCtx;
 typedef struct lexerCtx lexerCtx;
 
-typedef struct tokenLocation {
-    const char* filename;
-    int line;
-    int lineChar;
-} tokenLocation;
-
 typedef struct parserCtx {
     lexerCtx* lexer;
     tokenLocation location;
 
     ///Ownership of filename is taken by the parserResult of the astModule of the file
     char* filename;
+    ///Id in the compiler's source manager
+    int file;
     const char* fullname;
     char* path;
 
@@ -35,6 +32,10 @@ typedef struct parserCtx {
     ///The levels of break-able control flows currently in
     int breakLevel;
 
+    ///Skip function bodies, leaving them to parserBodies, and how many were
+    bool interface;
+    int skipped;
+
     int errors, warnings;
 
     ///The last line that an error occurred on
@@ -53,11 +54,22 @@ bool tokenIsString (const parserCtx* ctx);
 bool tokenIsChar (const parserCtx* ctx);
 bool tokenIsDecl (const parserCtx* ctx);
 
+/**
+ * The token n ahead of the current one (0 being the current), in O(1)
+ */
+const token* tokenPeek (const parserCtx* ctx, int n);
+bool tokenPeekIsPunct (const parserCtx* ctx, int n, punctTag punct);
+
 void tokenNext (parserCtx* ctx);
 void tokenSkipMaybe (parserCtx* ctx);
 
+/**
+ * The interned spelling of the current token, whatever it is
+ */
+const char* tokenGetAtom (const parserCtx* ctx);
+
 void tokenMatch (parserCtx* ctx);
-char* tokenDupMatch (parserCtx* ctx);
+const char* tokenMatchAtom (parserCtx* ctx);
 
 void tokenMatchToken (parserCtx* ctx, tokenTag Match);
 void tokenMatchKeyword (parserCtx* ctx, keywordTag keyword);
@@ -66,7 +78,8 @@ bool tokenTryMatchKeyword (parserCtx* ctx, keywordTag keyword);
 bool tokenTryMatchPunct (parserCtx* ctx, punctTag punct);
 
 int tokenMatchInt (parserCtx* ctx);
-char* tokenMatchIdent (parserCtx* ctx);
+const char* tokenMatchIdent (parserCtx* ctx);
+///Allocated from the current arena
 char* tokenMatchStr (parserCtx* ctx);
 char tokenMatchChar (parserCtx* ctx);
 
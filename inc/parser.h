@@ -5,6 +5,8 @@
 typedef struct ast ast;
 typedef struct sym sym;
 typedef struct compilerCtx compilerCtx;
+typedef struct arena arena;
+typedef struct lexerCtx lexerCtx;
 
 typedef struct parserResult {
     ast* tree;
@@ -12,8 +14,27 @@ typedef struct parserResult {
     char* filename;
     int errors, warnings;
     bool firsttime, notfound;
+
+    ///Holds the module's AST, symbols and types. Null if notfound.
+    arena* arena;
+    int lines;
+
+    ///Id in the source manager, and the path the file was found at
+    int file;
+    const char* fullname;
+    ///Tokens of the file, kept if any function bodies were skipped
+    lexerCtx* lexer;
 } parserResult;
 
 parserResult parser (const char* filename, const char* initialPath, compilerCtx* comp);
 
+/**
+ * Parse the skipped body of every function that the tree refers to, and
+ * of every function that those bodies refer to, and so on.
+ *
+ * Bodies from modules whose trees went to an earlier input are added to
+ * this tree, so that they're analyzed and emitted with it.
+ */
+void parserBodies (compilerCtx* comp, ast* tree);
+
 void parserResultDestroy (parserResult* result);
@@ -7,7 +7,8 @@ typedef struct reg {
     int size;
     ///Name when a byte, word, dword and qword
     const char* names[4];
-    ///If unused, 0, else the size allocated as in bytes
+    ///If unused, 0, else the size allocated as in bytes. Only for virtual
+    ///registers, physical registers keep theirs per thread (@see regGetSize)
     int allocatedAs;
 } reg;
 
@@ -33,6 +34,10 @@ typedef enum regIndex {
     regMax
 } regIndex;
 
+///Physical registers, only ever taken for instructions that need a particular
+///one. Shared by every thread, so that the IR can refer to them after the
+///thread that generated it is gone, but whether and at what size each is
+///allocated is per thread, for parallel jobs.
 extern reg regs[regMax];
 
 /**
@@ -51,11 +56,25 @@ reg* regRequest (regIndex r, int size);
 void regFree (reg* r);
 
 /**
- * Attempt to allocate a register, returning it if successful.
+ * The size a register is allocated as, in bytes, 0 if unused
+ */
+int regGetSize (const reg* r);
+void regSetSize (reg* r, int size);
+
+/**
+ * The index of a physical register, regUndefined if virtual
+ */
+regIndex regGetIndex (const reg* r);
+
+/**
+ * Allocate a new virtual register, named %v<n>.<size> in debug output. It is
+ * given a physical register (or stack slot) by irAllocRegs once its
+ * function has been generated. Lives as long as the current arena.
  */
 reg* regAlloc (int size);
 
 const char* regIndexGetName (regIndex r, int size);
+const char* regGetName (const reg* r, int size);
 
 /**
  * Return the name of a register at a certain size in bytes as it would
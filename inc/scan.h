@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../std/std.h"
+
+/**
+ * Bulk character scanning kernels used by the lexer to skip whitespace and
+ * comments many bytes at a time. Each has a portable scalar version and,
+ * on x86, SSE2 and AVX2 versions. The best supported is picked by scanInit.
+ *
+ * All of them stop at a NUL, and never read at or beyond end.
+ */
+
+typedef enum scanImpl {
+    scanScalar,
+    scanSSE2,
+    scanAVX2
+} scanImpl;
+
+/**
+ * Select the widest implementation the CPU supports. Call once at startup,
+ * before any lexing.
+ */
+void scanInit (void);
+
+/**
+ * Force a specific implementation, returning false (and leaving the
+ * selection alone) if it isn't supported
+ */
+bool scanSelect (scanImpl impl);
+scanImpl scanGetImpl (void);
+const char* scanImplGetStr (scanImpl impl);
+
+/**
+ * First character from str that isn't ' ', '\t', '\n' or '\r', or end
+ */
+const char* scanWhitespace (const char* str, const char* end);
+
+/**
+ * First character from str that is either a, b or NUL, or end
+ */
+const char* scanFind (const char* str, const char* end, char a, char b);
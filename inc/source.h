@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../std/std.h"
+
+#include "stdint.h"
+
+/**
+ * A position in any of the files compiled, as a single 32-bit number.
+ *
+ * Each file registered with the source manager is given a range of the
+ * location space, one location per character plus one for its EOF, so
+ * a location is the file's base plus an offset into it. Zero is never
+ * handed out and means "nowhere".
+ */
+typedef uint32_t tokenLocation;
+
+/**
+ * A location decoded into a form fit for humans
+ */
+typedef struct sourceLocation {
+    const char* filename;
+    int line;
+    ///Tabs count as four columns
+    int lineChar;
+} sourceLocation;
+
+typedef struct sourceFile {
+    char* filename;
+    tokenLocation base;
+    int length;
+
+    ///Offsets of the start of each line (the first is zero) and of every
+    ///tab, ascending. Enough to decode a location without the source.
+    int* lineStarts;
+    int lineNo;
+    int* tabs;
+    int tabNo;
+} sourceFile;
+
+/**
+ * Source manager: the file id table and the location space they share
+ */
+typedef struct sourceManager {
+    sourceFile* files;
+    int fileNo, fileCapacity;
+
+    ///Where the next file's range begins
+    tokenLocation next;
+} sourceManager;
+
+sourceManager* sourceManagerInit (sourceManager* mgr);
+void sourceManagerFree (sourceManager* mgr);
+
+/**
+ * Register a file, given its contents, returning its id. The contents
+ * are scanned for lines and tabs but not kept, the filename is copied.
+ */
+int sourceAddFile (sourceManager* mgr, const char* filename, const char* buffer, int length);
+
+/**
+ * The location of a character offset in a file
+ */
+tokenLocation sourceGetLocation (const sourceManager* mgr, int file, int offset);
+
+/**
+ * The id of the file that a (known) location is in
+ */
+int sourceFindFile (const sourceManager* mgr, tokenLocation loc);
+
+sourceLocation sourceDecode (const sourceManager* mgr, tokenLocation loc);
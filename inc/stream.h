@@ -1,16 +1,23 @@
 #pragma once
 
-#include "stdio.h"
+#include "../std/std.h"
 
 /**
  * Stream context
+ *
+ * The whole source is mapped (or, failing that, read) into memory and
+ * followed by a NUL sentinel, so the lexer can hand out slices of it
+ * directly. Line and column numbers are not tracked at all, locations
+ * are offsets into the buffer. @see sourceDecode
  */
 typedef struct streamCtx {
-    FILE* file;
+    const char* buffer;
+    int length;
+    ///Whether buffer is an mmap of the file rather than a malloc'd copy
+    bool mapped;
 
+    int pos;
     char current;
-    int line;
-    int lineChar;
 } streamCtx;
 
 streamCtx* streamInit (const char* filename);
@@ -25,3 +32,18 @@ char streamNext (streamCtx* ctx);
  * Backtrack a single character, return the old character (that is now next)
  */
 char streamPrev (streamCtx* ctx);
+
+/**
+ * Pointer to the current character, valid until streamEnd
+ */
+const char* streamGetPtr (const streamCtx* ctx);
+
+/**
+ * Pointer one past the last character (at the NUL sentinel)
+ */
+const char* streamGetEnd (const streamCtx* ctx);
+
+/**
+ * Jump forward to a pointer between streamGetPtr and streamGetEnd
+ */
+void streamSkipTo (streamCtx* ctx, const char* ptr);
@@ -8,6 +8,15 @@ typedef struct sym sym;
 
 typedef struct irFn irFn;
 
+typedef struct symIndex symIndex;
+typedef struct symExports symExports;
+
+enum {
+    ///Scopes with more children than this are given a hash index
+    ///@see sym::index
+    symIndexThreshold = 16
+};
+
 /**
  * Symbol tags
  * @see sym @see sym::tag
@@ -78,17 +87,14 @@ typedef enum symTypeMask {
  *
  * Can represent functions, structs, parameters, unnamed scopes etc
  *
- * @see symInit @see symEnd
- *
- * Owns:
- *   - ident
- *   - Its children
- *   - dt
- *   - label (if static or extern)
+ * Symbols, their vectors, dt and label are all allocated from the current
+ * arena, and freed with it. @see arenaSetCurrent
  */
 typedef struct sym {
     symTag tag;
-    char* ident;
+    ///An atom from the compiler's atom table, or "" if anonymous.
+    ///Compared by pointer: @see symChild
+    const char* ident;
 
     ///Vector of AST nodes for each declaration (inc. impls)
     vector/*<const ast* >*/ decls;
@@ -99,7 +105,7 @@ typedef struct sym {
     union {
         /*symId symParam symTypedef symEnumConstant*/
         struct {
-            type* dt;
+            const type* dt;
             /*symId symParam*/
             storageTag storage;
         };
@@ -118,6 +124,12 @@ typedef struct sym {
     sym* parent;
     ///Position in parent's vector
     int nthChild;
+    ///Children by ident for symChild, null until there are more than
+    ///symIndexThreshold children. Small scopes are just scanned.
+    symIndex* index;
+    ///symModuleLink targets: everything visible in the module, including
+    ///through its own links, once it has been parsed. @see symModuleExport
+    symExports* exports;
 
     union {
         /*symId: storageStatic storageExtern*/
@@ -136,20 +148,33 @@ typedef struct sym {
 /**
  * Initialize the symbol table
  * @return the global namespace symbol
- * @see symEnd
  */
 sym* symInit (void);
 
-/**
- * Destroy a symbol table
- */
-void symEnd (sym* global);
-
 sym* symCreateScope (sym* parent);
 sym* symCreateModuleLink (sym* parent, const sym* module);
+/**
+ * ident must be an atom, or "" for an anonymous symbol. It is not copied.
+ */
 sym* symCreateType (sym* parent, const char* ident, int size, symTypeMask typeMask);
 sym* symCreateNamed (symTag tag, sym* Parent, const char* ident);
 
+/**
+ * Create a symbol with no parent yet, for building a symbol tree out of
+ * order. Links must be given their target (first child) before they are
+ * added to a parent. @see moduleImageLoad
+ */
+sym* symCreateUnparented (symTag tag, const char* ident);
+void symAddChild (sym* Parent, sym* Child);
+
+/**
+ * Flatten everything symChild can find in a module scope, following its
+ * module links (each module once), into an index that module links to
+ * it consult instead of walking the modules it uses. Call once the
+ * module has been parsed.
+ */
+void symModuleExport (sym* Module);
+
 /**
  * Changes the parent of a symbol, replacing it with a symLink
  */
@@ -160,14 +185,16 @@ const sym* symGetNthParam (const sym* fn, int n);
 
 /**
  * Attempt to find a symbol directly accessible from a scope. Will search
- * inside contained enums, anon. unions but will not look at parent scopes.
+ * inside contained enums, anon. unions but will not look at parent scopes. look must be an atom.
+ * If several match, the one declared first is found, whether or not the
+ * scope is indexed.
  * @return Symbol, or null on failure.
  */
 sym* symChild (const sym* scope, const char* look);
 
 /**
  * Attempt to find a symbol visible from a scope. Will recurse up parent
- * scopes.
+ * scopes. look must be an atom.
  * @return Symbol, or null on failure
  */
 sym* symFind (const sym* scope, const char* look);
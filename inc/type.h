@@ -2,6 +2,8 @@
 
 #include "../std/std.h"
 
+#include "arena.h"
+
 typedef struct sym sym;
 typedef struct type type;
 typedef struct architecture architecture;
@@ -29,7 +31,11 @@ enum {
 };
 
 /**
- *
+ * Types are hash-consed: each distinct type is made once, in the current
+ * typeTable, and never modified or freed individually. Two types are
+ * structurally identical if and only if they are the same pointer.
+ * Derivations are therefore cheap, and return const types that are to be
+ * shared rather than copied.
  */
 typedef struct type {
     typeTag tag;
@@ -42,30 +48,52 @@ typedef struct type {
         const sym* basic;
         /*typePtr typeArray*/
         struct {
-            type* base;
+            const type* base;
             ///Size of the array
             ///Negative indices are described by enum constants
             int array;
+            ///typeArray: total size in bytes, cached by typeGetSize once the
+            ///elements are complete, zero until then. Not part of the type's
+            ///identity. Atomic, as code gen can be multithreaded.
+            _Atomic int size;
         };
         /*typeFunction*/
         struct {
-            type* returnType;
-            type** paramTypes;
+            const type* returnType;
+            const type** paramTypes;
             int params;
             bool variadic;
         };
     };
 } type;
 
-type* typeCreateBasic (const sym* basic);
-type* typeCreatePtr (type* base);
-type* typeCreateArray (type* base, int size);
-type* typeCreateFunction (type* returnType, type** paramTypes, int params, bool variadic);
-type* typeCreateInvalid (void);
+/**
+ * The hash-cons table that types are found in, or made in if new
+ */
+typedef struct typeTable {
+    int size, elements;
+    const type** slots;
+    ///The types themselves, and their parameter arrays
+    arena types;
+} typeTable;
 
-void typeDestroy (type* DT);
+typeTable* typeTableInit (typeTable* table);
+void typeTableFree (typeTable* table);
 
-type* typeDeepDuplicate (const type* DT);
+/**
+ * Set the table that types are interned in on this thread, returning the
+ * previous one
+ */
+typeTable* typeTableSetCurrent (typeTable* table);
+
+const type* typeCreateBasic (const sym* basic);
+const type* typeCreatePtr (const type* base);
+const type* typeCreateArray (const type* base, int size);
+/**
+ * paramTypes is copied if the type is new, and can be freed after.
+ */
+const type* typeCreateFunction (const type* returnType, const type** paramTypes, int params, bool variadic);
+const type* typeCreateInvalid (void);
 
 const sym* typeGetBasic (const type* DT);
 const type* typeGetBase (const type* DT);
@@ -74,15 +102,29 @@ const type* typeGetRecord (const type* DT);
 const type* typeGetCallable (const type* DT);
 int typeGetArraySize (const type* DT);
 
-bool typeSetArraySize (type* DT, int size);
+const type* typeDeriveFrom (const type* DT);
+const type* typeDeriveFromTwo (const type* L, const type* R);
+const type* typeDeriveUnified (const type* L, const type* R);
+const type* typeDeriveBase (const type* DT);
+const type* typeDerivePtr (const type* base);
+const type* typeDeriveArray (const type* base, int size);
+const type* typeDeriveReturn (const type* fn);
+
+/**
+ * The same type, const qualified
+ */
+const type* typeDeriveConst (const type* DT);
 
-type* typeDeriveFrom (const type* DT);
-type* typeDeriveFromTwo (const type* L, const type* R);
-type* typeDeriveUnified (const type* L, const type* R);
-type* typeDeriveBase (const type* DT);
-type* typeDerivePtr (const type* base);
-type* typeDeriveArray (const type* base, int size);
-type* typeDeriveReturn (const type* fn);
+/**
+ * An array type (possibly through typedefs) with its size replaced, or
+ * the type unchanged if it is not an array
+ */
+const type* typeDeriveArraySize (const type* DT, int size);
+
+/**
+ * A function type with the return type replaced (e.g. once inferred)
+ */
+const type* typeDeriveReturning (const type* fn, const type* returnType);
 
 /*All the following typeIsXXX respond positively when given an
   invalid, so that one error doesn't cascade. If it is important
@@ -119,6 +161,10 @@ bool typeIsEqual (const type* L, const type* R);
 
 const char* typeTagGetStr (typeTag tag);
 
+/**
+ * Size in bytes. Records are laid out by the analyzer, and arrays
+ * remember their size after the first query.
+ */
 int typeGetSize (const architecture* arch, const type* DT);
 
 char* typeToStr (const type* DT);
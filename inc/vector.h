@@ -2,9 +2,13 @@
 
 #include "../std/std.h"
 
+typedef struct arena arena;
+
 typedef struct vector {
     int length, capacity;
     void** buffer;
+    ///If set, the buffer is allocated from this instead of the heap
+    arena* arena;
 } vector;
 
 typedef void (*vectorDtor)(void*); ///For use with vectorFreeObjs
@@ -15,6 +19,12 @@ typedef void* (*vectorMapper)(void*); ///For use with vectorMap
  */
 vector* vectorInit (vector* v, int initialCapacity);
 
+/**
+ * Initialize a vector whose buffer lives in an arena. vectorFree then
+ * only resets it.
+ */
+vector* vectorInitArena (vector* v, int initialCapacity, arena* a);
+
 /**
  * Cleans up resources allocated by the vector but not the vector itself.
  */
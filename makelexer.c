@@ -0,0 +1,236 @@
+/*Generates lexer-tables.h, the keyword and punctuation tables used by
+  src/lexer.c. Called by the makefile:
+
+      makelexer >lexer-tables.h
+
+  To add a keyword or punctuator, add its tag to inc/lexer.h and a line
+  to one of the tables below.*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+typedef struct entry {
+    const char* str;
+    const char* tag;
+} entry;
+
+static const entry keywords[] = {
+    {"using", "keywordUsing"},
+    {"if", "keywordIf"}, {"else", "keywordElse"}, {"while", "keywordWhile"},
+    {"do", "keywordDo"}, {"for", "keywordFor"},
+    {"return", "keywordReturn"}, {"break", "keywordBreak"}, {"continue", "keywordContinue"},
+    {"sizeof", "keywordSizeof"},
+    {"const", "keywordConst"},
+    {"auto", "keywordAuto"}, {"static", "keywordStatic"}, {"extern", "keywordExtern"},
+    {"typedef", "keywordTypedef"},
+    {"struct", "keywordStruct"}, {"union", "keywordUnion"}, {"enum", "keywordEnum"},
+    {"void", "keywordVoid"}, {"bool", "keywordBool"}, {"char", "keywordChar"}, {"int", "keywordInt"},
+    {"true", "keywordTrue"}, {"false", "keywordFalse"},
+    {"va_start", "keywordVAStart"}, {"va_end", "keywordVAEnd"},
+    {"va_arg", "keywordVAArg"}, {"va_copy", "keywordVACopy"},
+    {"assert", "keywordAssert"}
+};
+
+static const entry puncts[] = {
+    {"{", "punctLBrace"}, {"}", "punctRBrace"},
+    {"(", "punctLParen"}, {")", "punctRParen"},
+    {"[", "punctLBracket"}, {"]", "punctRBracket"},
+    {";", "punctSemicolon"},
+    {".", "punctPeriod"}, {"...", "punctEllipsis"},
+    {",", "punctComma"},
+    {"=", "punctAssign"}, {"==", "punctEqual"},
+    {"!", "punctLogicalNot"}, {"!=", "punctNotEqual"},
+    {">", "punctGreater"}, {">=", "punctGreaterEqual"}, {">>", "punctShr"}, {">>=", "punctShrAssign"},
+    {"<", "punctLess"}, {"<=", "punctLessEqual"}, {"<<", "punctShl"}, {"<<=", "punctShlAssign"},
+    {"?", "punctQuestion"},
+    {":", "punctColon"},
+    {"&", "punctBitwiseAnd"}, {"&=", "punctBitwiseAndAssign"}, {"&&", "punctLogicalAnd"},
+    {"|", "punctBitwiseOr"}, {"|=", "punctBitwiseOrAssign"}, {"||", "punctLogicalOr"},
+    {"^", "punctBitwiseXor"}, {"^=", "punctBitwiseXorAssign"},
+    {"~", "punctBitwiseNot"},
+    {"+", "punctPlus"}, {"+=", "punctPlusAssign"}, {"++", "punctPlusPlus"},
+    {"-", "punctMinus"}, {"-=", "punctMinusAssign"}, {"--", "punctMinusMinus"}, {"->", "punctArrow"},
+    {"*", "punctTimes"}, {"*=", "punctTimesAssign"},
+    {"/", "punctDivide"}, {"/=", "punctDivideAssign"},
+    {"%", "punctModulo"}, {"%=", "punctModuloAssign"}
+};
+
+enum {
+    keywordNo = sizeof(keywords)/sizeof(*keywords),
+    punctNo = sizeof(puncts)/sizeof(*puncts),
+    maxStates = 256
+};
+
+/*==== Keywords ====
+
+  The hash mixes the first two and the last character with the length,
+  using multipliers found by brute force so that no two keywords collide.*/
+
+static unsigned int keywordHash (const char* str, unsigned int k[3], unsigned int size) {
+    int length = strlen(str);
+    return (  k[0]*(unsigned char) str[0] + k[1]*(unsigned char) str[1]
+            + k[2]*(unsigned char) str[length-1] + length) & (size-1);
+}
+
+static int keywordPerfect (unsigned int k[3], unsigned int size) {
+    char used[1024] = {0};
+
+    for (int i = 0; i < keywordNo; i++) {
+        unsigned int hash = keywordHash(keywords[i].str, k, size);
+
+        if (used[hash]++)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int keywordSearch (unsigned int k[3], unsigned int* size) {
+    for (*size = 32; *size <= 1024; *size *= 2)
+        for (k[0] = 1; k[0] < 64; k[0]++)
+            for (k[1] = 0; k[1] < 64; k[1]++)
+                for (k[2] = 0; k[2] < 64; k[2]++)
+                    if (keywordPerfect(k, *size))
+                        return 1;
+
+    return 0;
+}
+
+static void keywordTables (void) {
+    int minLength = 1 << 30, maxLength = 0;
+
+    for (int i = 0; i < keywordNo; i++) {
+        int length = strlen(keywords[i].str);
+        minLength = length < minLength ? length : minLength;
+        maxLength = length > maxLength ? length : maxLength;
+    }
+
+    unsigned int k[3], size;
+
+    if (minLength < 2 || !keywordSearch(k, &size)) {
+        fprintf(stderr, "makelexer: no perfect hash for the keywords\n");
+        exit(1);
+    }
+
+    printf("enum {\n"
+           "    keywordMinLength = %d,\n"
+           "    keywordMaxLength = %d,\n"
+           "    keywordHashSize = %u\n"
+           "};\n\n", minLength, maxLength, size);
+
+    printf("static unsigned int keywordHash (const char* str, int length) {\n"
+           "    return (  %uu*(unsigned char) str[0] + %uu*(unsigned char) str[1]\n"
+           "            + %uu*(unsigned char) str[length-1] + (unsigned int) length) & (keywordHashSize-1);\n"
+           "}\n\n", k[0], k[1], k[2]);
+
+    printf("static const struct {\n"
+           "    const char* str;\n"
+           "    int length;\n"
+           "    keywordTag tag;\n"
+           "} keywordTable[keywordHashSize] = {\n");
+
+    for (int i = 0; i < keywordNo; i++)
+        printf("    [%u] = {\"%s\", %d, %s},\n",
+               keywordHash(keywords[i].str, k, size), keywords[i].str,
+               (int) strlen(keywords[i].str), keywords[i].tag);
+
+    printf("};\n\n");
+
+    printf("static const char* const keywordStrs[] = {\n");
+
+    for (int i = 0; i < keywordNo; i++)
+        printf("    [%s] = \"%s\",\n", keywords[i].tag, keywords[i].str);
+
+    printf("};\n\n");
+}
+
+/*==== Punctuation ====
+
+  A DFA over character classes, built as a trie of the punctuators. Each
+  state records the punctuator it accepts, if any; the lexer takes the
+  longest accepted match and backtracks over anything past it.*/
+
+static void punctTables (void) {
+    int classes = 1;
+    int classOf[256] = {0};
+
+    int states = 1;
+    int next[maxStates][256];
+    int accept[maxStates];
+
+    memset(next, 0, sizeof(next));
+    memset(accept, -1, sizeof(accept));
+
+    for (int i = 0; i < punctNo; i++) {
+        int state = 0;
+
+        for (const char* c = puncts[i].str; *c; c++) {
+            int cls = classOf[(unsigned char) *c];
+
+            if (!cls)
+                cls = classOf[(unsigned char) *c] = classes++;
+
+            if (!next[state][cls])
+                next[state][cls] = states++;
+
+            state = next[state][cls];
+        }
+
+        accept[state] = i;
+    }
+
+    if (states > 255) {
+        fprintf(stderr, "makelexer: too many punctuation states\n");
+        exit(1);
+    }
+
+    printf("enum {\n"
+           "    punctClasses = %d,\n"
+           "    punctStates = %d\n"
+           "};\n\n", classes, states);
+
+    printf("static const unsigned char punctClass[256] = {\n");
+
+    for (int c = 0; c < 256; c++)
+        if (classOf[c])
+            printf("    ['%s%c'] = %d,\n", c == '\'' || c == '\\' ? "\\" : "", c, classOf[c]);
+
+    printf("};\n\n");
+
+    printf("static const unsigned char punctNext[punctStates][punctClasses] = {\n");
+
+    for (int state = 0; state < states; state++) {
+        printf("    {");
+
+        for (int cls = 0; cls < classes; cls++)
+            printf("%s%d", cls ? ", " : "", next[state][cls]);
+
+        printf("},\n");
+    }
+
+    printf("};\n\n");
+
+    printf("static const punctTag punctAccept[punctStates] = {\n");
+
+    for (int state = 0; state < states; state++)
+        printf("    %s,\n", accept[state] < 0 ? "punctUndefined" : puncts[accept[state]].tag);
+
+    printf("};\n\n");
+
+    printf("static const char* const punctStrs[] = {\n");
+
+    for (int i = 0; i < punctNo; i++)
+        printf("    [%s] = \"%s\",\n", puncts[i].tag, puncts[i].str);
+
+    printf("};\n");
+}
+
+int main (void) {
+    printf("/*Generated by makelexer.c, do not edit*/\n\n");
+
+    keywordTables();
+    punctTables();
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 #include "../inc/error.h"
 
 #include "../inc/eval.h"
+#include "../inc/arena.h"
 
 #include "stdlib.h"
 
@@ -22,20 +23,21 @@ static const type* analyzerDeclBasic (analyzerCtx* ctx, ast* Node);
 static void analyzerStruct (analyzerCtx* ctx, ast* Node);
 static void analyzerUnion (analyzerCtx* ctx, ast* Node);
 static void analyzerEnum (analyzerCtx* ctx, ast* Node);
+static void analyzerRecordLayout (analyzerCtx* ctx, sym* record, int nextOffset);
 
 /**
  * Handle any node produced by parserDeclExpr using the following fns.
  *
  * Takes ownership of base and assigns it to the symbol.
  */
-static const type* analyzerDeclNode (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
+static const type* analyzerDeclNode (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
 
-static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
-static const type* analyzerConst (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
-static const type* analyzerDeclPtrUOP (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
-static const type* analyzerDeclCall (analyzerCtx* ctx, ast* Node, type* returnType, bool module, storageTag storage);
-static const type* analyzerDeclIndex (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
-static const type* analyzerDeclIdentLiteral (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage);
+static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
+static const type* analyzerConst (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
+static const type* analyzerDeclPtrUOP (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
+static const type* analyzerDeclCall (analyzerCtx* ctx, ast* Node, const type* returnType, bool module, storageTag storage);
+static const type* analyzerDeclIndex (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
+static const type* analyzerDeclIdentLiteral (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage);
 
 void analyzerDecl (analyzerCtx* ctx, ast* Node, bool module) {
     debugEnter("Decl");
@@ -45,10 +47,9 @@ void analyzerDecl (analyzerCtx* ctx, ast* Node, bool module) {
 
     const type* BasicDT = analyzerDeclBasic(ctx, Node->l);
 
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
-        const type* R = analyzerDeclNode(ctx, Current, typeDeepDuplicate(BasicDT), module, storage);
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
+        const type* R = analyzerDeclNode(ctx, Current, BasicDT, module, storage);
 
         /*Complete? Avoid complaining about typedefs and the like
           (they don't need to be complete)*/
@@ -89,23 +90,22 @@ const type* analyzerType (analyzerCtx* ctx, ast* Node) {
     debugEnter("Type");
 
     const type* BasicDT = analyzerDeclBasic(ctx, Node->l);
-    Node->dt = typeDeepDuplicate(analyzerDeclNode(ctx, Node->r, typeDeepDuplicate(BasicDT), false, storageUndefined));
+    Node->dt = analyzerDeclNode(ctx, Node->r, BasicDT, false, storageUndefined);
 
     debugLeave();
 
     return Node->dt;
 }
 
-type* analyzerParamList (analyzerCtx* ctx, ast* Node, type* returnType) {
+const type* analyzerParamList (analyzerCtx* ctx, ast* Node, const type* returnType) {
     debugEnter("ParamList");
 
     bool variadic = false;
-    type** paramTypes = calloc(Node->children, sizeof(type*));
+    const type** paramTypes = malloc(Node->children*sizeof(type*));
     int paramNo = 0;
 
-    for (ast* param = Node->firstChild;
-         param;
-         param = param->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* param = Node->child[i];
         /*Ellipsis to indicate variadic function. The grammar has already
           ensured there is only one and that it is the final parameter.*/
         if (param->tag == astEllipsis) {
@@ -114,9 +114,9 @@ type* analyzerParamList (analyzerCtx* ctx, ast* Node, type* returnType) {
 
         } else if (param->tag == astParam) {
             const type* BasicDT = analyzerDeclBasic(ctx, param->l);
-            const type* paramType = analyzerDeclNode(ctx, param->r, typeDeepDuplicate(BasicDT), false, storageUndefined);
+            const type* paramType = analyzerDeclNode(ctx, param->r, BasicDT, false, storageUndefined);
 
-            paramTypes[paramNo++] = typeDeepDuplicate(paramType);
+            paramTypes[paramNo++] = paramType;
 
             if (!typeIsComplete(paramType))
                 errorIncompleteParamDecl(ctx, param, Node, paramNo, paramType);
@@ -125,7 +125,8 @@ type* analyzerParamList (analyzerCtx* ctx, ast* Node, type* returnType) {
             debugErrorUnhandled("analyzerParamList", "AST tag", astTagGetStr(param->tag));
     }
 
-    type* DT = typeCreateFunction(returnType, paramTypes, paramNo, variadic);
+    const type* DT = typeCreateFunction(returnType, paramTypes, paramNo, variadic);
+    free(paramTypes);
 
     debugLeave();
 
@@ -154,8 +155,7 @@ static const type* analyzerDeclBasic (analyzerCtx* ctx, ast* Node) {
         }
 
     } else if (Node->tag == astConst) {
-        Node->dt = typeDeepDuplicate(analyzerDeclBasic(ctx, Node->r));
-        Node->dt->qual.isConst = true;
+        Node->dt = typeDeriveConst(analyzerDeclBasic(ctx, Node->r));
 
     } else {
         if (Node->tag != astInvalid)
@@ -170,20 +170,20 @@ static const type* analyzerDeclBasic (analyzerCtx* ctx, ast* Node) {
 }
 
 static bool analyzerStructAnyDeclConst (ast* Node) {
-    for (ast* field = Node->firstChild;
-         field;
-         field = field->nextSibling)
+    for (int i = 0; i < Node->children; i++) {
+        ast* field = Node->child[i];
+
         if (   field->symbol && field->symbol->tag == symId && field->symbol->dt
             && typeIsMutable(field->symbol->dt) != mutMutable)
             return true;
+    }
 
     return false;
 }
 
 static void analyzerStruct (analyzerCtx* ctx, ast* Node) {
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
         analyzerDecl(ctx, Current, false);
 
         if (   !Node->symbol->hasConstFields
@@ -191,6 +191,10 @@ static void analyzerStruct (analyzerCtx* ctx, ast* Node) {
             Node->symbol->hasConstFields = true;
     }
 
+    /*Forward declarations come before the fields have types*/
+    if (Node->symbol->impl == Node)
+        analyzerRecordLayout(ctx, Node->symbol, 0);
+
     Node->dt = typeCreateBasic(Node->symbol);
 
     /*TODO: check compatiblity
@@ -198,25 +202,28 @@ static void analyzerStruct (analyzerCtx* ctx, ast* Node) {
 }
 
 static void analyzerUnion (analyzerCtx* ctx, ast* Node) {
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
         analyzerDecl(ctx, Current, false);
     }
 
+    /*Forward declarations come before the fields have types*/
+    if (Node->symbol->impl == Node)
+        analyzerRecordLayout(ctx, Node->symbol, 0);
+
     Node->dt = typeCreateBasic(Node->symbol);
 }
 
 static void analyzerEnum (analyzerCtx* ctx, ast* Node) {
     /*Assign types and values to the constants*/
 
+    Node->symbol->size = ctx->arch->wordsize;
     Node->dt = typeCreateBasic(Node->symbol);
 
     int nextConst = 0;
 
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
         /*Explicit assignment*/
         if (Current->tag == astBOP && Current->o == opAssign) {
             analyzerValue(ctx, Current->r);
@@ -234,13 +241,62 @@ static void analyzerEnum (analyzerCtx* ctx, ast* Node) {
 
         /*Assign type and value, increment nextConst*/
         if (Current->symbol) {
-            analyzerDeclIdentLiteral(ctx, Current, typeDeepDuplicate(Node->dt), false, storageUndefined);
+            analyzerDeclIdentLiteral(ctx, Current, Node->dt, false, storageUndefined);
             Current->symbol->constValue = nextConst++;
         }
     }
 }
 
-static const type* analyzerDeclNode (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+/*Assign the field offsets and the size of a record, once, so that neither
+  the analyzer nor the emitter have to work them out again. Named nested
+  records have been laid out already. The fields of anonymous ones are
+  laid out again, continuing from where the parent is at.*/
+static void analyzerRecordLayout (analyzerCtx* ctx, sym* record, int nextOffset) {
+    record->size = 0;
+
+    /*For every field*/
+    for (int n = 0; n < record->children.length; n++) {
+        sym* field = vectorGet(&record->children, n);
+        int fieldSize;
+
+        /*Find the size of the field*/
+
+        /*Fields of a second, erroneous definition aren't analyzed yet*/
+        if (field->tag == symId)
+            fieldSize = field->dt ? typeGetSize(ctx->arch, field->dt) : 0;
+
+        else if (field->tag == symStruct || field->tag == symUnion) {
+            if (!field->ident[0])
+                analyzerRecordLayout(ctx, field, nextOffset);
+
+            fieldSize = field->size;
+
+        /*Enums take no space, their size was set by analyzerEnum*/
+        } else if (field->tag == symEnum)
+            continue;
+
+        else {
+            debugErrorUnhandled("analyzerRecordLayout", "symbol tag", symTagGetStr(field->tag));
+            continue;
+        }
+
+        /*Set the field offset and update the record size*/
+
+        field->offset = nextOffset;
+
+        if (record->tag == symStruct) {
+            /*Add the size of this field, rounded up to the nearest word boundary*/
+            int alignment = ctx->arch->wordsize;
+            fieldSize = ((fieldSize-1)/alignment+1)*alignment;
+            record->size += fieldSize;
+            nextOffset += fieldSize;
+
+        } else
+            record->size = max(record->size, fieldSize);
+    }
+}
+
+static const type* analyzerDeclNode (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     debugEnter(astTagGetStr(Node->tag));
 
     const type* DT = 0;
@@ -297,7 +353,7 @@ static const type* analyzerDeclNode (analyzerCtx* ctx, ast* Node, type* base, bo
     return DT;
 }
 
-static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     /*Verify types*/
 
     const type* L = analyzerDeclNode(ctx, Node->l, base, module, storage);
@@ -306,8 +362,9 @@ static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, type* bas
     if (Node->r->tag == astLiteral && Node->r->litTag == literalInit) {
         analyzerCompoundInit(ctx, Node->r, L);
 
+        /*Types are immutable, so the symbol gets a sized copy*/
         if (typeIsArray(L) && typeGetArraySize(L) < 0)
-            typeSetArraySize(Node->symbol->dt, typeGetArraySize(Node->r->dt));
+            L = Node->symbol->dt = typeDeriveArraySize(Node->symbol->dt, typeGetArraySize(Node->r->dt));
 
     /*Regular assignment*/
     } else {
@@ -341,7 +398,7 @@ static const type* analyzerDeclAssignBOP (analyzerCtx* ctx, ast* Node, type* bas
     return L;
 }
 
-static const type* analyzerConst (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+static const type* analyzerConst (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     if (base->qual.isConst)
         errorAlreadyConst(ctx, Node);
 
@@ -349,24 +406,24 @@ static const type* analyzerConst (analyzerCtx* ctx, ast* Node, type* base, bool
         errorIllegalConst(ctx, Node, base);
 
     else
-        base->qual.isConst = true;
+        base = typeDeriveConst(base);
 
     return analyzerDeclNode(ctx, Node->r, base, module, storage);
 }
 
-static const type* analyzerDeclPtrUOP (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+static const type* analyzerDeclPtrUOP (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     return analyzerDeclNode(ctx, Node->r, typeCreatePtr(base), module, storage);
 }
 
-static const type* analyzerDeclCall (analyzerCtx* ctx, ast* Node, type* returnType, bool module, storageTag storage) {
+static const type* analyzerDeclCall (analyzerCtx* ctx, ast* Node, const type* returnType, bool module, storageTag storage) {
     if (!typeIsComplete(returnType))
         errorIncompleteReturnDecl(ctx, Node, returnType);
 
-    type* DT = analyzerParamList(ctx, Node, returnType);
+    const type* DT = analyzerParamList(ctx, Node, returnType);
     return analyzerDeclNode(ctx, Node->l, DT, module, storage);
 }
 
-static const type* analyzerDeclIndex (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+static const type* analyzerDeclIndex (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     int size = arraySizeError;
 
     /*Unspecified size, we will (hopefully) infer it from an initializer
@@ -394,7 +451,7 @@ static const type* analyzerDeclIndex (analyzerCtx* ctx, ast* Node, type* base, b
     return analyzerDeclNode(ctx, Node->l, typeCreateArray(base, size), module, storage);
 }
 
-static const type* analyzerDeclIdentLiteral (analyzerCtx* ctx, ast* Node, type* base, bool module, storageTag storage) {
+static const type* analyzerDeclIdentLiteral (analyzerCtx* ctx, ast* Node, const type* base, bool module, storageTag storage) {
     bool fn = typeIsFunction(base);
     /*The storage tag defaults to:
         - extern if the symbol is a function,
@@ -311,18 +311,19 @@ static void analyzerMemberBOP (analyzerCtx* ctx, ast* Node) {
         /*Try to find the field inside the record and get the return type*/
         } else {
             Node->symbol = analyzerRecordMember(ctx, Node->r, Node->o, record->basic);
-            Node->dt = Node->symbol ? typeDeepDuplicate(Node->symbol->dt)
+            Node->dt = Node->symbol ? Node->symbol->dt
                                     : typeCreateInvalid();
         }
 
-        Node->dt->qual.isConst |= record->qual.isConst;
+        if (record->qual.isConst)
+            Node->dt = typeDeriveConst(Node->dt);
     }
 }
 
 static void analyzerCommaBOP (analyzerCtx* ctx, ast* Node) {
     analyzerValue(ctx, Node->l);
     const type* R = analyzerValue(ctx, Node->r);
-    Node->dt = typeDeepDuplicate(R);
+    Node->dt = R;
 }
 
 static void analyzerUOP (analyzerCtx* ctx, ast* Node) {
@@ -388,14 +389,14 @@ static void analyzerUOP (analyzerCtx* ctx, ast* Node) {
 }
 
 static void analyzerTernary (analyzerCtx* ctx, ast* Node) {
-    const type* Cond = analyzerValue(ctx, Node->firstChild);
+    const type* Cond = analyzerValue(ctx, Node->child[0]);
     const type* L = analyzerValue(ctx, Node->l);
     const type* R = analyzerValue(ctx, Node->r);
 
     /*Operation allowed*/
 
     if (!typeIsCondition(Cond))
-        errorOpTypeExpected(ctx, Node->firstChild, opTernary, "condition value");
+        errorOpTypeExpected(ctx, Node->child[0], opTernary, "condition value");
 
     /*Result types match => return type*/
 
@@ -442,8 +443,8 @@ static void analyzerCall (analyzerCtx* ctx, ast* Node) {
 
         Node->dt = typeCreateInvalid();
 
-        for (ast* param = Node->firstChild; param; param = param->nextSibling)
-            analyzerValue(ctx, param);
+        for (int i = 0; i < Node->children; i++)
+            analyzerValue(ctx, Node->child[i]);
 
     } else {
         Node->dt = typeDeriveReturn(fn);
@@ -456,14 +457,12 @@ static void analyzerCall (analyzerCtx* ctx, ast* Node) {
 
         /*Do the parameter types match?*/
         else {
-            ast* param;
             int n;
 
-            /*Traverse down the node list and params array at the same
+            /*Traverse the node's children and params array at the same
               time, checking types*/
-            for (param = Node->firstChild, n = 0;
-                 param && n < fn->params;
-                 param = param->nextSibling, n++) {
+            for (n = 0; n < Node->children && n < fn->params; n++) {
+                ast* param = Node->child[n];
                 const type* Param = analyzerValue(ctx, param);
 
                 if (!typeIsCompatible(Param, fn->paramTypes[n]))
@@ -472,8 +471,8 @@ static void analyzerCall (analyzerCtx* ctx, ast* Node) {
 
             /*Analyze the rest of the given params even if there were
               fewer params in the prototype (as in a variadic fn).*/
-            for (; param; param = param->nextSibling)
-                analyzerValue(ctx, param);
+            for (; n < Node->children; n++)
+                analyzerValue(ctx, Node->child[n]);
         }
     }
 }
@@ -485,7 +484,7 @@ static void analyzerCast (analyzerCtx* ctx, ast* Node) {
     /*TODO: Verify compatibility. What exactly are the rules? All numerics
             cast to each other and nothing more?*/
 
-    Node->dt = typeDeepDuplicate(L);
+    Node->dt = L;
 }
 
 static void analyzerSizeof (analyzerCtx* ctx, ast* Node) {
@@ -513,13 +512,12 @@ static void analyzerLiteral (analyzerCtx* ctx, ast* Node) {
 
     else if (Node->litTag == literalStr) {
         /* const char* */
-        Node->dt = typeCreatePtr(typeCreateBasic(ctx->types[builtinChar]));
-        Node->dt->base->qual.isConst = true;
+        Node->dt = typeCreatePtr(typeDeriveConst(typeCreateBasic(ctx->types[builtinChar])));
 
     } else if (Node->litTag == literalIdent) {
         if (Node->symbol->tag == symEnumConstant || Node->symbol->tag == symId || Node->symbol->tag == symParam) {
             if (Node->symbol->dt) {
-                Node->dt = typeDeepDuplicate(Node->symbol->dt);
+                Node->dt = Node->symbol->dt;
 
             } else {
                 debugError("analyzerLiteral", "Symbol '%s' referenced without type", Node->symbol->ident);
@@ -554,7 +552,7 @@ static void analyzerCompoundLiteral (analyzerCtx* ctx, ast* Node) {
     if (!typeIsComplete(Node->dt))
         errorIncompleteCompound(ctx, Node, Node->dt);
 
-    Node->symbol->dt = typeDeepDuplicate(Node->dt);
+    Node->symbol->dt = Node->dt;
     Node->symbol->storage = storageAuto;
 }
 
@@ -577,13 +575,13 @@ void analyzerCompoundInit (analyzerCtx* ctx, ast* Node, const type* DT) {
             errorDegree(ctx, Node, "elements", 1, Node->children, "scalar");
 
         else {
-            const type* R = analyzerValue(ctx, Node->firstChild);
+            const type* R = analyzerValue(ctx, Node->child[0]);
 
             if (!typeIsCompatible(R, DT))
                 errorTypeExpectedType(ctx, Node->r, "variable initialization", DT);
         }
 
-        Node->dt = typeDeepDuplicate(DT);
+        Node->dt = DT;
     }
 }
 
@@ -598,9 +596,8 @@ static void analyzerStructInit (analyzerCtx* ctx, ast* Node, const type* DT) {
     /*Index of the next field to analyze*/
     int index = 0;
 
-    for (ast* current = Node->firstChild;
-         current;
-         current = current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* current = Node->child[i];
         ast* value = current;
         const sym* field = 0;
 
@@ -640,7 +637,7 @@ static void analyzerStructInit (analyzerCtx* ctx, ast* Node, const type* DT) {
         }
     }
 
-    Node->dt = typeDeepDuplicate(DT);
+    Node->dt = DT;
 }
 
 static void analyzerArrayInit (analyzerCtx* ctx, ast* Node, const type* DT) {
@@ -649,9 +646,8 @@ static void analyzerArrayInit (analyzerCtx* ctx, ast* Node, const type* DT) {
     bool error = false;
     int maxIndex = 0, index = 0;
 
-    for (ast *current = Node->firstChild;
-         current;
-         current = current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* current = Node->child[i];
         ast* value = current;
 
         /*Explicit index?*/
@@ -688,14 +684,14 @@ static void analyzerArrayInit (analyzerCtx* ctx, ast* Node, const type* DT) {
         }
     }
 
-    Node->dt = typeDeepDuplicate(DT);
+    Node->dt = DT;
 
     int elementNo = typeGetArraySize(DT);
 
     /*If the array size was unspecifed, or if there was an error,
       infer the size from the initializer given*/
     if (elementNo < 0)
-        typeSetArraySize(Node->dt, maxIndex+1);
+        Node->dt = typeDeriveArraySize(DT, maxIndex+1);
 
     else if (maxIndex >= elementNo)
         errorDegree(ctx, Node, "elements", elementNo, maxIndex+1, "array");
@@ -704,7 +700,7 @@ static void analyzerArrayInit (analyzerCtx* ctx, ast* Node, const type* DT) {
 static void analyzerElementInit (analyzerCtx* ctx, ast* Node, const type* expected) {
     /*Skipped initializer*/
     if (Node->tag == astEmpty)
-        Node->dt = typeDeepDuplicate(expected);
+        Node->dt = expected;
 
     /*Recursive initialization*/
     else if (Node->tag == astLiteral && Node->litTag == literalInit)
@@ -724,24 +720,24 @@ static analyzerFnCtx analyzerPushLambda (analyzerCtx* ctx, sym* fn) {
 
 static void analyzerLambda (analyzerCtx* ctx, ast* Node) {
     /*Param list*/
-    type* fn = analyzerParamList(ctx, Node, 0);
+    const type* fn = analyzerParamList(ctx, Node, 0);
 
     /*Body*/
 
     if (Node->r->tag == astCode) {
         analyzerFnCtx old = analyzerPushLambda(ctx, Node->symbol);
         analyzerNode(ctx, Node->r);
-        /*Take ownership of the ret type which has been inferred from the code*/
-        fn->returnType = ctx->fnctx.returnType ? ctx->fnctx.returnType
-                                               : typeCreateBasic(ctx->types[builtinVoid]);
+        /*Fill in the ret type which has been inferred from the code*/
+        fn = typeDeriveReturning(fn, ctx->fnctx.returnType ? ctx->fnctx.returnType
+                                                           : typeCreateBasic(ctx->types[builtinVoid]));
         ctx->fnctx = old;
 
     } else
-        fn->returnType = typeDeepDuplicate(analyzerValue(ctx, Node->r));
+        fn = typeDeriveReturning(fn, analyzerValue(ctx, Node->r));
 
     /*Result*/
     Node->dt = typeCreatePtr(fn);
-    Node->symbol->dt = typeDeepDuplicate(Node->dt);
+    Node->symbol->dt = Node->dt;
     Node->symbol->storage = storageStatic;
 }
 
@@ -765,7 +761,7 @@ static void analyzerVAArg (analyzerCtx* ctx, ast* Node) {
     analyzerVAListParam(ctx, Node->l, "va_arg", "first");
 
     const type* R = analyzerType(ctx, Node->r);
-    Node->dt = typeDeepDuplicate(R);
+    Node->dt = R;
 }
 
 static void analyzerVACopy (analyzerCtx* ctx, ast* Node) {
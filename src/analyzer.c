@@ -23,9 +23,10 @@ static void analyzerLoop (analyzerCtx* ctx, ast* Node);
 static void analyzerIter (analyzerCtx* ctx, ast* Node);
 static void analyzerReturn (analyzerCtx* ctx, ast* Node);
 
-static analyzerCtx* analyzerInit (sym** Types, const architecture* arch) {
+static analyzerCtx* analyzerInit (sym** Types, const sourceManager* sources, const architecture* arch) {
     analyzerCtx* ctx = malloc(sizeof(analyzerCtx));
     ctx->types = Types;
+    ctx->sources = sources;
     ctx->arch = arch;
 
     ctx->fnctx.fn = 0;
@@ -47,7 +48,7 @@ static void analyzerEnd (analyzerCtx* ctx) {
 
 static analyzerFnCtx analyzerPushFnctx (analyzerCtx* ctx, sym* Symbol) {
     const type* fn = typeGetCallable(Symbol->dt);
-    type* ret = fn ? typeDeriveReturn(fn) : typeCreateInvalid();
+    const type* ret = fn ? typeDeriveReturn(fn) : typeCreateInvalid();
 
     analyzerFnCtx old = ctx->fnctx;
     ctx->fnctx = (analyzerFnCtx) {Symbol, ret};
@@ -55,12 +56,11 @@ static analyzerFnCtx analyzerPushFnctx (analyzerCtx* ctx, sym* Symbol) {
 }
 
 static void analyzerPopFnctx (analyzerCtx* ctx, analyzerFnCtx old) {
-    typeDestroy(ctx->fnctx.returnType);
     ctx->fnctx = old;
 }
 
-analyzerResult analyzer (ast* Tree, sym** Types, const architecture* arch) {
-    analyzerCtx* ctx = analyzerInit(Types, arch);
+analyzerResult analyzer (ast* Tree, sym** Types, const sourceManager* sources, const architecture* arch) {
+    analyzerCtx* ctx = analyzerInit(Types, sources, arch);
 
     analyzerNode(ctx, Tree);
     analyzerResult result = {ctx->errors, ctx->warnings};
@@ -119,9 +119,8 @@ void analyzerNode (analyzerCtx* ctx, ast* Node) {
 }
 
 static void analyzerModule (analyzerCtx* ctx, ast* Node) {
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
         if (Current->tag == astUsing)
             analyzerUsing(ctx, Current);
 
@@ -150,9 +149,12 @@ static void analyzerFnImpl (analyzerCtx* ctx, ast* Node) {
         errorFnTag(ctx, Node);
 
     else if (!typeIsFunction(Node->symbol->dt))
-        errorTypeExpected(ctx, Node->l->firstChild, "implementation", "function");
+        errorTypeExpected(ctx, astFirstChild(Node->l), "implementation", "function");
 
-    /*Analyze the implementation*/
+    /*Analyze the implementation, unless it was skipped and never needed*/
+
+    if (!Node->r)
+        return;
 
     /*Save the old one, functions may be (illegally) nested*/
     analyzerFnCtx oldFnctx = analyzerPushFnctx(ctx, Node->symbol);
@@ -163,16 +165,14 @@ static void analyzerFnImpl (analyzerCtx* ctx, ast* Node) {
 }
 
 static void analyzerCode (analyzerCtx* ctx, ast* Node) {
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling)
-        analyzerNode(ctx, Current);
+    for (int i = 0; i < Node->children; i++)
+        analyzerNode(ctx, Node->child[i]);
 }
 
 static void analyzerBranch (analyzerCtx* ctx, ast* Node) {
     /*Is the condition a valid condition?*/
 
-    ast* cond = Node->firstChild;
+    ast* cond = Node->child[0];
     analyzerValue(ctx, cond);
 
     if (!typeIsCondition(cond->dt))
@@ -205,9 +205,9 @@ static void analyzerLoop (analyzerCtx* ctx, ast* Node) {
 }
 
 static void analyzerIter (analyzerCtx* ctx, ast* Node) {
-    ast* init = Node->firstChild;
-    ast* cond = init->nextSibling;
-    ast* iter = cond->nextSibling;
+    ast* init = Node->child[0];
+    ast* cond = Node->child[1];
+    ast* iter = Node->child[2];
 
     /*Initializer*/
 
@@ -250,7 +250,7 @@ static void analyzerReturn (analyzerCtx* ctx, ast* Node) {
        - Any further returns will be checked against this, and it will also be
          used for the type of the lambda itself.*/
     } else
-        ctx->fnctx.returnType = R ? typeDeepDuplicate(R)
+        ctx->fnctx.returnType = R ? R
                                   : typeCreateBasic(ctx->types[builtinVoid]);
 }
 
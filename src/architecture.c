@@ -3,6 +3,7 @@
 #include "../inc/debug.h"
 #include "../inc/sym.h"
 #include "../inc/reg.h"
+#include "../inc/arena.h"
 
 #include "../std/std.h"
 
@@ -88,7 +89,7 @@ static void archSetupRegs (architecture* arch, osTag os) {
         vectorPushFromArray(&arch->scratchRegs, (void**) scratchRegs,
                             sizeof(scratchRegs)/sizeof(regIndex), sizeof(regIndex));
         vectorPushFromArray(&arch->calleeSaveRegs, (void**) calleeSaveRegs,
-                            sizeof(scratchRegs)/sizeof(regIndex), sizeof(regIndex));
+                            sizeof(calleeSaveRegs)/sizeof(regIndex), sizeof(regIndex));
 
         /*RSI and RDI are scratch regs on Windows, callee save on most others*/
         vector* RSIandRDI = os == osWindows ? &arch->scratchRegs : &arch->calleeSaveRegs;
@@ -121,10 +122,10 @@ static void archSetupDriverFlags (architecture* arch, osTag os) {
 /*==== Arch specifics ====*/
 
 static void manglerLinux (sym* Symbol) {
-    Symbol->label = strdup(Symbol->ident);
+    Symbol->label = arenaStrdup(arenaGetCurrent(), Symbol->ident);
 }
 
 static void manglerWindows (sym* Symbol) {
-    Symbol->label = malloc(strlen(Symbol->ident)+2);
+    Symbol->label = arenaAlloc(arenaGetCurrent(), strlen(Symbol->ident)+2);
     sprintf(Symbol->label, "_%s", Symbol->ident);
 }
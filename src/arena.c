@@ -0,0 +1,136 @@
+#include "../inc/arena.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "stdalign.h"
+
+struct arenaBlock {
+    arenaBlock* next;
+    size_t size;
+    alignas(max_align_t) char data[];
+};
+
+/*Per thread, as each parallel job has its own arenas*/
+static _Thread_local arena* current = 0;
+
+arena* arenaInit (arena* a, size_t blockSize) {
+    a->blocks = 0;
+    a->next = 0;
+    a->end = 0;
+    a->blockSize = blockSize;
+
+    a->allocated = 0;
+    a->reserved = 0;
+    a->allocations = 0;
+
+    return a;
+}
+
+void arenaFree (arena* a) {
+    for (arenaBlock *block = a->blocks, *next; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+
+    a->blocks = 0;
+    a->next = 0;
+    a->end = 0;
+}
+
+static arenaBlock* arenaNewBlock (arena* a, size_t size) {
+    /*calloc, so everything handed out is already zeroed*/
+    arenaBlock* block = calloc(1, sizeof(arenaBlock) + size);
+    block->size = size;
+    a->reserved += size;
+    return block;
+}
+
+void* arenaAlloc (arena* a, size_t size) {
+    size_t align = alignof(max_align_t);
+    size = (size + align-1) & ~(align-1);
+
+    a->allocated += size;
+    a->allocations++;
+
+    if ((size_t) (a->end - a->next) >= size) {
+        void* ptr = a->next;
+        a->next += size;
+        return ptr;
+    }
+
+    /*Large objects get a block of their own, behind the current one so
+      that the rest of the current block isn't wasted*/
+    if (size > a->blockSize/4) {
+        arenaBlock* block = arenaNewBlock(a, size);
+
+        if (a->blocks) {
+            block->next = a->blocks->next;
+            a->blocks->next = block;
+
+        } else
+            a->blocks = block;
+
+        return block->data;
+    }
+
+    arenaBlock* block = arenaNewBlock(a, a->blockSize);
+    block->next = a->blocks;
+    a->blocks = block;
+
+    a->next = block->data + size;
+    a->end = block->data + a->blockSize;
+    return block->data;
+}
+
+char* arenaStrndup (arena* a, const char* str, int length) {
+    char* copy = arenaAlloc(a, length+1);
+    memcpy(copy, str, length);
+    return copy;
+}
+
+char* arenaStrdup (arena* a, const char* str) {
+    return arenaStrndup(a, str, strlen(str));
+}
+
+void arenaAdopt (arena* a, arena* from) {
+    if (from->blocks) {
+        arenaBlock* last = from->blocks;
+
+        while (last->next)
+            last = last->next;
+
+        /*Behind the current block, so its free space can still be used*/
+        if (a->blocks) {
+            last->next = a->blocks->next;
+            a->blocks->next = from->blocks;
+
+        } else
+            a->blocks = from->blocks;
+    }
+
+    a->allocated += from->allocated;
+    a->reserved += from->reserved;
+    a->allocations += from->allocations;
+
+    arenaInit(from, from->blockSize);
+}
+
+bool arenaOwns (const arena* a, const void* ptr) {
+    const char* p = ptr;
+
+    for (const arenaBlock* block = a->blocks; block; block = block->next)
+        if (p >= block->data && p < block->data + block->size)
+            return true;
+
+    return false;
+}
+
+arena* arenaSetCurrent (arena* a) {
+    arena* old = current;
+    current = a;
+    return old;
+}
+
+arena* arenaGetCurrent (void) {
+    return current;
+}
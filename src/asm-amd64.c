@@ -10,6 +10,151 @@
 #include "stdarg.h"
 #include "stdio.h"
 
+static operand asmWordReg (const asmCtx* ctx, regIndex r);
+
+/*==== Instructions ====*/
+
+static const char* asmOperandSizeGetStr (int size) {
+    if (size == 1)
+        return "byte";
+    else if (size == 2)
+        return "word";
+    else if (size == 4)
+        return "dword";
+    else if (size == 8)
+        return "qword";
+    else if (size == 16)
+        return "oword";
+    else
+        return "dword";
+}
+
+/*Write an operand into str, which has room for any. Addresses are formed
+  from registers of the word size.*/
+static const char* asmOperandToStr (const asmCtx* ctx, operand Value, char* str, int length) {
+    int wordsize = ctx->arch->wordsize;
+
+    if (Value.tag == operandReg)
+        snprintf(str, length, "%s", regGetName(Value.base, Value.size));
+
+    else if (Value.tag == operandMem) {
+        const char* sizeStr = asmOperandSizeGetStr(Value.size);
+        const char* baseStr = regGetName(Value.base, wordsize);
+
+        if (Value.index && Value.factor)
+            snprintf(str, length, "%s ptr [%s%+d*%s%+d]", sizeStr, baseStr,
+                     Value.factor, regGetName(Value.index, wordsize), Value.offset);
+
+        else if (Value.offset)
+            snprintf(str, length, "%s ptr [%s%+d]", sizeStr, baseStr, Value.offset);
+
+        else
+            snprintf(str, length, "%s ptr [%s]", sizeStr, baseStr);
+
+    } else if (Value.tag == operandLabelMem)
+        snprintf(str, length, "%s ptr [%s]", asmOperandSizeGetStr(Value.size), Value.label);
+
+    else {
+        char* valueStr = operandToStr(Value);
+        snprintf(str, length, "%s", valueStr);
+        free(valueStr);
+    }
+
+    return str;
+}
+
+void asmInstr (asmCtx* ctx, const irInstr* instr) {
+    enum {operandStrSize = 256};
+    char destStr[operandStrSize], LStr[operandStrSize], RStr[operandStrSize];
+
+    const char *dest = asmOperandToStr(ctx, instr->dest, destStr, operandStrSize),
+               *L = asmOperandToStr(ctx, instr->l, LStr, operandStrSize),
+               *R = asmOperandToStr(ctx, instr->r, RStr, operandStrSize);
+
+    if (instr->tag == instrMove)
+        asmOutLn(ctx, "mov %s, %s", dest, L);
+
+    else if (instr->tag == instrMoveZeroExt)
+        asmOutLn(ctx, "movzx %s, %s", dest, L);
+
+    else if (instr->tag == instrMoveSignExt)
+        asmOutLn(ctx, "movsx %s, %s", dest, L);
+
+    else if (instr->tag == instrConditionalMove) {
+        operand Cond = operandCreateFlags(conditionNegate(instr->r.condition));
+        char* CondStr = operandToStr(Cond);
+
+        asmOutLn(ctx, "j%s %s", CondStr, instr->label);
+        asmOutLn(ctx, "mov %s, %s", dest, L);
+        asmOutLn(ctx, "%s:", instr->label);
+
+        free(CondStr);
+
+    } else if (instr->tag == instrSetCond) {
+        char* CondStr = operandToStr(instr->r);
+        asmOutLn(ctx, "set%s %s", CondStr, dest);
+        free(CondStr);
+
+    } else if (instr->tag == instrEvalAddress)
+        asmOutLn(ctx, "lea %s, %s", dest, L);
+
+    else if (instr->tag == instrCompare)
+        asmOutLn(ctx, "cmp %s, %s", L, R);
+
+    else if (instr->tag == instrBOP) {
+        const char* OpStr = instr->bop == bopAdd ? "add" :
+                            instr->bop == bopSub ? "sub" :
+                            instr->bop == bopMul ? "imul" :
+                            instr->bop == bopBitAnd ? "and" :
+                            instr->bop == bopBitOr ? "or" :
+                            instr->bop == bopBitXor ? "xor" :
+                            instr->bop == bopShR ? "sar" :
+                            instr->bop == bopShL ? "sal" : 0;
+
+        if (!OpStr)
+            debugErrorUnhandledInt("asmInstr", "operator", instr->bop);
+
+        else if (operandIsEqual(instr->dest, instr->l))
+            asmOutLn(ctx, "%s %s, %s", OpStr, dest, R);
+
+        /*imul dest, src, imm*/
+        else
+            asmOutLn(ctx, "%s %s, %s, %s", OpStr, dest, L, R);
+
+    } else if (instr->tag == instrUOP) {
+        if (instr->uop == uopInc)
+            asmOutLn(ctx, "add %s, 1", dest);
+
+        else if (instr->uop == uopDec)
+            asmOutLn(ctx, "sub %s, 1", dest);
+
+        else if (instr->uop == uopNeg || instr->uop == uopBitwiseNot)
+            asmOutLn(ctx, "%s %s", instr->uop == uopNeg ? "neg" : "not", dest);
+
+        else
+            debugErrorUnhandledInt("asmInstr", "operator", instr->uop);
+
+    } else if (instr->tag == instrDivision)
+        asmOutLn(ctx, "idiv %s", L);
+
+    else if (instr->tag == instrPush)
+        asmOutLn(ctx, "push %s", L);
+
+    else if (instr->tag == instrPop)
+        asmOutLn(ctx, "pop %s", dest);
+
+    else if (instr->tag == instrRepStos)
+        asmOutLn(ctx, "rep stos%s", instr->l.literal == 8 ? "q" : "d");
+
+    else if (instr->tag == instrCallIndirect)
+        asmOutLn(ctx, "call %s", L);
+
+    else
+        debugErrorUnhandledInt("asmInstr", "instruction tag", instr->tag);
+}
+
+/*==== ====*/
+
 void asmComment (asmCtx* ctx, const char* str) {
     asmOutLn(ctx, ";%s", str);
 }
@@ -34,7 +179,7 @@ void asmFnLinkageEnd (FILE* file, const char* name) {
     (void) file, (void) name;
 }
 
-void asmFnPrologue (irCtx* ir, irBlock* block, int localSize) {
+void asmFnPrologue (irCtx* ir, irBlock* block, int localSize, const vector/*<regIndex>*/* savedRegs) {
     asmCtx* ctx = ir->asm;
 
     /*Register saving, create a new stack frame, stack variables etc*/
@@ -45,18 +190,18 @@ void asmFnPrologue (irCtx* ir, irBlock* block, int localSize) {
     if (localSize != 0)
         asmBOP(ir, block, bopSub, ctx->stackPtr, operandCreateLiteral(localSize));
 
-    for (int i = 0; i < ctx->arch->calleeSaveRegs.length; i++) {
-        regIndex r = (regIndex) vectorGet(&ctx->arch->calleeSaveRegs, i);
+    for (int i = 0; i < savedRegs->length; i++) {
+        regIndex r = (regIndex) vectorGet(savedRegs, i);
         asmSaveReg(ir, block, r);
     }
 }
 
-void asmFnEpilogue (irCtx* ir, irBlock* block) {
+void asmFnEpilogue (irCtx* ir, irBlock* block, const vector/*<regIndex>*/* savedRegs) {
     asmCtx* ctx = ir->asm;
 
     /*Pop off saved regs in reverse order*/
-    for (int i = ctx->arch->calleeSaveRegs.length-1; i >= 0 ; i--) {
-        regIndex r = (regIndex) vectorGet(&ctx->arch->calleeSaveRegs, i);
+    for (int i = savedRegs->length-1; i >= 0 ; i--) {
+        regIndex r = (regIndex) vectorGet(savedRegs, i);
         asmRestoreReg(ir, block, r);
     }
 
@@ -64,14 +209,19 @@ void asmFnEpilogue (irCtx* ir, irBlock* block) {
     asmPop(ir, block, ctx->basePtr);
 }
 
+/*A physical register operand of the word size, allocated or not*/
+static operand asmWordReg (const asmCtx* ctx, regIndex r) {
+    operand R = operandCreateReg(&regs[r]);
+    R.size = ctx->arch->wordsize;
+    return R;
+}
+
 void asmSaveReg (irCtx* ir, irBlock* block, regIndex r) {
-    asmCtx* ctx = ir->asm;
-    irBlockOut(block, "push %s", regIndexGetName(r, ctx->arch->wordsize));
+    asmPush(ir, block, asmWordReg(ir->asm, r));
 }
 
 void asmRestoreReg (irCtx* ir, irBlock* block, regIndex r) {
-    asmCtx* ctx = ir->asm;
-    irBlockOut(block, "pop %s", regIndexGetName(r, ctx->arch->wordsize));
+    asmPop(ir, block, asmWordReg(ir->asm, r));
 }
 
 void asmDataSection (asmCtx* ctx) {
@@ -128,9 +278,7 @@ void asmCall (asmCtx* ctx, const char* label) {
 }
 
 void asmCallIndirect (irBlock* block, operand L) {
-    char* LStr = operandToStr(L);
-    irBlockOut(block, "call %s", LStr);
-    free(LStr);
+    irInstrCreate(block, instrCallIndirect, operandCreate(operandUndefined), L, operandCreate(operandUndefined));
 }
 
 void asmReturn (asmCtx* ctx) {
@@ -170,19 +318,13 @@ void asmPush (irCtx* ir, irBlock* block, operand L) {
         asmPush(ir, block, intermediate);
         operandFree(intermediate);
 
-    } else {
-        char* LStr = operandToStr(L);
-        irBlockOut(block, "push %s", LStr);
-        free(LStr);
-    }
+    } else
+        irInstrCreate(block, instrPush, operandCreate(operandUndefined), L, operandCreate(operandUndefined));
 }
 
 void asmPop (irCtx* ir, irBlock* block, operand L) {
     (void) ir;
-
-    char* LStr = operandToStr(L);
-    irBlockOut(block, "pop %s", LStr);
-    free(LStr);
+    irInstrCreate(block, instrPop, L, operandCreate(operandUndefined), operandCreate(operandUndefined));
 }
 
 void asmPushN (irCtx* ir, irBlock* block, int n) {
@@ -247,33 +389,29 @@ void asmMove (irCtx* ir, irBlock* block, operand Dest, operand Src) {
         asmConditionalMove(ir, block, Src, Dest, operandCreateLiteral(1));
 
     } else {
-        char* DestStr = operandToStr(Dest);
-        char* SrcStr = operandToStr(Src);
-
-        if (   operandGetSize(ctx->arch, Dest) > operandGetSize(ctx->arch, Src)
-            && Src.tag != operandLiteral)
-            irBlockOut(block, "movzx %s, %s", DestStr, SrcStr);
-
-        else
-            irBlockOut(block, "mov %s, %s", DestStr, SrcStr);
-
-        free(DestStr);
-        free(SrcStr);
+        bool extend =    operandGetSize(ctx->arch, Dest) > operandGetSize(ctx->arch, Src)
+                      && Src.tag != operandLiteral;
+        irInstrCreate(block, extend ? instrMoveZeroExt : instrMove, Dest, Src, operandCreate(operandUndefined));
     }
 }
 
 void asmConditionalMove (irCtx* ir, irBlock* block, operand Cond, operand Dest, operand Src) {
-    char falseLabel[10];
-    sprintf(falseLabel, ".%X", ir->labelNo++);
-
-    Cond.condition = conditionNegate(Cond.condition);
-    char* cond = operandToStr(Cond);
+    /*The move itself must be a single instruction*/
+    if (operandIsMem(Dest) && operandIsMem(Src)) {
+        operand intermediate = operandCreateReg(regAlloc(max(Dest.size, Src.size)));
+        asmMove(ir, block, intermediate, Src);
+        asmConditionalMove(ir, block, Cond, Dest, intermediate);
+        operandFree(intermediate);
 
-    irBlockOut(block, "j%s %s", cond, falseLabel);
-    asmMove(ir, block, Dest, Src);
-    irBlockOut(block, "%s:", falseLabel);
+    } else {
+        irInstr* instr = irInstrCreate(block, instrConditionalMove, Dest, Src, Cond);
+        instr->label = irCreateLabel(ir);
+    }
+}
 
-    free(cond);
+void asmSignExtend (irCtx* ir, irBlock* block, operand Dest, operand Src) {
+    (void) ir;
+    irInstrCreate(block, instrMoveSignExt, Dest, Src, operandCreate(operandUndefined));
 }
 
 void asmRepStos (irCtx* ir, irBlock* block, operand RAX, operand RCX, operand RDI,
@@ -285,7 +423,8 @@ void asmRepStos (irCtx* ir, irBlock* block, operand RAX, operand RCX, operand RD
     asmMove(ir, block, RCX, operandCreateLiteral(iterations));
     asmEvalAddress(ir, block, RDI, Dest);
 
-    irBlockOut(block, "rep stos%s", chunksize == 8 ? "q" : "d");
+    irInstrCreate(block, instrRepStos, operandCreate(operandUndefined),
+                  operandCreateLiteral(chunksize), operandCreate(operandUndefined));
 }
 
 void asmEvalAddress (irCtx* ir, irBlock* block, operand L, operand R) {
@@ -298,12 +437,8 @@ void asmEvalAddress (irCtx* ir, irBlock* block, operand L, operand R) {
         operandFree(intermediate);
 
     } else {
-        char* LStr = operandToStr(L);
         R.size = ctx->arch->wordsize;
-        char* RStr = operandToStr(R);
-        irBlockOut(block, "lea %s, %s", LStr, RStr);
-        free(LStr);
-        free(RStr);
+        irInstrCreate(block, instrEvalAddress, L, R, operandCreate(operandUndefined));
     }
 }
 
@@ -321,13 +456,8 @@ void asmCompare (irCtx* ir, irBlock* block, operand L, operand R) {
     } else if (L.tag == operandLiteral) {
         asmCompare(ir, block, R, L);
 
-    } else {
-        char* LStr = operandToStr(L);
-        char* RStr = operandToStr(R);
-        irBlockOut(block, "cmp %s, %s", LStr, RStr);
-        free(LStr);
-        free(RStr);
-    }
+    } else
+        irInstrCreate(block, instrCompare, operandCreate(operandUndefined), L, R);
 }
 
 void asmBOP (irCtx* ir, irBlock* block, boperation Op, operand L, operand R) {
@@ -348,66 +478,26 @@ void asmBOP (irCtx* ir, irBlock* block, boperation Op, operand L, operand R) {
         } else {
             operand tmp = operandCreateReg(regAlloc(max(L.size, R.size)));
 
-            char* LStr = operandToStr(L);
-            char* RStr = operandToStr(R);
-            char* tmpStr = operandToStr(tmp);
-            irBlockOut(block, "imul %s, %s, %s", tmpStr, LStr, RStr);
-            free(tmpStr);
-            free(LStr);
-            free(RStr);
+            irInstr* instr = irInstrCreate(block, instrBOP, tmp, L, R);
+            instr->bop = bopMul;
 
             asmMove(ir, block, L, tmp);
             operandFree(tmp);
         }
 
     } else {
-        char* LStr = operandToStr(L);
-        char* RStr = operandToStr(R);
-
-        const char* OpStr = Op == bopAdd ? "add" :
-                            Op == bopSub ? "sub" :
-                            Op == bopMul ? "imul" :
-                            Op == bopBitAnd ? "and" :
-                            Op == bopBitOr ? "or" :
-                            Op == bopBitXor ? "xor" :
-                            Op == bopShR ? "sar" :
-                            Op == bopShL ? "sal" : 0;
-
-        if (OpStr)
-            irBlockOut(block, "%s %s, %s", OpStr, LStr, RStr);
-
-        else
-            printf("asmBOP(): unhandled operator '%d'\n", Op);
-
-        free(LStr);
-        free(RStr);
+        irInstr* instr = irInstrCreate(block, instrBOP, L, L, R);
+        instr->bop = Op;
     }
 }
 
 void asmDivision (irCtx* ir, irBlock* block, operand R) {
     (void) ir;
-
-    char* RStr = operandToStr(R);
-    irBlockOut(block, "idiv %s", RStr);
-    free(RStr);
+    irInstrCreate(block, instrDivision, operandCreate(operandUndefined), R, operandCreate(operandUndefined));
 }
 
 void asmUOP (irCtx* ir, irBlock* block, uoperation Op, operand R) {
     (void) ir;
-
-    char* RStr = operandToStr(R);
-
-    if (Op == uopInc)
-        irBlockOut(block, "add %s, 1", RStr);
-
-    else if (Op == uopDec)
-        irBlockOut(block, "sub %s, 1", RStr);
-
-    else if (Op == uopNeg || Op == uopBitwiseNot)
-        irBlockOut(block, "%s %s", Op == uopNeg ? "neg" : "not", RStr);
-
-    else
-        printf("asmUOP(): unhandled operator tag, %d", Op);
-
-    free(RStr);
+    irInstr* instr = irInstrCreate(block, instrUOP, R, R, operandCreate(operandUndefined));
+    instr->uop = Op;
 }
@@ -3,36 +3,21 @@
 #include "../inc/debug.h"
 #include "../inc/type.h"
 #include "../inc/sym.h"
+#include "../inc/arena.h"
 
 #include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
 
 ast* astCreate (astTag tag, tokenLocation location) {
-    ast* Node = calloc(1, sizeof(ast));
+    ast* Node = arenaAlloc(arenaGetCurrent(), sizeof(ast));
     Node->tag = tag;
     Node->location = location;
+    Node->child = Node->inlineChildren;
+    Node->childCapacity = astInlineChildren;
     return Node;
 }
 
-void astDestroy (ast* Node) {
-    for (ast *Current = Node->firstChild, *Next = Current ? Current->nextSibling : 0;
-         Current;
-         Current = Next, Next = Next ? Next->nextSibling : 0)
-        astDestroy(Current);
-
-    if (Node->l)
-        astDestroy(Node->l);
-
-    if (Node->r && Node->tag != astUsing)
-        astDestroy(Node->r);
-
-    if (Node->dt)
-        typeDestroy(Node->dt);
-
-    free(Node->literal);
-    free(Node);
-}
-
 ast* astCreateInvalid (tokenLocation location) {
     return astCreate(astInvalid, location);
 }
@@ -159,7 +144,7 @@ ast* astCreateLiteral (tokenLocation location, literalTag litTag) {
     return Node;
 }
 
-ast* astCreateLiteralIdent (tokenLocation location, char* ident) {
+ast* astCreateLiteralIdent (tokenLocation location, const char* ident) {
     ast* Node = astCreateLiteral(location, literalIdent);
     Node->literal = (void*) ident;
     return Node;
@@ -172,17 +157,22 @@ ast* astCreateAssert (tokenLocation location, ast* expr) {
 }
 
 void astAddChild (ast* Parent, ast* Child) {
-    if (Parent->firstChild == 0) {
-        Parent->firstChild = Child;
-        Parent->lastChild = Child;
-
-    } else {
-        Child->prevSibling = Parent->lastChild;
-        Parent->lastChild->nextSibling = Child;
-        Parent->lastChild = Child;
+    if (Parent->children == Parent->childCapacity) {
+        ast** old = Parent->child;
+        Parent->childCapacity *= 2;
+        Parent->child = arenaAlloc(arenaGetCurrent(), Parent->childCapacity*sizeof(ast*));
+        memcpy(Parent->child, old, Parent->children*sizeof(ast*));
     }
 
-    Parent->children++;
+    Parent->child[Parent->children++] = Child;
+}
+
+ast* astFirstChild (const ast* Node) {
+    return Node->children ? Node->child[0] : 0;
+}
+
+ast* astLastChild (const ast* Node) {
+    return Node->children ? Node->child[Node->children-1] : 0;
 }
 
 bool astIsValueTag (astTag tag) {
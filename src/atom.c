@@ -0,0 +1,117 @@
+#include "../inc/atom.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+static unsigned int atomHash (const char* str, int length) {
+    /*Jenkin's One-at-a-Time Hash, as in hashmap.c*/
+
+    unsigned int hash = 0;
+
+    for (int i = 0; i < length; i++) {
+        hash += (unsigned char) str[i];
+        hash += hash << 10;
+        hash ^= hash >> 6;
+    }
+
+    hash += hash << 3;
+    hash ^= hash >> 11;
+    hash += hash << 15;
+
+    return hash;
+}
+
+atomTable* atomTableInit (atomTable* table, int size) {
+    /*Power of two, so the hash can be masked*/
+    int pow2 = 16;
+
+    while (pow2 < size)
+        pow2 *= 2;
+
+    table->size = pow2;
+    table->elements = 0;
+    table->atoms = calloc(pow2, sizeof(char*));
+    table->lengths = calloc(pow2, sizeof(int));
+    table->hashes = calloc(pow2, sizeof(unsigned int));
+
+    arenaInit(&table->strings, 64*1024);
+
+    return table;
+}
+
+void atomTableFree (atomTable* table) {
+    arenaFree(&table->strings);
+
+    free(table->atoms);
+    free(table->lengths);
+    free(table->hashes);
+    table->atoms = 0;
+    table->lengths = 0;
+    table->hashes = 0;
+}
+
+/*Find the slot holding the string, or the empty slot where it would go*/
+static int atomFind (const atomTable* table, const char* str, int length, unsigned int hash) {
+    unsigned int mask = table->size-1;
+
+    for (unsigned int index = hash & mask;; index = (index+1) & mask) {
+        const char* atom = table->atoms[index];
+
+        if (   !atom
+            || (   table->hashes[index] == hash && table->lengths[index] == length
+                && !memcmp(atom, str, length)))
+            return index;
+    }
+}
+
+static void atomTableGrow (atomTable* table) {
+    atomTable old = *table;
+
+    table->size *= 2;
+    table->atoms = calloc(table->size, sizeof(char*));
+    table->lengths = calloc(table->size, sizeof(int));
+    table->hashes = calloc(table->size, sizeof(unsigned int));
+
+    for (int i = 0; i < old.size; i++) {
+        if (!old.atoms[i])
+            continue;
+
+        int index = atomFind(table, old.atoms[i], old.lengths[i], old.hashes[i]);
+        table->atoms[index] = old.atoms[i];
+        table->lengths[index] = old.lengths[i];
+        table->hashes[index] = old.hashes[i];
+    }
+
+    table->elements = old.elements;
+
+    free(old.atoms);
+    free(old.lengths);
+    free(old.hashes);
+}
+
+const char* atomGet (atomTable* table, const char* str, int length) {
+    unsigned int hash = atomHash(str, length);
+    int index = atomFind(table, str, length, hash);
+
+    if (table->atoms[index])
+        return table->atoms[index];
+
+    /*Keep the load factor under a half*/
+    if (2*(table->elements+1) > table->size) {
+        atomTableGrow(table);
+        index = atomFind(table, str, length, hash);
+    }
+
+    char* atom = arenaStrndup(&table->strings, str, length);
+
+    table->atoms[index] = atom;
+    table->lengths[index] = length;
+    table->hashes[index] = hash;
+    table->elements++;
+
+    return atom;
+}
+
+const char* atomGetStr (atomTable* table, const char* str) {
+    return atomGet(table, str, strlen(str));
+}
@@ -1,16 +1,21 @@
 #include "../inc/bitarray.h"
 
 #include "stdlib.h"
+#include "string.h"
 
 enum {
     bitsPerWord = 8*sizeof(bitarrayWord)
 };
 
+/*Unsigned, so the word loops have no signed overflow to assume away*/
+static size_t bitarrayGetWordNo (const bitarray* bits) {
+    return ((size_t) bits->bitno + bitsPerWord-1) / bitsPerWord;
+}
+
 bitarray* bitarrayInit (bitarray* bits, int bitno) {
-    /*Round up to fit enough bits*/
-    int size = (bitno-1)/bitsPerWord + 1;
-    bits->array = calloc(size, sizeof(bitarrayWord));
     bits->bitno = bitno;
+    /*Round up to fit enough bits*/
+    bits->array = calloc(max(bitarrayGetWordNo(bits), 1), sizeof(bitarrayWord));
     return bits;
 }
 
@@ -29,10 +34,10 @@ bool bitarrayModify (bitarray* bits, int index, bool set) {
         bit = index % bitsPerWord;
 
     if (set)
-        bits->array[word] |= 1 << bit;
+        bits->array[word] |= (bitarrayWord) 1 << bit;
 
     else
-        bits->array[word] &= ~(1 << bit);
+        bits->array[word] &= ~((bitarrayWord) 1 << bit);
 
     return true;
 }
@@ -52,5 +57,116 @@ bitarrayWord bitarrayTest (const bitarray* bits, int index) {
     int word = index / bitsPerWord,
         bit = index % bitsPerWord;
 
-    return bits->array[word] & (1 << bit);
+    return bits->array[word] & ((bitarrayWord) 1 << bit);
+}
+
+/*==== Whole arrays ====*/
+
+void bitarrayClear (bitarray* bits) {
+    memset(bits->array, 0, bitarrayGetWordNo(bits)*sizeof(bitarrayWord));
+}
+
+void bitarraySetAll (bitarray* bits) {
+    size_t wordNo = bitarrayGetWordNo(bits);
+    memset(bits->array, 0xFF, wordNo*sizeof(bitarrayWord));
+
+    /*Keep the bits past the end clear, so that whole words can be compared*/
+    int tail = bits->bitno % bitsPerWord;
+
+    if (tail != 0)
+        bits->array[wordNo-1] = ((bitarrayWord) 1 << tail) - 1;
+}
+
+void bitarrayCopy (bitarray* dest, const bitarray* src) {
+    memcpy(dest->array, src->array, bitarrayGetWordNo(dest)*sizeof(bitarrayWord));
+}
+
+bool bitarrayEqual (const bitarray* l, const bitarray* r) {
+    return !memcmp(l->array, r->array, bitarrayGetWordNo(l)*sizeof(bitarrayWord));
+}
+
+bool bitarrayUnion (bitarray* dest, const bitarray* src) {
+    bitarrayWord changed = 0;
+
+    for (size_t i = 0, wordNo = bitarrayGetWordNo(dest); i < wordNo; i++) {
+        bitarrayWord old = dest->array[i];
+        dest->array[i] |= src->array[i];
+        changed |= old ^ dest->array[i];
+    }
+
+    return changed != 0;
+}
+
+bool bitarrayIntersect (bitarray* dest, const bitarray* src) {
+    bitarrayWord changed = 0;
+
+    for (size_t i = 0, wordNo = bitarrayGetWordNo(dest); i < wordNo; i++) {
+        bitarrayWord old = dest->array[i];
+        dest->array[i] &= src->array[i];
+        changed |= old ^ dest->array[i];
+    }
+
+    return changed != 0;
+}
+
+bool bitarrayDifference (bitarray* dest, const bitarray* src) {
+    bitarrayWord changed = 0;
+
+    for (size_t i = 0, wordNo = bitarrayGetWordNo(dest); i < wordNo; i++) {
+        bitarrayWord old = dest->array[i];
+        dest->array[i] &= ~src->array[i];
+        changed |= old ^ dest->array[i];
+    }
+
+    return changed != 0;
+}
+
+/*Index of the lowest set bit of a non-zero word*/
+static int bitarrayWordLowest (bitarrayWord word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+
+    for (; !(word & 1); word >>= 1)
+        bit++;
+
+    return bit;
+#endif
+}
+
+int bitarrayNext (const bitarray* bits, int index) {
+    if (index >= bits->bitno)
+        return -1;
+
+    size_t word = (size_t) index / bitsPerWord,
+           bit = (size_t) index % bitsPerWord;
+
+    /*Ignore the bits of the first word before index*/
+    bitarrayWord current = bits->array[word] & (~(bitarrayWord) 0 << bit);
+
+    for (size_t wordNo = bitarrayGetWordNo(bits);;) {
+        if (current != 0)
+            return (int) word*bitsPerWord + bitarrayWordLowest(current);
+
+        else if (++word == wordNo)
+            return -1;
+
+        current = bits->array[word];
+    }
+}
+
+int bitarrayCount (const bitarray* bits) {
+    int count = 0;
+
+    for (size_t i = 0, wordNo = bitarrayGetWordNo(bits); i < wordNo; i++) {
+#if defined(__GNUC__)
+        count += __builtin_popcountll(bits->array[i]);
+#else
+        for (bitarrayWord word = bits->array[i]; word; word &= word-1)
+            count++;
+#endif
+    }
+
+    return count;
 }
@@ -14,6 +14,7 @@
 #include "../inc/emitter.h"
 
 #include "stdlib.h"
+#include "stdio.h"
 
 
 static void compilerInitSymbols (compilerCtx* ctx);
@@ -24,28 +25,41 @@ static void compilerInitSymbols (compilerCtx* ctx) {
 
     ctx->global = symInit();
     ctx->types = calloc((int) builtinTotal, sizeof(sym*));
-    ctx->types[builtinVoid] = symCreateType(ctx->global, "void", 0, typeNone);
-    ctx->types[builtinBool] = symCreateType(ctx->global, "bool", 4, typeBool);
-    ctx->types[builtinChar] = symCreateType(ctx->global, "char", 1, typeIntegral);
-    ctx->types[builtinInt] = symCreateType(ctx->global, "int", 4, typeIntegral);
-    ctx->types[builtinSizeT] = symCreateType(ctx->global, "size_t", ctx->arch->wordsize, typeIntegral);
-    ctx->types[builtinVAList] = symCreateType(ctx->global, "va_list", ctx->arch->wordsize, typeAssignment);
-
-    symCreateType(ctx->global, "int8_t", 1, typeIntegral);
-    symCreateType(ctx->global, "int16_t", 2, typeIntegral);
-    symCreateType(ctx->global, "int32_t", 4, typeIntegral);
-    symCreateType(ctx->global, "intptr_t", ctx->arch->wordsize, typeIntegral);
-    symCreateType(ctx->global, "intmax_t", ctx->arch->wordsize, typeIntegral);
+    ctx->types[builtinVoid] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "void"), 0, typeNone);
+    ctx->types[builtinBool] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "bool"), 4, typeBool);
+    ctx->types[builtinChar] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "char"), 1, typeIntegral);
+    ctx->types[builtinInt] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "int"), 4, typeIntegral);
+    ctx->types[builtinSizeT] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "size_t"), ctx->arch->wordsize, typeIntegral);
+    ctx->types[builtinVAList] = symCreateType(ctx->global, atomGetStr(&ctx->atoms, "va_list"), ctx->arch->wordsize, typeAssignment);
+
+    symCreateType(ctx->global, atomGetStr(&ctx->atoms, "int8_t"), 1, typeIntegral);
+    symCreateType(ctx->global, atomGetStr(&ctx->atoms, "int16_t"), 2, typeIntegral);
+    symCreateType(ctx->global, atomGetStr(&ctx->atoms, "int32_t"), 4, typeIntegral);
+    symCreateType(ctx->global, atomGetStr(&ctx->atoms, "intptr_t"), ctx->arch->wordsize, typeIntegral);
+    symCreateType(ctx->global, atomGetStr(&ctx->atoms, "intmax_t"), ctx->arch->wordsize, typeIntegral);
 
     if (ctx->arch->wordsize >= 8)
-        symCreateType(ctx->global, "int64_t", 8, typeIntegral);
+        symCreateType(ctx->global, atomGetStr(&ctx->atoms, "int64_t"), 8, typeIntegral);
 }
 
 void compilerInit (compilerCtx* ctx, const architecture* arch, const vector/*<char*>*/* searchPaths) {
     hashmapInit(&ctx->modules, 1024);
+    vectorInit(&ctx->moduleList, 32);
+    atomTableInit(&ctx->atoms, 4096);
+    sourceManagerInit(&ctx->sources);
+    moduleCacheInit(&ctx->moduleCache, 0);
+
+    arenaInit(&ctx->arena, 64*1024);
+    arenaSetCurrent(&ctx->arena);
+
+    typeTableInit(&ctx->typeTable);
+    typeTableSetCurrent(&ctx->typeTable);
 
     ctx->arch = arch;
     ctx->searchPaths = searchPaths;
+    ctx->threads = 1;
+    ctx->interfaces = false;
+    ctx->peephole = (irPeepholeStats) {{0}};
 
     ctx->errors = 0;
     ctx->warnings = 0;
@@ -55,31 +69,51 @@ void compilerInit (compilerCtx* ctx, const architecture* arch, const vector/*<ch
 
 void compilerEnd (compilerCtx* ctx) {
     hashmapFreeObjs(&ctx->modules, (hashmapKeyDtor) free, (hashmapValueDtor) parserResultDestroy);
+    vectorFree(&ctx->moduleList);
 
-    symEnd(ctx->global);
+    /*The symbol table lives in the arenas*/
     ctx->global = 0;
 
     free(ctx->types);
     ctx->types = 0;
+
+    atomTableFree(&ctx->atoms);
+    sourceManagerFree(&ctx->sources);
+    moduleCacheFree(&ctx->moduleCache);
+
+    typeTableSetCurrent(0);
+    typeTableFree(&ctx->typeTable);
+
+    arenaSetCurrent(0);
+    arenaFree(&ctx->arena);
 }
 
 void compiler (compilerCtx* ctx, const char* input, const char* output) {
     /*Parse the module*/
 
-    ast* tree = 0; {
+    ast* tree = 0;
+    arena* moduleArena = 0; {
         parserResult res = parser(input, "", ctx);
         ctx->errors += res.errors;
         ctx->warnings += res.warnings;
         tree = res.tree;
+        moduleArena = res.arena;
 
         if (res.notfound)
-            printf("fcc: Input file '%s' doesn't exist\n", input);
+            fprintf(debugGetLog(), "fcc: Input file '%s' doesn't exist\n", input);
     }
 
+    /*Types made during analysis and emission belong to the module*/
+    arena* oldArena = arenaSetCurrent(moduleArena ? moduleArena : &ctx->arena);
+
+    /*Only now is it known which skipped function bodies are needed*/
+    if (moduleArena && ctx->interfaces)
+        parserBodies(ctx, tree);
+
     /*Semantic analysis*/
 
     {
-        analyzerResult res = analyzer(tree, ctx->types, ctx->arch);
+        analyzerResult res = analyzer(tree, ctx->types, &ctx->sources, ctx->arch);
         ctx->errors += res.errors;
         ctx->warnings += res.warnings;
     }
@@ -87,5 +121,52 @@ void compiler (compilerCtx* ctx, const char* input, const char* output) {
     /*Emit the assembly*/
 
     if (ctx->errors == 0 && internalErrors == 0)
-        emitter(tree, output, ctx->arch);
+        emitter(tree, output, ctx->arch, ctx->threads, &ctx->peephole);
+
+    arenaSetCurrent(oldArena);
+}
+
+static void compilerPrintArenaStats (const char* name, const arena* a, int lines) {
+    FILE* log = debugGetLog();
+
+    fprintf(log, "fcc: %-24s %8d lines %10zu bytes %8d allocations",
+            name, lines, a->allocated, a->allocations);
+
+    if (lines)
+        fprintf(log, " %8.1f bytes/line\n", (double) a->allocated / lines);
+
+    else
+        fputc('\n', log);
+}
+
+void compilerPrintStats (const compilerCtx* ctx) {
+    size_t allocated =   ctx->arena.allocated + ctx->atoms.strings.allocated
+                       + ctx->typeTable.types.allocated,
+           reserved =   ctx->arena.reserved + ctx->atoms.strings.reserved
+                      + ctx->typeTable.types.reserved;
+    int lines = 0;
+
+    for (int i = 0; i < ctx->moduleList.length; i++) {
+        const parserResult* module = vectorGet(&ctx->moduleList, i);
+        compilerPrintArenaStats(module->filename, module->arena, module->lines);
+
+        allocated += module->arena->allocated;
+        reserved += module->arena->reserved;
+        lines += module->lines;
+    }
+
+    compilerPrintArenaStats("<global>", &ctx->arena, 0);
+    compilerPrintArenaStats("<identifiers>", &ctx->atoms.strings, 0);
+    compilerPrintArenaStats("<types>", &ctx->typeTable.types, 0);
+
+    FILE* log = debugGetLog();
+
+    fprintf(log, "fcc: %zu bytes in arenas (%zu reserved) for %d lines",
+            allocated, reserved, lines);
+
+    if (lines)
+        fprintf(log, ", %.1f bytes/line\n", (double) allocated / lines);
+
+    else
+        fputc('\n', log);
 }
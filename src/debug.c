@@ -12,18 +12,25 @@
 #include "stdarg.h"
 #include "stdio.h"
 
-FILE* logFile;
-debugMode mode;
+/*All per thread, so that parallel jobs each have their own log*/
+
+_Thread_local FILE* logFile;
+_Thread_local debugMode mode;
 //Indentation level of debug output
-int depth;
+_Thread_local int depth;
 
-int internalErrors;
+_Thread_local int internalErrors;
 
 void debugInit (FILE* nlog) {
     logFile = nlog;
+    depth = 0;
     debugSetMode(debugMinimal);
 }
 
+FILE* debugGetLog () {
+    return logFile;
+}
+
 debugMode debugSetMode (debugMode nmode) {
     debugMode old = mode;
     mode = nmode;
@@ -239,11 +246,8 @@ void reportNode (const ast* Node) {
              (void*) Node,
              astTagGetStr(Node->tag));
 
-    if (Node->nextSibling)
-        debugOut("next: %p   ", (void*) Node->nextSibling);
-
-    if (Node->firstChild)
-        debugOut("fc: %p   ", (void*) Node->firstChild);
+    if (Node->children)
+        debugOut("children: %d   ", Node->children);
 
     if (Node->l)
         debugOut("l: %p", (void*) Node->l);
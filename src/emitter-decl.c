@@ -11,12 +11,6 @@
 
 #include "../inc/eval.h"
 
-#include "assert.h"
-
-static void emitterDeclBasic (emitterCtx* ctx, ast* Node);
-static void emitterStructOrUnion (emitterCtx* ctx, sym* record, int nextOffset);
-static void emitterEnum (emitterCtx* ctx, sym* Symbol);
-
 static void emitterDeclNode (emitterCtx* ctx, irBlock** block, const ast* Node);
 static void emitterDeclAssignBOP (emitterCtx* ctx, irBlock** block, const ast* Node);
 static void emitterDeclCall (emitterCtx* ctx, irBlock** block, const ast* Node);
@@ -25,90 +19,12 @@ static void emitterDeclName (emitterCtx* ctx, const ast* Node);
 void emitterDecl (emitterCtx* ctx, irBlock** block, const ast* Node) {
     debugEnter("Decl");
 
-    emitterDeclBasic(ctx, Node->l);
-
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling)
-        emitterDeclNode(ctx, block, Current);
+    for (int i = 0; i < Node->children; i++)
+        emitterDeclNode(ctx, block, Node->child[i]);
 
     debugLeave();
 }
 
-static void emitterDeclBasic (emitterCtx* ctx, ast* Node) {
-    debugEnter(astTagGetStr(Node->tag));
-
-    if (Node->tag == astStruct || Node->tag == astUnion)
-        emitterStructOrUnion(ctx, Node->symbol, 0);
-
-    else if (Node->tag == astEnum)
-        emitterEnum(ctx, Node->symbol);
-
-    else if (Node->tag == astConst)
-        emitterDeclBasic(ctx, Node->r);
-
-    else if (Node->tag == astLiteral)
-        ;
-
-    else
-        debugErrorUnhandled("emitterDeclBasic", "AST tag", astTagGetStr(Node->tag));
-
-    debugLeave();
-}
-
-static void emitterStructOrUnion (emitterCtx* ctx, sym* record, int nextOffset) {
-    record->size = 0;
-
-    /*For every field*/
-    for (int n = 0; n < record->children.length; n++) {
-        sym* field = vectorGet(&record->children, n);
-        int fieldSize;
-
-        /*Find the size of the field*/
-
-        if (field->tag == symId) {
-            fieldSize = typeGetSize(ctx->arch, field->dt);
-
-        } else if (field->tag == symStruct || field->tag == symUnion) {
-            bool anonymous = !field->ident[0];
-            emitterStructOrUnion(ctx, field, anonymous ? nextOffset : 0);
-            fieldSize = field->size;
-
-        } else if (field->tag == symEnum) {
-            emitterEnum(ctx, field);
-            continue;
-
-        } else {
-            debugErrorUnhandled("emitterStructOrUnion", "symbol tag", symTagGetStr(field->tag));
-            continue;
-        }
-
-        /*Set the field offset and update the record size*/
-
-        field->offset = nextOffset;
-        reportSymbol(field);
-
-        if (record->tag == symStruct) {
-            /*Add the size of this field, rounded up to the nearest word boundary*/
-            int alignment = ctx->arch->wordsize;
-            fieldSize = ((fieldSize-1)/alignment+1)*alignment;
-            record->size += fieldSize;
-            nextOffset += fieldSize;
-
-        } else {
-            assert(record->tag == symUnion);
-            record->size = max(record->size, fieldSize);
-        }
-    }
-
-    reportSymbol(record);
-}
-
-static void emitterEnum (emitterCtx* ctx, sym* Symbol) {
-    Symbol->size = ctx->arch->wordsize;
-    reportSymbol(Symbol);
-}
-
 static void emitterDeclNode (emitterCtx* ctx, irBlock** block, const ast* Node) {
     debugEnter(astTagGetStr(Node->tag));
 
@@ -179,14 +95,12 @@ static void emitterDeclAssignBOP (emitterCtx* ctx, irBlock** block, const ast* N
 }
 
 static void emitterDeclCall (emitterCtx* ctx, irBlock** block, const ast* Node) {
-    for (ast* param = Node->firstChild;
-         param;
-         param = param->nextSibling) {
-        if (param->tag == astParam) {
-            emitterDeclBasic(ctx, param->l);
+    for (int i = 0; i < Node->children; i++) {
+        ast* param = Node->child[i];
+        if (param->tag == astParam)
             emitterDeclNode(ctx, block, param->r);
 
-        } else if (param->tag == astEllipsis)
+        else if (param->tag == astEllipsis)
             ;
 
         else
@@ -10,7 +10,7 @@
 
 #include "stdlib.h"
 
-static int emitterScopeAssignOffsets (const architecture* arch, sym* Scope, int offset);
+static int emitterScopeAssignOffsets (const architecture* arch, const sym* Scope, int offset, intmap* offsets);
 
 irFn* emitterSetFn (emitterCtx* ctx, irFn* fn) {
     irFn* old = ctx->curFn;
@@ -36,17 +36,24 @@ irBlock* emitterSetContinueTo (emitterCtx* ctx, irBlock* block) {
     return old;
 }
 
-static int emitterScopeAssignOffsets (const architecture* arch, sym* Scope, int offset) {
+/*Assign offsets to the symbols themselves, or if given a map, there instead*/
+static int emitterScopeAssignOffsets (const architecture* arch, const sym* Scope, int offset, intmap* offsets) {
     for (int n = 0; n < Scope->children.length; n++) {
         sym* Symbol = vectorGet(&Scope->children, n);
 
         if (Symbol->tag == symScope)
-            offset = emitterScopeAssignOffsets(arch, Symbol, offset);
+            offset = emitterScopeAssignOffsets(arch, Symbol, offset, offsets);
 
         else if (Symbol->tag == symId) {
             offset -= typeGetSize(arch, Symbol->dt);
-            Symbol->offset = offset;
-            reportSymbol(Symbol);
+
+            if (offsets)
+                intmapAdd(offsets, (intptr_t) Symbol, (void*)(intptr_t) offset);
+
+            else {
+                Symbol->offset = offset;
+                reportSymbol(Symbol);
+            }
 
         } else {}
     }
@@ -78,7 +85,24 @@ int emitterFnAllocateStack (const architecture* arch, sym* fn) {
 
     /*Allocate stack space for all the auto variables
       Stack grows down, so the amount is the negation of the last offset*/
-    return -emitterScopeAssignOffsets(arch, fn, 0);
+    return -emitterScopeAssignOffsets(arch, fn, 0, 0);
+}
+
+int emitterFnInlineStack (const architecture* arch, const sym* fn, int stacksize, intmap* offsets) {
+    /*Word align the params, which go first*/
+    int offset = -((stacksize + arch->wordsize-1) / arch->wordsize * arch->wordsize);
+
+    for (int n = 0; n < fn->children.length; n++) {
+        const sym* param = vectorGet(&fn->children, n);
+
+        if (param->tag != symParam)
+            break;
+
+        offset -= typeGetSize(arch, param->dt);
+        intmapAdd(offsets, (intptr_t) param, (void*)(intptr_t) offset);
+    }
+
+    return -emitterScopeAssignOffsets(arch, fn, offset, offsets);
 }
 
 operand emitterGetInReg (emitterCtx* ctx,  irBlock* block, operand src, int size) {
@@ -95,13 +119,16 @@ operand emitterTakeReg (emitterCtx* ctx, irBlock* block, regIndex r, int* oldSiz
     if (regIsUsed(r))
         asmSaveReg(ctx->ir, block, r);
 
-    *oldSize = regs[r].allocatedAs;
-    regs[r].allocatedAs = newSize;
+    irBlockTakeReg(block, r);
+
+    *oldSize = regGetSize(&regs[r]);
+    regSetSize(&regs[r], newSize);
     return operandCreateReg(&regs[r]);
 }
 
 void emitterGiveBackReg (emitterCtx* ctx, irBlock* block, regIndex r, int oldSize) {
-    regs[r].allocatedAs = oldSize;
+    regSetSize(&regs[r], oldSize);
+    irBlockGiveBackReg(block, r);
 
     if (oldSize)
         asmRestoreReg(ctx->ir, block, r);
@@ -119,26 +146,21 @@ void emitterBranchOnValue (emitterCtx* ctx, irBlock* block, const ast* value,
 }
 
 operand emitterWiden (emitterCtx* ctx, irBlock* block, operand R, int size) {
-    (void) ctx;
-
     if (R.tag == operandLiteral)
         return R;
 
-    char* RStr = operandToStr(R);
-
     operand L;
 
+    /*Widen a register in place, the instruction reading it at its old size*/
     if (R.tag == operandReg) {
-        R.base->allocatedAs = size;
-        L = R;
+        R.size = operandGetSize(ctx->arch, R);
+        L = operandCreateReg(R.base);
+        regSetSize(L.base, size);
 
     } else
         L = operandCreateReg(regAlloc(size));
 
-    char* LStr = operandToStr(L);
-    irBlockOut(block, "movsx %s, %s", LStr, RStr);
-    free(LStr);
-    free(RStr);
+    asmSignExtend(ctx->ir, block, L, R);
 
     if (R.tag != operandReg)
         operandFree(R);
@@ -151,7 +173,7 @@ operand emitterNarrow (emitterCtx* ctx, irBlock* block, operand R, int size) {
         return R;
 
     operand L = emitterGetInReg(ctx, block, R, operandGetSize(ctx->arch, R));
-    L.base->allocatedAs = size;
+    regSetSize(L.base, size);
     return L;
 }
 
@@ -0,0 +1,284 @@
+#include "../inc/emitter-internal.h"
+
+#include "../inc/debug.h"
+#include "../inc/type.h"
+#include "../inc/ast.h"
+#include "../inc/sym.h"
+#include "../inc/architecture.h"
+#include "../inc/ir.h"
+#include "../inc/reg.h"
+#include "../inc/asm.h"
+#include "../inc/asm-amd64.h"
+
+#include "stdlib.h"
+
+/*Calls to small static functions and lambdas are replaced by their bodies,
+  saving the whole calling sequence: saving scratch registers, pushing the
+  args, the call and the frame, and popping it all again.
+
+  The body is generated straight from the callee's AST, as if it were part
+  of the caller. Its params and locals are given fresh slots at the bottom
+  of the caller's frame (the callee's own symbols are left alone, as it may
+  be being generated on another thread), and returns go to a register then
+  jump past the body.
+
+  A lambda literal passed as an arg to a param that the callee only ever
+  calls is itself inlined at those calls.*/
+
+enum {
+    ///Largest body inlined, in AST nodes
+    emitterInlineMaxSize = 24,
+    ///Inlined bodies inside inlined bodies, at most
+    emitterInlineMaxDepth = 3
+};
+
+static bool emitterInlineIsLambda (const ast* Node) {
+    return Node->tag == astLiteral && Node->litTag == literalLambda;
+}
+
+/*Add up the nodes of an AST, giving up past the limit or if any can't be
+  generated more than once, in which case the result is -1*/
+static int emitterInlineSize (const ast* Node, int size, int limit) {
+    if (!Node || size < 0)
+        return size;
+
+    if (   ++size > limit
+        /*These emit a function, or an object, each time*/
+        || (Node->tag == astLiteral && (   Node->litTag == literalLambda
+                                        || Node->litTag == literalCompound))
+        /*Stack layout specific*/
+        || Node->tag == astVAStart || Node->tag == astVAEnd
+        || Node->tag == astVAArg || Node->tag == astVACopy)
+        return -1;
+
+    for (int i = 0; i < Node->children; i++)
+        size = emitterInlineSize(Node->child[i], size, limit);
+
+    size = emitterInlineSize(Node->l, size, limit);
+    return emitterInlineSize(Node->r, size, limit);
+}
+
+/*Are all the variables declared auto? Statics would be defined again*/
+static bool emitterInlineScopeIsAuto (const sym* Scope) {
+    for (int i = 0; i < Scope->children.length; i++) {
+        const sym* Symbol = vectorGet(&Scope->children, i);
+
+        if (Symbol->tag == symScope) {
+            if (!emitterInlineScopeIsAuto(Symbol))
+                return false;
+
+        } else if (Symbol->tag == symId && Symbol->storage != storageAuto)
+            return false;
+    }
+
+    return true;
+}
+
+static bool emitterInlineIsPossible (const emitterCtx* ctx, const ast* Node, const ast* impl);
+
+/*Can a lambda be bound to a param, inlining it wherever the param is
+  called? The param must never be used otherwise, as it won't have a value*/
+static bool emitterInlineCanBind (const emitterCtx* ctx, const ast* Node,
+                                  const sym* param, const ast* lambda) {
+    if (!Node)
+        return true;
+
+    if (Node->tag == astLiteral && Node->litTag == literalIdent)
+        return Node->symbol != param;
+
+    if (Node->tag == astCall && Node->l->tag == astLiteral && Node->l->symbol == param) {
+        if (!emitterInlineIsPossible(ctx, Node, lambda))
+            return false;
+
+    } else if (!emitterInlineCanBind(ctx, Node->l, param, lambda))
+        return false;
+
+    for (int i = 0; i < Node->children; i++)
+        if (!emitterInlineCanBind(ctx, Node->child[i], param, lambda))
+            return false;
+
+    return emitterInlineCanBind(ctx, Node->r, param, lambda);
+}
+
+/*Can a call be replaced by this function's body?*/
+static bool emitterInlineIsPossible (const emitterCtx* ctx, const ast* Node, const ast* impl) {
+    const sym* fn = impl->symbol;
+    const type* dt = typeGetCallable(fn->dt);
+    int wordsize = ctx->arch->wordsize;
+
+    if (!dt || dt->variadic || dt->params != Node->children)
+        return false;
+
+    /*Return in a register*/
+    if (   !typeIsVoid(Node->dt)
+        && (   typeIsStruct(Node->dt) || typeIsUnion(Node->dt)
+            || typeGetSize(ctx->arch, Node->dt) > wordsize))
+        return false;
+
+    /*Args that would each be pushed as a word*/
+    for (int i = 0; i < Node->children; i++) {
+        const sym* param = symGetNthParam(fn, i);
+        const ast* arg = Node->child[i];
+
+        if (!param || typeGetSize(ctx->arch, param->dt) != wordsize)
+            return false;
+
+        else if (emitterInlineIsLambda(arg)) {
+            if (!emitterInlineCanBind(ctx, impl->r, param, arg))
+                return false;
+
+        } else if (!typeIsArray(arg->dt) && typeGetSize(ctx->arch, arg->dt) != wordsize)
+            return false;
+    }
+
+    /*Falling off the end would leave the result unset*/
+    const ast* body = impl->r;
+
+    if (   body->tag == astCode && !typeIsVoid(Node->dt)
+        && (!body->children || body->child[body->children-1]->tag != astReturn))
+        return false;
+
+    return    emitterInlineScopeIsAuto(fn)
+           && emitterInlineSize(body, 0, emitterInlineMaxSize) >= 0;
+}
+
+const ast* emitterInlineTarget (const emitterCtx* ctx, const ast* Node) {
+    const ast* impl = 0;
+    const sym* fn = Node->l->symbol;
+
+    if (emitterInlineIsLambda(Node->l))
+        impl = Node->l;
+
+    else if (fn && ctx->inlined) {
+        /*A lambda bound to a param is always inlined, as the param was never
+          given its value*/
+        impl = intmapMap(&ctx->inlined->lambdas, (intptr_t) fn);
+
+        if (impl)
+            return impl;
+    }
+
+    if (   !impl && fn && symIsFunction(fn) && fn->storage == storageStatic
+        && fn->impl && fn->impl->tag == astFnImpl && fn->impl->r)
+        impl = fn->impl;
+
+    if (!impl)
+        return 0;
+
+    /*Recursion guard: never inside itself*/
+
+    if (impl->symbol == ctx->curFnSymbol)
+        return 0;
+
+    for (const emitterInlined* frame = ctx->inlined; frame; frame = frame->parent)
+        if (frame->fn == impl->symbol)
+            return 0;
+
+    if (ctx->inlined && ctx->inlined->depth >= emitterInlineMaxDepth)
+        return 0;
+
+    return emitterInlineIsPossible(ctx, Node, impl) ? impl : 0;
+}
+
+operand emitterInline (emitterCtx* ctx, irBlock** block, const ast* Node, const ast* impl) {
+    debugEnter("Inline");
+
+    emitterInlined frame = {
+        .fn = impl->symbol,
+        .depth = ctx->inlined ? ctx->inlined->depth+1 : 1,
+        .parent = ctx->inlined
+    };
+
+    intmapInit(&frame.offsets, 16);
+    intmapInit(&frame.lambdas, 4);
+
+    ctx->curFn->stacksize = emitterFnInlineStack(ctx->arch, frame.fn, ctx->curFn->stacksize,
+                                                 &frame.offsets);
+
+    /*Args into the param slots, backwards like a call, but evaluated in the
+      caller's frame*/
+    for (int i = Node->children; i > 0; i--) {
+        const sym* param = symGetNthParam(frame.fn, i-1);
+        const ast* arg = Node->child[i-1];
+
+        if (emitterInlineIsLambda(arg))
+            intmapAdd(&frame.lambdas, (intptr_t) param, (void*) arg);
+
+        else {
+            operand slot = operandCreateMem(&regs[regRBP],
+                                            (int)(intptr_t) intmapMap(&frame.offsets, (intptr_t) param),
+                                            ctx->arch->wordsize);
+            emitterValueSuggest(ctx, block, arg, &slot);
+        }
+    }
+
+    frame.result =   typeIsVoid(Node->dt)
+                   ? operandCreateVoid()
+                   : operandCreateReg(regAlloc(typeGetSize(ctx->arch, Node->dt)));
+
+    /*Body*/
+
+    irBlock* continuation = irBlockCreate(ctx->ir, ctx->curFn);
+
+    irBlock *oldReturnTo = emitterSetReturnTo(ctx, continuation),
+            *oldBreakTo = emitterSetBreakTo(ctx, 0),
+            *oldContinueTo = emitterSetContinueTo(ctx, 0);
+    emitterInlined* oldInlined = ctx->inlined;
+    ctx->inlined = &frame;
+
+    if (impl->r->tag == astCode)
+        emitterCode(ctx, *block, impl->r, continuation);
+
+    /*Lambda of just an expression*/
+    else {
+        emitterInlineReturn(ctx, block, impl->r);
+        irJump(*block, continuation);
+    }
+
+    ctx->inlined = oldInlined;
+    ctx->returnTo = oldReturnTo;
+    ctx->breakTo = oldBreakTo;
+    ctx->continueTo = oldContinueTo;
+
+    *block = continuation;
+
+    intmapFree(&frame.offsets);
+    intmapFree(&frame.lambdas);
+
+    debugLeave();
+
+    return frame.result;
+}
+
+void emitterInlineReturn (emitterCtx* ctx, irBlock** block, const ast* Node) {
+    operand result = ctx->inlined->result;
+
+    if (result.tag == operandVoid) {
+        emitterValue(ctx, block, Node, requestVoid);
+        return;
+    }
+
+    operand R = emitterValue(ctx, block, Node, requestValue);
+
+    /*Converted to the return type, as the caller would see it in RAX*/
+
+    int from = operandGetSize(ctx->arch, R),
+        to = operandGetSize(ctx->arch, result);
+
+    if (from != to)
+        R = (from < to ? emitterWiden : emitterNarrow)(ctx, *block, R, to);
+
+    asmMove(ctx->ir, *block, result, R);
+    operandFree(R);
+}
+
+int emitterSymbolOffset (const emitterCtx* ctx, const sym* Symbol) {
+    if (ctx->inlined) {
+        intptr_t offset = (intptr_t) intmapMap(&ctx->inlined->offsets, (intptr_t) Symbol);
+
+        if (offset)
+            return (int) offset;
+    }
+
+    return Symbol->offset;
+}
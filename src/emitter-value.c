@@ -228,6 +228,9 @@ static operand emitterValueImpl (emitterCtx* ctx, irBlock** block, const ast* No
             asmMove(ctx->ir, *block, operandCreateReg(rax), Value);
             regFree(rax);
 
+            /*Keep it there until the return*/
+            irBlockTakeReg(*block, regRAX);
+
         } else if (Value.base != regGet(regRAX))
             debugError("emitterValueImpl", "unable to allocate RAX for return");
 
@@ -375,25 +378,15 @@ static operand emitterDivisionBOP (emitterCtx* ctx, irBlock** block, const ast*
     asmDivision(ctx->ir, *block, R);
     operandFree(R);
 
-    /*If the result reg was used before, move it to a new reg*/
-    if ((isModulo ? rdxOldSize : raxOldSize) != 0) {
-        Value = operandCreateReg(regAlloc(typeGetSize(ctx->arch, Node->dt)));
-        asmMove(ctx->ir, *block, Value, isModulo ? RDX : RAX);
-
-        /*Restore regs*/
-        emitterGiveBackReg(ctx, *block, regRDX, rdxOldSize);
-        emitterGiveBackReg(ctx, *block, regRAX, raxOldSize);
-
-    } else {
-        if (isModulo) {
-            Value = RDX;
-            emitterGiveBackReg(ctx, *block, regRAX, raxOldSize);
+    /*Move the result out to a new reg. It will end up in RAX or RDX all the
+      same unless they're needed for something else while it's live.*/
+    operand Result = isModulo ? RDX : RAX;
+    Value = operandCreateReg(regAlloc(operandGetSize(ctx->arch, Result)));
+    asmMove(ctx->ir, *block, Value, Result);
 
-        } else {
-            Value = RAX;
-            emitterGiveBackReg(ctx, *block, regRDX, rdxOldSize);
-        }
-    }
+    /*Restore regs*/
+    emitterGiveBackReg(ctx, *block, regRDX, rdxOldSize);
+    emitterGiveBackReg(ctx, *block, regRAX, raxOldSize);
 
     /*If an assignment, also move the result into memory*/
     if (isAssign) {
@@ -425,7 +418,7 @@ static operand emitterShiftBOP (emitterCtx* ctx, irBlock** block, const ast* Nod
         emitterValueSuggest(ctx, block, Node->r, &R);
 
         /*Only CL*/
-        R.base->allocatedAs = 1;
+        regSetSize(R.base, 1);
     }
 
     /*Assignment op? Then get the LHS as an lvalue, otherwise in a register*/
@@ -582,7 +575,7 @@ static operand emitterTOP (emitterCtx* ctx, irBlock** block, const ast* Node, co
             *continuation = irBlockCreate(ctx->ir, ctx->curFn);
 
     /*Condition, branch*/
-    emitterBranchOnValue(ctx, *block, Node->firstChild, ifTrue, ifFalse);
+    emitterBranchOnValue(ctx, *block, Node->child[0], ifTrue, ifFalse);
 
     /*Ask for LHS to go in a reg, or the suggestion. This becomes our return*/
     operand Value = emitterValueImpl(ctx, &ifTrue, Node->l, requestReg, suggestion);
@@ -679,6 +672,12 @@ static operand emitterIndex (emitterCtx* ctx, irBlock** block, const ast* Node)
 }
 
 static operand emitterCall (emitterCtx* ctx, irBlock** block, const ast* Node) {
+    /*Small enough to generate in place?*/
+    const ast* impl = emitterInlineTarget(ctx, Node);
+
+    if (impl)
+        return emitterInline(ctx, block, Node, impl);
+
     operand Value;
 
     /*Caller save registers: only if in use*/
@@ -693,20 +692,19 @@ static operand emitterCall (emitterCtx* ctx, irBlock** block, const ast* Node) {
 
     /*If larger than a word, the return will be passed in a temporary position
       (stack) allocated by the caller.*/
-    bool retInTemp = typeGetSize(ctx->arch, Node->dt) > ctx->arch->wordsize;
+    int retSize = typeGetSize(ctx->arch, Node->dt);
+    bool retInTemp = retSize > ctx->arch->wordsize;
     int tempWords = 0;
 
     if (retInTemp) {
         /*Allocate the temporary space (rounded up to the nearest word)*/
-        tempWords = (typeGetSize(ctx->arch, Node->dt)-1)/ctx->arch->wordsize + 1;
+        tempWords = (retSize-1)/ctx->arch->wordsize + 1;
         asmPushN(ctx->ir, *block, tempWords);
     }
 
     /*Push the args on backwards (cdecl)*/
-    for (ast* Current = Node->lastChild;
-         Current;
-         Current = Current->prevSibling) {
-        operand Arg = emitterValue(ctx, block, Current, requestStack);
+    for (int i = Node->children; i > 0; i--) {
+        operand Arg = emitterValue(ctx, block, Node->child[i-1], requestStack);
         argSize += Arg.size;
     }
 
@@ -736,23 +734,19 @@ static operand emitterCall (emitterCtx* ctx, irBlock** block, const ast* Node) {
     *block = continuation;
 
     if (!typeIsVoid(Node->dt)) {
-        int size = retInTemp ? ctx->arch->wordsize : typeGetSize(ctx->arch, Node->dt);
+        int size = retInTemp ? ctx->arch->wordsize : retSize;
 
-        /*If RAX is already in use (currently backed up to the stack), relocate the
-          return value to another free reg before RAX's value is restored.*/
-        if (regIsUsed(regRAX)) {
-            Value = operandCreateReg(regAlloc(size));
-            int tmp = regs[regRAX].allocatedAs;
-            regs[regRAX].allocatedAs = size;
-            asmMove(ctx->ir, *block, Value, operandCreateReg(&regs[regRAX]));
-            regs[regRAX].allocatedAs = tmp;
+        /*Move the return value out of RAX, as RAX may be taken (and backed up
+          to the stack). If not, the register allocator can leave it there.*/
+        operand RAX = operandCreateReg(&regs[regRAX]);
+        RAX.size = size;
 
-        } else
-            Value = operandCreateReg(regRequest(regRAX, size));
+        Value = operandCreateReg(regAlloc(size));
+        asmMove(ctx->ir, *block, Value, RAX);
 
         /*The temporary's pointer is returned to us*/
         if (retInTemp)
-            Value = operandCreateMem(Value.base, 0, typeGetSize(ctx->arch, Node->dt));
+            Value = operandCreateMem(Value.base, 0, retSize);
 
     } else
         Value = operandCreateVoid();
@@ -764,13 +758,117 @@ static operand emitterCall (emitterCtx* ctx, irBlock** block, const ast* Node) {
     for (int i = ctx->arch->scratchRegs.length-1; i >= 0; i--) {
         regIndex r = (regIndex) vectorGet(&ctx->arch->scratchRegs, i);
 
-        if (regIsUsed(r) && regGet(r) != Value.base)
+        if (regIsUsed(r))
             asmRestoreReg(ctx->ir, *block, r);
     }
 
     return Value;
 }
 
+/*Could anything in the AST refer into the frame by address? Then the
+  frame has to outlive any call*/
+static bool emitterTakesFrameAddress (const ast* Node) {
+    if (!Node)
+        return false;
+
+    if (   (Node->tag == astUOP && Node->o == opAddressOf)
+        || (Node->tag == astLiteral && Node->litTag == literalCompound)
+        /*Arrays decay to their address*/
+        || (Node->dt && typeIsArray(Node->dt)))
+        return true;
+
+    for (int i = 0; i < Node->children; i++)
+        if (emitterTakesFrameAddress(Node->child[i]))
+            return true;
+
+    return emitterTakesFrameAddress(Node->l) || emitterTakesFrameAddress(Node->r);
+}
+
+/*The bytes of args that a fn is passed, if all are words, otherwise -1*/
+static int emitterFnArgSize (const emitterCtx* ctx, const sym* fn) {
+    const type* dt = typeGetCallable(fn->dt);
+
+    if (!dt || dt->variadic)
+        return -1;
+
+    for (int i = 0; i < dt->params; i++)
+        if (typeGetSize(ctx->arch, dt->paramTypes[i]) != ctx->arch->wordsize)
+            return -1;
+
+    return dt->params*ctx->arch->wordsize;
+}
+
+bool emitterTailCall (emitterCtx* ctx, irBlock* block, const ast* Node) {
+    if (Node->tag != astCall)
+        return false;
+
+    const sym* self = ctx->curFnSymbol;
+    sym* to = Node->l->symbol;
+
+    /*A direct call, returned with no conversion, from a fn (not an inlined
+      body)*/
+    if (   !to || !symIsFunction(to)
+        || ctx->inlined || !self || !self->impl || self->impl->tag != astFnImpl)
+        return false;
+
+    const type *ret = typeGetReturn(typeGetCallable(self->dt)),
+               *toRet = Node->dt;
+    int wordsize = ctx->arch->wordsize;
+
+    if (   typeIsVoid(ret) != typeIsVoid(toRet)
+        || (   !typeIsVoid(ret)
+            && (   typeIsStruct(ret) || typeIsUnion(ret) || typeIsStruct(toRet) || typeIsUnion(toRet)
+                || typeGetSize(ctx->arch, ret) != typeGetSize(ctx->arch, toRet)
+                || typeGetSize(ctx->arch, ret) > wordsize)))
+        return false;
+
+    /*The args go where this fn's own were, so they must fit*/
+
+    int argSize = emitterFnArgSize(ctx, to),
+        ownArgSize = emitterFnArgSize(ctx, self);
+
+    if (   argSize < 0 || ownArgSize < 0 || argSize > ownArgSize
+        || argSize != Node->children*wordsize)
+        return false;
+
+    /*Better inlined, and the frame might be needed by the callee*/
+    if (emitterInlineTarget(ctx, Node) || emitterTakesFrameAddress(self->impl->r))
+        return false;
+
+    debugEnter("TailCall");
+
+    /*Work out all the args before any are overwritten, as they may read the
+      params they replace*/
+
+    operand* args = malloc(sizeof(operand) * (Node->children ? Node->children : 1));
+
+    for (int i = Node->children; i > 0; i--) {
+        operand* arg = &args[i-1];
+        *arg = emitterValue(ctx, &block, Node->child[i-1], requestValue);
+
+        if (arg->tag != operandReg && arg->tag != operandLiteral)
+            *arg = emitterGetInReg(ctx, block, *arg, wordsize);
+    }
+
+    for (int i = 0; i < Node->children; i++) {
+        asmMove(ctx->ir, block, operandCreateMem(&regs[regRBP], (2+i)*wordsize, wordsize), args[i]);
+        operandFree(args[i]);
+    }
+
+    free(args);
+
+    /*Recursion is just a loop*/
+    if (to == self)
+        irJump(block, ctx->curFn->entryPoint);
+
+    else
+        irTailCall(block, to);
+
+    debugLeave();
+
+    return true;
+}
+
 static operand emitterCast (emitterCtx* ctx, irBlock** block, const ast* Node) {
     operand R = emitterValue(ctx, block, Node->r, requestValue);
 
@@ -805,7 +903,7 @@ operand emitterSymbol (emitterCtx* ctx, const sym* Symbol) {
 
         if (   Symbol->tag == symParam
             || Symbol->storage == storageAuto)
-            Value = operandCreateMem(&regs[regRBP], Symbol->offset, size);
+            Value = operandCreateMem(&regs[regRBP], emitterSymbolOffset(ctx, Symbol), size);
 
         else if (   Symbol->storage == storageStatic
                  || Symbol->storage == storageExtern) {
@@ -874,7 +972,7 @@ void emitterCompoundInit (emitterCtx* ctx, irBlock** block, const ast* Node, ope
 
     /*Scalar*/
     else
-        emitterValueSuggest(ctx, block, Node->firstChild, &base);
+        emitterValueSuggest(ctx, block, astFirstChild(Node), &base);
 }
 
 static void emitterStructInit (emitterCtx* ctx, irBlock** block, const ast* Node, operand base) {
@@ -887,9 +985,8 @@ static void emitterStructInit (emitterCtx* ctx, irBlock** block, const ast* Node
     int index = 0;
 
     /*For every field*/
-    for (ast* current = Node->firstChild;
-         current;
-         current = current->nextSibling, index++) {
+    for (int i = 0; i < Node->children; i++, index++) {
+        ast* current = Node->child[i];
         ast* value = current;
         sym* field = vectorGet(&record->children, index);
 
@@ -949,9 +1046,8 @@ static void emitterArrayInit (emitterCtx* ctx, irBlock** block, const ast* Node,
     int index = 0;
 
     /*For every element*/
-    for (ast* current = Node->firstChild;
-         current;
-         current = current->nextSibling, index++) {
+    for (int i = 0; i < Node->children; i++, index++) {
+        ast* current = Node->child[i];
         ast* value = current;
 
         /*Explicit index?*/
@@ -1008,9 +1104,10 @@ static operand emitterLambda (emitterCtx* ctx, irBlock** block, const ast* Node)
     irFn* fn = irFnCreate(ctx->ir, 0, stacksize);
     irFn* oldFn = emitterSetFn(ctx, fn);
     irBlock* oldReturnTo = emitterSetReturnTo(ctx, fn->epilogue);
-
-    free(Node->symbol->ident);
-    Node->symbol->ident = strdup(fn->name);
+    const sym* oldFnSymbol = ctx->curFnSymbol;
+    emitterInlined* oldInlined = ctx->inlined;
+    ctx->curFnSymbol = Node->symbol;
+    ctx->inlined = 0;
 
     /*Body*/
 
@@ -1027,6 +1124,8 @@ static operand emitterLambda (emitterCtx* ctx, irBlock** block, const ast* Node)
     /*Pop IR context*/
     ctx->curFn = oldFn;
     ctx->returnTo = oldReturnTo;
+    ctx->curFnSymbol = oldFnSymbol;
+    ctx->inlined = oldInlined;
 
     return operandCreateLabel(fn->name);
 }
@@ -9,15 +9,52 @@
 #include "../inc/sym.h"
 #include "../inc/architecture.h"
 #include "../inc/ir.h"
+#include "../inc/ir-peephole.h"
 #include "../inc/operand.h"
 #include "../inc/asm.h"
 #include "../inc/asm-amd64.h"
 #include "../inc/reg.h"
+#include "../inc/arena.h"
 
 #include "string.h"
 #include "stdlib.h"
-
-static void emitterModule (emitterCtx* ctx, const ast* Node);
+#include "stdio.h"
+#include "threads.h"
+#include "stdatomic.h"
+
+/**
+ * Part of the module, generated in its own IR context, @see irUnitInit.
+ * Each function is a unit, and so is each run of declarations between
+ * them.
+ */
+typedef struct emitterUnit {
+    irCtx ir;
+    ///The function, or null if this is just decls, which are generated as
+    ///soon as the module is walked
+    const ast* fnImpl;
+
+    ///The part of a thread's log that this unit wrote, if generated on
+    ///another thread
+    FILE* log;
+    long logStart, logEnd;
+    int internalErrors;
+} emitterUnit;
+
+typedef struct emitterQueue {
+    const emitterCtx* ctx;
+    const vector/*<emitterUnit*>*/* units;
+    atomic_int next;
+} emitterQueue;
+
+typedef struct emitterThread {
+    emitterQueue* queue;
+    ///Anything allocated while generating, adopted by the module's arena
+    arena arena;
+    FILE* log;
+} emitterThread;
+
+static void emitterModule (emitterCtx* ctx, vector/*<emitterUnit*>*/* units, const ast* Node);
+static void emitterUnits (emitterCtx* ctx, const vector/*<emitterUnit*>*/* units, int threads);
 static void emitterFnImpl (emitterCtx* ctx, const ast* Node);
 
 static irBlock* emitterLine (emitterCtx* ctx, irBlock* block, const ast* Node);
@@ -33,9 +70,12 @@ static emitterCtx* emitterInit (const char* output, const architecture* arch) {
     ctx->ir = malloc(sizeof(irCtx));
     irInit(ctx->ir, output, arch);
     ctx->arch = arch;
+    ctx->curFn = 0;
+    ctx->curFnSymbol = 0;
     ctx->returnTo = 0;
     ctx->breakTo = 0;
     ctx->continueTo = 0;
+    ctx->inlined = 0;
     return ctx;
 }
 
@@ -46,34 +86,218 @@ static void emitterEnd (emitterCtx* ctx) {
     free(ctx);
 }
 
-void emitter (const ast* Tree, const char* output, const architecture* arch) {
+void emitter (const ast* Tree, const char* output, const architecture* arch, int threads,
+              irPeepholeStats* peephole) {
     emitterCtx* ctx = emitterInit(output, arch);
 
-    emitterModule(ctx, Tree);
+    vector/*<emitterUnit*>*/ units;
+    vectorInit(&units, 64);
+
+    emitterModule(ctx, &units, Tree);
+    emitterUnits(ctx, &units, threads);
+
+    /*Back into one module, in source order*/
+    for (int i = 0; i < units.length; i++) {
+        emitterUnit* unit = vectorGet(&units, i);
+        irUnitMerge(ctx->ir, &unit->ir);
+    }
+
+    vectorFreeObjs(&units, free);
 
-    irBlockLevelAnalysis(ctx->ir);
+    irPeephole(ctx->ir, peephole);
     irEmit(ctx->ir);
 
     emitterEnd(ctx);
 }
 
-static void emitterModule (emitterCtx* ctx, const ast* Node) {
+/*==== Units ====*/
+
+static emitterUnit* emitterUnitCreate (emitterCtx* ctx, vector/*<emitterUnit*>*/* units, const ast* fnImpl) {
+    emitterUnit* unit = malloc(sizeof(emitterUnit));
+    /*Unit zero is the module itself*/
+    irUnitInit(&unit->ir, ctx->ir, units->length+1);
+    unit->fnImpl = fnImpl;
+    unit->log = 0;
+    unit->logStart = 0;
+    unit->logEnd = 0;
+    unit->internalErrors = 0;
+    vectorPush(units, unit);
+    return unit;
+}
+
+static emitterCtx emitterUnitCtx (const emitterCtx* ctx, emitterUnit* unit) {
+    return (emitterCtx) {&unit->ir, ctx->arch, 0, 0, 0, 0, 0, 0};
+}
+
+static void emitterUnitGenerate (const emitterCtx* ctx, emitterUnit* unit) {
+    if (unit->fnImpl) {
+        emitterCtx unitCtx = emitterUnitCtx(ctx, unit);
+        emitterFnImpl(&unitCtx, unit->fnImpl);
+    }
+
+    irConstantPropagation(&unit->ir);
+    irBlockLevelAnalysis(&unit->ir);
+    irLoopInvariantCodeMotion(&unit->ir);
+    irValueNumbering(&unit->ir);
+    irAllocRegs(&unit->ir);
+}
+
+static int emitterWorker (void* arg) {
+    emitterThread* thread = arg;
+    emitterQueue* q = thread->queue;
+
+    /*The stack and base pointers are always taken, as asmInit did for the
+      register file of the original thread*/
+    regRequest(regRSP, q->ctx->arch->wordsize);
+    regRequest(regRBP, q->ctx->arch->wordsize);
+
+    arenaSetCurrent(&thread->arena);
+    debugInit(thread->log);
+
+    for (int i; (i = atomic_fetch_add(&q->next, 1)) < q->units->length;) {
+        emitterUnit* unit = vectorGet(q->units, i);
+
+        internalErrors = 0;
+        unit->logStart = ftell(thread->log);
+
+        emitterUnitGenerate(q->ctx, unit);
+
+        unit->log = thread->log;
+        unit->logEnd = ftell(thread->log);
+        unit->internalErrors = internalErrors;
+    }
+
+    return 0;
+}
+
+static void emitterUnitReplayLog (const emitterUnit* unit, FILE* log) {
+    if (!unit->log || unit->logEnd <= unit->logStart)
+        return;
+
+    fseek(unit->log, unit->logStart, SEEK_SET);
+    char buffer[4096];
+
+    for (long left = unit->logEnd - unit->logStart; left > 0;) {
+        size_t length = fread(buffer, 1, min(left, (long) sizeof(buffer)), unit->log);
+
+        if (length == 0)
+            break;
+
+        fwrite(buffer, 1, length, log);
+        left -= length;
+    }
+}
+
+/*Generate the functions, concurrently if allowed more than one thread. The
+  output doesn't depend on which thread got which function: each unit
+  numbers its own labels, and its log is replayed in order afterwards.*/
+static void emitterUnits (emitterCtx* ctx, const vector/*<emitterUnit*>*/* units, int threads) {
+    int fnNo = 0;
+
+    for (int i = 0; i < units->length; i++)
+        fnNo += ((emitterUnit*) vectorGet(units, i))->fnImpl != 0;
+
+    threads = min(threads, fnNo);
+
+    if (threads <= 1) {
+        for (int i = 0; i < units->length; i++)
+            emitterUnitGenerate(ctx, vectorGet(units, i));
+
+        return;
+    }
+
+    emitterQueue q = {.ctx = ctx, .units = units};
+    atomic_init(&q.next, 0);
+
+    emitterThread* pool = malloc(threads*sizeof(emitterThread));
+    thrd_t* handles = malloc(threads*sizeof(thrd_t));
+
+    FILE* log = debugGetLog();
+
+    /*Stop at the first thread that can't be made, those already running
+      will claim every unit between them*/
+    int started = 0;
+
+    for (; started < threads; started++) {
+        emitterThread* thread = &pool[started];
+        thread->queue = &q;
+        arenaInit(&thread->arena, 16*1024);
+
+        /*Without a temporary file, the thread writes straight to the log*/
+        FILE* threadLog = tmpfile();
+        thread->log = threadLog ? threadLog : log;
+
+        if (thrd_create(&handles[started], emitterWorker, thread) != thrd_success) {
+            arenaFree(&thread->arena);
+
+            if (thread->log != log)
+                fclose(thread->log);
+
+            break;
+        }
+    }
+
+    threads = started;
+
+    for (int i = 0; i < threads; i++)
+        thrd_join(handles[i], 0);
+
+    /*Not even one, so generate them all on this thread*/
+    if (threads == 0)
+        for (int i = 0; i < units->length; i++)
+            emitterUnitGenerate(ctx, vectorGet(units, i));
+
+    for (int i = 0; i < units->length; i++) {
+        emitterUnit* unit = vectorGet(units, i);
+
+        if (unit->log != log)
+            emitterUnitReplayLog(unit, log);
+
+        internalErrors += unit->internalErrors;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        arenaAdopt(arenaGetCurrent(), &pool[i].arena);
+
+        if (pool[i].log != log)
+            fclose(pool[i].log);
+    }
+
+    free(handles);
+    free(pool);
+}
+
+/*==== Module ====*/
+
+static void emitterModule (emitterCtx* ctx, vector/*<emitterUnit*>*/* units, const ast* Node) {
     debugEnter("Module");
 
-    for (ast* Current = Node->firstChild;
-         Current;
-         Current = Current->nextSibling) {
+    for (int i = 0; i < Node->children; i++) {
+        ast* Current = Node->child[i];
         if (Current->tag == astUsing) {
             if (Current->r)
-                emitterModule(ctx, Current->r);
+                emitterModule(ctx, units, Current->r);
+
+        /*A skipped body, never needed, is just a prototype*/
+        } else if (Current->tag == astFnImpl && Current->r) {
+            emitterUnit* unit = emitterUnitCreate(ctx, units, Current);
+
+            /*The prototype now, so that the label is there for any unit
+              that calls the function, whenever it is generated*/
+            emitterCtx unitCtx = emitterUnitCtx(ctx, unit);
+            emitterDecl(&unitCtx, 0, Current->l);
 
-        } else if (Current->tag == astFnImpl)
-            emitterFnImpl(ctx, Current);
+        } else if (Current->tag == astDecl || Current->tag == astFnImpl) {
+            emitterUnit* unit = vectorGet(units, units->length-1);
 
-        else if (Current->tag == astDecl)
-            emitterDecl(ctx, 0, Current);
+            /*Start a new unit after a function*/
+            if (!unit || unit->fnImpl)
+                unit = emitterUnitCreate(ctx, units, 0);
 
-        else if (Current->tag == astEmpty)
+            emitterCtx unitCtx = emitterUnitCtx(ctx, unit);
+            emitterDecl(&unitCtx, 0, Current->tag == astFnImpl ? Current->l : Current);
+
+        } else if (Current->tag == astEmpty)
             debugMsg("Empty");
 
         else
@@ -86,13 +310,12 @@ static void emitterModule (emitterCtx* ctx, const ast* Node) {
 static void emitterFnImpl (emitterCtx* ctx, const ast* Node) {
     debugEnter("FnImpl");
 
-    emitterDecl(ctx, 0, Node->l);
-
     int stacksize = emitterFnAllocateStack(ctx->arch, Node->symbol);
 
     /* */
     irFn* fn = irFnCreate(ctx->ir, Node->symbol->label, stacksize);
     ctx->curFn = fn;
+    ctx->curFnSymbol = Node->symbol;
     ctx->returnTo = fn->epilogue;
 
     emitterCode(ctx, fn->entryPoint, Node->r, fn->epilogue);
@@ -102,10 +325,8 @@ static void emitterFnImpl (emitterCtx* ctx, const ast* Node) {
 
 irBlock* emitterCode (emitterCtx* ctx, irBlock* block, const ast* Node, irBlock* continuation) {
     if (Node)
-        for (ast* Current = Node->firstChild;
-             Current;
-             Current = Current->nextSibling)
-            block = emitterLine(ctx, block, Current);
+        for (int i = 0; i < Node->children; i++)
+            block = emitterLine(ctx, block, Node->child[i]);
 
     irJump(block, continuation);
 
@@ -159,8 +380,15 @@ static irBlock* emitterLine (emitterCtx* ctx, irBlock* block, const ast* Node) {
 }
 
 static void emitterReturn (emitterCtx* ctx, irBlock* block, const ast* Node) {
+    /*A call can reuse this frame, jumping instead of returning here*/
+    if (Node->r && emitterTailCall(ctx, block, Node->r))
+        return;
+
     /*Non void return?*/
-    if (Node->r)
+    else if (Node->r && ctx->inlined)
+        emitterInlineReturn(ctx, &block, Node->r);
+
+    else if (Node->r)
         emitterValue(ctx, &block, Node->r, requestReturn);
 
     irJump(block, ctx->returnTo);
@@ -172,7 +400,7 @@ static irBlock* emitterBranch (emitterCtx* ctx, irBlock* block, const ast* Node)
             *continuation = irBlockCreate(ctx->ir, ctx->curFn);
 
     /*Condition, branch*/
-    emitterBranchOnValue(ctx, block, Node->firstChild, ifTrue, ifFalse);
+    emitterBranchOnValue(ctx, block, Node->child[0], ifTrue, ifFalse);
 
     /*Emit the true and false branches*/
     emitterCode(ctx, ifTrue, Node->l, continuation);
@@ -221,9 +449,9 @@ static irBlock* emitterIter (emitterCtx* ctx, irBlock* block, const ast* Node) {
             *iterate = irBlockCreate(ctx->ir, ctx->curFn),
             *continuation = irBlockCreate(ctx->ir, ctx->curFn);
 
-    ast *init = Node->firstChild,
-        *cond = init->nextSibling,
-        *iter = cond->nextSibling,
+    ast *init = Node->child[0],
+        *cond = Node->child[1],
+        *iter = Node->child[2],
         *code = Node->l;
 
     /*Initialization*/
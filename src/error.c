@@ -4,6 +4,8 @@
 #include "../inc/ast.h"
 #include "../inc/sym.h"
 #include "../inc/debug.h"
+#include "../inc/source.h"
+#include "../inc/compiler.h"
 
 #include "../inc/lexer.h"
 #include "../inc/parser-internal.h"
@@ -14,11 +16,12 @@
 #include "stdlib.h"
 #include "string.h"
 
-static void tokenLocationMsg (tokenLocation loc);
+static void tokenLocationMsg (const sourceManager* sources, tokenLocation loc);
 static void verrorf (const char* format, va_list args);
 
-static void tokenLocationMsg (tokenLocation loc) {
-    printf("%s:%d:%d: ", loc.filename, loc.line, loc.lineChar);
+static void tokenLocationMsg (const sourceManager* sources, tokenLocation loc) {
+    sourceLocation decoded = sourceDecode(sources, loc);
+    fprintf(debugGetLog(), "%s:%d:%d: ", decoded.filename, decoded.line, decoded.lineChar);
 }
 
 void errorf (const char* format, ...) {
@@ -51,34 +54,34 @@ static void verrorf (const char* format, va_list args) {
 
     for (int i = 0; i < flen; i++) {
         if (format[i] == '$') {
-            printf("%.*s", i-upto, format+upto);
+            fprintf(debugGetLog(), "%.*s", i-upto, format+upto);
             upto = i+2;
             i++;
 
             /*Regular string*/
             if (format[i] == 's')
-                printf("%s", va_arg(args, const char*));
+                fprintf(debugGetLog(), "%s", va_arg(args, const char*));
 
             /*Highlighted string*/
             else if (format[i] == 'h')
-                printf("%s%s%s", colourString, va_arg(args, const char*), consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", colourString, va_arg(args, const char*), consoleNormal);
 
             /*Red string*/
             else if (format[i] == 'r')
-                printf("%s%s%s", consoleRed, va_arg(args, const char*), consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", consoleRed, va_arg(args, const char*), consoleNormal);
 
             /*Operator*/
             else if (format[i] == 'o')
-                printf("%s%s%s", colourOp, opTagGetStr(va_arg(args, opTag)), consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", colourOp, opTagGetStr(va_arg(args, opTag)), consoleNormal);
 
             /*Integer*/
             else if (format[i] == 'd')
-                printf("%s%d%s", colourNumber, va_arg(args, int), consoleNormal);
+                fprintf(debugGetLog(), "%s%d%s", colourNumber, va_arg(args, int), consoleNormal);
 
             /*Raw type*/
             else if (format[i] == 't') {
                 char* typeStr = typeToStr(va_arg(args, const type*));
-                printf("%s%s%s", colourType, typeStr, consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", colourType, typeStr, consoleNormal);
                 free(typeStr);
 
             /*Type with name*/
@@ -88,7 +91,7 @@ static void verrorf (const char* format, va_list args) {
 
                 char* identStr = strjoin((char**) (const char* []) {colourIdent, ident, colourType}, 3, malloc);
                 char* typeStr = typeToStrEmbed(dt, identStr);
-                printf("%s%s%s", colourType, typeStr, consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", colourType, typeStr, consoleNormal);
                 free(identStr);
                 free(typeStr);
 
@@ -98,13 +101,13 @@ static void verrorf (const char* format, va_list args) {
                 const char* ident = Symbol->ident ? Symbol->ident : "";
 
                 if (Symbol->tag != symId && Symbol->tag != symParam)
-                    printf("%s%s%s %s%s", colourTag, symTagGetStr(Symbol->tag), colourIdent, ident, consoleNormal);
+                    fprintf(debugGetLog(), "%s%s%s %s%s", colourTag, symTagGetStr(Symbol->tag), colourIdent, ident, consoleNormal);
 
                 else if (Symbol->dt)
                     errorf("$T", Symbol->dt, ident);
 
                 else
-                    printf("%s%s%s", colourIdent, ident, consoleNormal);
+                    fprintf(debugGetLog(), "%s%s%s", colourIdent, ident, consoleNormal);
 
             /*AST node*/
             } else if (format[i] == 'a') {
@@ -135,7 +138,7 @@ static void verrorf (const char* format, va_list args) {
                 } else
                     classStr = symTagGetStr(Symbol->tag);
 
-                printf("%s%s%s", colourTag, classStr, consoleNormal);
+                fprintf(debugGetLog(), "%s%s%s", colourTag, classStr, consoleNormal);
 
             } else if (format[i] == '\0')
                 break;
@@ -145,14 +148,16 @@ static void verrorf (const char* format, va_list args) {
         }
     }
 
-    printf("%.*s", flen-upto, &format[upto]);
+    fprintf(debugGetLog(), "%.*s", flen-upto, &format[upto]);
 }
 
 void errorParser (parserCtx* ctx, const char* format, ...) {
-    if (ctx->location.line == ctx->lastErrorLine)
+    int line = sourceDecode(&ctx->comp->sources, ctx->location).line;
+
+    if (line == ctx->lastErrorLine)
         return;
 
-    tokenLocationMsg(ctx->location);
+    tokenLocationMsg(&ctx->comp->sources, ctx->location);
     errorf("$r: ", "error");
 
     va_list args;
@@ -160,15 +165,15 @@ void errorParser (parserCtx* ctx, const char* format, ...) {
     verrorf(format, args);
     va_end(args);
 
-    putchar('\n');
+    fputc('\n', debugGetLog());
 
     ctx->errors++;
-    ctx->lastErrorLine = ctx->location.line;
+    ctx->lastErrorLine = line;
     debugWait();
 }
 
 void errorAnalyzer (analyzerCtx* ctx, const ast* Node, const char* format, ...) {
-    tokenLocationMsg(Node->location);
+    tokenLocationMsg(ctx->sources, Node->location);
     errorf("$r: ", "error");
 
     va_list args;
@@ -176,7 +181,7 @@ void errorAnalyzer (analyzerCtx* ctx, const ast* Node, const char* format, ...)
     verrorf(format, args);
     va_end(args);
 
-    putchar('\n');
+    fputc('\n', debugGetLog());
 
     ctx->errors++;
     debugWait();
@@ -185,19 +190,19 @@ void errorAnalyzer (analyzerCtx* ctx, const ast* Node, const char* format, ...)
 /*==== Parser errors ====*/
 
 void errorExpected (parserCtx* ctx, const char* expected) {
-    errorParser(ctx, "expected $h, found '$h'", expected, ctx->lexer->buffer);
+    errorParser(ctx, "expected $h, found '$h'", expected, lexerGetStr(ctx->lexer));
 }
 
 void errorUndefSym (parserCtx* ctx) {
-    errorParser(ctx, "'$h' undefined", ctx->lexer->buffer);
+    errorParser(ctx, "'$h' undefined", lexerGetStr(ctx->lexer));
 }
 
 void errorKeywordAsIdent (parserCtx* ctx) {
-    errorParser(ctx, "cannot use keyword '$h' as an identifier", ctx->lexer->buffer);
+    errorParser(ctx, "cannot use keyword '$h' as an identifier", lexerGetStr(ctx->lexer));
 }
 
 void errorUndefType (parserCtx* ctx) {
-    errorParser(ctx, "'$h' undefined, expected type", ctx->lexer->buffer);
+    errorParser(ctx, "'$h' undefined, expected type", lexerGetStr(ctx->lexer));
 }
 
 void errorIllegalOutside (parserCtx* ctx, const char* what, const char* where) {
@@ -209,15 +214,15 @@ void errorRedeclaredSymAs (parserCtx* ctx, const sym* Symbol, symTag tag) {
 
     errorParser(ctx, "$h redeclared as $s", Symbol->ident, tag != symId ? symTagGetStr(tag) : "different symbol type");
 
-    tokenLocationMsg(first->location);
+    tokenLocationMsg(&ctx->comp->sources, first->location);
     errorf("first declaration here as $c\n", Symbol);
 }
 
 void errorReimplementedSym (parserCtx* ctx, const sym* Symbol) {
     errorParser(ctx, "$n reimplemented", Symbol);
 
-    tokenLocationMsg(Symbol->impl->location);
-    puts("first implementation here");
+    tokenLocationMsg(&ctx->comp->sources, Symbol->impl->location);
+    fputs("first implementation here\n", debugGetLog());
 }
 
 void errorFileNotFound (parserCtx* ctx, const char* name) {
@@ -345,9 +350,11 @@ void errorConflictingDeclarations (analyzerCtx* ctx, const ast* Node,
     for (int n = 0; n < Symbol->decls.length; n++) {
         const ast* Current = (const ast*) vectorGet(&Symbol->decls, n);
 
-        if (Current->location.line != Node->location.line) {
-            tokenLocationMsg(Current->location);
-            printf("also declared here\n");
+        sourceLocation current = sourceDecode(ctx->sources, Current->location);
+
+        if (current.line != sourceDecode(ctx->sources, Node->location).line) {
+            tokenLocationMsg(ctx->sources, Current->location);
+            fprintf(debugGetLog(), "also declared here\n");
         }
     }
 }
@@ -358,10 +365,13 @@ void errorRedeclared (analyzerCtx* ctx, const ast* Node, const sym* Symbol) {
     for (int n = 0; n < Symbol->decls.length; n++) {
         const ast* Current = (const ast*) vectorGet(&Symbol->decls, n);
 
-        if (   Current->location.line != Node->location.line
-            || Current->location.filename != Node->location.filename) {
-            tokenLocationMsg(Current->location);
-            printf("also declared here\n");
+        sourceLocation current = sourceDecode(ctx->sources, Current->location),
+                       node = sourceDecode(ctx->sources, Node->location);
+
+        if (   current.line != node.line
+            || current.filename != node.filename) {
+            tokenLocationMsg(ctx->sources, Current->location);
+            fprintf(debugGetLog(), "also declared here\n");
         }
     }
 }
@@ -136,7 +136,7 @@ static evalResult evalUOP (const architecture* arch, const ast* Node) {
 }
 
 static evalResult evalTernary (const architecture* arch, const ast* Node) {
-    evalResult Cond = eval(arch, Node->firstChild),
+    evalResult Cond = eval(arch, Node->child[0]),
                L = eval(arch, Node->l),
                R = eval(arch, Node->r);
 
@@ -194,9 +194,8 @@ static evalResult evalLiteral (const architecture* arch, const ast* Node) {
 bool evalIsConstantInit (const ast* Node) {
     /*Compound initializer: constant if all the fields/elements are constant*/
     if (Node->tag == astLiteral && Node->litTag == literalInit) {
-        for (ast* current = Node->firstChild;
-             current;
-             current = current->nextSibling) {
+        for (int i = 0; i < Node->children; i++) {
+            ast* current = Node->child[i];
             ast* value = current;
 
             /*Designated initializer?*/
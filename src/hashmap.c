@@ -223,13 +223,14 @@ static void generalmapMerge (generalmap* dest, const generalmap* src,
 static void* generalmapMap (const generalmap* map, const char* key, generalmapHash hashf, generalmapCmp cmp) {
     int hash = hashf(key, map->size);
     int index = generalmapFind(map, key, hash, cmp);
-    return generalmapIsMatch(map, index, key, hash, cmp) ? map->values[index] : 0;
+    /*An empty slot has no key to compare*/
+    return map->values[index] && generalmapIsMatch(map, index, key, hash, cmp) ? map->values[index] : 0;
 }
 
 static bool generalmapTest (const generalmap* map, const char* key, generalmapHash hashf, generalmapCmp cmp) {
     int hash = hashf(key, map->size);
     int index = generalmapFind(map, key, hash, cmp);
-    return generalmapIsMatch(map, index, key, hash, cmp);
+    return map->values[index] && generalmapIsMatch(map, index, key, hash, cmp);
 }
 
 /*==== HASHMAP ====*/
@@ -0,0 +1,470 @@
+#include "../inc/ir-dataflow.h"
+
+#include "../inc/ir.h"
+#include "../inc/vector.h"
+#include "../inc/hashmap.h"
+#include "../inc/bitarray.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+
+#include "stdlib.h"
+
+static void irDataflowOrderBlocks (irDataflow* flow);
+static bool irDataflowVisit (irDataflow* flow, irBlock* block, bitarray* temp);
+
+static int irLivenessGetUses (const irLiveness* live, irInstr* instr, irRegUse* uses);
+static void irReachingDefsTransfer (const irReachingDefs* reaching, irInstr* instr,
+                                    bitarray* gen, bitarray* kill);
+
+/*==== Solver ====*/
+
+irDataflow* irDataflowInit (irDataflow* flow, irFn* fn, irDataflowDirection direction,
+                            irDataflowMeet meet, int bitno) {
+    flow->fn = fn;
+    flow->direction = direction;
+    flow->meet = meet;
+    flow->bitno = bitno;
+    flow->passes = 0;
+
+    int blockNo = fn->blocks.length;
+
+    vectorInit(&flow->order, blockNo);
+    irDataflowOrderBlocks(flow);
+
+    flow->gen = malloc(blockNo*sizeof(bitarray));
+    flow->kill = malloc(blockNo*sizeof(bitarray));
+    flow->in = malloc(blockNo*sizeof(bitarray));
+    flow->out = malloc(blockNo*sizeof(bitarray));
+
+    for (int i = 0; i < blockNo; i++) {
+        bitarrayInit(&flow->gen[i], bitno);
+        bitarrayInit(&flow->kill[i], bitno);
+        bitarrayInit(&flow->in[i], bitno);
+        bitarrayInit(&flow->out[i], bitno);
+
+        /*Start from the top of the lattice, so that the meet of a block not
+          yet visited doesn't lose anything*/
+        if (meet == meetIntersection) {
+            bitarraySetAll(&flow->in[i]);
+            bitarraySetAll(&flow->out[i]);
+        }
+    }
+
+    return flow;
+}
+
+void irDataflowFree (irDataflow* flow) {
+    for (int i = 0; i < flow->fn->blocks.length; i++) {
+        bitarrayFree(&flow->gen[i]);
+        bitarrayFree(&flow->kill[i]);
+        bitarrayFree(&flow->in[i]);
+        bitarrayFree(&flow->out[i]);
+    }
+
+    free(flow->gen);
+    free(flow->kill);
+    free(flow->in);
+    free(flow->out);
+
+    vectorFree(&flow->order);
+}
+
+static void irDataflowOrderBlocks (irDataflow* flow) {
+    irFn* fn = flow->fn;
+
+    /*Visiting blocks in order of the flow (mostly) means most of what they
+      depend on is already known, so fewer passes are needed*/
+    irFnOrderBlocks(fn, &flow->order);
+
+    /*Blocks that never reach the epilogue are left out of that order, but
+      their sets are still needed*/
+    bool* ordered = calloc(fn->blocks.length, sizeof(bool));
+
+    for (int i = 0; i < flow->order.length; i++)
+        ordered[((irBlock*) vectorGet(&flow->order, i))->nthChild] = true;
+
+    for (int i = 0; i < fn->blocks.length; i++)
+        if (!ordered[i])
+            vectorPush(&flow->order, vectorGet(&fn->blocks, i));
+
+    free(ordered);
+}
+
+int irDataflowSolve (irDataflow* flow) {
+    bitarray temp;
+    bitarrayInit(&temp, flow->bitno);
+
+    int passes = 0;
+    bool forward = flow->direction == dataflowForward;
+
+    for (bool changed = true; changed; passes++) {
+        changed = false;
+
+        for (int i = 0; i < flow->order.length; i++) {
+            irBlock* block = vectorGet(&flow->order, forward ? i : flow->order.length-1 - i);
+            changed |= irDataflowVisit(flow, block, &temp);
+        }
+    }
+
+    bitarrayFree(&temp);
+
+    return flow->passes = passes;
+}
+
+/*Meet the sets flowing into a block, and apply its transfer function.
+  Returns whether the set flowing out changed.*/
+static bool irDataflowVisit (irDataflow* flow, irBlock* block, bitarray* temp) {
+    int n = block->nthChild;
+    bool forward = flow->direction == dataflowForward;
+
+    bitarray *before = forward ? &flow->in[n] : &flow->out[n],
+             *after = forward ? &flow->out[n] : &flow->in[n],
+             *afterOthers = forward ? flow->out : flow->in;
+    const vector* edges = forward ? &block->preds : &block->succs;
+
+    /*Meet*/
+
+    if (edges->length == 0)
+        bitarrayClear(before);
+
+    for (int i = 0; i < edges->length; i++) {
+        const irBlock* other = vectorGet(edges, i);
+        const bitarray* otherAfter = &afterOthers[other->nthChild];
+
+        if (i == 0)
+            bitarrayCopy(before, otherAfter);
+
+        else if (flow->meet == meetUnion)
+            bitarrayUnion(before, otherAfter);
+
+        else
+            bitarrayIntersect(before, otherAfter);
+    }
+
+    /*Transfer*/
+
+    bitarrayCopy(temp, before);
+    bitarrayDifference(temp, &flow->kill[n]);
+    bitarrayUnion(temp, &flow->gen[n]);
+
+    if (bitarrayEqual(temp, after))
+        return false;
+
+    bitarrayCopy(after, temp);
+    return true;
+}
+
+static void irDataflowDumpSet (const bitarray* bits, const void* client, irDataflowNamer namer) {
+    debugOut("{");
+
+    for (int i = bitarrayNext(bits, 0); i >= 0; i = bitarrayNext(bits, i+1)) {
+        debugOut(" ");
+        namer(client, i);
+    }
+
+    debugOut(" }");
+}
+
+void irDataflowDump (const irDataflow* flow, const void* client, irDataflowNamer namer) {
+    debugMsg("%s: %s, %d bits", flow->fn->name,
+             flow->direction == dataflowForward ? "forward" : "backward", flow->bitno);
+
+    for (int i = 0; i < flow->order.length; i++) {
+        const irBlock* block = vectorGet(&flow->order, i);
+        int n = block->nthChild;
+
+        debugOut("%s:\n    in  ", block->label);
+        irDataflowDumpSet(&flow->in[n], client, namer);
+        debugOut("\n    out ");
+        irDataflowDumpSet(&flow->out[n], client, namer);
+        debugOut("\n");
+    }
+}
+
+/*==== ====*/
+
+/*The widest each register of a fn is named at*/
+static intmap/*<intptr_t>*/* irFnGetRegWidths (irFn* fn, int wordsize, intmap* widths) {
+    intmapInit(widths, 128);
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irInstrGetRegs(vectorGet(&block->instrs, j), wordsize, uses);
+
+            for (int k = 0; k < useNo; k++) {
+                intptr_t width = (intptr_t) intmapMap(widths, (intptr_t) *uses[k].where);
+
+                if (width < uses[k].size)
+                    intmapAdd(widths, (intptr_t) *uses[k].where, (void*) (intptr_t) uses[k].size);
+            }
+        }
+    }
+
+    return widths;
+}
+
+/*==== Liveness ====*/
+
+static void irLivenessNumber (irLiveness* live, reg* vreg) {
+    if (intmapMap(&live->indices, (intptr_t) vreg))
+        return;
+
+    int index = vectorPush(&live->regs, vreg);
+    intmapAdd(&live->indices, (intptr_t) vreg, (void*) (intptr_t) (index+1));
+}
+
+irLiveness* irLivenessInit (irLiveness* live, irFn* fn, int wordsize) {
+    live->wordsize = wordsize;
+    vectorInit(&live->regs, 64);
+    intmapInit(&live->indices, 128);
+
+    /*Number the registers*/
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irInstrGetRegs(vectorGet(&block->instrs, j), wordsize, uses);
+
+            for (int k = 0; k < useNo; k++)
+                irLivenessNumber(live, *uses[k].where);
+        }
+    }
+
+    intmap/*<intptr_t>*/ widths;
+    irFnGetRegWidths(fn, wordsize, &widths);
+    live->sizes = malloc(live->regs.length*sizeof(int));
+
+    for (int i = 0; i < live->regs.length; i++)
+        live->sizes[i] = (intptr_t) intmapMap(&widths, (intptr_t) vectorGet(&live->regs, i));
+
+    intmapFree(&widths);
+
+    irDataflowInit(&live->flow, fn, dataflowBackward, meetUnion, live->regs.length);
+
+    /*gen: read before being written in the block, kill: written*/
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+        bitarray *gen = &live->flow.gen[i],
+                 *kill = &live->flow.kill[i];
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irLivenessGetUses(live, vectorGet(&block->instrs, j), uses);
+
+            for (int k = 0; k < useNo; k++) {
+                int index = irLivenessGetIndex(live, *uses[k].where);
+
+                if (uses[k].read && !bitarrayTest(kill, index))
+                    bitarraySet(gen, index);
+            }
+
+            for (int k = 0; k < useNo; k++)
+                if (uses[k].written)
+                    bitarraySet(kill, irLivenessGetIndex(live, *uses[k].where));
+        }
+    }
+
+    irDataflowSolve(&live->flow);
+
+    return live;
+}
+
+void irLivenessFree (irLiveness* live) {
+    irDataflowFree(&live->flow);
+    vectorFree(&live->regs);
+    intmapFree(&live->indices);
+    free(live->sizes);
+}
+
+int irLivenessGetIndex (const irLiveness* live, const reg* vreg) {
+    return (intptr_t) intmapMap(&live->indices, (intptr_t) vreg) - 1;
+}
+
+/*As irInstrGetRegs, but a write of only part of a register reads it too*/
+static int irLivenessGetUses (const irLiveness* live, irInstr* instr, irRegUse* uses) {
+    int useNo = irInstrGetRegs(instr, live->wordsize, uses);
+
+    for (int k = 0; k < useNo; k++)
+        if (uses[k].written && uses[k].size < live->sizes[irLivenessGetIndex(live, *uses[k].where)])
+            uses[k].read = true;
+
+    return useNo;
+}
+
+void irLivenessTransfer (const irLiveness* live, irInstr* instr, bitarray* bits) {
+    irRegUse uses[irInstrMaxRegs];
+    int useNo = irLivenessGetUses(live, instr, uses);
+
+    for (int k = 0; k < useNo; k++)
+        if (uses[k].written)
+            bitarrayUnset(bits, irLivenessGetIndex(live, *uses[k].where));
+
+    for (int k = 0; k < useNo; k++)
+        if (uses[k].read)
+            bitarraySet(bits, irLivenessGetIndex(live, *uses[k].where));
+}
+
+void irLivenessAt (const irLiveness* live, const irBlock* block, int n, bitarray* result) {
+    bitarrayCopy(result, &live->flow.out[block->nthChild]);
+
+    for (int j = block->instrs.length-1; j >= n; j--)
+        irLivenessTransfer(live, vectorGet(&block->instrs, j), result);
+}
+
+static void irLivenessDumpReg (const void* live, int index) {
+    const irLiveness* liveness = live;
+    debugOut("%s", regGetName(vectorGet(&liveness->regs, index), liveness->sizes[index]));
+}
+
+void irLivenessDump (const irLiveness* live) {
+    irDataflowDump(&live->flow, live, irLivenessDumpReg);
+}
+
+/*==== Reaching definitions ====*/
+
+/*The register an instruction defines, if any. Only dest is ever written.*/
+static const irRegUse* irReachingDefsGetDef (const irRegUse* uses, int useNo) {
+    for (int k = 0; k < useNo; k++)
+        if (uses[k].written)
+            return &uses[k];
+
+    return 0;
+}
+
+static void irReachingDefsNumber (irReachingDefs* reaching, irInstr* instr, reg* vreg) {
+    int index = vectorPush(&reaching->defs, instr);
+    vectorPush(&reaching->defRegs, vreg);
+    intmapAdd(&reaching->indices, (intptr_t) instr, (void*) (intptr_t) (index+1));
+
+    vector* regDefs = intmapMap(&reaching->regDefs, (intptr_t) vreg);
+
+    if (!regDefs) {
+        regDefs = vectorInit(malloc(sizeof(vector)), 4);
+        intmapAdd(&reaching->regDefs, (intptr_t) vreg, regDefs);
+    }
+
+    vectorPush(regDefs, (void*) (intptr_t) index);
+}
+
+irReachingDefs* irReachingDefsInit (irReachingDefs* reaching, irFn* fn, int wordsize) {
+    reaching->wordsize = wordsize;
+    vectorInit(&reaching->defs, 64);
+    vectorInit(&reaching->defRegs, 64);
+    intmapInit(&reaching->indices, 128);
+    intmapInit(&reaching->regDefs, 64);
+
+    /*Number the definitions*/
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irInstr* instr = vectorGet(&block->instrs, j);
+
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irInstrGetRegs(instr, wordsize, uses);
+            const irRegUse* def = irReachingDefsGetDef(uses, useNo);
+
+            if (def)
+                irReachingDefsNumber(reaching, instr, *def->where);
+        }
+    }
+
+    /*Which are partial, by the widths of the registers*/
+
+    intmap/*<intptr_t>*/ widths;
+    irFnGetRegWidths(fn, wordsize, &widths);
+    reaching->partial = malloc(reaching->defs.length*sizeof(bool));
+
+    for (int i = 0; i < reaching->defs.length; i++) {
+        irRegUse uses[irInstrMaxRegs];
+        int useNo = irInstrGetRegs(vectorGet(&reaching->defs, i), wordsize, uses);
+        const irRegUse* def = irReachingDefsGetDef(uses, useNo);
+
+        reaching->partial[i] = def->read || def->size < (intptr_t) intmapMap(&widths, (intptr_t) *def->where);
+    }
+
+    intmapFree(&widths);
+
+    irDataflowInit(&reaching->flow, fn, dataflowForward, meetUnion, reaching->defs.length);
+
+    /*gen: the last definitions of each register in the block,
+      kill: every definition of the registers it overwrites*/
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++)
+            irReachingDefsTransfer(reaching, vectorGet(&block->instrs, j),
+                                   &reaching->flow.gen[i], &reaching->flow.kill[i]);
+    }
+
+    irDataflowSolve(&reaching->flow);
+
+    return reaching;
+}
+
+static void irReachingDefsFreeRegDefs (void* regDefs, int key) {
+    (void) key;
+    vectorFree(regDefs);
+    free(regDefs);
+}
+
+void irReachingDefsFree (irReachingDefs* reaching) {
+    irDataflowFree(&reaching->flow);
+    vectorFree(&reaching->defs);
+    vectorFree(&reaching->defRegs);
+    intmapFree(&reaching->indices);
+    intmapFreeObjs(&reaching->regDefs, irReachingDefsFreeRegDefs);
+    free(reaching->partial);
+}
+
+int irReachingDefsGetIndex (const irReachingDefs* reaching, const irInstr* instr) {
+    return (intptr_t) intmapMap(&reaching->indices, (intptr_t) instr) - 1;
+}
+
+/*Step forward over an instruction, into gen and if given, kill*/
+static void irReachingDefsTransfer (const irReachingDefs* reaching, irInstr* instr,
+                                    bitarray* gen, bitarray* kill) {
+    int index = irReachingDefsGetIndex(reaching, instr);
+
+    if (index < 0)
+        return;
+
+    /*Writing the whole register replaces any other definition of it*/
+    if (!reaching->partial[index]) {
+        const vector* regDefs = intmapMap(&reaching->regDefs, (intptr_t) vectorGet(&reaching->defRegs, index));
+
+        for (int k = 0; k < regDefs->length; k++) {
+            int other = (intptr_t) vectorGet(regDefs, k);
+            bitarrayUnset(gen, other);
+
+            if (kill)
+                bitarraySet(kill, other);
+        }
+    }
+
+    bitarraySet(gen, index);
+}
+
+void irReachingDefsAt (const irReachingDefs* reaching, const irBlock* block, int n, bitarray* result) {
+    bitarrayCopy(result, &reaching->flow.in[block->nthChild]);
+
+    for (int j = 0; j < n; j++)
+        irReachingDefsTransfer(reaching, vectorGet(&block->instrs, j), result, 0);
+}
+
+static void irReachingDefsDumpDef (const void* reaching, int index) {
+    const irInstr* def = vectorGet(&((const irReachingDefs*) reaching)->defs, index);
+    debugOut("%d:%s", index, regGetName(def->dest.base, def->dest.size));
+}
+
+void irReachingDefsDump (const irReachingDefs* reaching) {
+    irDataflowDump(&reaching->flow, reaching, irReachingDefsDumpDef);
+}
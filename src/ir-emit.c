@@ -58,34 +58,65 @@ static void irEmitStaticData (irCtx* ctx, FILE* file, const irStaticData* data)
         debugErrorUnhandledInt("irEmitStaticData", "static data tag", data->tag);
 }
 
-static void irEmitBlockChain (irCtx* ctx, FILE* file,
-                              intset/*<irBlock*>*/* done, vector/*<irBlock*>*/* priority,
-                              const irBlock* block) {
-    /*Already put in the priority list, leave*/
+static void irOrderBlockChain (intset/*<irBlock*>*/* done, vector/*<irBlock*>*/* order,
+                               const irBlock* block) {
+    /*Already put in the order, leave*/
     if (intsetAdd(done, (intptr_t) block))
         return;
 
     /*Add all the predecessors and their predecessors to the list*/
     for (int j = 0; j < block->preds.length; j++) {
         irBlock* pred = vectorGet(&block->preds, j);
-        irEmitBlockChain(ctx, file, done, priority, pred);
+        irOrderBlockChain(done, order, pred);
     }
 
     /*Followed by this block*/
-    vectorPush(priority, (void*) block);
+    vectorPush(order, (void*) block);
 }
 
-static void irEmitFn (irCtx* ctx, FILE* file, const irFn* fn) {
-    debugEnter(fn->name);
+/*Add any blocks reachable from this one not yet in the order, each
+  followed by its succs*/
+static void irOrderReachable (intset/*<irBlock*>*/* done, intset/*<irBlock*>*/* seen,
+                              vector/*<irBlock*>*/* order, const irBlock* block) {
+    if (intsetAdd(seen, (intptr_t) block))
+        return;
+
+    if (!intsetAdd(done, (intptr_t) block))
+        vectorPush(order, (void*) block);
+
+    for (int j = 0; j < block->succs.length; j++)
+        irOrderReachable(done, seen, order, vectorGet(&block->succs, j));
+}
 
-    intset/*<irBlock*>*/ done;
+void irFnOrderBlocks (const irFn* fn, vector/*<irBlock*>*/* order) {
+    intset/*<irBlock*>*/ done, seen;
     intsetInit(&done, fn->blocks.length*2);
+    intsetInit(&seen, fn->blocks.length*2);
+
+    /*Decide an order to emit the blocks in to minimize unnecessary jumps*/
+
+    bool returns = fn->epilogue->preds.length != 0 || fn->epilogue == fn->prologue;
+
+    if (returns)
+        irOrderBlockChain(&done, order, fn->epilogue);
+
+    /*Then whatever never returns, like an endless loop. If that's everything
+      the epilogue goes last, after the prologue.*/
+    irOrderReachable(&done, &seen, order, fn->prologue);
+
+    if (!returns)
+        irOrderBlockChain(&done, order, fn->epilogue);
+
+    intsetFree(&done);
+    intsetFree(&seen);
+}
+
+static void irEmitFn (irCtx* ctx, FILE* file, const irFn* fn) {
+    debugEnter(fn->name);
 
     vector/*<irBlock*>*/ priority;
     vectorInit(&priority, fn->blocks.length);
-
-    /*Decide an order to emit the blocks in to minimize unnecessary jumps*/
-    irEmitBlockChain(ctx, file, &done, &priority, fn->epilogue);
+    irFnOrderBlocks(fn, &priority);
 
     /*Emit*/
 
@@ -102,7 +133,6 @@ static void irEmitFn (irCtx* ctx, FILE* file, const irFn* fn) {
 
     /*Cleanup*/
     vectorFree(&priority);
-    intsetFree(&done);
 
     debugLeave();
 }
@@ -119,8 +149,8 @@ static void irEmitBlock (irCtx* ctx, FILE* file,
                                         : true)))
         asmLabel(ctx->asm, block->label);
 
-    fputs(block->str, file);
-    debugMsg(block->str);
+    for (int i = 0; i < block->instrs.length; i++)
+        asmInstr(ctx->asm, vectorGet(&block->instrs, i));
 
     if (block->term)
         irEmitTerm(ctx, file, block->term, nextblock);
@@ -166,6 +196,10 @@ static void irEmitTerm (irCtx* ctx, FILE* file, const irTerm* term, const irBloc
     } else if (term->tag == termReturn)
         asmReturn(ctx->asm);
 
+    /*The epilogue is already in the block, from irAllocRegs*/
+    else if (term->tag == termTailCall)
+        asmJump(ctx->asm, term->toAsSym->label);
+
     else
         debugErrorUnhandledInt("irEmitTerm", "terminal tag", term->tag);
 
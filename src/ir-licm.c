@@ -0,0 +1,676 @@
+#include "../inc/ir.h"
+
+#include "../inc/ir-ssa.h"
+#include "../inc/ir-dataflow.h"
+#include "../inc/vector.h"
+#include "../inc/hashmap.h"
+#include "../inc/bitarray.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+#include "../inc/architecture.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+/*Loop invariant code motion.
+
+  Loops are found as natural loops over the dominator tree, innermost
+  first. The emitter rotates while and for loops (the condition is tested
+  once before the loop, and again at the end of it) so a loop's header is
+  the first block of its body, and runs whenever the loop is entered.
+
+  The two operand instructions of the IR mean a value is usually built up
+  by several writes to one virtual register: a load, then a multiply, then
+  an add. So what gets hoisted is every write of a register in the loop
+  together, provided that they are all in one block with nothing else
+  naming it in between, the first doesn't read it, and it isn't live into
+  the header (so no iteration reads what the last one left). Each write
+  must compute only from the invariant:
+    - literals and labels,
+    - registers not written in the loop, or hoisted already,
+    - and loads of memory the loop doesn't write. A load through a pointer
+      may fault, so is only hoisted from the header, which would have run
+      it anyway. Stack slots and globals can always be loaded.
+  When only the leading writes compute from the invariant (the inv*k of
+  inv*k + i) they are hoisted into a new register, and the loop copies
+  from it. Invariant loads (other than of stack slots) used as an operand
+  of an arithmetic instruction or compare left in the loop are likewise
+  hoisted into registers of their own.
+
+  What is hoisted goes, in order, into a preheader inserted between the
+  header and its preds from outside the loop. As the loops are found again
+  after each one, code hoisted from an inner loop can then move out of the
+  outer loop too.*/
+
+typedef struct licmCtx {
+    irCtx* ir;
+    irFn* fn;
+    int wordsize;
+    bool frameEscapes;
+
+    irLoop* loop;
+    ///Of the liveness, which can't outlive a new block: the registers live
+    ///into the header, and the widest each is named at
+    intset/*<reg*>*/ liveIn;
+    intmap/*<intptr_t>*/ sizes;
+    ///The registers live out of the loop, into any block outside it
+    intset/*<reg*>*/ liveOut;
+
+    ///Memory operands the loop writes, and whether it may write anything a
+    ///pointer reaches (by a call)
+    vector/*<const operand*>*/ stores;
+    bool clobbers;
+
+    ///Registers written in the loop, and those of them since hoisted
+    intset/*<reg*>*/ written, hoisted;
+    ///The writes of each register hoisted, and the register
+    vector/*<vector<irInstr*>*>*/ groups;
+    vector/*<reg*>*/ groupRegs;
+    ///Invariant loads given registers of their own, and the registers
+    vector/*<const operand*>*/ loads;
+    vector/*<reg*>*/ loadRegs;
+
+    irBlock* preheader;
+    int hoistedNo;
+} licmCtx;
+
+static int licmLoop (irCtx* ir, irFn* fn, irLoop* loop, int wordsize);
+
+void irLoopInvariantCodeMotion (irCtx* ctx) {
+    int wordsize = ctx->arch->wordsize;
+
+    for (int i = 0; i < ctx->fns.length; i++) {
+        irFn* fn = vectorGet(&ctx->fns, i);
+        debugEnter(fn->name);
+
+        int loopNo = 0, hoistedNo = 0;
+
+        /*Loop headers already done*/
+        intset/*<irBlock*>*/ done;
+        intsetInit(&done, 8);
+
+        /*Find the loops again after each, as the blocks change*/
+        for (bool more = true; more;) {
+            irDominators doms;
+            irDominatorsInit(&doms, fn);
+
+            vector/*<irLoop*>*/ loops;
+            vectorInit(&loops, 4);
+            irLoopsFind(&doms, &loops);
+            irDominatorsFree(&doms);
+
+            more = false;
+
+            for (int j = 0; j < loops.length; j++) {
+                irLoop* loop = vectorGet(&loops, j);
+
+                if (intsetAdd(&done, (intptr_t) loop->header))
+                    continue;
+
+                loopNo++;
+                hoistedNo += licmLoop(ctx, fn, loop, wordsize);
+                more = true;
+                break;
+            }
+
+            vectorFreeObjs(&loops, (vectorDtor) irLoopDestroy);
+        }
+
+        intsetFree(&done);
+
+        debugMsg("%s: %d loops, %d instructions hoisted", fn->name, loopNo, hoistedNo);
+        debugLeave();
+    }
+}
+
+/*==== Invariance ====*/
+
+static bool licmIsFrame (const operand* Value) {
+    return Value->tag == operandMem && Value->base == &regs[regRBP];
+}
+
+static bool licmMayAlias (const licmCtx* ctx, const operand* l, const operand* r) {
+    bool lFrame = licmIsFrame(l), rFrame = licmIsFrame(r);
+
+    if (l->tag == operandLabelMem && r->tag == operandLabelMem)
+        return !strcmp(l->label, r->label);
+
+    else if (lFrame && rFrame)
+        return    l->index || r->index
+               || (l->offset < r->offset + r->size && r->offset < l->offset + l->size);
+
+    else if (lFrame || rFrame) {
+        const operand* other = lFrame ? r : l;
+        return other->tag != operandLabelMem && ctx->frameEscapes;
+    }
+
+    return true;
+}
+
+static bool licmRegIsInvariant (const licmCtx* ctx, const reg* r) {
+    if (!r)
+        return true;
+
+    else if (regGetIndex(r))
+        return r == &regs[regRBP];
+
+    return    !intsetTest(&ctx->written, (intptr_t) r)
+           || intsetTest(&ctx->hoisted, (intptr_t) r);
+}
+
+/*Can a load be done once, before the loop, instead of in a block of it*/
+static bool licmLoadIsInvariant (const licmCtx* ctx, const irBlock* block, const operand* Value) {
+    if (Value->tag == operandMem) {
+        if (!licmRegIsInvariant(ctx, Value->base) || !licmRegIsInvariant(ctx, Value->index))
+            return false;
+
+        /*Through a pointer: only from where it would have run anyway*/
+        if (!licmIsFrame(Value) && block != ctx->loop->header)
+            return false;
+    }
+
+    bool reachable = !(licmIsFrame(Value) && !ctx->frameEscapes);
+
+    if (ctx->clobbers && reachable)
+        return false;
+
+    for (int i = 0; i < ctx->stores.length; i++)
+        if (licmMayAlias(ctx, Value, vectorGet(&ctx->stores, i)))
+            return false;
+
+    return true;
+}
+
+static bool licmOperandIsInvariant (const licmCtx* ctx, const irBlock* block,
+                                    const operand* Value, const reg* except) {
+    if (Value->tag == operandReg)
+        return Value->base == except || licmRegIsInvariant(ctx, Value->base);
+
+    else if (Value->tag == operandMem || Value->tag == operandLabelMem)
+        return licmLoadIsInvariant(ctx, block, Value);
+
+    else
+        return    Value->tag == operandUndefined || Value->tag == operandLiteral
+               || Value->tag == operandLabelOffset;
+}
+
+/*Does the instruction compute its dest from its operands alone, with no
+  other effect (bar the flags) and no way to fault*/
+static bool licmInstrIsPure (const irInstr* instr) {
+    return    instr->tag == instrMove || instr->tag == instrMoveZeroExt
+           || instr->tag == instrMoveSignExt || instr->tag == instrEvalAddress
+           || instr->tag == instrBOP || instr->tag == instrUOP;
+}
+
+static bool licmInstrWrites (const irInstr* instr, const reg* r) {
+    return irInstrWritesDest(instr) && instr->dest.tag == operandReg && instr->dest.base == r;
+}
+
+static bool licmInstrMentions (irInstr* instr, int wordsize, const reg* r) {
+    irRegUse uses[irInstrMaxRegs];
+    int useNo = irInstrGetRegs(instr, wordsize, uses);
+
+    for (int i = 0; i < useNo; i++)
+        if (*uses[i].where == r)
+            return true;
+
+    return false;
+}
+
+static bool licmInstrReads (irInstr* instr, int wordsize, const reg* r) {
+    irRegUse uses[irInstrMaxRegs];
+    int useNo = irInstrGetRegs(instr, wordsize, uses);
+
+    for (int i = 0; i < useNo; i++)
+        if (*uses[i].where == r && uses[i].read)
+            return true;
+
+    return false;
+}
+
+/*Could a write of a register be done before the loop: pure, whole (the
+  size given), from the invariant, and its flags unread*/
+static bool licmWriteIsInvariant (const licmCtx* ctx, const irBlock* block, int n,
+                                  const reg* r, int size) {
+    const irInstr* instr = vectorGet(&block->instrs, n);
+
+    return    licmInstrIsPure(instr)
+           && instr->dest.size == size
+           && licmOperandIsInvariant(ctx, block, &instr->l, r)
+           && licmOperandIsInvariant(ctx, block, &instr->r, r)
+           && !(irInstrSetsFlags(instr) && irBlockFlagsRead(block, n));
+}
+
+/*==== Hoisting ====*/
+
+static irBlock* licmGetPreheader (licmCtx* ctx) {
+    if (ctx->preheader)
+        return ctx->preheader;
+
+    irBlock* header = ctx->loop->header;
+    irBlock* preheader = ctx->preheader = irBlockCreate(ctx->ir, ctx->fn);
+
+    /*Everything from outside the loop goes through the preheader. Copied,
+      as redirecting changes the preds.*/
+
+    vector/*<irBlock*>*/ preds;
+    vectorInit(&preds, header->preds.length);
+    vectorPushFromVector(&preds, &header->preds);
+
+    for (int i = 0; i < preds.length; i++) {
+        irBlock* pred = vectorGet(&preds, i);
+
+        if (!ctx->loop->contains[pred->nthChild] && vectorFind(&header->preds, pred) >= 0)
+            irBlockRedirect(pred, header, preheader);
+    }
+
+    vectorFree(&preds);
+
+    irJump(preheader, header);
+
+    /*First among the preds, where the way in was, as the order blocks are
+      emitted in follows them*/
+    for (int i = header->preds.length; i > 1; i--)
+        vectorSet(&header->preds, i-1, vectorGet(&header->preds, i-2));
+
+    vectorSet(&header->preds, 0, preheader);
+
+    return preheader;
+}
+
+/*Take the instructions at the positions given out of a block, in order,
+  and onto the end of a vector*/
+static void licmTake (irBlock* block, const int* positions, int positionNo,
+                      vector/*<irInstr*>*/* taken) {
+    for (int i = 0; i < positionNo; i++)
+        vectorPush(taken, vectorGet(&block->instrs, positions[i]));
+
+    /*Close up the gaps, keeping the order*/
+
+    int kept = positions[0];
+
+    for (int i = positions[0], next = 0; i < block->instrs.length; i++) {
+        if (next < positionNo && positions[next] == i)
+            next++;
+
+        else
+            vectorSet(&block->instrs, kept++, vectorGet(&block->instrs, i));
+    }
+
+    while (block->instrs.length > kept)
+        vectorPop(&block->instrs);
+}
+
+/*Is b as a, but writing r where a writes q*/
+static bool licmInstrIsRenamed (const irInstr* a, const irInstr* b, reg* q, const reg* r) {
+    if (a->tag != b->tag || a->bop != b->bop)
+        return false;
+
+    const operand *aOperands[3] = {&a->dest, &a->l, &a->r},
+                  *bOperands[3] = {&b->dest, &b->l, &b->r};
+
+    for (int i = 0; i < 3; i++) {
+        operand renamed = *bOperands[i];
+
+        if (renamed.tag == operandReg || renamed.tag == operandMem) {
+            if (renamed.base == r)
+                renamed.base = q;
+
+            if (renamed.tag == operandMem && renamed.index == r)
+                renamed.index = q;
+        }
+
+        if (!operandIsEqual(*aOperands[i], renamed) || aOperands[i]->size != renamed.size)
+            return false;
+    }
+
+    return true;
+}
+
+/*A register already hoisted with the same writes as those given*/
+static reg* licmFindSame (const licmCtx* ctx, const irBlock* block, const int* positions,
+                          int positionNo, const reg* r) {
+    for (int i = 0; i < ctx->groups.length; i++) {
+        const vector* group = vectorGet(&ctx->groups, i);
+        reg* q = vectorGet(&ctx->groupRegs, i);
+
+        bool same = group->length == positionNo;
+
+        for (int j = 0; same && j < positionNo; j++)
+            same = licmInstrIsRenamed(vectorGet(group, j),
+                                      vectorGet(&block->instrs, positions[j]), q, r);
+
+        if (same)
+            return q;
+    }
+
+    return 0;
+}
+
+/*Make the loop read one register instead of another*/
+static void licmRename (const licmCtx* ctx, const reg* from, reg* to) {
+    for (int i = 0; i < ctx->loop->blocks.length; i++) {
+        const irBlock* block = vectorGet(&ctx->loop->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irInstrGetRegs(vectorGet(&block->instrs, j), ctx->wordsize, uses);
+
+            for (int k = 0; k < useNo; k++)
+                if (*uses[k].where == from)
+                    *uses[k].where = to;
+        }
+    }
+}
+
+/*Hoist the leading writes of the register written by the nth instruction
+  of a block, those that compute from the invariant, into a new register.
+  The last of them becomes a copy of it. This is the inv*k of inv*k + i,
+  which is built in the same register as the variant part.*/
+static bool licmHoistPrefix (licmCtx* ctx, irBlock* block, int n) {
+    irInstr* first = vectorGet(&block->instrs, n);
+    reg* r = first->dest.base;
+    int size = first->dest.size;
+
+    if (   intsetTest(&ctx->hoisted, (intptr_t) r)
+        || licmInstrReads(first, ctx->wordsize, r))
+        return false;
+
+    /*The writes, up to the first that isn't invariant or the first read of
+      what they have so far*/
+
+    int* positions = malloc(block->instrs.length*sizeof(int));
+    int positionNo = 0;
+
+    for (int i = n; i < block->instrs.length; i++) {
+        irInstr* instr = vectorGet(&block->instrs, i);
+
+        if (licmInstrWrites(instr, r)) {
+            if (!licmWriteIsInvariant(ctx, block, i, r, size))
+                break;
+
+            positions[positionNo++] = i;
+
+        } else if (licmInstrMentions(instr, ctx->wordsize, r))
+            break;
+    }
+
+    /*A lone load is no better off in a register of its own*/
+    bool hoistable = positionNo >= 2;
+
+    if (hoistable) {
+        irInstr* last = vectorGet(&block->instrs, positions[positionNo-1]);
+        reg* same = licmFindSame(ctx, block, positions, positionNo, r);
+
+        /*All but the last*/
+        vector/*<irInstr*>*/* taken = malloc(sizeof(vector));
+        vectorInit(taken, positionNo);
+        licmTake(block, positions, positionNo-1, taken);
+
+        if (same) {
+            vectorFreeObjs(taken, (vectorDtor) irInstrDestroy);
+            free(taken);
+
+        } else {
+            same = regAlloc(size);
+
+            irBlock* preheader = licmGetPreheader(ctx);
+            vectorPushFromVector(&preheader->instrs, taken);
+
+            irInstr* copy = irInstrCreate(preheader, last->tag, last->dest, last->l, last->r);
+            copy->bop = last->bop;
+            vectorPush(taken, copy);
+
+            for (int i = 0; i < taken->length; i++) {
+                irRegUse uses[irInstrMaxRegs];
+                int useNo = irInstrGetRegs(vectorGet(taken, i), ctx->wordsize, uses);
+
+                for (int j = 0; j < useNo; j++)
+                    if (*uses[j].where == r)
+                        *uses[j].where = same;
+            }
+
+            vectorPush(&ctx->groups, taken);
+            vectorPush(&ctx->groupRegs, same);
+        }
+
+        last->tag = instrMove;
+        last->bop = bopUndefined;
+        last->l = operandCreateReg(same);
+        last->l.size = size;
+        last->r = operandCreate(operandUndefined);
+
+        ctx->hoistedNo += positionNo;
+    }
+
+    free(positions);
+    return hoistable;
+}
+
+/*Try to hoist all the writes of the register written by the nth
+  instruction of a block, or failing that, the invariant ones leading*/
+static bool licmHoistReg (licmCtx* ctx, irBlock* block, int n) {
+    irInstr* first = vectorGet(&block->instrs, n);
+    reg* r = first->dest.base;
+
+    int size = (intptr_t) intmapMap(&ctx->sizes, (intptr_t) r);
+
+    /*Live into the header, or read before written*/
+    if (   intsetTest(&ctx->hoisted, (intptr_t) r) || intsetTest(&ctx->liveIn, (intptr_t) r)
+        || licmInstrReads(first, ctx->wordsize, r))
+        return licmHoistPrefix(ctx, block, n);
+
+    /*The writes, all in this block and in a run with nothing else naming
+      the register in between, each computing from the invariant*/
+
+    int* positions = malloc(block->instrs.length*sizeof(int));
+    int positionNo = 0;
+
+    bool hoistable = true, inRun = true;
+
+    for (int i = n; hoistable && i < block->instrs.length; i++) {
+        irInstr* instr = vectorGet(&block->instrs, i);
+
+        if (licmInstrWrites(instr, r)) {
+            hoistable = inRun && licmWriteIsInvariant(ctx, block, i, r, size);
+            positions[positionNo++] = i;
+
+        /*Read after the last write*/
+        } else if (licmInstrMentions(instr, ctx->wordsize, r))
+            inRun = false;
+    }
+
+    /*None anywhere else*/
+
+    for (int i = 0; hoistable && i < ctx->loop->blocks.length; i++) {
+        const irBlock* other = vectorGet(&ctx->loop->blocks, i);
+        int end = other == block ? n : other->instrs.length;
+
+        for (int j = 0; hoistable && j < end; j++)
+            hoistable = !licmInstrWrites(vectorGet(&other->instrs, j), r);
+    }
+
+    if (hoistable) {
+        /*The same value was hoisted into another register: use that, if
+          nothing reads this one after the loop*/
+        reg* same = intsetTest(&ctx->liveOut, (intptr_t) r)
+                    ? 0 : licmFindSame(ctx, block, positions, positionNo, r);
+
+        vector/*<irInstr*>*/* taken = malloc(sizeof(vector));
+        vectorInit(taken, positionNo);
+        licmTake(block, positions, positionNo, taken);
+
+        if (same) {
+            licmRename(ctx, r, same);
+            vectorFreeObjs(taken, (vectorDtor) irInstrDestroy);
+            free(taken);
+
+        } else {
+            vectorPushFromVector(&licmGetPreheader(ctx)->instrs, taken);
+            vectorPush(&ctx->groups, taken);
+            vectorPush(&ctx->groupRegs, r);
+        }
+
+        intsetAdd(&ctx->hoisted, (intptr_t) r);
+        ctx->hoistedNo += positionNo;
+    }
+
+    free(positions);
+    return hoistable || licmHoistPrefix(ctx, block, n);
+}
+
+/*Give an invariant load its own register, loaded in the preheader*/
+static void licmHoistLoad (licmCtx* ctx, const irBlock* block, operand* Value) {
+    /*A stack slot is as cheap to read as a register, which would be better
+      left free*/
+    if (   (Value->tag != operandMem && Value->tag != operandLabelMem)
+        || licmIsFrame(Value) || !licmLoadIsInvariant(ctx, block, Value))
+        return;
+
+    reg* r = 0;
+
+    for (int i = 0; i < ctx->loads.length && !r; i++)
+        if (operandIsEqual(*Value, *(const operand*) vectorGet(&ctx->loads, i)))
+            r = vectorGet(&ctx->loadRegs, i);
+
+    if (!r) {
+        r = regAlloc(Value->size);
+        irInstr* load = irInstrCreate(licmGetPreheader(ctx), instrMove, operandCreateReg(r), *Value,
+                                      operandCreate(operandUndefined));
+
+        vectorPush(&ctx->loads, &load->l);
+        vectorPush(&ctx->loadRegs, r);
+        ctx->hoistedNo++;
+    }
+
+    int size = Value->size;
+    *Value = operandCreateReg(r);
+    Value->size = size;
+}
+
+/*==== Loops ====*/
+
+static void licmFindWrites (licmCtx* ctx) {
+    for (int i = 0; i < ctx->loop->blocks.length; i++) {
+        const irBlock* block = vectorGet(&ctx->loop->blocks, i);
+
+        if (block->term && (block->term->tag == termCall || block->term->tag == termCallIndirect))
+            ctx->clobbers = true;
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irInstr* instr = vectorGet(&block->instrs, j);
+
+            if (instr->tag == instrCallIndirect || instr->tag == instrRepStos)
+                ctx->clobbers = true;
+
+            else if (!irInstrWritesDest(instr))
+                continue;
+
+            else if (instr->dest.tag == operandMem || instr->dest.tag == operandLabelMem)
+                vectorPush(&ctx->stores, &instr->dest);
+
+            else if (instr->dest.tag == operandReg)
+                intsetAdd(&ctx->written, (intptr_t) instr->dest.base);
+        }
+    }
+}
+
+static int licmLoop (irCtx* ir, irFn* fn, irLoop* loop, int wordsize) {
+    licmCtx ctx = {.ir = ir, .fn = fn, .wordsize = wordsize,
+                   .frameEscapes = irFnTakesFrameAddress(fn), .loop = loop};
+
+    intsetInit(&ctx.liveIn, 16);
+    intmapInit(&ctx.sizes, 64);
+    intsetInit(&ctx.liveOut, 16);
+    vectorInit(&ctx.groups, 4);
+    vectorInit(&ctx.groupRegs, 4);
+    vectorInit(&ctx.stores, 8);
+    intsetInit(&ctx.written, 32);
+    intsetInit(&ctx.hoisted, 8);
+    vectorInit(&ctx.loads, 4);
+    vectorInit(&ctx.loadRegs, 4);
+
+    irLiveness live;
+    irLivenessInit(&live, fn, wordsize);
+
+    for (int i = 0; i < live.regs.length; i++) {
+        reg* r = vectorGet(&live.regs, i);
+        intmapAdd(&ctx.sizes, (intptr_t) r, (void*)(intptr_t) live.sizes[i]);
+
+        if (bitarrayTest(&live.flow.in[loop->header->nthChild], i))
+            intsetAdd(&ctx.liveIn, (intptr_t) r);
+    }
+
+    for (int i = 0; i < loop->blocks.length; i++) {
+        const irBlock* block = vectorGet(&loop->blocks, i);
+
+        for (int j = 0; j < block->succs.length; j++) {
+            const irBlock* succ = vectorGet(&block->succs, j);
+
+            if (loop->contains[succ->nthChild])
+                continue;
+
+            for (int k = 0; k < live.regs.length; k++)
+                if (bitarrayTest(&live.flow.in[succ->nthChild], k))
+                    intsetAdd(&ctx.liveOut, (intptr_t) vectorGet(&live.regs, k));
+        }
+    }
+
+    irLivenessFree(&live);
+
+    licmFindWrites(&ctx);
+
+    /*Registers, until no more become invariant*/
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 0; i < loop->blocks.length; i++) {
+            irBlock* block = vectorGet(&loop->blocks, i);
+
+            for (int j = 0; j < block->instrs.length; j++) {
+                const irInstr* instr = vectorGet(&block->instrs, j);
+
+                bool candidate =    irInstrWritesDest(instr) && instr->dest.tag == operandReg
+                                 && !regGetIndex(instr->dest.base);
+
+                /*Anything after it has moved up*/
+                if (candidate && licmHoistReg(&ctx, block, j)) {
+                    changed = true;
+                    j--;
+                }
+            }
+        }
+    }
+
+    /*Then the loads left in the second operand*/
+
+    for (int i = 0; i < loop->blocks.length; i++) {
+        const irBlock* block = vectorGet(&loop->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irInstr* instr = vectorGet(&block->instrs, j);
+
+            if (instr->tag == instrCompare) {
+                licmHoistLoad(&ctx, block, &instr->l);
+                licmHoistLoad(&ctx, block, &instr->r);
+
+            } else if (instr->tag == instrBOP && !operandIsEqual(instr->dest, instr->r))
+                licmHoistLoad(&ctx, block, &instr->r);
+        }
+    }
+
+    intsetFree(&ctx.liveIn);
+    intmapFree(&ctx.sizes);
+    intsetFree(&ctx.liveOut);
+    vectorFreeObjs(&ctx.groups, (vectorDtor) vectorFree);
+    vectorFree(&ctx.groupRegs);
+    vectorFree(&ctx.stores);
+    intsetFree(&ctx.written);
+    intsetFree(&ctx.hoisted);
+    vectorFree(&ctx.loads);
+    vectorFree(&ctx.loadRegs);
+
+    return ctx.hoistedNo;
+}
@@ -0,0 +1,616 @@
+#include "../inc/ir.h"
+
+#include "../inc/vector.h"
+#include "../inc/hashmap.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+#include "../inc/architecture.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "limits.h"
+
+/*Local value numbering, a block at a time.
+
+  Walking a block in order, every value an instruction reads or computes is
+  given a number, the same for two values only if they are known to be
+  equal: the same literal, the same operation on the same numbers, or a load
+  of the same address (by the numbers of the registers forming it) with no
+  write in between that may have changed it. A store gives what it wrote
+  the number of the value stored, so a later load of it gets that too. An
+  operation on literals is numbered as the literal it gives, so one that a
+  load forwarded literals into still folds.
+
+  An instruction computing a number still held by some virtual register
+  becomes a move from it (or of the literal, if that's what it is), and a
+  read of a register becomes a read of the first register given its number,
+  while that still holds it. The instructions this leaves unread are then
+  removed.
+
+  A write to memory invalidates the loads it may alias:
+    - Addresses off the same registers alias only if their bytes overlap,
+      so a[i].x and a[i].y don't.
+    - Stack slots, off the frame pointer, can't be reached any other way
+      unless the fn takes the address of one.
+    - Globals alias only themselves, and pointers.
+  Anything else may alias anything. An indirect call (direct ones end the
+  block) or a rep stos may write anything a pointer can reach.
+
+  Physical registers other than the frame pointer aren't followed, every
+  read of one is a new number.*/
+
+typedef struct lvnAddress {
+    ///operandMem or operandLabelMem
+    operandTag tag;
+    ///Value numbers of the registers, -1 if none
+    int base, index;
+    int factor, offset;
+    const char* label;
+    ///Off the frame pointer, a local or parameter
+    bool frame;
+} lvnAddress;
+
+typedef enum lvnExprTag {
+    exprLiteral,
+    exprLabel,
+    exprAddress,
+    exprLoad,
+    exprBOP,
+    exprUOP,
+    exprZeroExt,
+    exprSignExt
+} lvnExprTag;
+
+typedef struct lvnExpr {
+    lvnExprTag tag;
+    int size;
+
+    ///exprLiteral
+    int literal;
+    ///exprLabel
+    const char* label;
+    ///exprAddress exprLoad
+    lvnAddress addr;
+    ///exprBOP exprUOP: the operation; and the value numbers of the operands
+    int op, l, r;
+
+    ///The value number it was given
+    int value;
+    ///exprLoad: memory written since may have changed it
+    bool killed;
+    ///The next with the same hash
+    struct lvnExpr* next;
+} lvnExpr;
+
+typedef struct lvnReg {
+    ///The value number a virtual register holds, and the size it is known at
+    int value, size;
+} lvnReg;
+
+typedef struct lvnCtx {
+    int wordsize;
+    ///Does the fn take the address of a stack slot
+    bool frameEscapes;
+
+    ///All the expressions of the block, and those by hash
+    vector/*<lvnExpr*>*/ exprs;
+    intmap/*<lvnExpr*>*/ table;
+    ///The loads not yet killed
+    vector/*<lvnExpr*>*/ loads;
+
+    ///By value number: the expression first given it (null if none), and
+    ///the register to read it from (if it still holds it)
+    vector/*<const lvnExpr*>*/ defs;
+    vector/*<reg*>*/ holders;
+
+    intmap/*<lvnReg*>*/ regs;
+    vector/*<lvnReg*>*/ regRecords;
+
+    int frameValue;
+
+    int reusedNo, constantNo, substitutedNo;
+} lvnCtx;
+
+static void lvnFn (irFn* fn, int wordsize);
+static void lvnBlock (lvnCtx* ctx, irBlock* block);
+
+void irValueNumbering (irCtx* ctx) {
+    for (int i = 0; i < ctx->fns.length; i++)
+        lvnFn(vectorGet(&ctx->fns, i), ctx->arch->wordsize);
+}
+
+static void lvnFn (irFn* fn, int wordsize) {
+    debugEnter(fn->name);
+
+    lvnCtx ctx = {.wordsize = wordsize, .frameEscapes = irFnTakesFrameAddress(fn)};
+
+    for (int i = 0; i < fn->blocks.length; i++)
+        lvnBlock(&ctx, vectorGet(&fn->blocks, i));
+
+    int deadNo = 0;
+
+    if (ctx.reusedNo || ctx.constantNo || ctx.substitutedNo)
+        deadNo = irFnDeleteDeadInstrs(fn, wordsize);
+
+    debugMsg("%s: %d values reused, %d constants, %d reads replaced and %d instructions removed",
+             fn->name, ctx.reusedNo, ctx.constantNo, ctx.substitutedNo, deadNo);
+
+    debugLeave();
+}
+
+/*==== Value numbers ====*/
+
+static int lvnFresh (lvnCtx* ctx, const lvnExpr* def) {
+    vectorPush(&ctx->defs, (void*) def);
+    return vectorPush(&ctx->holders, 0);
+}
+
+static lvnReg* lvnGetReg (const lvnCtx* ctx, const reg* r) {
+    return intmapMap(&ctx->regs, (intptr_t) r);
+}
+
+/*The register to read a value from at a size, if one still holds it*/
+static reg* lvnGetHolder (const lvnCtx* ctx, int value, int size) {
+    reg* holder = vectorGet(&ctx->holders, value);
+
+    if (!holder)
+        return 0;
+
+    const lvnReg* record = lvnGetReg(ctx, holder);
+    return record->value == value && record->size == size ? holder : 0;
+}
+
+static void lvnRegSetValue (lvnCtx* ctx, reg* r, int value, int size) {
+    lvnReg* record = lvnGetReg(ctx, r);
+
+    if (!record) {
+        record = malloc(sizeof(lvnReg));
+        intmapAdd(&ctx->regs, (intptr_t) r, record);
+        vectorPush(&ctx->regRecords, record);
+    }
+
+    bool held = lvnGetHolder(ctx, value, size) != 0;
+
+    *record = (lvnReg) {value, size};
+
+    if (!held)
+        vectorSet(&ctx->holders, value, r);
+}
+
+static int lvnRegGetValue (lvnCtx* ctx, reg* r, int size) {
+    if (regGetIndex(r))
+        return r == &regs[regRBP] ? ctx->frameValue : lvnFresh(ctx, 0);
+
+    const lvnReg* record = lvnGetReg(ctx, r);
+
+    if (record && record->size == size)
+        return record->value;
+
+    /*Written before the block, or at another size*/
+    int value = lvnFresh(ctx, 0);
+    lvnRegSetValue(ctx, r, value, size);
+    return value;
+}
+
+/*==== Expressions ====*/
+
+static intptr_t lvnExprHash (const lvnExpr* expr) {
+    int fields[] = {expr->tag, expr->size, expr->literal, expr->op, expr->l, expr->r,
+                    expr->addr.tag, expr->addr.base, expr->addr.index,
+                    expr->addr.factor, expr->addr.offset};
+
+    uintptr_t hash = 0;
+
+    for (unsigned i = 0; i < sizeof(fields)/sizeof(*fields); i++)
+        hash = hash*31 + (unsigned) fields[i];
+
+    const char* label = expr->label ? expr->label : expr->addr.label;
+
+    for (int i = 0; label && label[i]; i++)
+        hash = hash*31 + (unsigned char) label[i];
+
+    /*Zero marks an empty slot in an intmap*/
+    return hash ? (intptr_t) hash : 1;
+}
+
+static bool lvnLabelIsEqual (const char* l, const char* r) {
+    return l == r || (l && r && !strcmp(l, r));
+}
+
+static bool lvnAddressIsEqual (const lvnAddress* l, const lvnAddress* r) {
+    return    l->tag == r->tag && l->base == r->base && l->index == r->index
+           && l->factor == r->factor && l->offset == r->offset
+           && lvnLabelIsEqual(l->label, r->label);
+}
+
+static bool lvnExprIsEqual (const lvnExpr* l, const lvnExpr* r) {
+    return    l->tag == r->tag && l->size == r->size && l->literal == r->literal
+           && l->op == r->op && l->l == r->l && l->r == r->r
+           && lvnLabelIsEqual(l->label, r->label) && lvnAddressIsEqual(&l->addr, &r->addr);
+}
+
+/*Add an expression as having a value number, or if given -1, a new one*/
+static int lvnExprAdd (lvnCtx* ctx, lvnExpr expr, int value) {
+    lvnExpr* added = malloc(sizeof(lvnExpr));
+    *added = expr;
+
+    intptr_t hash = lvnExprHash(added);
+    added->next = intmapMap(&ctx->table, hash);
+    added->value = value >= 0 ? value : lvnFresh(ctx, added);
+
+    intmapAdd(&ctx->table, hash, added);
+    vectorPush(&ctx->exprs, added);
+
+    if (added->tag == exprLoad)
+        vectorPush(&ctx->loads, added);
+
+    return added->value;
+}
+
+static int lvnExprGetValue (lvnCtx* ctx, lvnExpr expr) {
+    for (const lvnExpr* found = intmapMap(&ctx->table, lvnExprHash(&expr));
+         found;
+         found = found->next) {
+        if (!found->killed && lvnExprIsEqual(found, &expr))
+            return found->value;
+    }
+
+    return lvnExprAdd(ctx, expr, -1);
+}
+
+static lvnAddress lvnOperandGetAddress (lvnCtx* ctx, const operand* Value) {
+    lvnAddress addr = {.tag = Value->tag, .base = -1, .index = -1};
+
+    if (Value->tag == operandLabelMem) {
+        addr.label = Value->label;
+        return addr;
+    }
+
+    if (Value->base)
+        addr.base = lvnRegGetValue(ctx, Value->base, ctx->wordsize);
+
+    if (Value->index) {
+        addr.index = lvnRegGetValue(ctx, Value->index, ctx->wordsize);
+        addr.factor = Value->factor;
+    }
+
+    addr.offset = Value->offset;
+    addr.frame = Value->base == &regs[regRBP];
+    return addr;
+}
+
+/*The value number of what an operand reads. Literals are numbered by the
+  size they are read at, as they have none of their own.*/
+static int lvnOperandGetValue (lvnCtx* ctx, const operand* Value, int size) {
+    if (Value->tag == operandLiteral)
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprLiteral, .size = size,
+                                               .literal = Value->literal});
+
+    else if (Value->tag == operandLabelOffset)
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprLabel, .label = Value->label});
+
+    else if (Value->tag == operandReg)
+        return lvnRegGetValue(ctx, Value->base, Value->size);
+
+    else if (Value->tag == operandMem || Value->tag == operandLabelMem)
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprLoad, .size = Value->size,
+                                               .addr = lvnOperandGetAddress(ctx, Value)});
+
+    else
+        return lvnFresh(ctx, 0);
+}
+
+/*==== Memory ====*/
+
+static bool lvnMayAlias (const lvnCtx* ctx, const lvnAddress* l, int lSize,
+                         const lvnAddress* r, int rSize) {
+    if (l->tag == operandLabelMem && r->tag == operandLabelMem)
+        return lvnLabelIsEqual(l->label, r->label);
+
+    bool sameRegs =    l->tag == operandMem && r->tag == operandMem
+                    && l->base == r->base && l->index == r->index && l->factor == r->factor;
+
+    if (sameRegs)
+        return l->offset < r->offset + rSize && r->offset < l->offset + lSize;
+
+    else if (l->frame && r->frame)
+        return true;
+
+    else if (l->frame || r->frame) {
+        const lvnAddress* other = l->frame ? r : l;
+        return other->tag != operandLabelMem && ctx->frameEscapes;
+    }
+
+    return true;
+}
+
+/*Kill the loads that a write to an address may change, or if null, those
+  that anything a pointer reaches may*/
+static void lvnInvalidate (lvnCtx* ctx, const lvnAddress* addr, int size) {
+    int kept = 0;
+
+    for (int i = 0; i < ctx->loads.length; i++) {
+        lvnExpr* load = vectorGet(&ctx->loads, i);
+
+        bool killed = addr ? lvnMayAlias(ctx, &load->addr, load->size, addr, size)
+                           : !load->addr.frame || ctx->frameEscapes;
+
+        if (killed)
+            load->killed = true;
+
+        else
+            vectorSet(&ctx->loads, kept++, load);
+    }
+
+    while (ctx->loads.length > kept)
+        vectorPop(&ctx->loads);
+}
+
+/*==== Instructions ====*/
+
+/*Read each register from the first to hold its value*/
+static void lvnSubstitute (lvnCtx* ctx, irInstr* instr) {
+    /*In a two operand form, l is the dest and stays so*/
+    bool tied =    (instr->tag == instrBOP || instr->tag == instrUOP)
+                && operandIsEqual(instr->dest, instr->l);
+
+    irRegUse uses[irInstrMaxRegs];
+    int useNo = irInstrGetRegs(instr, ctx->wordsize, uses);
+
+    for (int i = 0; i < useNo; i++) {
+        irRegUse use = uses[i];
+
+        bool inL = use.where == &instr->l.base || use.where == &instr->l.index;
+
+        if (use.written || (tied && inL))
+            continue;
+
+        const lvnReg* record = lvnGetReg(ctx, *use.where);
+
+        if (!record || record->size != use.size)
+            continue;
+
+        reg* holder = lvnGetHolder(ctx, record->value, use.size);
+
+        if (holder && holder != *use.where) {
+            *use.where = holder;
+            ctx->substitutedNo++;
+        }
+    }
+
+    if (tied)
+        instr->l = instr->dest;
+}
+
+/*Replace a load with a register holding its value, or the literal it is*/
+static void lvnFoldLoad (lvnCtx* ctx, operand* Value) {
+    if (Value->tag != operandMem && Value->tag != operandLabelMem)
+        return;
+
+    int value = lvnOperandGetValue(ctx, Value, Value->size);
+    reg* holder = lvnGetHolder(ctx, value, Value->size);
+    const lvnExpr* def = vectorGet(&ctx->defs, value);
+
+    if (holder) {
+        int size = Value->size;
+        *Value = operandCreateReg(holder);
+        Value->size = size;
+
+    } else if (def && def->tag == exprLiteral)
+        *Value = operandCreateLiteral(def->literal);
+
+    else
+        return;
+
+    ctx->substitutedNo++;
+}
+
+/*Sign extend the low size bytes of a value*/
+static int64_t lvnTruncate (uint64_t value, int size) {
+    if (size >= 8)
+        return (int64_t) value;
+
+    uint64_t mask = ((uint64_t) 1 << size*8) - 1,
+             sign = (uint64_t) 1 << (size*8 - 1);
+
+    value &= mask;
+    return value & sign ? -(int64_t) ((~value & mask) + 1) : (int64_t) value;
+}
+
+/*The literal an operation on the values numbered l and r gives, if they are
+  both literals and it fits an immediate. r is ignored by unary ones.*/
+static bool lvnFold (const lvnCtx* ctx, const irInstr* instr, int l, int r, int size,
+                     int* result) {
+    const lvnExpr *lDef = vectorGet(&ctx->defs, l),
+                  *rDef = instr->tag == instrBOP ? vectorGet(&ctx->defs, r) : lDef;
+
+    if (   !lDef || lDef->tag != exprLiteral || !rDef || rDef->tag != exprLiteral
+        || size <= 0 || size > 8)
+        return false;
+
+    int64_t sl = lvnTruncate((uint64_t) (int64_t) lDef->literal, size);
+    uint64_t ul = sl, ur = (uint64_t) (int64_t) rDef->literal;
+    int shift = (int) (ur & (size == 8 ? 63 : 31));
+    uint64_t folded;
+
+    if (instr->tag == instrUOP) {
+        if (instr->uop == uopUndefined)
+            return false;
+
+        folded = instr->uop == uopInc ? ul + 1 :
+                 instr->uop == uopDec ? ul - 1 :
+                 instr->uop == uopNeg ? -ul :
+                 /*uopBitwiseNot*/ ~ul;
+
+    } else {
+        if (instr->bop == bopUndefined)
+            return false;
+
+        folded = instr->bop == bopAdd ? ul + ur :
+                 instr->bop == bopSub ? ul - ur :
+                 instr->bop == bopMul ? ul * ur :
+                 instr->bop == bopBitAnd ? ul & ur :
+                 instr->bop == bopBitOr ? ul | ur :
+                 instr->bop == bopBitXor ? ul ^ ur :
+                 instr->bop == bopShL ? ul << shift :
+                 /*bopShR, arithmetic like sar*/
+                 (uint64_t) (sl < 0 ? ~(~sl >> shift) : sl >> shift);
+    }
+
+    int64_t value = lvnTruncate(folded, size);
+
+    if (value < INT_MIN || value > INT_MAX)
+        return false;
+
+    *result = (int) value;
+    return true;
+}
+
+/*The value number of what an instruction writes to its dest, if it only
+  depends on what it reads, otherwise -1*/
+static int lvnInstrGetValue (lvnCtx* ctx, const irInstr* instr) {
+    int size = instr->dest.size;
+
+    if (instr->tag == instrMove)
+        return lvnOperandGetValue(ctx, &instr->l, size);
+
+    else if (instr->tag == instrMoveZeroExt || instr->tag == instrMoveSignExt) {
+        int l = lvnOperandGetValue(ctx, &instr->l, instr->l.size);
+        return lvnExprGetValue(ctx, (lvnExpr) {
+            .tag = instr->tag == instrMoveZeroExt ? exprZeroExt : exprSignExt,
+            .size = size, .l = l});
+
+    } else if (instr->tag == instrEvalAddress)
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprAddress, .size = size,
+                                               .addr = lvnOperandGetAddress(ctx, &instr->l)});
+
+    else if (instr->tag == instrBOP) {
+        int l = lvnOperandGetValue(ctx, &instr->l, size),
+            r = lvnOperandGetValue(ctx, &instr->r, size);
+
+        bool commutative =    instr->bop == bopAdd || instr->bop == bopMul
+                           || instr->bop == bopBitAnd || instr->bop == bopBitOr
+                           || instr->bop == bopBitXor;
+
+        int folded;
+
+        if (lvnFold(ctx, instr, l, r, size, &folded))
+            return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprLiteral, .size = size,
+                                                   .literal = folded});
+
+        if (commutative && l > r) {
+            int tmp = l;
+            l = r;
+            r = tmp;
+        }
+
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprBOP, .size = size, .op = instr->bop,
+                                               .l = l, .r = r});
+
+    } else if (instr->tag == instrUOP) {
+        int l = lvnOperandGetValue(ctx, &instr->l, size), folded;
+
+        if (lvnFold(ctx, instr, l, l, size, &folded))
+            return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprLiteral, .size = size,
+                                                   .literal = folded});
+
+        return lvnExprGetValue(ctx, (lvnExpr) {.tag = exprUOP, .size = size, .op = instr->uop,
+                                               .l = l});
+
+    } else
+        return -1;
+}
+
+/*Replace an instruction computing a value already held with a move of it*/
+static void lvnReplace (lvnCtx* ctx, irBlock* block, int n, irInstr* instr, int value) {
+    bool replaceable =    (   instr->tag == instrMove && instr->l.tag != operandReg
+                           && instr->l.tag != operandLiteral)
+                       || instr->tag == instrMoveZeroExt || instr->tag == instrMoveSignExt
+                       || instr->tag == instrEvalAddress
+                       || (   (instr->tag == instrBOP || instr->tag == instrUOP)
+                           && !irBlockFlagsRead(block, n));
+
+    if (!replaceable)
+        return;
+
+    reg* holder = lvnGetHolder(ctx, value, instr->dest.size);
+    const lvnExpr* def = vectorGet(&ctx->defs, value);
+
+    if (holder && holder != instr->dest.base) {
+        instr->l = operandCreateReg(holder);
+        instr->l.size = instr->dest.size;
+        ctx->reusedNo++;
+
+    } else if (def && def->tag == exprLiteral) {
+        instr->l = operandCreateLiteral(def->literal);
+        ctx->constantNo++;
+
+    } else
+        return;
+
+    instr->tag = instrMove;
+    instr->r = operandCreate(operandUndefined);
+}
+
+static void lvnInstr (lvnCtx* ctx, irBlock* block, int n) {
+    irInstr* instr = vectorGet(&block->instrs, n);
+
+    if (instr->tag == instrTakeReg || instr->tag == instrGiveBackReg)
+        return;
+
+    lvnSubstitute(ctx, instr);
+
+    /*Shifts take their count in CL*/
+    if (   instr->tag == instrCompare
+        || (instr->tag == instrBOP && instr->bop != bopShL && instr->bop != bopShR))
+        lvnFoldLoad(ctx, &instr->r);
+
+    int value = lvnInstrGetValue(ctx, instr);
+
+    operand dest = instr->dest;
+    bool writes = irInstrWritesDest(instr);
+
+    if (writes && (dest.tag == operandMem || dest.tag == operandLabelMem)) {
+        lvnAddress addr = lvnOperandGetAddress(ctx, &dest);
+        lvnInvalidate(ctx, &addr, dest.size);
+
+        if (instr->tag == instrMove)
+            lvnExprAdd(ctx, (lvnExpr) {.tag = exprLoad, .size = dest.size, .addr = addr}, value);
+
+    } else if (instr->tag == instrCallIndirect || instr->tag == instrRepStos)
+        lvnInvalidate(ctx, 0, 0);
+
+    else if (writes && dest.tag == operandReg && !regGetIndex(dest.base)) {
+        if (value >= 0)
+            lvnReplace(ctx, block, n, instr, value);
+
+        else
+            value = lvnFresh(ctx, 0);
+
+        lvnRegSetValue(ctx, dest.base, value, dest.size);
+    }
+}
+
+static void lvnBlock (lvnCtx* ctx, irBlock* block) {
+    vectorInit(&ctx->exprs, 64);
+    intmapInit(&ctx->table, 128);
+    vectorInit(&ctx->loads, 16);
+    vectorInit(&ctx->defs, 64);
+    vectorInit(&ctx->holders, 64);
+    intmapInit(&ctx->regs, 64);
+    vectorInit(&ctx->regRecords, 32);
+
+    ctx->frameValue = lvnFresh(ctx, 0);
+
+    for (int i = 0; i < block->instrs.length; i++)
+        lvnInstr(ctx, block, i);
+
+    vectorFreeObjs(&ctx->exprs, free);
+    intmapFree(&ctx->table);
+    vectorFree(&ctx->loads);
+    vectorFree(&ctx->defs);
+    vectorFree(&ctx->holders);
+    intmapFree(&ctx->regs);
+    vectorFreeObjs(&ctx->regRecords, free);
+}
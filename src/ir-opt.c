@@ -1,6 +1,9 @@
 #include "../inc/ir.h"
 
+#include "../inc/ir-dataflow.h"
 #include "../inc/hashmap.h"
+#include "../inc/bitarray.h"
+#include "../inc/reg.h"
 
 #include "stdio.h"
 
@@ -10,6 +13,8 @@ static bool blaBlock (irFn* fn, intset/*<irBlock*>*/* done, irBlock* block);
 static bool ubrBlock (irFn* fn, irBlock* block);
 static bool lbcBlock (irFn* fn, irBlock* block);
 
+static bool dceInstrIsRemovable (const irInstr* instr);
+
 /*Block Level Analysis (BLA) involves two optimizations:
     1. Unreachable Block Removal (UBR)
         - Blocks with no predecessors are removed.
@@ -60,8 +65,9 @@ static bool blaBlock (irFn* fn, intset/*<irBlock*>*/* done, irBlock* block) {
 }
 
 static bool ubrBlock (irFn* fn, irBlock* block) {
-    /*No predecessors => unreachable code => delete*/
-    if (irBlockGetPredNo(fn, block) == 0) {
+    /*No predecessors => unreachable code => delete
+      Except the epilogue of a fn that never returns, which it refers to*/
+    if (irBlockGetPredNo(fn, block) == 0 && block != fn->epilogue) {
         irBlockDelete(fn, block);
         return true;
     }
@@ -82,3 +88,57 @@ static bool lbcBlock (irFn* fn, irBlock* block) {
 
     return false;
 }
+
+/*==== Dead code ====*/
+
+static bool dceInstrIsRemovable (const irInstr* instr) {
+    return    instr->tag == instrMove || instr->tag == instrMoveZeroExt
+           || instr->tag == instrMoveSignExt || instr->tag == instrConditionalMove
+           || instr->tag == instrEvalAddress || instr->tag == instrBOP
+           || instr->tag == instrUOP;
+}
+
+/*Each removal can leave what it read dead too, so within a block they are
+  found walking back, and over the fn, until none are left.*/
+int irFnDeleteDeadInstrs (irFn* fn, int wordsize) {
+    int total = 0;
+
+    for (int removedNo = 1; removedNo;) {
+        removedNo = 0;
+
+        irLiveness live;
+        irLivenessInit(&live, fn, wordsize);
+
+        bitarray bits;
+        bitarrayInit(&bits, live.flow.bitno);
+
+        for (int i = 0; i < fn->blocks.length; i++) {
+            irBlock* block = vectorGet(&fn->blocks, i);
+
+            bitarrayCopy(&bits, &live.flow.out[block->nthChild]);
+
+            for (int j = block->instrs.length; j > 0; j--) {
+                irInstr* instr = vectorGet(&block->instrs, j-1);
+
+                bool dead =    dceInstrIsRemovable(instr)
+                            && instr->dest.tag == operandReg && !regGetIndex(instr->dest.base)
+                            && !bitarrayTest(&bits, irLivenessGetIndex(&live, instr->dest.base))
+                            && !(irInstrSetsFlags(instr) && irBlockFlagsRead(block, j-1));
+
+                if (dead) {
+                    irBlockRemoveInstr(block, j-1);
+                    removedNo++;
+
+                } else
+                    irLivenessTransfer(&live, instr, &bits);
+            }
+        }
+
+        bitarrayFree(&bits);
+        irLivenessFree(&live);
+
+        total += removedNo;
+    }
+
+    return total;
+}
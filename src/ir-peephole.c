@@ -0,0 +1,383 @@
+#include "../inc/ir-peephole.h"
+
+#include "../inc/ir.h"
+#include "../inc/vector.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+#include "../inc/architecture.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+
+/*Peephole optimization, once registers are allocated.
+
+  Each rule looks at the instruction at some position in a block, and
+  maybe those just after it, and if they match, rewrites them in place.
+  The rules are tried in the order of the table at each position, and when
+  one fires, the position steps back one so that what it left can be
+  matched again with the instruction before. Rules only ever look within a
+  block, so a register is only known to be dead where it is written again
+  before being read, later in the block.*/
+
+typedef struct peepCtx {
+    int wordsize;
+} peepCtx;
+
+/*Does it at the nth instruction of a block. The instructions at n and any
+  it looks at after are known to exist.*/
+typedef bool (*peepRuleFn)(const peepCtx* ctx, irBlock* block, int n);
+
+typedef struct peepRule {
+    irPeepholeRule rule;
+    const char* name;
+    ///Instructions looked at, from n
+    int window;
+    peepRuleFn apply;
+} peepRule;
+
+static bool peepMoveSelf (const peepCtx* ctx, irBlock* block, int n);
+static bool peepMoveBack (const peepCtx* ctx, irBlock* block, int n);
+static bool peepMoveOverwritten (const peepCtx* ctx, irBlock* block, int n);
+static bool peepMoveForward (const peepCtx* ctx, irBlock* block, int n);
+static bool peepPushPop (const peepCtx* ctx, irBlock* block, int n);
+static bool peepNoOp (const peepCtx* ctx, irBlock* block, int n);
+static bool peepCondMoveSame (const peepCtx* ctx, irBlock* block, int n);
+static bool peepSetCond (const peepCtx* ctx, irBlock* block, int n);
+
+static const peepRule peepRules[] = {
+    {peepholeMoveSelf, "mov-self", 1, peepMoveSelf},
+    {peepholeMoveBack, "mov-back", 2, peepMoveBack},
+    {peepholeMoveOverwritten, "mov-overwritten", 2, peepMoveOverwritten},
+    {peepholeMoveForward, "mov-forward", 2, peepMoveForward},
+    {peepholePushPop, "push-pop", 2, peepPushPop},
+    {peepholeNoOp, "no-op", 1, peepNoOp},
+    {peepholeCondMoveSame, "cmov-same", 2, peepCondMoveSame},
+    {peepholeSetCond, "cmov-setcc", 2, peepSetCond}
+};
+
+_Static_assert(sizeof(peepRules)/sizeof(*peepRules) == peepholeRuleNo,
+               "a peephole rule is missing from the table");
+
+static void peepBlock (const peepCtx* ctx, irBlock* block, irPeepholeStats* stats);
+
+void irPeephole (irCtx* ctx, irPeepholeStats* stats) {
+    peepCtx peep = {ctx->arch->wordsize};
+    irPeepholeStats local = {{0}};
+
+    for (int i = 0; i < ctx->fns.length; i++) {
+        irFn* fn = vectorGet(&ctx->fns, i);
+
+        for (int j = 0; j < fn->blocks.length; j++)
+            peepBlock(&peep, vectorGet(&fn->blocks, j), &local);
+    }
+
+    for (int i = 0; i < peepholeRuleNo; i++) {
+        if (local.fired[i])
+            debugMsg("peephole %s: %d", peepRules[i].name, local.fired[i]);
+
+        if (stats)
+            stats->fired[i] += local.fired[i];
+    }
+}
+
+void irPeepholePrintStats (const irPeepholeStats* stats) {
+    FILE* log = debugGetLog();
+    int total = 0;
+
+    for (int i = 0; i < peepholeRuleNo; i++) {
+        fprintf(log, "fcc: peephole %-16s %8d\n", peepRules[i].name, stats->fired[i]);
+        total += stats->fired[i];
+    }
+
+    fprintf(log, "fcc: peephole %-16s %8d\n", "total", total);
+}
+
+static void peepBlock (const peepCtx* ctx, irBlock* block, irPeepholeStats* stats) {
+    for (int n = 0; n < block->instrs.length;) {
+        bool fired = false;
+
+        for (int i = 0; i < peepholeRuleNo && !fired; i++) {
+            const peepRule* rule = &peepRules[i];
+
+            if (n + rule->window <= block->instrs.length && rule->apply(ctx, block, n)) {
+                stats->fired[rule->rule]++;
+                fired = true;
+            }
+        }
+
+        if (!fired)
+            n++;
+
+        else if (n > 0)
+            n--;
+    }
+}
+
+/*==== Helpers ====*/
+
+static irInstr* peepGet (const irBlock* block, int n) {
+    return vectorGet(&block->instrs, n);
+}
+
+static bool peepIsMem (operand Value) {
+    return Value.tag == operandMem || Value.tag == operandLabelMem;
+}
+
+static bool peepIsReg (operand Value) {
+    return Value.tag == operandReg;
+}
+
+/*Does the operand name a register, as itself or in an address*/
+static bool peepMentions (operand Value, const reg* r) {
+    if (Value.tag == operandReg)
+        return Value.base == r;
+
+    else if (Value.tag == operandMem)
+        return Value.base == r || Value.index == r;
+
+    return false;
+}
+
+static bool peepIsMove (const irInstr* instr) {
+    return instr->tag == instrMove && instr->l.tag != operandUndefined;
+}
+
+/*Is the instruction known not to read the register*/
+static bool peepInstrIgnores (const irInstr* instr, const reg* r) {
+    if (instr->tag == instrDivision)
+        return r != &regs[regRAX] && r != &regs[regRDX] && !peepMentions(instr->l, r);
+
+    else if (instr->tag == instrRepStos)
+        return r != &regs[regRAX] && r != &regs[regRCX] && r != &regs[regRDI];
+
+    else if (   instr->tag == instrCallIndirect || instr->tag == instrTakeReg
+             || instr->tag == instrGiveBackReg)
+        return false;
+
+    bool readsDest =    instr->tag == instrConditionalMove || instr->tag == instrSetCond
+                     || instr->tag == instrBOP || instr->tag == instrUOP;
+
+    return    !peepMentions(instr->l, r) && !peepMentions(instr->r, r)
+           && (peepIsMem(instr->dest) ? !peepMentions(instr->dest, r)
+                                      : !(readsDest && peepMentions(instr->dest, r)));
+}
+
+/*Is the register, as written at a size by the nth instruction, written
+  over later in the block before anything reads it*/
+static bool peepRegDeadAfter (const irBlock* block, int n, const reg* r, int size) {
+    /*Pushes, pops and calls read these without naming them*/
+    if (r == &regs[regRSP] || r == &regs[regRBP])
+        return false;
+
+    for (int i = n+1; i < block->instrs.length; i++) {
+        const irInstr* instr = peepGet(block, i);
+
+        if (!peepInstrIgnores(instr, r))
+            return false;
+
+        bool overwrites =    (   instr->tag == instrMove || instr->tag == instrMoveZeroExt
+                              || instr->tag == instrMoveSignExt || instr->tag == instrEvalAddress
+                              || instr->tag == instrPop)
+                          && instr->dest.tag == operandReg && instr->dest.base == r
+                          && instr->dest.size >= size;
+
+        if (overwrites)
+            return true;
+    }
+
+    /*It may be read in a succ*/
+    return false;
+}
+
+/*==== Rules ====*/
+
+static bool peepMoveSelf (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    const irInstr* instr = peepGet(block, n);
+
+    if (!peepIsMove(instr) || !operandIsEqual(instr->dest, instr->l) || instr->dest.size != instr->l.size)
+        return false;
+
+    irBlockRemoveInstr(block, n);
+    return true;
+}
+
+static bool peepMoveBack (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    const irInstr *first = peepGet(block, n),
+                  *second = peepGet(block, n+1);
+
+    bool match =    peepIsMove(first) && peepIsMove(second)
+                 && operandIsEqual(first->dest, second->l) && operandIsEqual(first->l, second->dest)
+                 && first->dest.size == first->l.size && second->dest.size == first->dest.size
+                 /*The first didn't change where the second moves to*/
+                 && !(peepIsReg(first->dest) && peepMentions(first->l, first->dest.base));
+
+    if (!match)
+        return false;
+
+    irBlockRemoveInstr(block, n+1);
+    return true;
+}
+
+static bool peepMoveOverwritten (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    const irInstr *first = peepGet(block, n),
+                  *second = peepGet(block, n+1);
+
+    if (!peepIsMove(first) || !peepIsReg(first->dest))
+        return false;
+
+    const reg* r = first->dest.base;
+
+    bool match =    (second->tag == instrMove || second->tag == instrMoveZeroExt
+                     || second->tag == instrMoveSignExt || second->tag == instrEvalAddress)
+                 && peepIsReg(second->dest) && second->dest.base == r
+                 && second->dest.size >= first->dest.size
+                 && !peepMentions(second->l, r);
+
+    if (!match)
+        return false;
+
+    irBlockRemoveInstr(block, n);
+    return true;
+}
+
+static bool peepMoveForward (const peepCtx* ctx, irBlock* block, int n) {
+    irInstr *first = peepGet(block, n),
+            *second = peepGet(block, n+1);
+
+    if (!peepIsMove(first) || !peepIsReg(first->dest))
+        return false;
+
+    const reg* r = first->dest.base;
+    int size = first->dest.size;
+
+    bool intoMove =    peepIsMove(second)
+                    && peepIsReg(second->l) && second->l.base == r && second->l.size == size
+                    && !peepMentions(second->dest, r)
+                    && !(peepIsMem(second->dest) && peepIsMem(first->l));
+
+    bool intoPush =    second->tag == instrPush
+                    && peepIsReg(second->l) && second->l.base == r
+                    && size == ctx->wordsize && second->l.size == size;
+
+    if (!(intoMove || intoPush) || !peepRegDeadAfter(block, n+1, r, size))
+        return false;
+
+    second->l = first->l;
+    irBlockRemoveInstr(block, n);
+    return true;
+}
+
+static bool peepPushPop (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    irInstr *push = peepGet(block, n),
+            *pop = peepGet(block, n+1);
+
+    if (push->tag != instrPush || pop->tag != instrPop)
+        return false;
+
+    /*Addresses relative to the stack pointer would move*/
+    const reg* sp = &regs[regRSP];
+
+    if (peepMentions(push->l, sp) || peepMentions(pop->dest, sp))
+        return false;
+
+    if (operandIsEqual(push->l, pop->dest)) {
+        irBlockRemoveInstr(block, n+1);
+        irBlockRemoveInstr(block, n);
+        return true;
+
+    } else if (   (peepIsMem(push->l) && peepIsMem(pop->dest))
+               || (push->l.tag != operandLiteral && push->l.size != pop->dest.size))
+        return false;
+
+    pop->tag = instrMove;
+    pop->l = push->l;
+    irBlockRemoveInstr(block, n);
+    return true;
+}
+
+static bool peepNoOp (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    irInstr* instr = peepGet(block, n);
+
+    if (instr->tag != instrBOP || instr->r.tag != operandLiteral)
+        return false;
+
+    int literal = instr->r.literal;
+    boperation bop = instr->bop;
+
+    bool identity =   bop == bopMul ? literal == 1
+                    : bop == bopAdd || bop == bopSub || bop == bopBitOr || bop == bopBitXor
+                      || bop == bopShL || bop == bopShR ? literal == 0
+                    : false;
+
+    if (!identity || irBlockFlagsRead(block, n))
+        return false;
+
+    /*imul dest, src, 1*/
+    if (!operandIsEqual(instr->dest, instr->l)) {
+        if (peepIsMem(instr->dest) && peepIsMem(instr->l))
+            return false;
+
+        instr->tag = instrMove;
+        instr->r = operandCreate(operandUndefined);
+
+    } else
+        irBlockRemoveInstr(block, n);
+
+    return true;
+}
+
+static bool peepCondMoveSame (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    const irInstr *move = peepGet(block, n),
+                  *cmov = peepGet(block, n+1);
+
+    bool match =    peepIsMove(move) && cmov->tag == instrConditionalMove
+                 && operandIsEqual(move->dest, cmov->dest)
+                 && (move->l.tag == operandLiteral || move->l.tag == operandReg)
+                 && operandIsEqual(move->l, cmov->l) && move->l.size == cmov->l.size;
+
+    if (!match)
+        return false;
+
+    irBlockRemoveInstr(block, n+1);
+    return true;
+}
+
+static bool peepSetCond (const peepCtx* ctx, irBlock* block, int n) {
+    (void) ctx;
+    irInstr *move = peepGet(block, n),
+            *cmov = peepGet(block, n+1);
+
+    bool match =    peepIsMove(move) && cmov->tag == instrConditionalMove
+                 && operandIsEqual(move->dest, cmov->dest)
+                 && move->l.tag == operandLiteral && move->l.literal == 0
+                 && cmov->l.tag == operandLiteral && cmov->l.literal == 1
+                 /*Only some registers have a byte to set*/
+                 && (peepIsMem(cmov->dest) || (peepIsReg(cmov->dest) && regGetName(cmov->dest.base, 1)));
+
+    if (!match)
+        return false;
+
+    /*mov doesn't touch the flags, so it can stay before, setting the rest
+      of the register to zero. Unless there is no rest.*/
+
+    bool whole = cmov->dest.size == 1;
+
+    cmov->tag = instrSetCond;
+    cmov->dest.size = 1;
+    cmov->l = operandCreate(operandUndefined);
+
+    free(cmov->label);
+    cmov->label = 0;
+
+    if (whole)
+        irBlockRemoveInstr(block, n);
+
+    return true;
+}
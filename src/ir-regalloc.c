@@ -0,0 +1,710 @@
+#include "../inc/ir.h"
+
+#include "../inc/vector.h"
+#include "../inc/hashmap.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+#include "../inc/architecture.h"
+#include "../inc/asm-amd64.h"
+
+#include "stdlib.h"
+
+/*Linear scan register allocation, after Poletto & Sarkar.
+
+  The emitter gives instructions virtual registers (from regAlloc), and
+  brackets any use it makes of a particular physical register with
+  instrTakeReg and instrGiveBackReg. Instructions are numbered through the
+  function in the order the blocks will be emitted, terminals included, and
+  gap n is the point just before instruction n. A virtual register first
+  named at instruction s and last named at e is live in gaps s+1 to e (at
+  least s+1, as even if never read, its register is written). Gaps are
+  stretched over any loop that a register is live into. Then the intervals
+  are given registers in order of where they start, and those that don't
+  fit are spilled, and the instructions are rewritten with the registers
+  chosen.*/
+
+typedef struct raInterval raInterval;
+
+typedef struct raInterval {
+    reg* vreg;
+    ///Order first seen in
+    int n;
+    ///First and last gaps where it is live
+    int from, to;
+    ///Smallest size it is named at, ruling out some registers
+    int size;
+
+    ///The other side of a move, if it's a physical or virtual register
+    regIndex hint;
+    raInterval* hintInterval;
+
+    ///Register assigned, unless spilled
+    regIndex r;
+    bool spilled;
+
+    ///Rematerialized if only ever set to a constant by a single instruction
+    int writes;
+    bool isConstant;
+    int constant;
+    const irInstr* def;
+
+    ///If spilled (and not rematerialized), the base pointer offset of its slot
+    int offset;
+} raInterval;
+
+/*A virtual register named by an instruction*/
+typedef struct raMention {
+    raInterval* interval;
+    ///Where in the instruction's operands, to be replaced
+    reg** where;
+    int size;
+    bool read, written;
+} raMention;
+
+typedef struct raCtx {
+    irCtx* ir;
+    const architecture* arch;
+    irFn* fn;
+
+    vector/*<irBlock*>*/ order;
+    ///First instruction of each block and its terminal, by nthChild
+    int *blockStarts, *blockEnds;
+
+    intmap/*<raInterval*>*/ intervals;
+    vector/*<raInterval*>*/ sorted;
+
+    ///Gaps where each physical register is taken, as pairs
+    vector/*<intptr_t>*/ fixed[regMax];
+    ///Intervals given each register, in order
+    vector/*<raInterval*>*/ assigned[regMax];
+    ///Candidates, in order of preference: scratch then callee save
+    regIndex candidates[regMax];
+    int candidateNo;
+    bool used[regMax];
+
+    int spillNo, borrowNo;
+} raCtx;
+
+static void raFn (irCtx* ir, irFn* fn);
+static int raIntervalCmp (const raInterval** l, const raInterval** r);
+
+static void raScan (raCtx* ctx);
+static void raScanInstr (raCtx* ctx, irInstr* instr, int n);
+static void raExtendOverLoops (raCtx* ctx);
+static void raAssign (raCtx* ctx);
+static void raRewrite (raCtx* ctx);
+static void raRewriteInstr (raCtx* ctx, irBlock* block, irInstr* instr, int n);
+static void raFrame (raCtx* ctx);
+
+/*==== Directives ====*/
+
+void irBlockTakeReg (irBlock* block, regIndex r) {
+    irInstrCreate(block, instrTakeReg, operandCreateReg(&regs[r]),
+                  operandCreate(operandUndefined), operandCreate(operandUndefined));
+}
+
+void irBlockGiveBackReg (irBlock* block, regIndex r) {
+    irInstrCreate(block, instrGiveBackReg, operandCreateReg(&regs[r]),
+                  operandCreate(operandUndefined), operandCreate(operandUndefined));
+}
+
+/*==== ====*/
+
+void irAllocRegs (irCtx* ctx) {
+    for (int i = 0; i < ctx->fns.length; i++)
+        raFn(ctx, vectorGet(&ctx->fns, i));
+}
+
+static void raFree (raCtx* ctx) {
+    vectorFree(&ctx->order);
+    free(ctx->blockStarts);
+    free(ctx->blockEnds);
+
+    intmapFree(&ctx->intervals);
+    vectorFreeObjs(&ctx->sorted, free);
+
+    for (regIndex r = 0; r < regMax; r++) {
+        vectorFree(&ctx->fixed[r]);
+        vectorFree(&ctx->assigned[r]);
+    }
+}
+
+static void raAddCandidates (raCtx* ctx, const vector/*<regIndex>*/* list) {
+    for (int i = 0; i < list->length; i++) {
+        regIndex r = (regIndex) vectorGet(list, i);
+
+        if (r >= regRAX && r <= regR15)
+            ctx->candidates[ctx->candidateNo++] = r;
+    }
+}
+
+static void raFn (irCtx* ir, irFn* fn) {
+    debugEnter(fn->name);
+
+    raCtx ctx = {.ir = ir, .arch = ir->arch, .fn = fn};
+
+    vectorInit(&ctx.order, fn->blocks.length);
+    irFnOrderBlocks(fn, &ctx.order);
+    ctx.blockStarts = calloc(fn->blocks.length, sizeof(int));
+    ctx.blockEnds = calloc(fn->blocks.length, sizeof(int));
+
+    intmapInit(&ctx.intervals, 64);
+    vectorInit(&ctx.sorted, 64);
+
+    for (regIndex r = 0; r < regMax; r++) {
+        vectorInit(&ctx.fixed[r], 4);
+        vectorInit(&ctx.assigned[r], 4);
+    }
+
+    raAddCandidates(&ctx, &ctx.arch->scratchRegs);
+    raAddCandidates(&ctx, &ctx.arch->calleeSaveRegs);
+
+    raScan(&ctx);
+    qsort(ctx.sorted.buffer, ctx.sorted.length, sizeof(void*),
+          (int (*)(const void*, const void*)) raIntervalCmp);
+    raExtendOverLoops(&ctx);
+    raAssign(&ctx);
+    raRewrite(&ctx);
+    raFrame(&ctx);
+
+    raFree(&ctx);
+
+    debugLeave();
+}
+
+/*==== Operands ====*/
+
+static bool raIsDirective (const irInstr* instr) {
+    return instr->tag == instrTakeReg || instr->tag == instrGiveBackReg;
+}
+
+/*Is the operand a virtual register, and if so which interval is it*/
+static raInterval* raOperandGetInterval (const raCtx* ctx, operand Value) {
+    if (Value.tag != operandReg || regGetIndex(Value.base))
+        return 0;
+
+    return intmapMap(&ctx->intervals, (intptr_t) Value.base);
+}
+
+/*Does the instruction name a physical register?*/
+static bool raInstrNamesReg (const irInstr* instr, regIndex r) {
+    const operand* operands[3] = {&instr->dest, &instr->l, &instr->r};
+
+    for (int n = 0; n < 3; n++) {
+        const operand* Value = operands[n];
+
+        if (Value->tag == operandReg && Value->base == &regs[r])
+            return true;
+
+        else if (Value->tag == operandMem && (Value->base == &regs[r] || Value->index == &regs[r]))
+            return true;
+    }
+
+    return false;
+}
+
+/*Find the virtual registers an instruction names, and what it does with them*/
+static int raInstrMentions (raCtx* ctx, irInstr* instr, raMention* mentions) {
+    irRegUse uses[irInstrMaxRegs];
+    int useNo = irInstrGetRegs(instr, ctx->arch->wordsize, uses);
+
+    for (int i = 0; i < useNo; i++) {
+        reg* vreg = *uses[i].where;
+        raInterval* interval = intmapMap(&ctx->intervals, (intptr_t) vreg);
+
+        if (!interval) {
+            interval = calloc(1, sizeof(raInterval));
+            interval->vreg = vreg;
+            interval->n = ctx->sorted.length;
+            interval->from = -1;
+            interval->size = uses[i].size;
+            intmapAdd(&ctx->intervals, (intptr_t) vreg, interval);
+            vectorPush(&ctx->sorted, interval);
+        }
+
+        /*Writing only part of the register keeps the rest*/
+        bool read = uses[i].read || (uses[i].written && uses[i].size < ctx->arch->wordsize);
+
+        mentions[i] = (raMention) {interval, uses[i].where, uses[i].size, read, uses[i].written};
+    }
+
+    return useNo;
+}
+
+/*==== Live intervals ====*/
+
+static void raAddFixed (raCtx* ctx, regIndex r, int from, int to) {
+    if (from > to)
+        return;
+
+    vectorPush(&ctx->fixed[r], (void*) (intptr_t) from);
+    vectorPush(&ctx->fixed[r], (void*) (intptr_t) to);
+    ctx->used[r] = true;
+}
+
+static void raScan (raCtx* ctx) {
+    /*Where each register was taken, and how many times over*/
+    int takenAt[regMax] = {0}, takes[regMax] = {0};
+
+    int n = 0;
+
+    for (int i = 0; i < ctx->order.length; i++) {
+        irBlock* block = vectorGet(&ctx->order, i);
+        ctx->blockStarts[block->nthChild] = n;
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irInstr* instr = vectorGet(&block->instrs, j);
+
+            if (instr->tag == instrTakeReg) {
+                regIndex r = regGetIndex(instr->dest.base);
+
+                if (takes[r]++ == 0)
+                    takenAt[r] = n;
+
+            } else if (instr->tag == instrGiveBackReg) {
+                regIndex r = regGetIndex(instr->dest.base);
+
+                /*Live up to the last instruction before the give*/
+                if (takes[r] > 0 && --takes[r] == 0)
+                    raAddFixed(ctx, r, takenAt[r], n);
+
+            } else
+                raScanInstr(ctx, instr, n++);
+        }
+
+        /*The terminal: a call clobbers the scratch registers*/
+        ctx->blockEnds[block->nthChild] = n;
+
+        if (   block->term
+            && (block->term->tag == termCall || block->term->tag == termCallIndirect))
+            for (int j = 0; j < ctx->arch->scratchRegs.length; j++) {
+                regIndex r = (regIndex) vectorGet(&ctx->arch->scratchRegs, j);
+                raAddFixed(ctx, r, n+1, n+1);
+            }
+
+        n++;
+    }
+
+    /*Never given back*/
+    for (regIndex r = 0; r < regMax; r++)
+        if (takes[r] > 0)
+            raAddFixed(ctx, r, takenAt[r], n);
+}
+
+static void raScanInstr (raCtx* ctx, irInstr* instr, int n) {
+    raMention mentions[irInstrMaxRegs];
+    int mentionNo = raInstrMentions(ctx, instr, mentions);
+
+    for (int i = 0; i < mentionNo; i++) {
+        raInterval* interval = mentions[i].interval;
+
+        if (interval->from < 0) {
+            interval->from = n+1;
+            interval->def = instr;
+        }
+
+        interval->to = max(n, interval->from);
+        interval->size = min(interval->size, mentions[i].size);
+
+        if (mentions[i].written) {
+            interval->writes++;
+            interval->isConstant =    instr->tag == instrMove && !mentions[i].read
+                                   && instr->l.tag == operandLiteral;
+            interval->constant = instr->l.literal;
+            interval->def = instr;
+        }
+    }
+
+    /*Moves between registers: try to give both sides the same one*/
+    if (instr->tag == instrMove) {
+        raInterval *dest = raOperandGetInterval(ctx, instr->dest),
+                   *src = raOperandGetInterval(ctx, instr->l);
+
+        if (dest && src) {
+            dest->hintInterval = src;
+            src->hintInterval = dest;
+
+        } else if (dest && instr->l.tag == operandReg)
+            dest->hint = regGetIndex(instr->l.base);
+
+        else if (src && instr->dest.tag == operandReg)
+            src->hint = regGetIndex(instr->dest.base);
+    }
+}
+
+static void raExtendOverLoops (raCtx* ctx) {
+    /*Anything live into the head of a loop lives until its back edge.
+      Repeated for nested loops.*/
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 0; i < ctx->order.length; i++) {
+            irBlock* block = vectorGet(&ctx->order, i);
+            int end = ctx->blockEnds[block->nthChild];
+
+            for (int j = 0; j < block->succs.length; j++) {
+                irBlock* head = vectorGet(&block->succs, j);
+                int start = ctx->blockStarts[head->nthChild];
+
+                int index = vectorFind(&ctx->order, head);
+
+                if (index < 0 || index > i)
+                    continue;
+
+                for (int k = 0; k < ctx->sorted.length; k++) {
+                    raInterval* interval = vectorGet(&ctx->sorted, k);
+
+                    if (interval->from <= start && interval->to >= start && interval->to <= end) {
+                        interval->to = end+1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*==== Assignment ====*/
+
+static int raIntervalCmp (const raInterval** l, const raInterval** r) {
+    return (*l)->from != (*r)->from ? (*l)->from - (*r)->from : (*l)->n - (*r)->n;
+}
+
+static bool raFixedOverlaps (const raCtx* ctx, regIndex r, int from, int to) {
+    for (int i = 0; i < ctx->fixed[r].length; i += 2) {
+        int fixedFrom = (intptr_t) vectorGet(&ctx->fixed[r], i),
+            fixedTo = (intptr_t) vectorGet(&ctx->fixed[r], i+1);
+
+        if (fixedFrom <= to && from <= fixedTo)
+            return true;
+    }
+
+    return false;
+}
+
+/*Could the register hold the interval, ignoring what it's already given to*/
+static bool raRegSuits (const raCtx* ctx, const raInterval* interval, regIndex r) {
+    return    r != regUndefined
+           && regGet(r)->size <= interval->size
+           && !raFixedOverlaps(ctx, r, interval->from, interval->to);
+}
+
+static raInterval* raRegHolder (const raCtx* ctx, regIndex r) {
+    return ctx->assigned[r].length ? vectorGet(&ctx->assigned[r], ctx->assigned[r].length-1) : 0;
+}
+
+static bool raRegFree (const raCtx* ctx, const raInterval* interval, regIndex r) {
+    const raInterval* holder = raRegHolder(ctx, r);
+    return raRegSuits(ctx, interval, r) && (!holder || holder->to < interval->from);
+}
+
+static void raGive (raCtx* ctx, raInterval* interval, regIndex r) {
+    interval->r = r;
+    vectorPush(&ctx->assigned[r], interval);
+    ctx->used[r] = true;
+}
+
+static regIndex raChoose (const raCtx* ctx, const raInterval* interval) {
+    /*The other side of a move, if possible*/
+    if (interval->hint && raRegFree(ctx, interval, interval->hint))
+        return interval->hint;
+
+    const raInterval* other = interval->hintInterval;
+
+    if (other && other->r && !other->spilled && raRegFree(ctx, interval, other->r))
+        return other->r;
+
+    /*Then scratch registers, then callee save registers already saved*/
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < ctx->candidateNo; i++) {
+            regIndex r = ctx->candidates[i];
+            bool scratch = i < ctx->arch->scratchRegs.length;
+
+            if ((pass == 1 || scratch || ctx->used[r]) && raRegFree(ctx, interval, r))
+                return r;
+        }
+    }
+
+    return regUndefined;
+}
+
+static bool raIsRemat (const raInterval* interval) {
+    return interval->writes == 1 && interval->isConstant;
+}
+
+static void raAssign (raCtx* ctx) {
+    for (int i = 0; i < ctx->sorted.length; i++) {
+        raInterval* interval = vectorGet(&ctx->sorted, i);
+        regIndex r = raChoose(ctx, interval);
+
+        if (r) {
+            raGive(ctx, interval, r);
+            continue;
+        }
+
+        /*Spill whichever of it and those it could displace lives the longest*/
+        raInterval* victim = 0;
+
+        for (int j = 0; j < ctx->candidateNo; j++) {
+            regIndex candidate = ctx->candidates[j];
+            raInterval* holder = raRegHolder(ctx, candidate);
+
+            if (   raRegSuits(ctx, interval, candidate)
+                && holder && (!victim || holder->to > victim->to))
+                victim = holder;
+        }
+
+        if (victim && victim->to > interval->to) {
+            vectorPop(&ctx->assigned[victim->r]);
+            victim->spilled = true;
+            raGive(ctx, interval, victim->r);
+
+        } else
+            interval->spilled = true;
+    }
+
+    /*Stack slots for the spilled, below the locals*/
+    for (int i = 0; i < ctx->sorted.length; i++) {
+        raInterval* interval = vectorGet(&ctx->sorted, i);
+
+        if (interval->spilled && !raIsRemat(interval))
+            interval->offset = -(ctx->fn->stacksize + ++ctx->spillNo*ctx->arch->wordsize);
+    }
+}
+
+/*==== Rewriting ====*/
+
+static operand raSlot (const raCtx* ctx, int offset) {
+    return operandCreateMem(&regs[regRBP], offset, ctx->arch->wordsize);
+}
+
+static operand raWordReg (const raCtx* ctx, regIndex r) {
+    operand R = operandCreateReg(&regs[r]);
+    R.size = ctx->arch->wordsize;
+    return R;
+}
+
+static void raMove (irBlock* block, operand dest, operand src) {
+    irInstrCreate(block, instrMove, dest, src, operandCreate(operandUndefined));
+}
+
+/*A register to load a spilled interval into for an instruction. Either one
+  that is free at the time, or failing that, one to borrow: any not named by
+  the instruction, to be saved and restored around it.*/
+static regIndex raFindTemp (const raCtx* ctx, const raInterval* interval, const irInstr* instr, int n,
+                            const raMention* mentions, int mentionNo, const bool* taken, bool borrow) {
+    for (int i = 0; i < ctx->candidateNo; i++) {
+        regIndex r = ctx->candidates[i];
+
+        if (   taken[r] || regGet(r)->size > interval->size
+            || raInstrNamesReg(instr, r) || raFixedOverlaps(ctx, r, n, n+1))
+            continue;
+
+        bool busy = false;
+
+        if (borrow) {
+            for (int j = 0; j < mentionNo; j++)
+                busy |= !mentions[j].interval->spilled && mentions[j].interval->r == r;
+
+        } else {
+            for (int j = 0; j < ctx->assigned[r].length; j++) {
+                const raInterval* other = vectorGet(&ctx->assigned[r], j);
+                busy |= other->from <= n+1 && other->to >= n;
+            }
+        }
+
+        if (!busy)
+            return r;
+    }
+
+    return regUndefined;
+}
+
+static void raRewrite (raCtx* ctx) {
+    int n = 0;
+
+    for (int i = 0; i < ctx->order.length; i++) {
+        irBlock* block = vectorGet(&ctx->order, i);
+
+        vector/*<irInstr*>*/ old = block->instrs;
+        vectorInit(&block->instrs, old.length+4);
+
+        for (int j = 0; j < old.length; j++) {
+            irInstr* instr = vectorGet(&old, j);
+
+            if (raIsDirective(instr))
+                irInstrDestroy(instr);
+
+            else
+                raRewriteInstr(ctx, block, instr, n++);
+        }
+
+        /*The terminal*/
+        n++;
+
+        vectorFree(&old);
+    }
+}
+
+static void raRewriteInstr (raCtx* ctx, irBlock* block, irInstr* instr, int n) {
+    raMention mentions[irInstrMaxRegs];
+    int mentionNo = raInstrMentions(ctx, instr, mentions);
+
+    int wordsize = ctx->arch->wordsize;
+
+    /*Registers for the spilled, by mention*/
+    regIndex temps[irInstrMaxRegs] = {0};
+    bool taken[regMax] = {0};
+
+    regIndex borrowed[irInstrMaxRegs];
+    int borrowNo = 0;
+
+    for (int i = 0; i < mentionNo; i++) {
+        raInterval* interval = mentions[i].interval;
+
+        if (!interval->spilled)
+            continue;
+
+        /*The constant is loaded wherever it's used instead*/
+        if (raIsRemat(interval) && interval->def == instr) {
+            irInstrDestroy(instr);
+            return;
+        }
+
+        for (int j = 0; j < i; j++)
+            if (mentions[j].interval == interval)
+                temps[i] = temps[j];
+
+        if (temps[i])
+            continue;
+
+        regIndex r = raFindTemp(ctx, interval, instr, n, mentions, mentionNo, taken, false);
+
+        if (!r) {
+            r = raFindTemp(ctx, interval, instr, n, mentions, mentionNo, taken, true);
+            borrowed[borrowNo++] = r;
+
+        } else
+            ctx->used[r] = true;
+
+        if (!r)
+            debugError("raRewriteInstr", "no register to load %s into",
+                       regGetName(interval->vreg, interval->size));
+
+        temps[i] = r;
+        taken[r] = true;
+    }
+
+    ctx->borrowNo = max(ctx->borrowNo, borrowNo);
+
+    /*Borrowed registers are kept in slots of their own meanwhile*/
+    for (int k = 0; k < borrowNo; k++) {
+        int offset = -(ctx->fn->stacksize + (ctx->spillNo+k+1)*wordsize);
+        raMove(block, raSlot(ctx, offset), raWordReg(ctx, borrowed[k]));
+    }
+
+    /*Load the spilled that are read*/
+    for (int i = 0; i < mentionNo; i++) {
+        raInterval* interval = mentions[i].interval;
+        bool first = true, read = false;
+
+        for (int j = 0; j < mentionNo; j++) {
+            if (mentions[j].interval == interval) {
+                first &= j >= i;
+                read |= mentions[j].read;
+            }
+        }
+
+        if (!interval->spilled || !temps[i] || !first || !read)
+            continue;
+
+        operand temp = raWordReg(ctx, temps[i]);
+
+        if (raIsRemat(interval))
+            raMove(block, temp, operandCreateLiteral(interval->constant));
+
+        else
+            raMove(block, temp, raSlot(ctx, interval->offset));
+    }
+
+    /*The instruction, with the registers put in*/
+
+    for (int i = 0; i < mentionNo; i++) {
+        raInterval* interval = mentions[i].interval;
+        *mentions[i].where = &regs[interval->spilled ? temps[i] : interval->r];
+    }
+
+    /*Moves from a register to itself are dropped*/
+    bool redundant =    instr->tag == instrMove
+                     && instr->dest.tag == operandReg && instr->l.tag == operandReg
+                     && instr->dest.base == instr->l.base && instr->dest.size == instr->l.size;
+
+    if (redundant)
+        irInstrDestroy(instr);
+
+    else
+        vectorPush(&block->instrs, instr);
+
+    /*Store the spilled that are written*/
+    for (int i = 0; i < mentionNo; i++) {
+        raInterval* interval = mentions[i].interval;
+        bool first = true, written = false;
+
+        for (int j = 0; j < mentionNo; j++) {
+            if (mentions[j].interval == interval) {
+                first &= j >= i;
+                written |= mentions[j].written;
+            }
+        }
+
+        if (interval->spilled && temps[i] && first && written && !raIsRemat(interval))
+            raMove(block, raSlot(ctx, interval->offset), raWordReg(ctx, temps[i]));
+    }
+
+    /*Give back the borrowed*/
+    for (int k = borrowNo; k > 0; k--) {
+        int offset = -(ctx->fn->stacksize + (ctx->spillNo+k)*wordsize);
+        raMove(block, raWordReg(ctx, borrowed[k-1]), raSlot(ctx, offset));
+    }
+}
+
+/*==== Frame ====*/
+
+static void raFrame (raCtx* ctx) {
+    irFn* fn = ctx->fn;
+
+    /*Only the callee save registers actually used need saving*/
+    vector/*<regIndex>*/ saved;
+    vectorInit(&saved, ctx->arch->calleeSaveRegs.length+1);
+
+    for (int i = 0; i < ctx->arch->calleeSaveRegs.length; i++) {
+        regIndex r = (regIndex) vectorGet(&ctx->arch->calleeSaveRegs, i);
+
+        if (ctx->used[r])
+            vectorPush(&saved, (void*) r);
+    }
+
+    int frameSize = fn->stacksize + (ctx->spillNo + ctx->borrowNo)*ctx->arch->wordsize;
+
+    /*Put the prologue in front of whatever the prologue block already has*/
+    vector/*<irInstr*>*/ instrs = fn->prologue->instrs;
+    vectorInit(&fn->prologue->instrs, instrs.length+saved.length+4);
+
+    asmFnPrologue(ctx->ir, fn->prologue, frameSize, &saved);
+
+    vectorPushFromVector(&fn->prologue->instrs, &instrs);
+    vectorFree(&instrs);
+
+    asmFnEpilogue(ctx->ir, fn->epilogue, &saved);
+
+    /*Tail calls leave the frame themselves*/
+    for (int i = 0; i < fn->blocks.length; i++) {
+        irBlock* block = vectorGet(&fn->blocks, i);
+
+        if (block->term && block->term->tag == termTailCall)
+            asmFnEpilogue(ctx->ir, block, &saved);
+    }
+
+    vectorFree(&saved);
+}
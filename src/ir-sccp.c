@@ -0,0 +1,576 @@
+#include "../inc/ir.h"
+
+#include "../inc/ir-ssa.h"
+#include "../inc/ir-dataflow.h"
+#include "../inc/vector.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+#include "../inc/operand.h"
+#include "../inc/architecture.h"
+
+#include "stdlib.h"
+#include "limits.h"
+
+/*Sparse conditional constant propagation, after Wegman & Zadeck.
+
+  Each SSA definition of a virtual register gets a value from the lattice
+  unknown > constant > varying, starting unknown, and each block and edge
+  starts unreachable. From the prologue, the reachable blocks are evaluated
+  (phis only meeting the values along reachable edges), and a branch whose
+  compare is of constants only makes the edge it takes reachable. A block
+  is evaluated again whenever a definition it reads changes, or another
+  edge into it is found, until nothing changes. Values only ever move down
+  the lattice, so this ends.
+
+  Then, in the reachable blocks, constant definitions become moves of the
+  constant, constant reads become the constant where the instruction
+  allows an immediate, branches known to go one way become jumps and their
+  compares are dropped. Unreachable blocks are deleted, and finally any
+  instruction defining a register that is never read is too.
+
+  Only virtual registers are covered. Locals live in stack slots, and
+  their loads are left alone.*/
+
+typedef enum sccpLevel {
+    ///Not yet seen to be given a value, so could still be anything
+    levelUnknown,
+    levelConstant,
+    ///Not known at compile time
+    levelVarying
+} sccpLevel;
+
+typedef struct sccpValue {
+    sccpLevel level;
+    ///levelConstant: sign extended from the size in bytes it is known at
+    int64_t constant;
+    int size;
+} sccpValue;
+
+typedef struct sccpCtx {
+    irFn* fn;
+    int wordsize;
+    irSSA ssa;
+
+    ///By definition number
+    sccpValue* values;
+
+    ///Blocks by nthChild, and edges into each block by the position of the
+    ///pred in block->preds, offset by edgeStarts[nthChild]
+    bool* executable;
+    int* edgeStarts;
+    bool* edges;
+
+    ///Blocks to be evaluated, once each at a time
+    vector/*<irBlock*>*/ worklist;
+    bool* queued;
+
+    int constantNo, branchNo, blockNo, deadNo;
+} sccpCtx;
+
+static void sccpFn (irFn* fn, int wordsize);
+static void sccpPropagate (sccpCtx* ctx);
+static void sccpRewrite (sccpCtx* ctx);
+static void sccpDeleteBlocks (sccpCtx* ctx);
+
+void irConstantPropagation (irCtx* ctx) {
+    for (int i = 0; i < ctx->fns.length; i++)
+        sccpFn(vectorGet(&ctx->fns, i), ctx->arch->wordsize);
+}
+
+static void sccpFn (irFn* fn, int wordsize) {
+    debugEnter(fn->name);
+
+    int blockNo = fn->blocks.length;
+
+    sccpCtx ctx = {.fn = fn, .wordsize = wordsize};
+    irSSAInit(&ctx.ssa, fn, wordsize);
+
+    ctx.values = malloc(max(ctx.ssa.defs.length, 1)*sizeof(sccpValue));
+
+    for (int i = 0; i < ctx.ssa.defs.length; i++) {
+        const irSSADef* def = vectorGet(&ctx.ssa.defs, i);
+        /*Parameters and the uninitialized*/
+        ctx.values[i] = (sccpValue) {def->tag == ssaEntry ? levelVarying : levelUnknown, 0, 0};
+    }
+
+    ctx.executable = calloc(blockNo, sizeof(bool));
+    ctx.queued = calloc(blockNo, sizeof(bool));
+    ctx.edgeStarts = malloc(blockNo*sizeof(int));
+
+    int edgeNo = 0;
+
+    for (int i = 0; i < blockNo; i++) {
+        const irBlock* block = vectorGet(&fn->blocks, i);
+        ctx.edgeStarts[i] = edgeNo;
+        edgeNo += block->preds.length;
+    }
+
+    ctx.edges = calloc(max(edgeNo, 1), sizeof(bool));
+    vectorInit(&ctx.worklist, 16);
+
+    sccpPropagate(&ctx);
+    sccpRewrite(&ctx);
+
+    irSSAFree(&ctx.ssa);
+    free(ctx.values);
+    free(ctx.queued);
+    free(ctx.edgeStarts);
+    free(ctx.edges);
+    vectorFree(&ctx.worklist);
+
+    /*Last, as it renumbers the blocks*/
+    sccpDeleteBlocks(&ctx);
+    free(ctx.executable);
+
+    ctx.deadNo += irFnDeleteDeadInstrs(fn, wordsize);
+
+    debugMsg("%s: %d constants, %d branches resolved, %d blocks and %d instructions removed",
+             fn->name, ctx.constantNo, ctx.branchNo, ctx.blockNo, ctx.deadNo);
+
+    debugLeave();
+}
+
+/*==== Values ====*/
+
+static sccpValue sccpVarying (void) {
+    return (sccpValue) {levelVarying, 0, 0};
+}
+
+/*Sign extend the low size bytes of a value*/
+static int64_t sccpTruncate (uint64_t value, int size) {
+    if (size >= 8)
+        return (int64_t) value;
+
+    uint64_t mask = ((uint64_t) 1 << size*8) - 1,
+             sign = (uint64_t) 1 << (size*8 - 1);
+
+    value &= mask;
+    return value & sign ? -(int64_t) ((~value & mask) + 1) : (int64_t) value;
+}
+
+static sccpValue sccpConstant (uint64_t value, int size) {
+    if (size <= 0 || size > 8)
+        return sccpVarying();
+
+    return (sccpValue) {levelConstant, sccpTruncate(value, size), size};
+}
+
+static bool sccpValueIsEqual (sccpValue l, sccpValue r) {
+    return    l.level == r.level
+           && (l.level != levelConstant || (l.constant == r.constant && l.size == r.size));
+}
+
+/*The greatest lower bound. Two constants agreeing on what both know of
+  remain constant, at the smaller size.*/
+static sccpValue sccpMeet (sccpValue l, sccpValue r) {
+    if (l.level == levelUnknown)
+        return r;
+
+    else if (r.level == levelUnknown)
+        return l;
+
+    else if (l.level == levelVarying || r.level == levelVarying)
+        return sccpVarying();
+
+    int size = min(l.size, r.size);
+
+    if (sccpTruncate(l.constant, size) == sccpTruncate(r.constant, size))
+        return sccpConstant(l.constant, size);
+
+    return sccpVarying();
+}
+
+static sccpValue sccpDefGetValue (const sccpCtx* ctx, const irSSADef* def) {
+    return def ? ctx->values[def->n] : sccpVarying();
+}
+
+/*The value of a definition read at a size, which can't be wider than
+  what is known*/
+static sccpValue sccpValueRead (sccpValue value, int size) {
+    if (value.level != levelConstant)
+        return value;
+
+    else if (size > value.size)
+        return sccpVarying();
+
+    return sccpConstant(value.constant, size);
+}
+
+/*The value of an operand read, literals taken at the size given*/
+static sccpValue sccpOperandGetValue (const sccpCtx* ctx, operand* Value, int size) {
+    if (Value->tag == operandLiteral)
+        return sccpConstant(Value->literal, size);
+
+    else if (Value->tag == operandReg && !regGetIndex(Value->base)) {
+        irSSADef* def = irSSAGetUse(&ctx->ssa, &Value->base);
+        return sccpValueRead(sccpDefGetValue(ctx, def), Value->size);
+    }
+
+    /*Physical registers and memory*/
+    return sccpVarying();
+}
+
+static void sccpQueue (sccpCtx* ctx, irBlock* block) {
+    if (!ctx->queued[block->nthChild]) {
+        ctx->queued[block->nthChild] = true;
+        vectorPush(&ctx->worklist, block);
+    }
+}
+
+static void sccpSetValue (sccpCtx* ctx, const irSSADef* def, sccpValue value) {
+    sccpValue* current = &ctx->values[def->n];
+    sccpValue lowered = sccpMeet(*current, value);
+
+    if (sccpValueIsEqual(lowered, *current))
+        return;
+
+    *current = lowered;
+
+    for (int i = 0; i < def->users.length; i++)
+        sccpQueue(ctx, vectorGet(&def->users, i));
+}
+
+/*==== Evaluation ====*/
+
+static bool sccpCondition (conditionTag cond, int64_t l, int64_t r) {
+    return cond == conditionEqual ? l == r :
+           cond == conditionNotEqual ? l != r :
+           cond == conditionGreater ? l > r :
+           cond == conditionGreaterEqual ? l >= r :
+           cond == conditionLess ? l < r :
+           cond == conditionLessEqual ? l <= r : false;
+}
+
+/*Whether a condition holds on the flags as they are before the nth
+  instruction of a block: a constant 1 or 0, if set by a compare of
+  constants in the same block*/
+static sccpValue sccpFlagsAt (const sccpCtx* ctx, const irBlock* block, int n, conditionTag cond) {
+    for (int i = n; i > 0; i--) {
+        irInstr* instr = vectorGet(&block->instrs, i-1);
+
+        if (instr->tag == instrCompare) {
+            int size = instr->l.size;
+            sccpValue l = sccpOperandGetValue(ctx, &instr->l, size),
+                      r = sccpOperandGetValue(ctx, &instr->r, size);
+
+            if (l.level == levelVarying || r.level == levelVarying || cond == conditionUndefined)
+                return sccpVarying();
+
+            else if (l.level == levelUnknown || r.level == levelUnknown)
+                return (sccpValue) {levelUnknown, 0, 0};
+
+            return sccpConstant(sccpCondition(cond, l.constant, r.constant), 1);
+
+        } else if (irInstrSetsFlags(instr))
+            return sccpVarying();
+    }
+
+    return sccpVarying();
+}
+
+static sccpValue sccpEvaluateBOP (boperation bop, int64_t l, int64_t r, int size) {
+    if (bop == bopUndefined || bop > bopShL)
+        return sccpVarying();
+
+    uint64_t ul = l, ur = r;
+    int shift = (int) (ur & (size == 8 ? 63 : 31));
+
+    uint64_t result = bop == bopAdd ? ul + ur :
+                      bop == bopSub ? ul - ur :
+                      bop == bopMul ? ul * ur :
+                      bop == bopBitAnd ? ul & ur :
+                      bop == bopBitOr ? ul | ur :
+                      bop == bopBitXor ? ul ^ ur :
+                      bop == bopShL ? ul << shift :
+                      /*bopShR, arithmetic like sar*/
+                      (uint64_t) (l < 0 ? ~(~l >> shift) : l >> shift);
+
+    return sccpConstant(result, size);
+}
+
+static sccpValue sccpEvaluateUOP (uoperation uop, int64_t r, int size) {
+    uint64_t ur = r;
+
+    if (uop == uopInc)
+        return sccpConstant(ur + 1, size);
+
+    else if (uop == uopDec)
+        return sccpConstant(ur - 1, size);
+
+    else if (uop == uopNeg)
+        return sccpConstant(-ur, size);
+
+    else if (uop == uopBitwiseNot)
+        return sccpConstant(~ur, size);
+
+    return sccpVarying();
+}
+
+/*The value given to the register written by the nth instruction of a block*/
+static sccpValue sccpEvaluate (const sccpCtx* ctx, const irBlock* block, int n,
+                               irInstr* instr, const irSSADef* def) {
+    int size = instr->dest.size;
+
+    if (instr->tag == instrConditionalMove) {
+        sccpValue cond = sccpFlagsAt(ctx, block, n, instr->r.condition),
+                  moved = sccpOperandGetValue(ctx, &instr->l, size),
+                  kept = sccpValueRead(sccpDefGetValue(ctx, def->prior), size);
+
+        if (cond.level == levelConstant)
+            return cond.constant ? moved : kept;
+
+        else if (cond.level == levelUnknown)
+            return cond;
+
+        return sccpMeet(moved, kept);
+
+    /*A write narrower than the register gives a value only known at that
+      size, so reading any more of it is varying anyway*/
+    } else if (instr->tag == instrMove)
+        return sccpOperandGetValue(ctx, &instr->l, size);
+
+    else if (instr->tag == instrMoveZeroExt || instr->tag == instrMoveSignExt) {
+        int from = instr->l.size;
+        sccpValue value = sccpOperandGetValue(ctx, &instr->l, from);
+
+        if (value.level != levelConstant || from <= 0 || from >= 8)
+            return value;
+
+        uint64_t extended = instr->tag == instrMoveSignExt
+                            ? (uint64_t) value.constant
+                            : (uint64_t) value.constant & (((uint64_t) 1 << from*8) - 1);
+
+        return sccpConstant(extended, size);
+
+    } else if (instr->tag == instrBOP) {
+        sccpValue l = sccpOperandGetValue(ctx, &instr->l, size),
+                  r = sccpOperandGetValue(ctx, &instr->r, size);
+
+        if (l.level == levelVarying || r.level == levelVarying)
+            return sccpVarying();
+
+        else if (l.level == levelUnknown || r.level == levelUnknown)
+            return (sccpValue) {levelUnknown, 0, 0};
+
+        return sccpEvaluateBOP(instr->bop, l.constant, r.constant, size);
+
+    } else if (instr->tag == instrUOP) {
+        sccpValue r = sccpOperandGetValue(ctx, &instr->l, size);
+
+        if (r.level != levelConstant)
+            return r;
+
+        return sccpEvaluateUOP(instr->uop, r.constant, size);
+    }
+
+    /*Addresses, pops*/
+    return sccpVarying();
+}
+
+static void sccpMarkEdge (sccpCtx* ctx, const irBlock* from, irBlock* to) {
+    bool found = false;
+
+    for (int i = 0; i < to->preds.length; i++) {
+        bool* edge = &ctx->edges[ctx->edgeStarts[to->nthChild] + i];
+
+        if (vectorGet(&to->preds, i) == from && !*edge)
+            found = *edge = true;
+    }
+
+    if (found) {
+        ctx->executable[to->nthChild] = true;
+        sccpQueue(ctx, to);
+    }
+}
+
+static void sccpVisitTerm (sccpCtx* ctx, irBlock* block) {
+    const irTerm* term = block->term;
+
+    if (!term)
+        return;
+
+    else if (term->tag == termJump)
+        sccpMarkEdge(ctx, block, term->to);
+
+    else if (term->tag == termBranch) {
+        sccpValue cond = term->cond.tag == operandFlags
+                         ? sccpFlagsAt(ctx, block, block->instrs.length, term->cond.condition)
+                         : sccpVarying();
+
+        if (cond.level == levelConstant)
+            sccpMarkEdge(ctx, block, cond.constant ? term->ifTrue : term->ifFalse);
+
+        else if (cond.level == levelVarying) {
+            sccpMarkEdge(ctx, block, term->ifTrue);
+            sccpMarkEdge(ctx, block, term->ifFalse);
+        }
+
+    } else if (term->tag == termCall || term->tag == termCallIndirect)
+        sccpMarkEdge(ctx, block, term->ret);
+}
+
+static void sccpVisitBlock (sccpCtx* ctx, irBlock* block) {
+    const vector* phis = &ctx->ssa.phis[block->nthChild];
+
+    for (int i = 0; i < phis->length; i++) {
+        const irSSADef* phi = vectorGet(phis, i);
+        sccpValue value = {levelUnknown, 0, 0};
+
+        for (int k = 0; k < phi->args.length; k++)
+            if (ctx->edges[ctx->edgeStarts[block->nthChild] + k])
+                value = sccpMeet(value, sccpDefGetValue(ctx, vectorGet(&phi->args, k)));
+
+        sccpSetValue(ctx, phi, value);
+    }
+
+    for (int i = 0; i < block->instrs.length; i++) {
+        irInstr* instr = vectorGet(&block->instrs, i);
+        const irSSADef* def = irSSAGetDef(&ctx->ssa, instr);
+
+        if (def)
+            sccpSetValue(ctx, def, sccpEvaluate(ctx, block, i, instr, def));
+    }
+
+    sccpVisitTerm(ctx, block);
+}
+
+static void sccpPropagate (sccpCtx* ctx) {
+    irBlock* prologue = ctx->fn->prologue;
+    ctx->executable[prologue->nthChild] = true;
+    sccpQueue(ctx, prologue);
+
+    while (ctx->worklist.length) {
+        irBlock* block = vectorPop(&ctx->worklist);
+        ctx->queued[block->nthChild] = false;
+
+        if (ctx->executable[block->nthChild])
+            sccpVisitBlock(ctx, block);
+    }
+}
+
+/*==== Rewriting ====*/
+
+static bool sccpFitsImmediate (sccpValue value) {
+    return    value.level == levelConstant
+           && value.constant >= INT_MIN && value.constant <= INT_MAX;
+}
+
+/*Replace a register read by an operand with the constant it holds*/
+static void sccpFoldOperand (sccpCtx* ctx, operand* Value) {
+    if (Value->tag != operandReg || regGetIndex(Value->base))
+        return;
+
+    sccpValue value = sccpOperandGetValue(ctx, Value, Value->size);
+
+    if (!sccpFitsImmediate(value))
+        return;
+
+    *Value = operandCreateLiteral((int) value.constant);
+    ctx->constantNo++;
+}
+
+static void sccpRewriteInstr (sccpCtx* ctx, irBlock* block, int n, irInstr* instr) {
+    const irSSADef* def = irSSAGetDef(&ctx->ssa, instr);
+    sccpValue value = sccpDefGetValue(ctx, def);
+
+    bool foldable =    instr->tag == instrMove || instr->tag == instrMoveZeroExt
+                    || instr->tag == instrMoveSignExt || instr->tag == instrConditionalMove
+                    || ((instr->tag == instrBOP || instr->tag == instrUOP) && !irBlockFlagsRead(block, n));
+
+    /*The whole instruction becomes a move of the constant*/
+    if (   def && foldable && sccpFitsImmediate(value)
+        && (instr->tag != instrMove || instr->l.tag != operandLiteral)) {
+        instr->tag = instrMove;
+        instr->l = operandCreateLiteral((int) value.constant);
+        instr->r = operandCreate(operandUndefined);
+
+        free(instr->label);
+        instr->label = 0;
+
+        ctx->constantNo++;
+        return;
+    }
+
+    /*Otherwise the operands that could be immediates*/
+
+    if (   instr->tag == instrMove || instr->tag == instrConditionalMove
+        || (instr->tag == instrPush && instr->l.size == ctx->wordsize))
+        sccpFoldOperand(ctx, &instr->l);
+
+    /*Shifts take their count in CL, and division has no immediate form*/
+    else if (   instr->tag == instrCompare
+             || (instr->tag == instrBOP && instr->bop != bopShL && instr->bop != bopShR))
+        sccpFoldOperand(ctx, &instr->r);
+}
+
+static void sccpRewriteBlock (sccpCtx* ctx, irBlock* block) {
+    irTerm* term = block->term;
+
+    if (term && term->tag == termBranch && term->cond.tag == operandFlags) {
+        sccpValue cond = sccpFlagsAt(ctx, block, block->instrs.length, term->cond.condition);
+
+        if (cond.level == levelConstant) {
+            irBlockResolveBranch(block, cond.constant != 0);
+            ctx->branchNo++;
+        }
+    }
+
+    for (int i = 0; i < block->instrs.length; i++)
+        sccpRewriteInstr(ctx, block, i, vectorGet(&block->instrs, i));
+
+    /*Compares no longer read by anything*/
+
+    for (int i = 0; i < block->instrs.length;) {
+        const irInstr* instr = vectorGet(&block->instrs, i);
+
+        if (instr->tag == instrCompare && !irBlockFlagsRead(block, i)) {
+            irBlockRemoveInstr(block, i);
+            ctx->deadNo++;
+
+        } else
+            i++;
+    }
+}
+
+static void sccpRewrite (sccpCtx* ctx) {
+    const vector* order = &ctx->ssa.doms.order;
+
+    for (int i = 0; i < order->length; i++) {
+        irBlock* block = vectorGet(order, i);
+
+        if (ctx->executable[block->nthChild])
+            sccpRewriteBlock(ctx, block);
+    }
+}
+
+static void sccpDeleteBlocks (sccpCtx* ctx) {
+    irFn* fn = ctx->fn;
+
+    /*Anything still reachable stays, even if the evaluation never got
+      there. The epilogue always stays, as the fn refers to it.*/
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        const irBlock* block = vectorGet(&fn->blocks, i);
+
+        if (!ctx->executable[i])
+            continue;
+
+        for (int j = 0; j < block->succs.length; j++)
+            ctx->executable[((irBlock*) vectorGet(&block->succs, j))->nthChild] = true;
+    }
+
+    ctx->executable[fn->epilogue->nthChild] = true;
+
+    vector/*<irBlock*>*/ dead;
+    vectorInit(&dead, 4);
+
+    for (int i = 0; i < fn->blocks.length; i++)
+        if (!ctx->executable[i])
+            vectorPush(&dead, vectorGet(&fn->blocks, i));
+
+    for (int i = 0; i < dead.length; i++)
+        irBlockDelete(fn, vectorGet(&dead, i));
+
+    ctx->blockNo = dead.length;
+    vectorFree(&dead);
+}
@@ -0,0 +1,577 @@
+#include "../inc/ir-ssa.h"
+
+#include "../inc/ir.h"
+#include "../inc/ir-dataflow.h"
+#include "../inc/vector.h"
+#include "../inc/hashmap.h"
+#include "../inc/bitarray.h"
+#include "../inc/debug.h"
+#include "../inc/reg.h"
+
+#include "stdlib.h"
+
+static void irDominatorsNumber (irDominators* doms, vector/*<irBlock*>*/* postorder, irBlock* block);
+static irBlock* irDominatorsIntersect (const irDominators* doms, irBlock* l, irBlock* r);
+
+typedef struct irSSARenamer {
+    irSSA* ssa;
+    const irLiveness* live;
+    ///By register index: the definitions in scope, innermost last, and
+    ///the value it had on entry if ever read
+    vector/*<irSSADef*>*/* stacks;
+    irSSADef** entries;
+} irSSARenamer;
+
+static void irSSAPlacePhis (irSSA* ssa, const irLiveness* live);
+static void irSSARename (irSSARenamer* renamer, irBlock* block);
+
+/*==== Dominators ====*/
+
+irDominators* irDominatorsInit (irDominators* doms, irFn* fn) {
+    int blockNo = fn->blocks.length;
+
+    doms->fn = fn;
+    doms->idoms = calloc(blockNo, sizeof(irBlock*));
+    doms->postorder = malloc(blockNo*sizeof(int));
+    doms->children = malloc(blockNo*sizeof(vector));
+    doms->frontiers = malloc(blockNo*sizeof(vector));
+
+    for (int i = 0; i < blockNo; i++) {
+        doms->postorder[i] = -1;
+        vectorInit(&doms->children[i], 2);
+        vectorInit(&doms->frontiers[i], 2);
+    }
+
+    /*Number the reachable blocks in postorder, then reverse it*/
+
+    vector/*<irBlock*>*/ postorder;
+    vectorInit(&postorder, blockNo);
+    irDominatorsNumber(doms, &postorder, fn->prologue);
+
+    vectorInit(&doms->order, postorder.length);
+
+    for (int i = postorder.length; i > 0; i--)
+        vectorPush(&doms->order, vectorGet(&postorder, i-1));
+
+    vectorFree(&postorder);
+
+    /*Iterate to a fixed point. In reverse postorder, every block but those
+      heading loops has had all its preds visited by the time it is reached,
+      so this rarely takes more than two passes.*/
+
+    doms->idoms[fn->prologue->nthChild] = fn->prologue;
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 1; i < doms->order.length; i++) {
+            irBlock* block = vectorGet(&doms->order, i);
+            irBlock* idom = 0;
+
+            for (int j = 0; j < block->preds.length; j++) {
+                irBlock* pred = vectorGet(&block->preds, j);
+
+                if (!doms->idoms[pred->nthChild])
+                    continue;
+
+                idom = idom ? irDominatorsIntersect(doms, pred, idom) : pred;
+            }
+
+            if (doms->idoms[block->nthChild] != idom) {
+                doms->idoms[block->nthChild] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    doms->idoms[fn->prologue->nthChild] = 0;
+
+    /*The tree, and the frontiers: a block is in the frontier of each of its
+      preds, and of their dominators, up to (not including) its own*/
+
+    for (int i = 1; i < doms->order.length; i++) {
+        irBlock* block = vectorGet(&doms->order, i);
+        irBlock* idom = doms->idoms[block->nthChild];
+
+        vectorPush(&doms->children[idom->nthChild], block);
+
+        if (block->preds.length < 2)
+            continue;
+
+        for (int j = 0; j < block->preds.length; j++) {
+            irBlock* runner = vectorGet(&block->preds, j);
+
+            if (!irBlockIsReachable(doms, runner))
+                continue;
+
+            for (; runner != idom; runner = doms->idoms[runner->nthChild]) {
+                vector* frontier = &doms->frontiers[runner->nthChild];
+
+                if (vectorFind(frontier, block) < 0)
+                    vectorPush(frontier, block);
+            }
+        }
+    }
+
+    return doms;
+}
+
+void irDominatorsFree (irDominators* doms) {
+    for (int i = 0; i < doms->fn->blocks.length; i++) {
+        vectorFree(&doms->children[i]);
+        vectorFree(&doms->frontiers[i]);
+    }
+
+    free(doms->idoms);
+    free(doms->postorder);
+    free(doms->children);
+    free(doms->frontiers);
+    vectorFree(&doms->order);
+}
+
+static void irDominatorsNumber (irDominators* doms, vector/*<irBlock*>*/* postorder, irBlock* block) {
+    /*Mark it as seen before recursing, for loops*/
+    doms->postorder[block->nthChild] = 0;
+
+    for (int i = 0; i < block->succs.length; i++) {
+        irBlock* succ = vectorGet(&block->succs, i);
+
+        if (doms->postorder[succ->nthChild] < 0)
+            irDominatorsNumber(doms, postorder, succ);
+    }
+
+    doms->postorder[block->nthChild] = vectorPush(postorder, block);
+}
+
+static irBlock* irDominatorsIntersect (const irDominators* doms, irBlock* l, irBlock* r) {
+    /*Climb the tree (as known so far) from whichever is lower until they meet*/
+    while (l != r) {
+        while (doms->postorder[l->nthChild] < doms->postorder[r->nthChild])
+            l = doms->idoms[l->nthChild];
+
+        while (doms->postorder[r->nthChild] < doms->postorder[l->nthChild])
+            r = doms->idoms[r->nthChild];
+    }
+
+    return l;
+}
+
+bool irBlockIsReachable (const irDominators* doms, const irBlock* block) {
+    return doms->postorder[block->nthChild] >= 0;
+}
+
+bool irBlockDominates (const irDominators* doms, const irBlock* a, const irBlock* b) {
+    if (!irBlockIsReachable(doms, b))
+        return false;
+
+    for (; b; b = doms->idoms[b->nthChild])
+        if (a == b)
+            return true;
+
+    return false;
+}
+
+/*==== Natural loops ====*/
+
+static irLoop* irLoopCreate (irBlock* header, int blockNo) {
+    irLoop* loop = malloc(sizeof(irLoop));
+    loop->header = header;
+    vectorInit(&loop->blocks, 4);
+    loop->contains = calloc(blockNo, sizeof(bool));
+    vectorInit(&loop->latches, 1);
+
+    vectorPush(&loop->blocks, header);
+    loop->contains[header->nthChild] = true;
+
+    return loop;
+}
+
+void irLoopDestroy (irLoop* loop) {
+    vectorFree(&loop->blocks);
+    free(loop->contains);
+    vectorFree(&loop->latches);
+    free(loop);
+}
+
+/*Add a latch and, walking back from it, the blocks reaching it*/
+static void irLoopAddLatch (irLoop* loop, const irDominators* doms, irBlock* latch) {
+    vectorPush(&loop->latches, latch);
+
+    vector/*<irBlock*>*/ worklist;
+    vectorInit(&worklist, 4);
+    vectorPush(&worklist, latch);
+
+    while (worklist.length) {
+        irBlock* block = vectorPop(&worklist);
+
+        if (loop->contains[block->nthChild] || !irBlockIsReachable(doms, block))
+            continue;
+
+        loop->contains[block->nthChild] = true;
+        vectorPush(&loop->blocks, block);
+
+        for (int i = 0; i < block->preds.length; i++)
+            vectorPush(&worklist, vectorGet(&block->preds, i));
+    }
+
+    vectorFree(&worklist);
+}
+
+static int irLoopCmpSize (const void* l, const void* r) {
+    return   (*(irLoop* const*) l)->blocks.length
+           - (*(irLoop* const*) r)->blocks.length;
+}
+
+void irLoopsFind (const irDominators* doms, vector/*<irLoop*>*/* loops) {
+    int blockNo = doms->fn->blocks.length;
+
+    for (int i = 0; i < doms->order.length; i++) {
+        irBlock* header = vectorGet(&doms->order, i);
+        irLoop* loop = 0;
+
+        for (int j = 0; j < header->preds.length; j++) {
+            irBlock* pred = vectorGet(&header->preds, j);
+
+            if (!irBlockDominates(doms, header, pred))
+                continue;
+
+            if (!loop)
+                loop = irLoopCreate(header, blockNo);
+
+            irLoopAddLatch(loop, doms, pred);
+        }
+
+        if (loop)
+            vectorPush(loops, loop);
+    }
+
+    qsort(loops->buffer, loops->length, sizeof(void*), irLoopCmpSize);
+}
+
+/*==== SSA ====*/
+
+static irSSADef* irSSADefCreate (irSSA* ssa, irSSADefTag tag, reg* vreg, irBlock* block) {
+    irSSADef* def = malloc(sizeof(irSSADef));
+    def->tag = tag;
+    def->n = vectorPush(&ssa->defs, def);
+    def->vreg = vreg;
+    def->block = block;
+    def->instr = 0;
+    def->prior = 0;
+    vectorInit(&def->args, tag == ssaPhi ? max(block->preds.length, 1) : 1);
+    vectorInit(&def->users, 2);
+    return def;
+}
+
+static void irSSADefDestroy (irSSADef* def) {
+    vectorFree(&def->args);
+    vectorFree(&def->users);
+    free(def);
+}
+
+static void irSSADefAddUser (irSSADef* def, irBlock* block) {
+    if (vectorFind(&def->users, block) < 0)
+        vectorPush(&def->users, block);
+}
+
+irSSA* irSSAInit (irSSA* ssa, irFn* fn, int wordsize) {
+    ssa->wordsize = wordsize;
+    irDominatorsInit(&ssa->doms, fn);
+
+    vectorInit(&ssa->defs, 64);
+    ssa->phis = malloc(fn->blocks.length*sizeof(vector));
+
+    for (int i = 0; i < fn->blocks.length; i++)
+        vectorInit(&ssa->phis[i], 1);
+
+    intmapInit(&ssa->uses, 256);
+    intmapInit(&ssa->instrDefs, 128);
+
+    /*Liveness prunes the phis, and numbers the registers*/
+    irLiveness live;
+    irLivenessInit(&live, fn, wordsize);
+
+    irSSAPlacePhis(ssa, &live);
+
+    int regNo = live.regs.length;
+    irSSARenamer renamer = {ssa, &live, malloc(regNo*sizeof(vector)), calloc(regNo, sizeof(irSSADef*))};
+
+    for (int i = 0; i < regNo; i++)
+        vectorInit(&renamer.stacks[i], 4);
+
+    irSSARename(&renamer, fn->prologue);
+
+    for (int i = 0; i < regNo; i++)
+        vectorFree(&renamer.stacks[i]);
+
+    free(renamer.stacks);
+    free(renamer.entries);
+
+    irLivenessFree(&live);
+
+    return ssa;
+}
+
+void irSSAFree (irSSA* ssa) {
+    for (int i = 0; i < ssa->doms.fn->blocks.length; i++)
+        vectorFree(&ssa->phis[i]);
+
+    free(ssa->phis);
+
+    vectorFreeObjs(&ssa->defs, (vectorDtor) irSSADefDestroy);
+    intmapFree(&ssa->uses);
+    intmapFree(&ssa->instrDefs);
+
+    irDominatorsFree(&ssa->doms);
+}
+
+static void irSSAPlacePhis (irSSA* ssa, const irLiveness* live) {
+    irFn* fn = ssa->doms.fn;
+    int regNo = live->regs.length;
+
+    /*The blocks writing each register*/
+
+    vector/*<irBlock*>*/* defBlocks = malloc(regNo*sizeof(vector));
+
+    for (int i = 0; i < regNo; i++)
+        vectorInit(&defBlocks[i], 2);
+
+    for (int i = 0; i < ssa->doms.order.length; i++) {
+        irBlock* block = vectorGet(&ssa->doms.order, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irRegUse uses[irInstrMaxRegs];
+            int useNo = irInstrGetRegs(vectorGet(&block->instrs, j), ssa->wordsize, uses);
+
+            for (int k = 0; k < useNo; k++) {
+                if (!uses[k].written)
+                    continue;
+
+                vector* blocks = &defBlocks[irLivenessGetIndex(live, *uses[k].where)];
+
+                if (vectorGet(blocks, blocks->length-1) != block)
+                    vectorPush(blocks, block);
+            }
+        }
+    }
+
+    /*A phi goes wherever a register's definitions meet: the iterated
+      frontier of the blocks writing it. Each block is stamped with the last
+      register it was visited for, saving clearing between them.*/
+
+    int *hasPhi = calloc(fn->blocks.length, sizeof(int)),
+        *queued = calloc(fn->blocks.length, sizeof(int));
+
+    for (int i = 0; i < regNo; i++) {
+        int stamp = i+1;
+        vector* work = &defBlocks[i];
+
+        for (int j = 0; j < work->length; j++)
+            queued[((irBlock*) vectorGet(work, j))->nthChild] = stamp;
+
+        while (work->length) {
+            irBlock* block = vectorPop(work);
+            const vector* frontier = &ssa->doms.frontiers[block->nthChild];
+
+            for (int j = 0; j < frontier->length; j++) {
+                irBlock* join = vectorGet(frontier, j);
+
+                if (hasPhi[join->nthChild] == stamp)
+                    continue;
+
+                hasPhi[join->nthChild] = stamp;
+
+                /*Pruned: not where the register is dead anyway*/
+                if (bitarrayTest(&live->flow.in[join->nthChild], i)) {
+                    irSSADef* phi = irSSADefCreate(ssa, ssaPhi, vectorGet(&live->regs, i), join);
+
+                    for (int k = 0; k < join->preds.length; k++)
+                        vectorPush(&phi->args, 0);
+
+                    vectorPush(&ssa->phis[join->nthChild], phi);
+                }
+
+                if (queued[join->nthChild] != stamp) {
+                    queued[join->nthChild] = stamp;
+                    vectorPush(work, join);
+                }
+            }
+        }
+    }
+
+    free(hasPhi);
+    free(queued);
+
+    for (int i = 0; i < regNo; i++)
+        vectorFree(&defBlocks[i]);
+
+    free(defBlocks);
+}
+
+/*The definition of a register in scope, the value on entry if none*/
+static irSSADef* irSSARenamerGetTop (irSSARenamer* renamer, int index) {
+    vector* stack = &renamer->stacks[index];
+
+    if (stack->length)
+        return vectorGet(stack, stack->length-1);
+
+    if (!renamer->entries[index]) {
+        irFn* fn = renamer->ssa->doms.fn;
+        renamer->entries[index] = irSSADefCreate(renamer->ssa, ssaEntry,
+                                                 vectorGet(&renamer->live->regs, index), fn->prologue);
+    }
+
+    return renamer->entries[index];
+}
+
+/*Walk the dominator tree, keeping the definitions in scope of each register*/
+static void irSSARename (irSSARenamer* renamer, irBlock* block) {
+    irSSA* ssa = renamer->ssa;
+    const irLiveness* live = renamer->live;
+
+    /*Registers defined here, to be popped on the way out*/
+    vector/*<intptr_t>*/ pushed;
+    vectorInit(&pushed, 8);
+
+    const vector* phis = &ssa->phis[block->nthChild];
+
+    for (int i = 0; i < phis->length; i++) {
+        irSSADef* phi = vectorGet(phis, i);
+        int index = irLivenessGetIndex(live, phi->vreg);
+
+        vectorPush(&renamer->stacks[index], phi);
+        vectorPush(&pushed, (void*) (intptr_t) index);
+    }
+
+    for (int i = 0; i < block->instrs.length; i++) {
+        irInstr* instr = vectorGet(&block->instrs, i);
+
+        irRegUse uses[irInstrMaxRegs];
+        int useNo = irInstrGetRegs(instr, ssa->wordsize, uses);
+
+        /*Reads first, they see the definitions before this instruction*/
+        for (int k = 0; k < useNo; k++) {
+            if (!uses[k].read || uses[k].written)
+                continue;
+
+            irSSADef* def = irSSARenamerGetTop(renamer, irLivenessGetIndex(live, *uses[k].where));
+            intmapAdd(&ssa->uses, (intptr_t) uses[k].where, def);
+            irSSADefAddUser(def, block);
+        }
+
+        for (int k = 0; k < useNo; k++) {
+            if (!uses[k].written)
+                continue;
+
+            int index = irLivenessGetIndex(live, *uses[k].where);
+            irSSADef* def = irSSADefCreate(ssa, ssaInstr, *uses[k].where, block);
+            def->instr = instr;
+
+            /*Keeping some of what was there*/
+            if (uses[k].read || uses[k].size < live->sizes[index]) {
+                def->prior = irSSARenamerGetTop(renamer, index);
+                irSSADefAddUser(def->prior, block);
+            }
+
+            intmapAdd(&ssa->instrDefs, (intptr_t) instr, def);
+
+            vectorPush(&renamer->stacks[index], def);
+            vectorPush(&pushed, (void*) (intptr_t) index);
+        }
+    }
+
+    /*Fill in the phis of the succs, for each edge from here*/
+    for (int i = 0; i < block->succs.length; i++) {
+        irBlock* succ = vectorGet(&block->succs, i);
+        const vector* succPhis = &ssa->phis[succ->nthChild];
+
+        for (int j = 0; j < succPhis->length; j++) {
+            irSSADef* phi = vectorGet(succPhis, j);
+            irSSADef* def = irSSARenamerGetTop(renamer, irLivenessGetIndex(live, phi->vreg));
+
+            for (int k = 0; k < succ->preds.length; k++) {
+                if (vectorGet(&succ->preds, k) == block) {
+                    vectorSet(&phi->args, k, def);
+                    irSSADefAddUser(def, succ);
+                }
+            }
+        }
+    }
+
+    const vector* children = &ssa->doms.children[block->nthChild];
+
+    for (int i = 0; i < children->length; i++)
+        irSSARename(renamer, vectorGet(children, i));
+
+    for (int i = 0; i < pushed.length; i++)
+        vectorPop(&renamer->stacks[(intptr_t) vectorGet(&pushed, i)]);
+
+    vectorFree(&pushed);
+}
+
+irSSADef* irSSAGetUse (const irSSA* ssa, reg* const* where) {
+    return intmapMap(&ssa->uses, (intptr_t) where);
+}
+
+irSSADef* irSSAGetDef (const irSSA* ssa, const irInstr* instr) {
+    return intmapMap(&ssa->instrDefs, (intptr_t) instr);
+}
+
+/*==== Dump ====*/
+
+static void irSSADumpDef (const irSSADef* def) {
+    if (def)
+        debugOut("d%d", def->n);
+
+    else
+        debugOut("-");
+}
+
+void irSSADump (const irSSA* ssa) {
+    debugMsg("%s: %d definitions", ssa->doms.fn->name, ssa->defs.length);
+
+    for (int i = 0; i < ssa->doms.order.length; i++) {
+        const irBlock* block = vectorGet(&ssa->doms.order, i);
+        const irBlock* idom = ssa->doms.idoms[block->nthChild];
+
+        debugOut("%s: idom %s, frontier {", block->label, idom ? idom->label : "-");
+
+        const vector* frontier = &ssa->doms.frontiers[block->nthChild];
+
+        for (int j = 0; j < frontier->length; j++)
+            debugOut(" %s", ((const irBlock*) vectorGet(frontier, j))->label);
+
+        debugOut(" }\n");
+
+        const vector* phis = &ssa->phis[block->nthChild];
+
+        for (int j = 0; j < phis->length; j++) {
+            const irSSADef* phi = vectorGet(phis, j);
+            debugOut("    d%d = phi %s(", phi->n, regGetName(phi->vreg, ssa->wordsize));
+
+            for (int k = 0; k < phi->args.length; k++) {
+                debugOut(k ? ", " : "");
+                irSSADumpDef(vectorGet(&phi->args, k));
+            }
+
+            debugOut(")\n");
+        }
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            irInstr* instr = vectorGet(&block->instrs, j);
+            const irSSADef* def = irSSAGetDef(ssa, instr);
+
+            if (!def)
+                continue;
+
+            debugOut("    d%d = %s", def->n, regGetName(def->vreg, instr->dest.size));
+
+            if (def->prior) {
+                debugOut(" keeping ");
+                irSSADumpDef(def->prior);
+            }
+
+            debugOut("\n");
+        }
+    }
+}
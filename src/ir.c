@@ -5,10 +5,10 @@
 #include "../inc/operand.h"
 #include "../inc/asm.h"
 #include "../inc/asm-amd64.h"
+#include "../inc/reg.h"
 
 #include "stdlib.h"
 #include "string.h"
-#include "stdarg.h"
 
 static void irAddFn (irCtx* ctx, irFn* fn);
 static void irAddData (irCtx* ctx, irStaticData* data);
@@ -34,11 +34,7 @@ static void irBlockTerminate (irBlock* block, irTerm* term);
  * Update the preds/succs vectors in from and to
  */
 static void irBlockLink (irBlock* from, irBlock* to);
-
-/*==== ====*/
-
-static irInstr* irInstrCreate (irInstrTag tag, irBlock* block);
-static void irInstrDestroy (irInstr* instr);
+static void irBlockUnlink (irBlock* from, irBlock* to);
 
 /*==== ====*/
 
@@ -57,7 +53,6 @@ enum {
     irCtxRODataNo = 64,
     irFnBlockNo = 8,
     irBlockInstrNo = 8,
-    irBlockStrSize = 1024,
     irBlockPredNo = 2,
     irBlockSuccNo = 2
 };
@@ -69,6 +64,7 @@ void irInit (irCtx* ctx, const char* output, const architecture* arch) {
     vectorInit(&ctx->data, irCtxDataNo);
     vectorInit(&ctx->rodata, irCtxRODataNo);
 
+    ctx->unit = 0;
     ctx->labelNo = 0;
 
     ctx->asm = asmInit(output, arch);
@@ -82,6 +78,28 @@ void irFree (irCtx* ctx) {
     asmEnd(ctx->asm);
 }
 
+void irUnitInit (irCtx* unit, const irCtx* module, int unitNo) {
+    vectorInit(&unit->fns, 2);
+    vectorInit(&unit->data, 2);
+    vectorInit(&unit->rodata, 2);
+
+    unit->unit = unitNo;
+    unit->labelNo = 0;
+
+    unit->asm = module->asm;
+    unit->arch = module->arch;
+}
+
+void irUnitMerge (irCtx* module, irCtx* unit) {
+    vectorPushFromVector(&module->fns, &unit->fns);
+    vectorPushFromVector(&module->data, &unit->data);
+    vectorPushFromVector(&module->rodata, &unit->rodata);
+
+    vectorFree(&unit->fns);
+    vectorFree(&unit->data);
+    vectorFree(&unit->rodata);
+}
+
 static void irAddFn (irCtx* ctx, irFn* fn) {
     vectorPush(&ctx->fns, fn);
 }
@@ -94,9 +112,9 @@ static void irAddROData (irCtx* ctx, irStaticData* data) {
     vectorPush(&ctx->rodata, data);
 }
 
-static char* irCreateLabel (irCtx* ctx) {
-    char* label = malloc(10);
-    sprintf(label, ".%04X", ctx->labelNo++);
+char* irCreateLabel (irCtx* ctx) {
+    char* label = malloc(24);
+    sprintf(label, ".%X_%04X", ctx->unit, ctx->labelNo++);
     return label;
 }
 
@@ -112,8 +130,8 @@ irFn* irFnCreate (irCtx* ctx, const char* name, int stacksize) {
     fn->entryPoint = irBlockCreate(ctx, fn);
     fn->epilogue = irBlockCreate(ctx, fn);
 
-    asmFnPrologue(ctx, fn->prologue, stacksize);
-    asmFnEpilogue(ctx, fn->epilogue);
+    /*The prologue and epilogue themselves wait for irAllocRegs*/
+    fn->stacksize = stacksize;
 
     irJump(fn->prologue, fn->entryPoint);
     irReturn(fn->epilogue);
@@ -141,10 +159,6 @@ irBlock* irBlockCreate (irCtx* ctx, irFn* fn) {
     block->term = 0;
     block->label = irCreateLabel(ctx);
 
-    block->str = calloc(irBlockStrSize, sizeof(char*));
-    block->length = 0;
-    block->capacity = irBlockStrSize;
-
     vectorInit(&block->preds, irBlockPredNo);
     vectorInit(&block->succs, irBlockSuccNo);
 
@@ -161,7 +175,6 @@ static void irBlockDestroy (irBlock* block) {
     irTermDestroy(block->term);
 
     free(block->label);
-    free(block->str);
     free(block);
 }
 
@@ -173,30 +186,6 @@ int irBlockGetSuccNo (irBlock* block) {
     return block->succs.length + (block->term->tag == termCall || block->term->tag == termCallIndirect ? 1 : 0);
 }
 
-void irBlockOut (irBlock* block, const char* format, ...) {
-    va_list args[2];
-    va_start(args[0], format);
-    va_copy(args[1], args[0]);
-    debugVarMsg(format, args[1]);
-    va_end(args[1]);
-
-    int length = vsnprintf(block->str+block->length, block->capacity-block->length, format, args[0]);
-    va_end(args[0]);
-
-    if (length < 0 || block->length+length >= block->capacity) {
-        block->capacity *= 2;
-        block->capacity += length+2;
-        block->str = realloc(block->str, block->capacity);
-
-        va_start(args[0], format);
-        vsnprintf(block->str+block->length, block->capacity, format, args[0]);
-        va_end(args[0]);
-    }
-
-    block->length += length;
-    block->str[block->length++] = '\n';
-}
-
 static void irAddInstr (irBlock* block, irInstr* instr) {
     vectorPush(&block->instrs, instr);
 }
@@ -215,6 +204,12 @@ static void irBlockLink (irBlock* from, irBlock* to) {
     vectorPush(&to->preds, from);
 }
 
+/*Remove one link, the reverse of irBlockLink*/
+static void irBlockUnlink (irBlock* from, irBlock* to) {
+    vectorRemoveReorder(&from->succs, vectorFind(&from->succs, to));
+    vectorRemoveReorder(&to->preds, vectorFind(&to->preds, from));
+}
+
 /*==== Static data internals ====*/
 
 static irStaticData* irStaticDataCreate (irCtx* ctx, bool ro, irStaticDataTag tag) {
@@ -255,25 +250,126 @@ operand irStringConstant (irCtx* ctx, const char* str) {
 
 /*==== Instruction internals ====*/
 
-static irInstr* irInstrCreate (irInstrTag tag, irBlock* block) {
+/*Fix the size of a register operand, if not already*/
+static operand irOperandFixSize (operand Value) {
+    if (Value.tag == operandReg && Value.size == 0)
+        Value.size = regGetSize(Value.base);
+
+    return Value;
+}
+
+irInstr* irInstrCreate (irBlock* block, irInstrTag tag, operand dest, operand l, operand r) {
     irInstr* instr = malloc(sizeof(irInstr));
     instr->tag = tag;
-    instr->op = opUndefined;
+    instr->bop = bopUndefined;
+
+    instr->dest = irOperandFixSize(dest);
+    instr->l = irOperandFixSize(l);
+    instr->r = irOperandFixSize(r);
 
-    instr->dest = operandCreate(operandUndefined);
-    instr->l = operandCreate(operandUndefined);
-    instr->r = operandCreate(operandUndefined);
+    instr->label = 0;
 
     irAddInstr(block, instr);
 
     return instr;
 }
 
-static void irInstrDestroy (irInstr* instr) {
-    (void) irInstrCreate;
+void irInstrDestroy (irInstr* instr) {
+    free(instr->label);
     free(instr);
 }
 
+/*Is the dest of an instruction written, and does it keep what was there*/
+bool irInstrWritesDest (const irInstr* instr) {
+    return    instr->tag == instrMove || instr->tag == instrMoveZeroExt
+           || instr->tag == instrMoveSignExt || instr->tag == instrConditionalMove
+           || instr->tag == instrSetCond || instr->tag == instrEvalAddress || instr->tag == instrBOP
+           || instr->tag == instrUOP || instr->tag == instrPop;
+}
+
+static bool irInstrReadsDest (const irInstr* instr) {
+    return !irInstrWritesDest(instr) || instr->tag == instrConditionalMove;
+}
+
+bool irFnTakesFrameAddress (const irFn* fn) {
+    const reg* frame = &regs[regRBP];
+
+    for (int i = 0; i < fn->blocks.length; i++) {
+        const irBlock* block = vectorGet(&fn->blocks, i);
+
+        for (int j = 0; j < block->instrs.length; j++) {
+            const irInstr* instr = vectorGet(&block->instrs, j);
+
+            if (   instr->tag == instrEvalAddress && instr->l.tag == operandMem
+                && (instr->l.base == frame || instr->l.index == frame))
+                return true;
+
+            const operand* operands[3] = {&instr->dest, &instr->l, &instr->r};
+
+            for (int k = 0; k < 3; k++)
+                if (operands[k]->tag == operandReg && operands[k]->base == frame)
+                    return true;
+        }
+    }
+
+    return false;
+}
+
+bool irInstrSetsFlags (const irInstr* instr) {
+    return    instr->tag == instrCompare || instr->tag == instrBOP || instr->tag == instrUOP
+           || instr->tag == instrDivision || instr->tag == instrCallIndirect;
+}
+
+bool irBlockFlagsRead (const irBlock* block, int n) {
+    for (int i = n+1; i < block->instrs.length; i++) {
+        const irInstr* instr = vectorGet(&block->instrs, i);
+
+        if (instr->tag == instrConditionalMove || instr->tag == instrSetCond)
+            return true;
+
+        else if (irInstrSetsFlags(instr))
+            return false;
+    }
+
+    return block->term && block->term->tag == termBranch;
+}
+
+static void irAddRegUse (irRegUse* uses, int* useNo, reg** where, int size, bool read, bool written) {
+    /*Physical registers are left to those that name them*/
+    if (!*where || regGetIndex(*where))
+        return;
+
+    if (debugAssert("irAddRegUse", "register count", *useNo < irInstrMaxRegs))
+        return;
+
+    uses[(*useNo)++] = (irRegUse) {where, size, read, written};
+}
+
+int irInstrGetRegs (irInstr* instr, int wordsize, irRegUse* uses) {
+    if (instr->tag == instrTakeReg || instr->tag == instrGiveBackReg)
+        return 0;
+
+    int useNo = 0;
+    operand* operands[3] = {&instr->dest, &instr->l, &instr->r};
+
+    for (int n = 0; n < 3; n++) {
+        operand* Value = operands[n];
+
+        if (Value->tag == operandReg) {
+            /*Only dest is ever written*/
+            bool written = n == 0 && irInstrWritesDest(instr),
+                 read = n != 0 || irInstrReadsDest(instr);
+            irAddRegUse(uses, &useNo, &Value->base, Value->size, read, written);
+
+        } else if (Value->tag == operandMem) {
+            irAddRegUse(uses, &useNo, &Value->base, wordsize, true, false);
+            irAddRegUse(uses, &useNo, &Value->index, wordsize, true, false);
+        }
+    }
+
+    return useNo;
+}
+
 /*==== Terminal instruction internals ====*/
 
 static irTerm* irTermCreate (irTermTag tag, irBlock* block) {
@@ -336,6 +432,11 @@ void irCallIndirect (irBlock* block, operand to, irBlock* ret) {
     asmCallIndirect(block, to);
 }
 
+void irTailCall (irBlock* block, sym* to) {
+    irTerm* term = irTermCreate(termTailCall, block);
+    term->toAsSym = to;
+}
+
 static void irReturn (irBlock* block) {
     irTermCreate(termReturn, block);
 }
@@ -366,6 +467,61 @@ void irBlockDelete (irFn* fn, irBlock* block) {
     irBlockDestroy(block);
 }
 
+void irBlockResolveBranch (irBlock* block, bool cond) {
+    irTerm* branch = block->term;
+
+    if (debugAssert("irBlockResolveBranch", "branch", branch && branch->tag == termBranch))
+        return;
+
+    irBlock *to = cond ? branch->ifTrue : branch->ifFalse,
+            *dropped = cond ? branch->ifFalse : branch->ifTrue;
+
+    /*The link to the block taken stays, even if both ways went there*/
+    irBlockUnlink(block, dropped);
+
+    branch->tag = termJump;
+    branch->to = to;
+}
+
+void irBlockRedirect (irBlock* block, irBlock* from, irBlock* to) {
+    irTerm* term = block->term;
+
+    if (debugAssert("irBlockRedirect", "terminal", term != 0))
+        return;
+
+    irBlock** targets[2] = {0, 0};
+
+    if (term->tag == termJump)
+        targets[0] = &term->to;
+
+    else if (term->tag == termBranch) {
+        targets[0] = &term->ifTrue;
+        targets[1] = &term->ifFalse;
+
+    } else if (term->tag == termCall || term->tag == termCallIndirect)
+        targets[0] = &term->ret;
+
+    /*Linked once for each way it goes there*/
+    for (int i = 0; i < 2; i++) {
+        if (!targets[i] || *targets[i] != from)
+            continue;
+
+        *targets[i] = to;
+        irBlockUnlink(block, from);
+        irBlockLink(block, to);
+    }
+}
+
+void irBlockRemoveInstr (irBlock* block, int n) {
+    irInstr* instr = vectorGet(&block->instrs, n);
+
+    for (int i = n; i < block->instrs.length-1; i++)
+        vectorSet(&block->instrs, i, vectorGet(&block->instrs, i+1));
+
+    vectorPop(&block->instrs);
+    irInstrDestroy(instr);
+}
+
 void irBlocksCombine (irFn* fn, irBlock* pred, irBlock* succ) {
     /*Combine them by putting everything from the succ into the pred,
       taking ownership where possible. Then destroy the succ.*/
@@ -378,20 +534,8 @@ void irBlocksCombine (irFn* fn, irBlock* pred, irBlock* succ) {
     pred->term = succ->term;
     succ->term = 0;
 
-    /*Cat the strings*/
-
-    int totalLength = pred->length + succ->length-1;
-
-    if (pred->capacity >= totalLength) {
-        strncat(pred->str, succ->str, pred->capacity);
-        pred->length = totalLength;
-
-    } else {
-        char* str = malloc(totalLength);
-        snprintf(str, totalLength, "%s%s", pred->str, succ->str);
-        free(pred->str);
-        pred->str = str;
-    }
+    /*The pred owns the instrs now*/
+    succ->instrs.length = 0;
 
     /*Link to the succs of the succ*/
     for (int i = 0; i < succ->succs.length; i++)
@@ -4,40 +4,116 @@
 #include "../inc/debug.h"
 
 #include "../inc/stream.h"
+#include "../inc/scan.h"
+#include "../inc/atom.h"
+
+/*Keyword hash and punctuation DFA, generated by makelexer.c*/
+#include "../lexer-tables.h"
 
 #include "stdlib.h"
 #include "string.h"
 #include "ctype.h"
 
+static void lexerLoad (lexerCtx* ctx, int index);
+static void lexerScan (lexerCtx* ctx);
 static void lexerSkipInsignificants (lexerCtx* ctx);
-static void lexerEat (lexerCtx* ctx, char c);
 static void lexerEatNext (lexerCtx* ctx);
-static bool lexerTryEatNext (lexerCtx* ctx, char c);
 
 static void lexerPunct (lexerCtx* ctx);
 static keywordTag lookKeyword (const char* str, int length);
 
-lexerCtx* lexerInit (const char* filename) {
+lexerCtx* lexerInit (const char* filename, atomTable* atoms) {
     lexerCtx* ctx = malloc(sizeof(lexerCtx));
     ctx->stream = streamInit(filename);
-    ctx->line = 1;
-    ctx->lineChar = 1;
+    ctx->atoms = atoms;
+    ctx->base = 0;
+    ctx->location = 0;
 
     ctx->token = tokenUndefined;
     ctx->keyword = keywordUndefined;
     ctx->punct = punctUndefined;
 
+    ctx->slice = streamGetPtr(ctx->stream);
+    ctx->length = 0;
+    ctx->atom = 0;
+
     ctx->bufferSize = 64;
     ctx->buffer = malloc(sizeof(char)*ctx->bufferSize);
+
+    ctx->tokens = 0;
+    ctx->tokenNo = 0;
+    ctx->tokenCapacity = 0;
+    ctx->cursor = -1;
     return ctx;
 }
 
 void lexerEnd (lexerCtx* ctx) {
     streamEnd(ctx->stream);
     free(ctx->buffer);
+    free(ctx->tokens);
     free(ctx);
 }
 
+void lexerTokenize (lexerCtx* ctx) {
+    debugAssert("lexerTokenize", "first token", ctx->token == tokenUndefined && !ctx->tokens);
+
+    /*Guess a token per four characters, roughly typical*/
+    ctx->tokenCapacity = ctx->stream->length/4 + 16;
+    ctx->tokens = malloc(sizeof(token)*ctx->tokenCapacity);
+
+    do {
+        lexerScan(ctx);
+
+        if (ctx->tokenNo == ctx->tokenCapacity)
+            ctx->tokens = realloc(ctx->tokens, sizeof(token)*(ctx->tokenCapacity *= 2));
+
+        ctx->tokens[ctx->tokenNo++] = (token) {
+            .tag = ctx->token, .keyword = ctx->keyword, .punct = ctx->punct,
+            .length = ctx->length, .location = ctx->location,
+            .atom = ctx->atom
+        };
+    } while (ctx->token != tokenEOF);
+
+    /*Rewind, ready for lexerNext to load the first*/
+    ctx->token = tokenUndefined;
+    ctx->cursor = -1;
+}
+
+const token* lexerPeek (const lexerCtx* ctx, int n) {
+    debugAssert("lexerPeek", "tokenized", ctx->tokens != 0);
+
+    /*Before the first lexerNext there is no current token yet, so n=0
+      gives the first one, the same as n=1*/
+    int index = ctx->cursor + n;
+    index = index < 0 ? 0 : index;
+    return &ctx->tokens[index < ctx->tokenNo ? index : ctx->tokenNo-1];
+}
+
+void lexerSeek (lexerCtx* ctx, tokenLocation location) {
+    debugAssert("lexerSeek", "tokenized", ctx->tokens != 0);
+
+    /*Locations ascend through the array*/
+    int lower = 0, upper = ctx->tokenNo;
+
+    while (lower < upper) {
+        int middle = lower + (upper-lower)/2;
+
+        if (ctx->tokens[middle].location < location)
+            lower = middle+1;
+
+        else
+            upper = middle;
+    }
+
+    /*Past the last token is the EOF*/
+    lexerLoad(ctx, lower < ctx->tokenNo ? lower : ctx->tokenNo-1);
+}
+
+/*Skip forward to the first a, b or NUL*/
+static void lexerSkipUntil (lexerCtx* ctx, char a, char b) {
+    streamSkipTo(ctx->stream, scanFind(streamGetPtr(ctx->stream), streamGetEnd(ctx->stream), a, b));
+}
+
 /*Eat as many insignificants (comments, whitespace etc) as possible*/
 static void lexerSkipInsignificants (lexerCtx* ctx) {
     while (true) {
@@ -48,15 +124,19 @@ static void lexerSkipInsignificants (lexerCtx* ctx) {
         case '\n':
         case '\r':
             streamNext(ctx->stream);
+
+            /*Only bother with the bulk scan for runs (indentation)*/
+            switch (ctx->stream->current) {
+            case ' ': case '\t': case '\n': case '\r':
+                streamSkipTo(ctx->stream, scanWhitespace(streamGetPtr(ctx->stream), streamGetEnd(ctx->stream)));
+            }
+
             break;
 
         /*C preprocessor is treated as a comment*/
         case '#':
             /*Eat until a new line*/
-            while (   ctx->stream->current != '\n'
-                   && ctx->stream->current != 0)
-                streamNext(ctx->stream);
-
+            lexerSkipUntil(ctx, '\n', '\n');
             streamNext(ctx->stream);
             break;
 
@@ -69,9 +149,7 @@ static void lexerSkipInsignificants (lexerCtx* ctx) {
                 streamNext(ctx->stream);
 
                 do {
-                    while (   ctx->stream->current != '*'
-                           && ctx->stream->current != 0)
-                        streamNext(ctx->stream);
+                    lexerSkipUntil(ctx, '*', '*');
 
                     if (ctx->stream->current == 0)
                         break;
@@ -85,11 +163,7 @@ static void lexerSkipInsignificants (lexerCtx* ctx) {
             /*C++ Comment*/
             } else if (ctx->stream->current == '/') {
                 streamNext(ctx->stream);
-
-                while (   ctx->stream->current != '\n'
-                       && ctx->stream->current != '\r'
-                       && ctx->stream->current != 0)
-                    streamNext(ctx->stream);
+                lexerSkipUntil(ctx, '\n', '\r');
 
             /*Fuck, we just ate an important character. Backtrack!*/
             } else {
@@ -106,37 +180,61 @@ static void lexerSkipInsignificants (lexerCtx* ctx) {
     }
 }
 
-static void lexerEat (lexerCtx* ctx, char c) {
-    /*Buffer full? Double the size*/
-    if (ctx->length+1 == ctx->bufferSize)
-        ctx->buffer = realloc(ctx->buffer, ctx->bufferSize *= 2);
+const char* lexerGetStr (lexerCtx* ctx) {
+    /*Buffer too small? Double the size until it isn't*/
+    if (ctx->length >= ctx->bufferSize) {
+        while (ctx->length >= ctx->bufferSize)
+            ctx->bufferSize *= 2;
+
+        ctx->buffer = realloc(ctx->buffer, ctx->bufferSize);
+    }
 
-    ctx->buffer[ctx->length++] = c;
+    memcpy(ctx->buffer, ctx->slice, ctx->length);
+    ctx->buffer[ctx->length] = 0;
+    return ctx->buffer;
 }
 
 static void lexerEatNext (lexerCtx* ctx) {
-    lexerEat(ctx, streamNext(ctx->stream));
+    streamNext(ctx->stream);
 }
 
-static bool lexerTryEatNext (lexerCtx* ctx, char c) {
-    if (ctx->stream->current == c) {
-        lexerEatNext(ctx);
-        return true;
+void lexerNext (lexerCtx* ctx) {
+    if (!ctx->tokens) {
+        lexerScan(ctx);
+        return;
+    }
 
-    } else
-        return false;
+    /*Stay on the EOF once there*/
+    lexerLoad(ctx, ctx->cursor+1 < ctx->tokenNo ? ctx->cursor+1 : ctx->cursor);
 }
 
-void lexerNext (lexerCtx* ctx) {
+/*Make the token at an index of the array the current one*/
+static void lexerLoad (lexerCtx* ctx, int index) {
+    const token* next = &ctx->tokens[index];
+    ctx->cursor = index;
+    ctx->token = next->tag;
+    ctx->keyword = next->keyword;
+    ctx->punct = next->punct;
+    /*Strings and characters leave their opening quote out of the slice*/
+    bool quoted = next->tag == tokenStr || next->tag == tokenChar;
+    ctx->slice = ctx->stream->buffer + (next->location - ctx->base) + quoted;
+    ctx->length = next->length;
+    ctx->location = next->location;
+    ctx->atom = next->atom;
+}
+
+/*Lex the next token directly from the stream*/
+static void lexerScan (lexerCtx* ctx) {
     if (ctx->token == tokenEOF)
         return;
 
     lexerSkipInsignificants(ctx);
 
-    ctx->line = ctx->stream->line;
-    ctx->lineChar = ctx->stream->lineChar;
+    int start = ctx->stream->pos;
+    ctx->location = ctx->base + start;
 
-    ctx->length = 0;
+    ctx->slice = streamGetPtr(ctx->stream);
+    ctx->atom = 0;
     ctx->keyword = keywordUndefined;
     ctx->punct = punctUndefined;
 
@@ -154,12 +252,16 @@ void lexerNext (lexerCtx* ctx) {
                || ctx->stream->current == '_')
             lexerEatNext(ctx);
 
-        lexerEat(ctx, 0);
+        int length = ctx->stream->pos - start;
+        ctx->keyword = lookKeyword(ctx->slice, length);
 
-        ctx->keyword = lookKeyword(ctx->buffer, ctx->length);
-        ctx->token =   ctx->keyword != keywordUndefined
-                     ? tokenKeyword
-                     : tokenIdent;
+        if (ctx->keyword != keywordUndefined)
+            ctx->token = tokenKeyword;
+
+        else {
+            ctx->token = tokenIdent;
+            ctx->atom = atomGet(ctx->atoms, ctx->slice, length);
+        }
 
     /*Number*/
     } else if (isdigit(ctx->stream->current)) {
@@ -174,6 +276,10 @@ void lexerNext (lexerCtx* ctx) {
         ctx->token = ctx->stream->current == '"' ? tokenStr : tokenChar;
         streamNext(ctx->stream);
 
+        /*Leave the quotes out of the slice*/
+        ctx->slice++;
+        start++;
+
         while (   ctx->stream->current != (ctx->token == tokenStr ? '"' : '\'')
                && ctx->stream->current != 0) {
             if (ctx->stream->current == '\\')
@@ -182,209 +288,69 @@ void lexerNext (lexerCtx* ctx) {
             lexerEatNext(ctx);
         }
 
+        ctx->length = ctx->stream->pos - start;
         streamNext(ctx->stream);
 
     /*Punctuation or an unrecognised character*/
-    } else {
-        lexerEatNext(ctx);
-
-        /*Assume punctuation*/
+    } else
         lexerPunct(ctx);
-    }
 
-    lexerEat(ctx, 0);
-
-    //printf("token(%d:%d): '%s'.\n", ctx->stream->line, ctx->stream->lineChar, ctx->buffer);
+    if (ctx->token != tokenStr && ctx->token != tokenChar)
+        ctx->length = ctx->stream->pos - start;
 }
 
 static void lexerPunct (lexerCtx* ctx) {
-    ctx->token = tokenPunct;
-
-    switch (ctx->buffer[0]) {
-    case '{': ctx->punct = punctLBrace; break;
-    case '}': ctx->punct = punctRBrace; break;
-    case '(': ctx->punct = punctLParen; break;
-    case ')': ctx->punct = punctRParen; break;
-    case '[': ctx->punct = punctLBracket; break;
-    case ']': ctx->punct = punctRBracket; break;
-    case ';': ctx->punct = punctSemicolon; break;
-    case '.':
-        ctx->punct = punctPeriod;
-
-        if (ctx->stream->current == '.') {
-            lexerEatNext(ctx);
+    int state = 0, accepted = 0, pastAccepted = 0;
 
-            if (ctx->stream->current == '.') {
-                ctx->punct = punctEllipsis;
-                lexerEatNext(ctx);
-
-            /*Oops, it's just two dots, backtrack*/
-            } else {
-                streamPrev(ctx->stream);
-                ctx->length--;
-            }
-        }
+    /*Run the DFA as far as it goes, remembering the last accepting state*/
+    for (int next;
+         (next = punctNext[state][punctClass[(unsigned char) ctx->stream->current]]);
+         state = next) {
+        lexerEatNext(ctx);
 
-        break;
-
-    case ',': ctx->punct = punctComma; break;
-
-    case '=': ctx->punct = lexerTryEatNext(ctx, '=') ? punctEqual : punctAssign; break;
-    case '!': ctx->punct = lexerTryEatNext(ctx, '=') ? punctNotEqual : punctLogicalNot; break;
-    case '>': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctGreaterEqual
-                           : lexerTryEatNext(ctx, '>')
-                             ? (lexerTryEatNext(ctx, '=') ? punctShrAssign : punctShr)
-                             : punctGreater; break;
-    case '<': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctLessEqual
-                           : lexerTryEatNext(ctx, '<')
-                             ? (lexerTryEatNext(ctx, '=') ? punctShlAssign : punctShl)
-                             : punctLess; break;
-
-    case '?': ctx->punct = punctQuestion; break;
-    case ':': ctx->punct = punctColon; break;
-
-    case '&': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctBitwiseAndAssign
-                           : lexerTryEatNext(ctx, '&') ? punctLogicalAnd : punctBitwiseAnd; break;
-    case '|': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctBitwiseOrAssign
-                           : lexerTryEatNext(ctx, '|') ? punctLogicalOr : punctBitwiseOr; break;
-    case '^': ctx->punct = lexerTryEatNext(ctx, '=') ? punctBitwiseXorAssign : punctBitwiseXor; break;
-    case '~': ctx->punct = punctBitwiseNot; break;
-
-    case '+': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctPlusAssign
-                           : lexerTryEatNext(ctx, '+') ? punctPlusPlus : punctPlus; break;
-    case '-': ctx->punct =   lexerTryEatNext(ctx, '=') ? punctMinusAssign
-                           : lexerTryEatNext(ctx, '-') ? punctMinusMinus
-                           : lexerTryEatNext(ctx, '>') ? punctArrow : punctMinus; break;
-    case '*': ctx->punct = lexerTryEatNext(ctx, '=') ? punctTimesAssign : punctTimes; break;
-    case '/': ctx->punct = lexerTryEatNext(ctx, '=') ? punctDivideAssign : punctDivide; break;
-    case '%': ctx->punct = lexerTryEatNext(ctx, '=') ? punctModuloAssign : punctModulo; break;
+        if (punctAccept[next] != punctUndefined) {
+            accepted = next;
+            pastAccepted = 0;
 
-    /*Oops, actually an unrecognised character*/
-    default: ctx->token = tokenOther;
+        } else
+            pastAccepted++;
     }
-}
 
-static keywordTag keywordMatch (const char* str, int n, const char* look, keywordTag kw) {
-    return !strcmp(str+n+1, look+n+1) ? kw : keywordUndefined;
-}
+    /*Went further than the longest match, e.g. "..", so backtrack*/
+    for (; pastAccepted; pastAccepted--)
+        streamPrev(ctx->stream);
+
+    if (accepted) {
+        ctx->token = tokenPunct;
+        ctx->punct = punctAccept[accepted];
 
-static keywordTag keywordMatch2 (const char* str, int n, const char* look, keywordTag kw,
-                                 const char* look2, keywordTag kw2) {
-    return   !strcmp(str+n+1, look+n+1) ? kw
-           : !strcmp(str+n+1, look2+n+1) ? kw2 : keywordUndefined;
+    /*Oops, actually an unrecognised character*/
+    } else {
+        lexerEatNext(ctx);
+        ctx->token = tokenOther;
+    }
 }
 
 static keywordTag lookKeyword (const char* str, int length) {
-    int longest = strlen("continue")+1;
-
-    if (length > longest)
+    if (length < keywordMinLength || length > keywordMaxLength)
         return keywordUndefined;
 
-    /*Manual trie
-      Yeah it's ugly, but it's fast. And lexing is the slowest part of compilation.*/
-
-    switch (str[0]) {
-    case 'd': return keywordMatch(str, 0, "do", keywordDo);
-    case 'r': return keywordMatch(str, 0, "return", keywordReturn);
-    case 'w': return keywordMatch(str, 0, "while", keywordWhile);
-
-    case 'a': return keywordMatch2(str, 0, "assert", keywordAssert,
-                                           "auto", keywordAuto);
-    case 'b': return keywordMatch2(str, 0, "bool", keywordBool,
-                                           "break", keywordBreak);
-    case 't': return keywordMatch2(str, 0, "true", keywordTrue,
-                                           "typedef", keywordTypedef);
-    case 'u': return keywordMatch2(str, 0, "union", keywordUnion,
-                                           "using", keywordUsing);
-
-    case 'c':
-        switch (str[1]) {
-        case 'h': return keywordMatch(str, 1, "char", keywordChar);
-        case 'o':
-            if (str[2] != 'n')
-                return keywordUndefined;
-
-            return keywordMatch2(str, 2, "const", keywordConst,
-                                         "continue", keywordContinue);
-
-        default: return keywordUndefined;
-        }
-
-    case 'e':
-        switch (str[1]) {
-        case 'l': return keywordMatch(str, 1, "else", keywordElse);
-        case 'n': return keywordMatch(str, 1, "enum", keywordEnum);
-        case 'x': return keywordMatch(str, 1, "extern", keywordExtern);
-        default: return keywordUndefined;
-        }
-
-    case 'f': return keywordMatch2(str, 0, "false", keywordFalse,
-                                           "for", keywordFor);
-
-    case 'i': return keywordMatch2(str, 0, "if", keywordIf,
-                                           "int", keywordInt);
-
-    case 's':
-        switch (str[1]) {
-        case 'i': return keywordMatch(str, 1, "sizeof", keywordSizeof);
-        case 't': return keywordMatch2(str, 1, "static", keywordStatic,
-                                               "struct", keywordStruct);
-        default: return keywordUndefined;
-        }
+    /*Perfect hash: the only keyword it could be is in this slot*/
+    unsigned int hash = keywordHash(str, length);
 
-    case 'v':
-        switch (str[1]) {
-        case 'a':
-            if (str[2] == '_') {
-                switch (str[3]) {
-                    case 'a': return keywordMatch(str, 3, "va_arg", keywordVAArg);
-                    case 'c': return keywordMatch(str, 3, "va_copy", keywordVACopy);
-                    case 'e': return keywordMatch(str, 3, "va_end", keywordVAEnd);
-                    case 's': return keywordMatch(str, 3, "va_start", keywordVAStart);
-                    default: return keywordUndefined;
-                }
-
-            } else
-                return keywordUndefined;
-
-        case 'o': return keywordMatch(str, 1, "void", keywordVoid);
-        default: return keywordUndefined;
-        }
+    if (   keywordTable[hash].length == length
+        && !memcmp(keywordTable[hash].str, str, length))
+        return keywordTable[hash].tag;
 
-    default: return keywordUndefined;
-    }
+    else
+        return keywordUndefined;
 }
 
 const char* keywordTagGetStr (keywordTag tag) {
+    int tags = sizeof(keywordStrs)/sizeof(*keywordStrs);
+
     if (tag == keywordUndefined) return "<undefined>";
-    else if (tag == keywordUsing) return "using";
-    else if (tag == keywordIf) return "if";
-    else if (tag == keywordElse) return "else";
-    else if (tag == keywordWhile) return "while";
-    else if (tag == keywordDo) return "do";
-    else if (tag == keywordFor) return "for";
-    else if (tag == keywordReturn) return "return";
-    else if (tag == keywordBreak) return "break";
-    else if (tag == keywordContinue) return "continue";
-    else if (tag == keywordSizeof) return "sizeof";
-    else if (tag == keywordConst) return "const";
-    else if (tag == keywordAuto) return "auto";
-    else if (tag == keywordStatic) return "static";
-    else if (tag == keywordExtern) return "extern";
-    else if (tag == keywordTypedef) return "typedef";
-    else if (tag == keywordStruct) return "struct";
-    else if (tag == keywordUnion) return "union";
-    else if (tag == keywordEnum) return "enum";
-    else if (tag == keywordVoid) return "void";
-    else if (tag == keywordBool) return "bool";
-    else if (tag == keywordChar) return "char";
-    else if (tag == keywordInt) return "int";
-    else if (tag == keywordTrue) return "true";
-    else if (tag == keywordFalse) return "false";
-    else if (tag == keywordVAStart) return "va_start";
-    else if (tag == keywordVAEnd) return "va_end";
-    else if (tag == keywordVAArg) return "va_arg";
-    else if (tag == keywordVACopy) return "va_copy";
+    else if ((int) tag > 0 && (int) tag < tags && keywordStrs[tag]) return keywordStrs[tag];
     else {
         char* str = malloc(logi(tag, 10)+2);
         sprintf(str, "%d", tag);
@@ -395,53 +361,10 @@ const char* keywordTagGetStr (keywordTag tag) {
 }
 
 const char* punctTagGetStr (punctTag tag) {
+    int tags = sizeof(punctStrs)/sizeof(*punctStrs);
+
     if (tag == punctUndefined) return "<undefined>";
-    else if (tag == punctLBrace) return "{";
-    else if (tag == punctRBrace) return "}";
-    else if (tag == punctLParen) return "(";
-    else if (tag == punctRParen) return ")";
-    else if (tag == punctLBracket) return "[";
-    else if (tag == punctRBracket) return "]";
-    else if (tag == punctSemicolon) return ";";
-    else if (tag == punctPeriod) return ".";
-    else if (tag == punctEllipsis) return "...";
-    else if (tag == punctComma) return ",";
-    else if (tag == punctAssign) return "=";
-    else if (tag == punctEqual) return "==";
-    else if (tag == punctLogicalNot) return "!";
-    else if (tag == punctNotEqual) return "!=";
-    else if (tag == punctGreater) return ">";
-    else if (tag == punctGreaterEqual) return ">=";
-    else if (tag == punctShr) return ">>";
-    else if (tag == punctShrAssign) return ">>=";
-    else if (tag == punctLess) return "<";
-    else if (tag == punctLessEqual) return "<=";
-    else if (tag == punctShl) return "<<";
-    else if (tag == punctShlAssign) return "<<=";
-    else if (tag == punctQuestion) return "?";
-    else if (tag == punctColon) return ":";
-    else if (tag == punctBitwiseAnd) return "&";
-    else if (tag == punctBitwiseAndAssign) return "&=";
-    else if (tag == punctLogicalAnd) return "&&";
-    else if (tag == punctBitwiseOr) return "|";
-    else if (tag == punctBitwiseOrAssign) return "|=";
-    else if (tag == punctLogicalOr) return "||";
-    else if (tag == punctBitwiseXor) return "^";
-    else if (tag == punctBitwiseXorAssign) return "^=";
-    else if (tag == punctBitwiseNot) return "~";
-    else if (tag == punctPlus) return "+";
-    else if (tag == punctPlusAssign) return "+=";
-    else if (tag == punctPlusPlus) return "++";
-    else if (tag == punctMinus) return "-";
-    else if (tag == punctMinusAssign) return "-=";
-    else if (tag == punctMinusMinus) return "--";
-    else if (tag == punctArrow) return "->";
-    else if (tag == punctTimes) return "*";
-    else if (tag == punctTimesAssign) return "*=";
-    else if (tag == punctDivide) return "/";
-    else if (tag == punctDivideAssign) return "/=";
-    else if (tag == punctModulo) return "%";
-    else if (tag == punctModuloAssign) return "%=";
+    else if ((int) tag > 0 && (int) tag < tags && punctStrs[tag]) return punctStrs[tag];
     else {
         char* str = malloc(logi(tag, 10)+2);
         sprintf(str, "%d", tag);
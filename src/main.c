@@ -6,36 +6,175 @@
 #include "../inc/compiler.h"
 #include "../inc/sym.h"
 #include "../inc/reg.h"
+#include "../inc/scan.h"
 
 #include "string.h"
 #include "stdlib.h"
 #include "stdio.h"
-
+#include "threads.h"
+#include "stdatomic.h"
+
+/**
+ * One input, compiled on whichever thread gets to it first
+ */
+typedef struct job {
+    const config* conf;
+    const char *input, *intermediate;
+
+    ///Everything said while compiling it, held back until the jobs before
+    ///it have had their say so that the output doesn't depend on timing
+    FILE* log;
+
+    int errors, warnings, internalErrors;
+} job;
+
+typedef struct jobQueue {
+    job* jobs;
+    int jobNo;
+    ///The next job not yet taken by a thread
+    atomic_int next;
+} jobQueue;
+
+static void jobRun (job* j);
+static int jobWorker (void* queue);
+static void driverParallel (const config* conf, int* errors, int* warnings);
 static bool driver (config conf);
 
 static const char* plural (int n) {
     return n == 1 ? "" : "s";
 }
 
-static bool driver (config conf) {
-    bool fail = false;
+static void jobRun (job* j) {
+    /*Each job has its own log and compiler, modules included. Compiling
+      a module writes to its symbols, so they can't be shared.*/
+    debugInit(j->log ? j->log : stdout);
+    internalErrors = 0;
 
     compilerCtx comp;
-    compilerInit(&comp, &conf.arch, &conf.includeSearchPaths);
+    compilerInit(&comp, &j->conf->arch, &j->conf->includeSearchPaths);
 
-    /*Compile each of the inputs to assembly*/
-    for (int i = 0; i < conf.inputs.length; i++) {
-        compiler(&comp,
-                 vectorGet(&conf.inputs, i),
-                 vectorGet(&conf.intermediates, i));
-    }
+    /*Threads left over from having fewer inputs than jobs go to code gen*/
+    comp.threads = max(1, j->conf->jobs / j->conf->inputs.length);
+    comp.moduleCache.dir = j->conf->moduleCache;
+    comp.interfaces = j->conf->interfaces;
+
+    compiler(&comp, j->input, j->intermediate);
+
+    if (j->conf->memStats)
+        compilerPrintStats(&comp);
+
+    if (j->conf->peepholeStats)
+        irPeepholePrintStats(&comp.peephole);
 
     compilerEnd(&comp);
 
-    if (comp.errors != 0 || comp.warnings != 0)
+    j->errors = comp.errors;
+    j->warnings = comp.warnings;
+    j->internalErrors = internalErrors;
+}
+
+static int jobWorker (void* queue) {
+    jobQueue* q = queue;
+
+    for (int i; (i = atomic_fetch_add(&q->next, 1)) < q->jobNo;)
+        jobRun(&q->jobs[i]);
+
+    return 0;
+}
+
+static void driverParallel (const config* conf, int* errors, int* warnings) {
+    jobQueue q = {.jobs = calloc(conf->inputs.length, sizeof(job)),
+                  .jobNo = conf->inputs.length};
+    atomic_init(&q.next, 0);
+
+    for (int i = 0; i < q.jobNo; i++)
+        q.jobs[i] = (job) {conf, vectorGet(&conf->inputs, i), vectorGet(&conf->intermediates, i),
+                           tmpfile(), 0, 0, 0};
+
+    /*Never more threads than jobs*/
+    int threadNo = min(conf->jobs, q.jobNo);
+    thrd_t* threads = malloc(threadNo*sizeof(thrd_t));
+
+    /*Stop at the first thread that can't be made, those already running
+      will claim every job between them*/
+    int started = 0;
+
+    while (   started < threadNo
+           && thrd_create(&threads[started], jobWorker, &q) == thrd_success)
+        started++;
+
+    /*Not even one, so run them all on this thread*/
+    if (started == 0) {
+        int oldInternalErrors = internalErrors;
+        jobWorker(&q);
+
+        debugInit(stdout);
+        internalErrors = oldInternalErrors;
+    }
+
+    for (int i = 0; i < started; i++)
+        thrd_join(threads[i], 0);
+
+    /*Replay the logs in input order*/
+    for (int i = 0; i < q.jobNo; i++) {
+        job* j = &q.jobs[i];
+
+        /*If there was no temporary file, it went straight to stdout*/
+        if (j->log) {
+            rewind(j->log);
+            char buffer[4096];
+
+            for (size_t length; (length = fread(buffer, 1, sizeof(buffer), j->log));)
+                fwrite(buffer, 1, length, stdout);
+
+            fclose(j->log);
+        }
+
+        *errors += j->errors;
+        *warnings += j->warnings;
+        internalErrors += j->internalErrors;
+    }
+
+    free(threads);
+    free(q.jobs);
+}
+
+static bool driver (config conf) {
+    bool fail = false;
+    int errors = 0, warnings = 0;
+
+    if (conf.jobs)
+        driverParallel(&conf, &errors, &warnings);
+
+    else {
+        compilerCtx comp;
+        compilerInit(&comp, &conf.arch, &conf.includeSearchPaths);
+        comp.moduleCache.dir = conf.moduleCache;
+        comp.interfaces = conf.interfaces;
+
+        /*Compile each of the inputs to assembly*/
+        for (int i = 0; i < conf.inputs.length; i++) {
+            compiler(&comp,
+                     vectorGet(&conf.inputs, i),
+                     vectorGet(&conf.intermediates, i));
+        }
+
+        if (conf.memStats)
+            compilerPrintStats(&comp);
+
+        if (conf.peepholeStats)
+            irPeepholePrintStats(&comp.peephole);
+
+        compilerEnd(&comp);
+
+        errors = comp.errors;
+        warnings = comp.warnings;
+    }
+
+    if (errors != 0 || warnings != 0)
         printf("Compilation complete with %d error%s and %d warning%s\n",
-               comp.errors, plural(comp.errors),
-               comp.warnings, plural(comp.warnings));
+               errors, plural(errors),
+               warnings, plural(warnings));
 
     else if (internalErrors)
         printf("Compilation complete with %d internal error%s\n",
@@ -60,11 +199,12 @@ static bool driver (config conf) {
         free(intermediates);
     }
 
-    return fail || comp.errors != 0 || internalErrors != 0;
+    return fail || errors != 0 || internalErrors != 0;
 }
 
 int main (int argc, char** argv) {
     debugInit(stdout);
+    scanInit();
 
     bool fail = false;
 
@@ -93,6 +233,11 @@ int main (int argc, char** argv) {
         puts("  -S         Compile only, do not assemble or link");
         puts("  -s         Keep temporary assembly output after compilation");
         puts("  -o <file>  Output into a specific file");
+        puts("  -j <n>     Compile on up to n threads");
+        puts("  -M <dir>   Keep images of used modules in a directory, to load instead of parsing");
+        puts("  --mem-stats  Report the memory used per line of each module");
+        puts("  --interfaces  Parse the function bodies of used modules only once referred to");
+        puts("  --peephole-stats  Report how often each peephole rule fired");
         puts("  --help     Display command line information");
         puts("  --version  Display version information");
 
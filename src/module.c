@@ -0,0 +1,1023 @@
+#include "../inc/module.h"
+
+#include "../inc/debug.h"
+#include "../inc/ast.h"
+#include "../inc/sym.h"
+#include "../inc/atom.h"
+#include "../inc/arena.h"
+#include "../inc/compiler.h"
+#include "../inc/architecture.h"
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+enum {
+    ///"FCM1", and bumped whenever the AST, symbols or format change
+    moduleMagic = 0x314D4346,
+    moduleVersion = 2
+};
+
+/*All records are multiples of eight bytes, so that every table starts
+  aligned within the image*/
+
+typedef struct moduleHeader {
+    uint32_t magic, version;
+    uint64_t hash;
+    ///Symbols in the global scope before any module scope, the built in types
+    int32_t builtins;
+    int32_t lines;
+    int32_t depNo, refNo, symNo, nodeNo;
+    ///In int32s, int32s and chars
+    int32_t listLength, pathLength, stringLength;
+    ///Whether the function bodies were skipped, as for compilerCtx::interfaces
+    int32_t interface;
+    ///Of the architecture compiled for, as symbol sizes depend on it
+    int32_t wordsize, padding;
+} moduleHeader;
+
+typedef struct moduleDepRecord {
+    int32_t name, padding;
+    uint64_t hash;
+} moduleDepRecord;
+
+/*A symbol of another module: the module it is in (an index into the
+  modules used, directly or not, see moduleListUsed; or -1 for the global
+  scope), and the path of children leading to it from there*/
+typedef struct moduleRefRecord {
+    int32_t module, path, length, padding;
+} moduleRefRecord;
+
+/*Symbols are referred to by index: those of the module first, then the
+  refs. Nodes by index. Strings by offset. Null is -1 for all three.*/
+
+typedef struct moduleSymRecord {
+    int32_t tag, ident, parent, impl;
+    int32_t decls, declNo;
+    ///The first child of a link, the symbol linked to
+    int32_t target;
+    int32_t size, typeMask, complete, storage;
+    ///A ref to a symbol of another module that this one redeclared, moving
+    ///it here. Only the declarations and children added here are recorded.
+    int32_t adopt;
+} moduleSymRecord;
+
+typedef enum moduleLiteralKind {
+    moduleLiteralNone,
+    moduleLiteralAtom,
+    moduleLiteralStr,
+    moduleLiteralInt,
+    moduleLiteralChar
+} moduleLiteralKind;
+
+typedef struct moduleNodeRecord {
+    int32_t tag, location, o, l, r, symbol;
+    int32_t children, childNo;
+    ///Or marker
+    int32_t litTag, literalKind;
+    int64_t constant;
+    ///A string offset or the value itself, depending on literalKind
+    int64_t literal;
+} moduleNodeRecord;
+
+struct moduleImage {
+    char* buffer;
+
+    const moduleHeader* header;
+    const moduleDepRecord* deps;
+    const moduleRefRecord* refs;
+    const moduleSymRecord* syms;
+    const moduleNodeRecord* nodes;
+    const int32_t *lists, *paths;
+    const char* strings;
+};
+
+/*A growing buffer of records for the writer*/
+typedef struct moduleBuffer {
+    char* data;
+    int length, capacity;
+} moduleBuffer;
+
+typedef struct moduleWriter {
+    compilerCtx* comp;
+    ///What the module's symbols were allocated from, to tell them apart
+    ///from those it adopted
+    const arena* arena;
+    tokenLocation base;
+    vector/*<const sym*>*/ modules;
+
+    ///The module's symbols and nodes, by index
+    vector/*<const sym*>*/ syms;
+    vector/*<const ast*>*/ nodes;
+    ///Index+1 of each symbol and node of the module, and of each symbol of
+    ///another module that has been referred to
+    intmap symIndices, nodeIndices, refIndices;
+    ///Offset+1 of each string
+    hashmap stringOffsets;
+
+    moduleBuffer deps, refs, symTable, nodeTable, lists, paths, strings;
+
+    ///Set on finding anything the image can't express
+    bool fail;
+} moduleWriter;
+
+static char* moduleReadFile (const char* filename, int* length);
+static uint64_t moduleHash (const char* buffer, int length);
+static char* moduleImageGetFilename (const moduleCache* cache, uint64_t hash);
+static int moduleCountBuiltins (const compilerCtx* comp);
+static void moduleListUsed (vector/*<const sym*>*/* modules, intset* visited, const sym* Module);
+
+static bool moduleImageCheck (moduleImage* image, int length);
+static sym* moduleImageResolveRef (const moduleImage* image, const moduleRefRecord* ref,
+                                   const sym* global, const vector/*<const sym*>*/* modules);
+
+static int moduleBufferPush (moduleBuffer* buffer, const void* data, int size);
+
+static void moduleWriterAddSym (moduleWriter* w, const sym* Symbol);
+static void moduleWriterAddNode (moduleWriter* w, const ast* Node);
+static int32_t moduleWriterSym (moduleWriter* w, const sym* Symbol);
+static int32_t moduleWriterNode (moduleWriter* w, const ast* Node);
+static int32_t moduleWriterString (moduleWriter* w, const char* str);
+static int32_t moduleWriterRef (moduleWriter* w, const sym* Symbol);
+static int32_t moduleWriterAdoptRef (moduleWriter* w, const sym* Symbol);
+static void moduleWriterSymRecord (moduleWriter* w, const sym* Symbol);
+static void moduleWriterNodeRecord (moduleWriter* w, const ast* Node);
+static bool moduleWriterSave (moduleWriter* w, const char* filename, const moduleHeader* header);
+
+/*==== Cache ====*/
+
+static void moduleCacheFreeKey (char* key, const void* value) {
+    (void) value;
+    free(key);
+}
+
+static void moduleCacheEntryDestroy (void* entry) {
+    moduleCacheEntry* e = entry;
+
+    free(e->source);
+    moduleImageFree(e->image);
+    free(e);
+}
+
+moduleCache* moduleCacheInit (moduleCache* cache, const char* dir) {
+    cache->dir = dir;
+    hashmapInit(&cache->entries, 64);
+    return cache;
+}
+
+void moduleCacheFree (moduleCache* cache) {
+    hashmapFreeObjs(&cache->entries, moduleCacheFreeKey, moduleCacheEntryDestroy);
+}
+
+moduleCacheEntry* moduleCacheGetEntry (moduleCache* cache, const char* fullname) {
+    moduleCacheEntry* entry = hashmapMap(&cache->entries, fullname);
+
+    if (!entry) {
+        int length;
+        char* source = moduleReadFile(fullname, &length);
+
+        if (!source)
+            return 0;
+
+        entry = malloc(sizeof(moduleCacheEntry));
+        *entry = (moduleCacheEntry) {moduleHash(source, length), source, length, moduleUnchecked, 0};
+        hashmapAdd(&cache->entries, strdup(fullname), entry);
+    }
+
+    return entry;
+}
+
+static char* moduleReadFile (const char* filename, int* length) {
+    FILE* file = fopen(filename, "rb");
+
+    if (!file)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    /*Terminated, as the lexer would have it*/
+    char* buffer = malloc(size+1);
+
+    if (size < 0 || fread(buffer, 1, size, file) != (size_t) size) {
+        free(buffer);
+        buffer = 0;
+
+    } else {
+        buffer[size] = 0;
+        *length = size;
+    }
+
+    fclose(file);
+    return buffer;
+}
+
+/*FNV-1a*/
+static uint64_t moduleHash (const char* buffer, int length) {
+    uint64_t hash = 0xCBF29CE484222325u;
+
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char) buffer[i];
+        hash *= 0x100000001B3u;
+    }
+
+    return hash;
+}
+
+static char* moduleImageGetFilename (const moduleCache* cache, uint64_t hash) {
+    char* filename = malloc(strlen(cache->dir)+1+16+4+1);
+    sprintf(filename, "%s/%016llx.fcm", cache->dir, (unsigned long long) hash);
+    return filename;
+}
+
+static int moduleCountBuiltins (const compilerCtx* comp) {
+    int builtins = 0;
+
+    while (   builtins < comp->global->children.length
+           && ((const sym*) vectorGet(&comp->global->children, builtins))->tag != symScope)
+        builtins++;
+
+    return builtins;
+}
+
+/*Every module scope that a module brings into view, starting with itself,
+  in the same order whichever way they were made*/
+static void moduleListUsed (vector/*<const sym*>*/* modules, intset* visited, const sym* Module) {
+    if (intsetAdd(visited, (intptr_t) Module))
+        return;
+
+    vectorPush(modules, (sym*) Module);
+
+    for (int n = 0; n < Module->children.length; n++) {
+        const sym* Current = vectorGet(&Module->children, n);
+
+        if (Current->tag == symModuleLink)
+            moduleListUsed(modules, visited, vectorGet(&Current->children, 0));
+    }
+}
+
+static void moduleListDeps (vector/*<const sym*>*/* modules, const moduleDep* deps, int depNo) {
+    intset visited;
+    intsetInit(&visited, 64);
+
+    for (int n = 0; n < depNo; n++)
+        moduleListUsed(modules, &visited, deps[n].scope);
+
+    intsetFree(&visited);
+}
+
+/*==== Reading ====*/
+
+moduleImage* moduleImageRead (const moduleCache* cache, uint64_t hash, const compilerCtx* comp) {
+    char* filename = moduleImageGetFilename(cache, hash);
+    int length;
+    char* buffer = moduleReadFile(filename, &length);
+    free(filename);
+
+    if (!buffer)
+        return 0;
+
+    moduleImage* image = malloc(sizeof(moduleImage));
+    image->buffer = buffer;
+
+    if (!moduleImageCheck(image, length)) {
+        moduleImageFree(image);
+        return 0;
+    }
+
+    const moduleHeader* header = image->header;
+
+    if (   header->hash != hash
+        || header->builtins != moduleCountBuiltins(comp)
+        || header->interface != (int32_t) comp->interfaces
+        || header->wordsize != comp->arch->wordsize) {
+        moduleImageFree(image);
+        return 0;
+    }
+
+    return image;
+}
+
+void moduleImageFree (moduleImage* image) {
+    if (image)
+        free(image->buffer);
+
+    free(image);
+}
+
+static bool moduleInRange (int32_t index, int32_t length) {
+    return index >= -1 && index < length;
+}
+
+static bool moduleSpanInRange (int32_t start, int32_t length, int32_t total) {
+    return start >= 0 && length >= 0 && start <= total && length <= total-start;
+}
+
+/*Lay out the tables, making sure that every index in them is in range,
+  so that loading doesn't have to*/
+static bool moduleImageCheck (moduleImage* image, int length) {
+    const moduleHeader* header = (const moduleHeader*) image->buffer;
+
+    if (   (size_t) length < sizeof(moduleHeader)
+        || header->magic != moduleMagic || header->version != moduleVersion)
+        return false;
+
+    if (   header->depNo < 0 || header->refNo < 0 || header->symNo < 1 || header->nodeNo < 1
+        || header->listLength < 0 || header->pathLength < 0 || header->stringLength < 0)
+        return false;
+
+    /*Sizes in int64s, so the checks can't overflow*/
+    int64_t expected =   (int64_t) sizeof(moduleHeader)
+                       + (int64_t) header->depNo*sizeof(moduleDepRecord)
+                       + (int64_t) header->refNo*sizeof(moduleRefRecord)
+                       + (int64_t) header->symNo*sizeof(moduleSymRecord)
+                       + (int64_t) header->nodeNo*sizeof(moduleNodeRecord)
+                       + (int64_t) (header->listLength + header->pathLength)*sizeof(int32_t)
+                       + header->stringLength;
+
+    if (expected != length)
+        return false;
+
+    char* next = image->buffer + sizeof(moduleHeader);
+    image->header = header;
+    image->deps = (const moduleDepRecord*) next;
+    next += header->depNo*sizeof(moduleDepRecord);
+    image->refs = (const moduleRefRecord*) next;
+    next += header->refNo*sizeof(moduleRefRecord);
+    image->syms = (const moduleSymRecord*) next;
+    next += header->symNo*sizeof(moduleSymRecord);
+    image->nodes = (const moduleNodeRecord*) next;
+    next += header->nodeNo*sizeof(moduleNodeRecord);
+    image->lists = (const int32_t*) next;
+    next += header->listLength*sizeof(int32_t);
+    image->paths = (const int32_t*) next;
+    next += header->pathLength*sizeof(int32_t);
+    image->strings = next;
+
+    /*Every string ends before the table does*/
+    if (header->stringLength && image->strings[header->stringLength-1])
+        return false;
+
+    int32_t strings = header->stringLength,
+            nodes = header->nodeNo,
+            syms = header->symNo + header->refNo;
+
+    for (int i = 0; i < header->depNo; i++)
+        if (image->deps[i].name < 0 || image->deps[i].name >= strings)
+            return false;
+
+    for (int i = 0; i < header->refNo; i++) {
+        const moduleRefRecord* ref = &image->refs[i];
+
+        if (   ref->module < -1
+            || !moduleSpanInRange(ref->path, ref->length, header->pathLength))
+            return false;
+    }
+
+    for (int i = 0; i < header->symNo; i++) {
+        const moduleSymRecord* record = &image->syms[i];
+
+        /*Parents come before their children, only the scope has none*/
+        if (   record->tag <= symUndefined || record->tag > symParam
+            || !moduleInRange(record->ident, strings)
+            || !moduleInRange(record->parent, i) || (i != 0 && record->parent < 0)
+            || !moduleInRange(record->impl, nodes)
+            || !moduleInRange(record->target, syms)
+            || !moduleInRange(record->adopt, header->refNo) || (i == 0 && record->adopt >= 0)
+            || !moduleSpanInRange(record->decls, record->declNo, header->listLength))
+            return false;
+
+        for (int n = 0; n < record->declNo; n++)
+            if (!moduleInRange(image->lists[record->decls+n], nodes) || image->lists[record->decls+n] < 0)
+                return false;
+    }
+
+    for (int i = 0; i < header->nodeNo; i++) {
+        const moduleNodeRecord* record = &image->nodes[i];
+
+        if (   record->tag <= astUndefined || record->tag > astEllipsis
+            || !moduleInRange(record->l, nodes) || !moduleInRange(record->r, nodes)
+            || !moduleInRange(record->symbol, syms)
+            || !moduleSpanInRange(record->children, record->childNo, header->listLength)
+            || record->literalKind < moduleLiteralNone || record->literalKind > moduleLiteralChar)
+            return false;
+
+        if (   (   record->literalKind == moduleLiteralAtom
+                || record->literalKind == moduleLiteralStr)
+            && (record->literal < 0 || record->literal >= strings))
+            return false;
+
+        for (int n = 0; n < record->childNo; n++)
+            if (!moduleInRange(image->lists[record->children+n], nodes) || image->lists[record->children+n] < 0)
+                return false;
+    }
+
+    return true;
+}
+
+int moduleImageGetLines (const moduleImage* image) {
+    return image->header->lines;
+}
+
+int moduleImageGetDepNo (const moduleImage* image) {
+    return image->header->depNo;
+}
+
+const char* moduleImageGetDepName (const moduleImage* image, int n) {
+    return image->strings + image->deps[n].name;
+}
+
+uint64_t moduleImageGetDepHash (const moduleImage* image, int n) {
+    return image->deps[n].hash;
+}
+
+/*==== Loading ====*/
+
+static sym* moduleImageResolveRef (const moduleImage* image, const moduleRefRecord* ref,
+                                   const sym* global, const vector/*<const sym*>*/* modules) {
+    const sym* Current = ref->module == -1 ? global : vectorGet(modules, ref->module);
+
+    for (int i = 0; Current && i < ref->length; i++) {
+        int n = image->paths[ref->path+i];
+
+        if (n < 0 || n >= Current->children.length)
+            return 0;
+
+        Current = vectorGet(&Current->children, n);
+
+        /*Redeclared since, into another scope*/
+        while (Current->tag == symLink)
+            Current = vectorGet(&Current->children, 0);
+    }
+
+    return (sym*) Current;
+}
+
+static sym* moduleImageGetSym (const moduleImage* image, int32_t index, sym** syms, sym** refs) {
+    if (index < 0)
+        return 0;
+
+    else if (index < image->header->symNo)
+        return syms[index];
+
+    else
+        return refs[index - image->header->symNo];
+}
+
+ast* moduleImageLoad (const moduleImage* image, compilerCtx* comp, sym* scope,
+                      const moduleDep* deps, tokenLocation base) {
+    const moduleHeader* header = image->header;
+
+    /*Find the symbols of other modules first, so that if any have gone
+      missing nothing has been made*/
+
+    vector/*<const sym*>*/ modules;
+    vectorInit(&modules, 16);
+    moduleListDeps(&modules, deps, header->depNo);
+
+    sym** refs = malloc(sizeof(sym*)*(header->refNo+1));
+    bool found = true;
+
+    for (int i = 0; found && i < header->refNo; i++) {
+        refs[i] = moduleImageResolveRef(image, &image->refs[i], comp->global, &modules);
+        found = refs[i] != 0;
+    }
+
+    vectorFree(&modules);
+
+    /*Redeclared symbols must still be what they were*/
+    for (int i = 0; found && i < header->symNo; i++) {
+        const moduleSymRecord* record = &image->syms[i];
+        found = record->adopt < 0 || (int32_t) refs[record->adopt]->tag == record->tag;
+    }
+
+    if (!found) {
+        free(refs);
+        return 0;
+    }
+
+    /*Make every symbol and node, then fill in the references between them*/
+
+    sym** syms = malloc(sizeof(sym*)*header->symNo);
+    ast** nodes = malloc(sizeof(ast*)*header->nodeNo);
+
+    syms[0] = scope;
+
+    for (int i = 1; i < header->symNo; i++) {
+        const moduleSymRecord* record = &image->syms[i];
+
+        if (record->adopt >= 0)
+            syms[i] = refs[record->adopt];
+
+        else {
+            const char* ident = record->ident < 0 ? 0 : atomGetStr(&comp->atoms, image->strings + record->ident);
+            syms[i] = symCreateUnparented(record->tag, ident);
+        }
+    }
+
+    for (int i = 0; i < header->nodeNo; i++) {
+        int32_t location = image->nodes[i].location;
+        nodes[i] = astCreate(image->nodes[i].tag, location ? base + location-1 : 0);
+    }
+
+    for (int i = 1; i < header->symNo; i++) {
+        const moduleSymRecord* record = &image->syms[i];
+        sym* Symbol = syms[i];
+        bool isType =    Symbol->tag == symType || Symbol->tag == symStruct
+                      || Symbol->tag == symUnion || Symbol->tag == symEnum;
+
+        /*Only what the parser might have added to an adopted symbol*/
+        if (record->adopt >= 0) {
+            if (isType && record->complete)
+                Symbol->complete = true;
+
+        } else if (isType) {
+            Symbol->size = record->size;
+            Symbol->typeMask = record->typeMask;
+            Symbol->complete = record->complete;
+
+        } else
+            Symbol->storage = record->storage;
+
+        if (record->target >= 0)
+            vectorPush(&Symbol->children, moduleImageGetSym(image, record->target, syms, refs));
+
+        if (record->impl >= 0)
+            Symbol->impl = nodes[record->impl];
+
+        for (int n = 0; n < record->declNo; n++)
+            vectorPush(&Symbol->decls, nodes[image->lists[record->decls+n]]);
+    }
+
+    /*In order, so that every scope gets its children in the order it had.
+      Adopted symbols are moved as the parser moved them, leaving a link.*/
+    for (int i = 1; i < header->symNo; i++) {
+        if (image->syms[i].adopt >= 0)
+            symChangeParent(syms[i], syms[image->syms[i].parent]);
+
+        else
+            symAddChild(syms[image->syms[i].parent], syms[i]);
+    }
+
+    for (int i = 0; i < header->nodeNo; i++) {
+        const moduleNodeRecord* record = &image->nodes[i];
+        ast* Node = nodes[i];
+
+        Node->o = record->o;
+        Node->l = record->l < 0 ? 0 : nodes[record->l];
+        Node->r = record->r < 0 ? 0 : nodes[record->r];
+        Node->symbol = moduleImageGetSym(image, record->symbol, syms, refs);
+        Node->constant = record->constant;
+
+        for (int n = 0; n < record->childNo; n++)
+            astAddChild(Node, nodes[image->lists[record->children+n]]);
+
+        if (Node->tag == astMarker)
+            Node->marker = record->litTag;
+
+        else
+            Node->litTag = record->litTag;
+
+        const char* str = image->strings + (   record->literalKind == moduleLiteralAtom
+                                            || record->literalKind == moduleLiteralStr
+                                            ? record->literal : 0);
+
+        if (record->literalKind == moduleLiteralAtom)
+            Node->literal = (void*) atomGetStr(&comp->atoms, str);
+
+        /*In the arena, as tokenMatchStr's are*/
+        else if (record->literalKind == moduleLiteralStr)
+            Node->literal = arenaStrdup(arenaGetCurrent(), str);
+
+        else if (record->literalKind == moduleLiteralInt) {
+            Node->literal = arenaAlloc(arenaGetCurrent(), sizeof(int));
+            *(int*) Node->literal = (int) record->literal;
+
+        } else if (record->literalKind == moduleLiteralChar) {
+            Node->literal = arenaAlloc(arenaGetCurrent(), sizeof(char));
+            *(char*) Node->literal = (char) record->literal;
+        }
+    }
+
+    ast* tree = nodes[0];
+
+    free(nodes);
+    free(syms);
+    free(refs);
+
+    return tree;
+}
+
+/*==== Writing ====*/
+
+static int moduleBufferPush (moduleBuffer* buffer, const void* data, int size) {
+    if (buffer->length+size > buffer->capacity) {
+        buffer->capacity = max(2*buffer->capacity, buffer->length+size);
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+
+    int offset = buffer->length;
+    memcpy(buffer->data+offset, data, size);
+    buffer->length += size;
+    return offset;
+}
+
+static int moduleBufferPushInt (moduleBuffer* buffer, int32_t n) {
+    return moduleBufferPush(buffer, &n, sizeof(int32_t)) / sizeof(int32_t);
+}
+
+/*Does the symbol have declarations in this module?*/
+static bool moduleWriterIsDeclared (const moduleWriter* w, const sym* Symbol) {
+    for (int n = 0; n < Symbol->decls.length; n++)
+        if (intmapMap(&w->nodeIndices, (intptr_t) vectorGet(&Symbol->decls, n)))
+            return true;
+
+    return false;
+}
+
+/*Number the symbols of the module in preorder, parents before children*/
+static void moduleWriterAddSym (moduleWriter* w, const sym* Symbol) {
+    int index = vectorPush(&w->syms, (sym*) Symbol);
+    intmapAdd(&w->symIndices, (intptr_t) Symbol, (void*) (intptr_t) (index+1));
+
+    /*The children of links are whatever they link to*/
+    if (Symbol->tag == symModuleLink || Symbol->tag == symLink)
+        return;
+
+    bool adopted = !arenaOwns(w->arena, Symbol);
+    bool added = false;
+
+    for (int n = 0; n < Symbol->children.length; n++) {
+        const sym* Child = vectorGet(&Symbol->children, n);
+
+        /*An adopted symbol keeps the children it came with, and this
+          module's can only follow them*/
+        if (adopted && !arenaOwns(w->arena, Child)) {
+            if (added || moduleWriterIsDeclared(w, Child))
+                w->fail = true;
+
+            continue;
+        }
+
+        added = true;
+        moduleWriterAddSym(w, Child);
+    }
+}
+
+static void moduleWriterAddNode (moduleWriter* w, const ast* Node) {
+    if (!Node || intmapMap(&w->nodeIndices, (intptr_t) Node))
+        return;
+
+    int index = vectorPush(&w->nodes, (ast*) Node);
+    intmapAdd(&w->nodeIndices, (intptr_t) Node, (void*) (intptr_t) (index+1));
+
+    for (int i = 0; i < Node->children; i++)
+        moduleWriterAddNode(w, Node->child[i]);
+
+    moduleWriterAddNode(w, Node->l);
+
+    /*A using holds the tree of a module used for the first time, which
+      is not part of this one*/
+    if (Node->tag != astUsing)
+        moduleWriterAddNode(w, Node->r);
+}
+
+static int32_t moduleWriterNode (moduleWriter* w, const ast* Node) {
+    if (!Node)
+        return -1;
+
+    intptr_t index = (intptr_t) intmapMap(&w->nodeIndices, (intptr_t) Node);
+
+    /*Part of another module*/
+    if (!index)
+        w->fail = true;
+
+    return index-1;
+}
+
+static int32_t moduleWriterSym (moduleWriter* w, const sym* Symbol) {
+    if (!Symbol)
+        return -1;
+
+    intptr_t index = (intptr_t) intmapMap(&w->symIndices, (intptr_t) Symbol);
+
+    if (index)
+        return index-1;
+
+    index = (intptr_t) intmapMap(&w->refIndices, (intptr_t) Symbol);
+
+    if (!index) {
+        /*Redeclared here, but taken by another module since*/
+        if (moduleWriterIsDeclared(w, Symbol))
+            w->fail = true;
+
+        index = moduleWriterRef(w, Symbol)+1;
+        intmapAdd(&w->refIndices, (intptr_t) Symbol, (void*) index);
+    }
+
+    return w->syms.length + index-1;
+}
+
+static int32_t moduleWriterString (moduleWriter* w, const char* str) {
+    if (!str)
+        return -1;
+
+    intptr_t offset = (intptr_t) hashmapMap(&w->stringOffsets, str);
+
+    if (!offset) {
+        offset = moduleBufferPush(&w->strings, str, strlen(str)+1)+1;
+        hashmapAdd(&w->stringOffsets, str, (void*) offset);
+    }
+
+    return offset-1;
+}
+
+/*Describe a symbol of another module by the path of children to it from
+  the scope of its module, which must be one this module uses*/
+static int32_t moduleWriterRef (moduleWriter* w, const sym* Symbol) {
+    const sym* global = w->comp->global;
+
+    vector/*<intptr_t>*/ path;
+    vectorInit(&path, 8);
+
+    const sym* Current = Symbol;
+
+    for (; Current->parent && Current->parent != global; Current = Current->parent)
+        vectorPush(&path, (void*) (intptr_t) Current->nthChild);
+
+    moduleRefRecord ref = {-1, 0, 0, 0};
+
+    if (!Current->parent)
+        w->fail = true;
+
+    else {
+        ref.module = vectorFind(&w->modules, (sym*) Current);
+
+        /*Not a module, a built in type*/
+        if (ref.module < 0) {
+            if (Current->tag == symScope)
+                w->fail = true;
+
+            vectorPush(&path, (void*) (intptr_t) Current->nthChild);
+        }
+    }
+
+    ref.path = w->paths.length / sizeof(int32_t);
+    ref.length = path.length;
+
+    for (int i = path.length; i > 0; i--)
+        moduleBufferPushInt(&w->paths, (intptr_t) vectorGet(&path, i-1));
+
+    vectorFree(&path);
+
+    return moduleBufferPush(&w->refs, &ref, sizeof(ref)) / sizeof(ref);
+}
+
+/*A symbol moved into this module from another is found by the link the
+  move left in its place: at the top of a module it uses, or among the
+  built in types*/
+static int32_t moduleWriterAdoptRef (moduleWriter* w, const sym* Symbol) {
+    for (int m = -1; m < w->modules.length; m++) {
+        const sym* Module = m < 0 ? w->comp->global : vectorGet(&w->modules, m);
+
+        for (int n = 0; n < Module->children.length; n++) {
+            const sym* Link = vectorGet(&Module->children, n);
+
+            if (Link->tag == symLink && vectorGet(&Link->children, 0) == Symbol) {
+                moduleRefRecord ref = {m, w->paths.length / sizeof(int32_t), 1, 0};
+                moduleBufferPushInt(&w->paths, n);
+                return moduleBufferPush(&w->refs, &ref, sizeof(ref)) / sizeof(ref);
+            }
+        }
+    }
+
+    w->fail = true;
+    return -1;
+}
+
+static void moduleWriterSymRecord (moduleWriter* w, const sym* Symbol) {
+    bool root = Symbol == vectorGet(&w->syms, 0),
+         adopted = !root && !arenaOwns(w->arena, Symbol);
+
+    moduleSymRecord record = {
+        .tag = Symbol->tag,
+        .ident = moduleWriterString(w, Symbol->ident),
+        .parent = root ? -1 : moduleWriterSym(w, Symbol->parent),
+        .target = -1,
+        .adopt = adopted ? moduleWriterAdoptRef(w, Symbol) : -1
+    };
+
+    /*The implementation of an adopted symbol may be another module's*/
+    if (!adopted || intmapMap(&w->nodeIndices, (intptr_t) Symbol->impl))
+        record.impl = moduleWriterNode(w, Symbol->impl);
+
+    else
+        record.impl = -1;
+
+    if (   Symbol->tag == symType || Symbol->tag == symStruct
+        || Symbol->tag == symUnion || Symbol->tag == symEnum) {
+        record.size = Symbol->size;
+        record.typeMask = Symbol->typeMask;
+        record.complete = Symbol->complete;
+
+    } else {
+        record.storage = Symbol->storage;
+
+        /*Types are the analyzer's*/
+        if (Symbol->dt)
+            w->fail = true;
+    }
+
+    /*Nor labels, offsets, constants*/
+    if (Symbol->label)
+        w->fail = true;
+
+    if (Symbol->tag == symModuleLink || Symbol->tag == symLink)
+        record.target = moduleWriterSym(w, vectorGet(&Symbol->children, 0));
+
+    /*Those of an adopted symbol from before it was adopted are left be.
+      This module's must come after them.*/
+    record.decls = w->lists.length / sizeof(int32_t);
+
+    for (int n = 0; n < Symbol->decls.length; n++) {
+        const ast* decl = vectorGet(&Symbol->decls, n);
+
+        if (adopted && !record.declNo && !intmapMap(&w->nodeIndices, (intptr_t) decl))
+            continue;
+
+        moduleBufferPushInt(&w->lists, moduleWriterNode(w, decl));
+        record.declNo++;
+    }
+
+    moduleBufferPush(&w->symTable, &record, sizeof(record));
+}
+
+static moduleLiteralKind moduleWriterLiteral (moduleWriter* w, const ast* Node, int64_t* value) {
+    if (!Node->literal)
+        return moduleLiteralNone;
+
+    if (Node->tag == astLiteral) {
+        if (Node->litTag == literalIdent) {
+            *value = moduleWriterString(w, Node->literal);
+            return moduleLiteralAtom;
+
+        } else if (Node->litTag == literalStr) {
+            *value = moduleWriterString(w, Node->literal);
+            return moduleLiteralStr;
+
+        } else if (Node->litTag == literalInt) {
+            *value = *(int*) Node->literal;
+            return moduleLiteralInt;
+
+        } else if (Node->litTag == literalBool || Node->litTag == literalChar) {
+            *value = *(char*) Node->literal;
+            return moduleLiteralChar;
+        }
+
+    } else if (Node->tag == astUsing) {
+        *value = moduleWriterString(w, Node->literal);
+        return moduleLiteralStr;
+
+    /*The name of something anonymous*/
+    } else if (Node->tag == astEmpty || Node->tag == astInvalid) {
+        *value = moduleWriterString(w, Node->literal);
+        return moduleLiteralAtom;
+    }
+
+    w->fail = true;
+    return moduleLiteralNone;
+}
+
+static void moduleWriterNodeRecord (moduleWriter* w, const ast* Node) {
+    moduleNodeRecord record = {
+        .tag = Node->tag,
+        .location = Node->location ? Node->location - w->base + 1 : 0,
+        .o = Node->o,
+        .l = moduleWriterNode(w, Node->l),
+        .r = Node->tag == astUsing ? -1 : moduleWriterNode(w, Node->r),
+        .symbol = moduleWriterSym(w, Node->symbol),
+        .litTag = Node->tag == astMarker ? (int32_t) Node->marker : (int32_t) Node->litTag,
+        .constant = Node->constant
+    };
+
+    record.literalKind = moduleWriterLiteral(w, Node, &record.literal);
+
+    if (Node->location && Node->location < w->base)
+        w->fail = true;
+
+    if (Node->dt)
+        w->fail = true;
+
+    record.children = w->lists.length / sizeof(int32_t);
+    record.childNo = Node->children;
+
+    for (int i = 0; i < Node->children; i++)
+        moduleBufferPushInt(&w->lists, moduleWriterNode(w, Node->child[i]));
+
+    moduleBufferPush(&w->nodeTable, &record, sizeof(record));
+}
+
+bool moduleImageWrite (const moduleCache* cache, uint64_t hash, compilerCtx* comp,
+                       const ast* tree, const sym* scope, tokenLocation base, int lines,
+                       const moduleDep* deps, int depNo) {
+    /*The module's arena is current*/
+    moduleWriter w = {.comp = comp, .arena = arenaGetCurrent(), .base = base};
+
+    vectorInit(&w.modules, 16);
+    vectorInit(&w.syms, 256);
+    vectorInit(&w.nodes, 1024);
+    intmapInit(&w.symIndices, 256);
+    intmapInit(&w.nodeIndices, 1024);
+    intmapInit(&w.refIndices, 64);
+    hashmapInit(&w.stringOffsets, 256);
+
+    moduleListDeps(&w.modules, deps, depNo);
+
+    for (int n = 0; n < depNo; n++) {
+        moduleDepRecord record = {moduleWriterString(&w, deps[n].name), 0, deps[n].hash};
+        moduleBufferPush(&w.deps, &record, sizeof(record));
+    }
+
+    moduleWriterAddNode(&w, tree);
+    moduleWriterAddSym(&w, scope);
+
+    for (int i = 0; !w.fail && i < w.syms.length; i++)
+        moduleWriterSymRecord(&w, vectorGet(&w.syms, i));
+
+    for (int i = 0; !w.fail && i < w.nodes.length; i++)
+        moduleWriterNodeRecord(&w, vectorGet(&w.nodes, i));
+
+    bool written = false;
+
+    if (!w.fail) {
+        moduleHeader header = {
+            .magic = moduleMagic, .version = moduleVersion,
+            .hash = hash,
+            .builtins = moduleCountBuiltins(comp),
+            .interface = comp->interfaces,
+            .wordsize = comp->arch->wordsize,
+            .lines = lines,
+            .depNo = depNo,
+            .refNo = w.refs.length / sizeof(moduleRefRecord),
+            .symNo = w.syms.length,
+            .nodeNo = w.nodes.length,
+            .listLength = w.lists.length / sizeof(int32_t),
+            .pathLength = w.paths.length / sizeof(int32_t),
+            .stringLength = w.strings.length
+        };
+
+        char* filename = moduleImageGetFilename(cache, hash);
+        written = moduleWriterSave(&w, filename, &header);
+        free(filename);
+    }
+
+    vectorFree(&w.modules);
+    vectorFree(&w.syms);
+    vectorFree(&w.nodes);
+    intmapFree(&w.symIndices);
+    intmapFree(&w.nodeIndices);
+    intmapFree(&w.refIndices);
+    hashmapFree(&w.stringOffsets);
+
+    free(w.deps.data);
+    free(w.refs.data);
+    free(w.symTable.data);
+    free(w.nodeTable.data);
+    free(w.lists.data);
+    free(w.paths.data);
+    free(w.strings.data);
+
+    return written;
+}
+
+static bool moduleWriterSave (moduleWriter* w, const char* filename, const moduleHeader* header) {
+    /*Written aside and renamed into place, so that other compilations
+      only ever see a whole image*/
+    char* temporary = malloc(strlen(filename)+32);
+    sprintf(temporary, "%s.%lx", filename,
+            (unsigned long) ((uintptr_t) w ^ (uintptr_t) time(0) ^ (uintptr_t) clock()));
+
+    FILE* file = fopen(temporary, "wb");
+    bool written = false;
+
+    if (file) {
+        const moduleBuffer* tables[] = {&w->deps, &w->refs, &w->symTable, &w->nodeTable,
+                                        &w->lists, &w->paths, &w->strings};
+        written = fwrite(header, sizeof(moduleHeader), 1, file) == 1;
+
+        for (int i = 0; i < (int) (sizeof(tables)/sizeof(tables[0])); i++)
+            if (tables[i]->length)
+                written &= fwrite(tables[i]->data, tables[i]->length, 1, file) == 1;
+
+        written &= fclose(file) == 0;
+        written = written && rename(temporary, filename) == 0;
+
+        if (!written)
+            remove(temporary);
+    }
+
+    free(temporary);
+    return written;
+}
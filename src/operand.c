@@ -142,7 +142,7 @@ int operandGetSize (const architecture* arch, operand Value) {
         return 0;
 
     else if (Value.tag == operandReg)
-        return Value.base->allocatedAs;
+        return Value.size ? Value.size : regGetSize(Value.base);
 
     else if (Value.tag == operandMem || Value.tag == operandLabelMem)
         return Value.size;
@@ -175,7 +175,7 @@ char* operandToStr (operand Value) {
         return strdup(conditions[Value.condition]);
 
     } else if (Value.tag == operandReg)
-        return strdup(regGetStr(Value.base));
+        return strdup(regGetName(Value.base, Value.size ? Value.size : regGetSize(Value.base)));
 
     else if (Value.tag == operandMem || Value.tag == operandLabelMem) {
         const char* sizeStr;
@@ -10,6 +10,8 @@ typedef enum expectTag {
     expectNothing,
     expectOutput,
     expectIncludeSearchPath,
+    expectJobs,
+    expectModuleCache,
     expectTheUnexpected
 } expectTag;
 
@@ -22,6 +24,7 @@ static void stateSetExpect (optionsState* state, expectTag expect, const char* o
 
 static void optionsParseMacro (config* conf, optionsState* state, const char* option);
 static void optionsParseMicro (config* conf, optionsState* state, const char* option);
+static void optionsParseJobs (config* conf, const char* count);
 
 /*==== Program configuration ====*/
 
@@ -30,6 +33,11 @@ config configCreate () {
     conf.fail = false;
     conf.mode = modeDefault;
     conf.deleteAsm = true;
+    conf.memStats = false;
+    conf.interfaces = false;
+    conf.peepholeStats = false;
+    conf.jobs = 0;
+    conf.moduleCache = 0;
 
     archInit(&conf.arch);
 
@@ -53,6 +61,9 @@ void configDestroy (config conf) {
 
     free(conf.output);
     conf.output = 0;
+
+    free(conf.moduleCache);
+    conf.moduleCache = 0;
 }
 
 static void configSetMode (config* conf, configMode mode, const char* option) {
@@ -82,6 +93,15 @@ static void optionsParseMacro (config* conf, optionsState* state, const char* op
     else if (!strcmp(option, "--help"))
         configSetMode(conf, modeHelp, option);
 
+    else if (!strcmp(option, "--mem-stats"))
+        conf->memStats = true;
+
+    else if (!strcmp(option, "--interfaces"))
+        conf->interfaces = true;
+
+    else if (!strcmp(option, "--peephole-stats"))
+        conf->peepholeStats = true;
+
     else
         printf("fcc: Unknown option '%s'\n", option);
 }
@@ -106,11 +126,35 @@ static void optionsParseMicro (config* conf, optionsState* state, const char* op
         else if (suboption == 'I')
             stateSetExpect(state, expectIncludeSearchPath, asStr);
 
+        else if (suboption == 'M')
+            stateSetExpect(state, expectModuleCache, asStr);
+
+        /*The job count can be given in the same option, -j4*/
+        else if (suboption == 'j') {
+            if (option[j+1]) {
+                optionsParseJobs(conf, option+j+1);
+                break;
+
+            } else
+                stateSetExpect(state, expectJobs, asStr);
+        }
+
         else
             printf("fcc: Unknown option '%c' in '%s'\n", suboption, option);
     }
 }
 
+static void optionsParseJobs (config* conf, const char* count) {
+    char* end;
+    long jobs = strtol(count, &end, 10);
+
+    if (*end || jobs < 1 || jobs > 1024)
+        printf("fcc: Invalid job count '%s'\n", count);
+
+    else
+        conf->jobs = jobs;
+}
+
 void optionsParse (config* conf, int argc, char** argv) {
     optionsState state = {expectNothing};
 
@@ -119,7 +163,10 @@ void optionsParse (config* conf, int argc, char** argv) {
 
         if (strprefix(option, "-")) {
             if (state.expect != expectNothing) {
-                const char* noun = state.expect == expectOutput ? "output file" : "include search path";
+                const char* noun =   state.expect == expectOutput ? "output file"
+                                   : state.expect == expectJobs ? "job count"
+                                   : state.expect == expectModuleCache ? "module image directory"
+                                   : "include search path";
                 printf("fcc: Expected %s for preceding option, found option '%s'\n", noun, option);
                 state.expect = expectNothing;
             }
@@ -144,6 +191,19 @@ void optionsParse (config* conf, int argc, char** argv) {
                 vectorPush(&conf->includeSearchPaths, strdup(option));
                 state.expect = expectNothing;
 
+            } else if (state.expect == expectJobs) {
+                optionsParseJobs(conf, option);
+                state.expect = expectNothing;
+
+            } else if (state.expect == expectModuleCache) {
+                if (conf->moduleCache) {
+                    printf("fcc: Overriding previous module image directory with '%s'\n", option);
+                    free(conf->moduleCache);
+                }
+
+                conf->moduleCache = strdup(option);
+                state.expect = expectNothing;
+
             } else {
                 if (fexists(option)) {
                     vectorPush(&conf->inputs, strdup(option));
@@ -4,6 +4,8 @@
 #include "../inc/sym.h"
 #include "../inc/ast.h"
 #include "../inc/error.h"
+#include "../inc/compiler.h"
+#include "../inc/atom.h"
 
 #include "../inc/lexer.h"
 
@@ -11,6 +13,7 @@
 
 static ast* parserStorage (parserCtx* ctx, symTag* tag);
 static ast* parserFnImpl (parserCtx* ctx, ast* decl);
+static tokenLocation parserSkipBody (parserCtx* ctx);
 
 static ast* parserField (parserCtx* ctx);
 static ast* parserEnumField (parserCtx* ctx);
@@ -75,9 +78,8 @@ static void parserCreateParamSymbols (ast* Node, sym* scope) {
     }
 
     /*For each param*/
-    for (ast* param = call->firstChild;
-         param;
-         param = param->nextSibling) {
+    for (int i = 0; i < call->children; i++) {
+        ast* param = call->child[i];
         /*Trace up to find the identifier*/
 
         ast* ident = param;
@@ -198,7 +200,7 @@ static ast* parserStorage (parserCtx* ctx, symTag* tag) {
 static ast* parserFnImpl (parserCtx* ctx, ast* decl) {
     debugEnter("FnImpl");
 
-    sym* fn = decl->firstChild->symbol;
+    sym* fn = decl->child[0]->symbol;
 
     ast* Node = astCreateFnImpl(ctx->location, decl);
     Node->symbol = fn;
@@ -211,20 +213,45 @@ static ast* parserFnImpl (parserCtx* ctx, ast* decl) {
     else {
         fn->impl = Node;
         /*Now that we have the implementation, create param symbols*/
-        parserCreateParamSymbols(decl->firstChild, fn);
+        parserCreateParamSymbols(decl->child[0], fn);
     }
 
     /*Body*/
 
-    sym* OldScope = scopeSet(ctx, fn);
-    Node->r = parserCode(ctx);
-    ctx->scope = OldScope;
+    if (ctx->interface) {
+        Node->constant = parserSkipBody(ctx) - Node->location;
+        ctx->skipped++;
+
+    } else {
+        sym* OldScope = scopeSet(ctx, fn);
+        Node->r = parserCode(ctx);
+        ctx->scope = OldScope;
+    }
 
     debugLeave();
 
     return Node;
 }
 
+/*Skip a body by matching braces, without parsing it, returning the
+  location of the closing brace*/
+static tokenLocation parserSkipBody (parserCtx* ctx) {
+    tokenMatchPunct(ctx, punctLBrace);
+
+    for (int depth = 1; ctx->lexer->token != tokenEOF; tokenNext(ctx)) {
+        if (tokenIsPunct(ctx, punctLBrace))
+            depth++;
+
+        else if (tokenIsPunct(ctx, punctRBrace) && --depth == 0)
+            break;
+    }
+
+    /*Missing at EOF, which parserCode also lets go*/
+    tokenLocation end = ctx->location;
+    tokenTryMatchPunct(ctx, punctRBrace);
+    return end;
+}
+
 /**
  * Field = DeclBasic [ DeclExpr# [{ "," DeclExpr# }] ] ";"
  *
@@ -305,10 +332,10 @@ static ast* parserDeclBasic (parserCtx* ctx) {
 
     else {
         tokenLocation loc = ctx->location;
-        sym* Symbol = symFind(ctx->scope, ctx->lexer->buffer);
+        sym* Symbol = symFind(ctx->scope, tokenGetAtom(ctx));
 
         if (Symbol) {
-            Node = astCreateLiteralIdent(loc, tokenDupMatch(ctx));
+            Node = astCreateLiteralIdent(loc, tokenMatchAtom(ctx));
             Node->symbol = Symbol;
 
         } else {
@@ -358,7 +385,7 @@ static ast* parserStructOrUnion (parserCtx* ctx) {
     /*Anonymous struct, will require a body*/
     else {
         name = astCreateEmpty(loc);
-        name->literal = strdup("");
+        name->literal = (void*) "";
         name->symbol = symCreateNamed(tag, ctx->scope, "");
     }
 
@@ -412,7 +439,7 @@ static ast* parserEnum (parserCtx* ctx) {
 
     else {
         name = astCreateEmpty(loc);
-        name->literal = strdup("");
+        name->literal = (void*) "";
         name->symbol = symCreateNamed(symEnum, ctx->scope, "");
     }
 
@@ -561,10 +588,11 @@ void parserParamList (parserCtx* ctx, ast* Node, bool inDecl) {
           or the beginning of a void* parameter*/
         if (tokenTryMatchKeyword(ctx, keywordVoid)) {
             if (!tokenIsPunct(ctx, punctRParen)) {
-                ast* basic = astCreateLiteralIdent(voidloc, strdup("void"));
+                const char* voidAtom = atomGetStr(&ctx->comp->atoms, "void");
+                ast* basic = astCreateLiteralIdent(voidloc, voidAtom);
                 ast* expr = parserDeclExpr(ctx, inDecl, symParam);
                 ast* param = astCreateParam(voidloc, basic, expr);
-                param->symbol = basic->symbol = symFind(ctx->scope, "void");
+                param->symbol = basic->symbol = symFind(ctx->scope, voidAtom);
                 astAddChild(Node, param);
 
                 if (!tokenTryMatchPunct(ctx, punctComma))
@@ -659,11 +687,11 @@ static ast* parserName (parserCtx* ctx, bool inDecl, symTag tag) {
 
     if (tokenIsIdent(ctx)) {
         tokenLocation loc = ctx->location;
-        Node = astCreateLiteralIdent(loc, tokenDupMatch(ctx));
+        Node = astCreateLiteralIdent(loc, tokenMatchAtom(ctx));
 
         /*Check for a collision only in this scope, will shadow any
           other declarations elsewhere.*/
-        sym* Symbol = symFind(ctx->scope, (char*) Node->literal);
+        sym* Symbol = symFind(ctx->scope, Node->literal);
 
         if (Symbol) {
             Node->symbol = Symbol;
@@ -673,7 +701,7 @@ static ast* parserName (parserCtx* ctx, bool inDecl, symTag tag) {
                 errorRedeclaredSymAs(ctx, Node->symbol, tag);
 
         } else if (inDecl)
-            Node->symbol = symCreateNamed(tag, ctx->scope, (char*) Node->literal);
+            Node->symbol = symCreateNamed(tag, ctx->scope, Node->literal);
 
         if (Node->symbol) {
             /*Can't tell whether this is a duplicate declaration
@@ -690,7 +718,7 @@ static ast* parserName (parserCtx* ctx, bool inDecl, symTag tag) {
             errorExpected(ctx, "identifier");
 
         Node = astCreateInvalid(ctx->location);
-        Node->literal = strdup("");
+        Node->literal = (void*) "";
         Node->symbol = symCreateNamed(tag, ctx->scope, "");
     }
 
@@ -4,6 +4,9 @@
 #include "../inc/sym.h"
 #include "../inc/ast.h"
 #include "../inc/error.h"
+#include "../inc/compiler.h"
+#include "../inc/atom.h"
+#include "../inc/arena.h"
 
 #include "stdlib.h"
 #include "stdarg.h"
@@ -47,7 +50,7 @@ bool tokenIsChar (const parserCtx* ctx) {
 }
 
 bool tokenIsDecl (const parserCtx* ctx) {
-    sym* Symbol = tokenIsIdent(ctx) ? symFind(ctx->scope, ctx->lexer->buffer) : 0;
+    sym* Symbol = tokenIsIdent(ctx) ? symFind(ctx->scope, ctx->lexer->atom) : 0;
 
     return    (Symbol && Symbol->tag != symId
                       && Symbol->tag != symParam)
@@ -60,11 +63,17 @@ bool tokenIsDecl (const parserCtx* ctx) {
            || tokenIsKeyword(ctx, keywordChar) || tokenIsKeyword(ctx, keywordInt);
 }
 
+const token* tokenPeek (const parserCtx* ctx, int n) {
+    return lexerPeek(ctx->lexer, n);
+}
+
+bool tokenPeekIsPunct (const parserCtx* ctx, int n, punctTag punct) {
+    return tokenPeek(ctx, n)->punct == punct;
+}
+
 void tokenNext (parserCtx* ctx) {
     lexerNext(ctx->lexer);
-    ctx->location = (tokenLocation) {ctx->filename,
-                                     ctx->lexer->line,
-                                     ctx->lexer->lineChar};
+    ctx->location = ctx->lexer->location;
 }
 
 void tokenSkipMaybe (parserCtx* ctx) {
@@ -73,12 +82,21 @@ void tokenSkipMaybe (parserCtx* ctx) {
 }
 
 void tokenMatch (parserCtx* ctx) {
-    debugMsg("matched:%d:%d: '%s'", ctx->location.line, ctx->location.lineChar, ctx->lexer->buffer);
+    debugMsg("matched:%u: '%s'", ctx->location, lexerGetStr(ctx->lexer));
     tokenNext(ctx);
 }
 
-char* tokenDupMatch (parserCtx* ctx) {
-    char* Old = strdup(ctx->lexer->buffer);
+const char* tokenGetAtom (const parserCtx* ctx) {
+    /*Identifiers were interned by the lexer*/
+    if (ctx->lexer->atom)
+        return ctx->lexer->atom;
+
+    else
+        return atomGet(&ctx->comp->atoms, ctx->lexer->slice, ctx->lexer->length);
+}
+
+const char* tokenMatchAtom (parserCtx* ctx) {
+    const char* Old = tokenGetAtom(ctx);
 
     tokenMatch(ctx);
 
@@ -165,15 +183,20 @@ void tokenMatchToken (parserCtx* ctx, tokenTag Match) {
 }
 
 int tokenMatchInt (parserCtx* ctx) {
-    int ret = atoi(ctx->lexer->buffer);
+    int ret = 0;
+
+    /*Integer tokens are only ever digits*/
+    if (tokenIsInt(ctx))
+        for (int i = 0; i < ctx->lexer->length; i++)
+            ret = ret*10 + (ctx->lexer->slice[i] - '0');
 
     tokenMatchToken(ctx, tokenInt);
 
     return ret;
 }
 
-char* tokenMatchIdent (parserCtx* ctx) {
-    char* Old = strdup(ctx->lexer->buffer);
+const char* tokenMatchIdent (parserCtx* ctx) {
+    const char* Old = tokenGetAtom(ctx);
 
     tokenMatchToken(ctx, tokenIdent);
 
@@ -181,22 +204,25 @@ char* tokenMatchIdent (parserCtx* ctx) {
 }
 
 char* tokenMatchStr (parserCtx* ctx) {
-    int total = ctx->lexer->length;
+    /*Room for the terminator*/
+    int total = ctx->lexer->length+1;
     char* str = calloc(total, sizeof(char));
 
     if (tokenIsString(ctx)) {
+        const char* buffer = ctx->lexer->slice;
+
         for (int i = 0, length = 0; i+1 < total; i++) {
             /*Escape sequence*/
-            if (ctx->lexer->buffer[i] == '\\') {
+            if (buffer[i] == '\\') {
                 i++;
 
-                if (   ctx->lexer->buffer[i] == 'n' || ctx->lexer->buffer[i] == 'r'
-                    || ctx->lexer->buffer[i] == 't' || ctx->lexer->buffer[i] == '\\'
-                    || ctx->lexer->buffer[i] == '\'' || ctx->lexer->buffer[i] == '"') {
+                if (   buffer[i] == 'n' || buffer[i] == 'r'
+                    || buffer[i] == 't' || buffer[i] == '\\'
+                    || buffer[i] == '\'' || buffer[i] == '"') {
                     str[length++] = '\\';
-                    str[length++] = ctx->lexer->buffer[i];
+                    str[length++] = buffer[i];
 
-                } else if (ctx->lexer->buffer[i] == 'e') {
+                } else if (buffer[i] == 'e') {
                     str = realloc(str, total+3);
 					memset(&str[total+1], sizeof(str[0])*3, 0);
 					total += 3;
@@ -207,8 +233,8 @@ char* tokenMatchStr (parserCtx* ctx) {
                     str[length++] = '3';
 
                 /*An actual linebreak mid string? Escaped, ignore it*/
-                } else if (   ctx->lexer->buffer[i] == '\n'
-                           || ctx->lexer->buffer[i] == '\r') {
+                } else if (   buffer[i] == '\n'
+                           || buffer[i] == '\r') {
                     i++;
 
                 /*Unrecognised escape: ignore*/
@@ -216,7 +242,7 @@ char* tokenMatchStr (parserCtx* ctx) {
                     i++;
 
             } else
-                str[length++] = ctx->lexer->buffer[i];
+                str[length++] = buffer[i];
         }
 
         tokenMatch(ctx);
@@ -224,23 +250,28 @@ char* tokenMatchStr (parserCtx* ctx) {
     } else
         errorExpected(ctx, "string");
 
-    return str;
+    /*Moved into the arena with the rest of the AST*/
+    char* copy = arenaStrdup(arenaGetCurrent(), str);
+    free(str);
+    return copy;
 }
 
 char tokenMatchChar (parserCtx* ctx) {
     char ret = '\0';
 
     if (tokenIsChar(ctx)) {
-        if (ctx->lexer->buffer[0] == '\\') {
-            if (ctx->lexer->buffer[1] == 'n') ret = '\n';
-            else if (ctx->lexer->buffer[1] == 'r') ret = '\r';
-            else if (ctx->lexer->buffer[1] == 't') ret = '\t';
-            else if (ctx->lexer->buffer[1] == '\\') ret = '\\';
-            else if (ctx->lexer->buffer[1] == '\'') ret = '\'';
-            else if (ctx->lexer->buffer[1] == '"') ret = '"';
+        const char* buffer = ctx->lexer->slice;
+
+        if (buffer[0] == '\\') {
+            if (buffer[1] == 'n') ret = '\n';
+            else if (buffer[1] == 'r') ret = '\r';
+            else if (buffer[1] == 't') ret = '\t';
+            else if (buffer[1] == '\\') ret = '\\';
+            else if (buffer[1] == '\'') ret = '\'';
+            else if (buffer[1] == '"') ret = '"';
 
         } else
-            ret = ctx->lexer->buffer[0];
+            ret = buffer[0];
 
         tokenMatch(ctx);
 
@@ -6,6 +6,7 @@
 #include "../inc/error.h"
 
 #include "../inc/lexer.h"
+#include "../inc/arena.h"
 
 #include "stdlib.h"
 #include "string.h"
@@ -25,7 +26,7 @@ static ast* parserObject (parserCtx* ctx);
 static ast* parserFactor (parserCtx* ctx);
 static ast* parserElementInit (parserCtx* ctx);
 static ast* parserDesignatedInit (parserCtx* ctx, ast* element, bool array);
-static ast* parserLambda (parserCtx* ctx, bool partial);
+static ast* parserLambda (parserCtx* ctx);
 static ast* parserVA (parserCtx* ctx);
 
 /**
@@ -311,7 +312,7 @@ static ast* parserObject (parserCtx* ctx) {
                         tokenTryMatchPunct(ctx, punctArrow) ? opMemberDeref : opUndefined)) {
             ast* field = astCreateLiteral(loc, literalIdent);
             Node = astCreateBOP(loc, Node, o, field);
-            field->literal = (void*) strdup(ctx->lexer->buffer);
+            field->literal = (void*) tokenGetAtom(ctx);
 
             if (tokenIsIdent(ctx))
                 tokenMatch(ctx);
@@ -403,18 +404,18 @@ static ast* parserFactor (parserCtx* ctx) {
 
     /*Lambda*/
     } else if (tokenIsPunct(ctx, punctLBracket)) {
-        Node = parserLambda(ctx, false);
+        Node = parserLambda(ctx);
 
     /*Integer*/
     } else if (tokenIsInt(ctx)) {
         Node = astCreateLiteral(ctx->location, literalInt);
-        Node->literal = malloc(sizeof(int));
+        Node->literal = arenaAlloc(arenaGetCurrent(), sizeof(int));
         *(int*) Node->literal = tokenMatchInt(ctx);
 
     /*Boolean*/
     } else if (tokenIsKeyword(ctx, keywordTrue) || tokenIsKeyword(ctx, keywordFalse)) {
         Node = astCreateLiteral(ctx->location, literalBool);
-        Node->literal = malloc(sizeof(char));
+        Node->literal = arenaAlloc(arenaGetCurrent(), sizeof(char));
         *(char*) Node->literal = tokenIsKeyword(ctx, keywordTrue) ? 1 : 0;
 
         tokenMatch(ctx);
@@ -427,7 +428,7 @@ static ast* parserFactor (parserCtx* ctx) {
     /*Character*/
     } else if (tokenIsChar(ctx)) {
         Node = astCreateLiteral(ctx->location, literalChar);
-        Node->literal = malloc(sizeof(char));
+        Node->literal = arenaAlloc(arenaGetCurrent(), sizeof(char));
         *(char*) Node->literal = tokenMatchChar(ctx);
 
     /*va_start va_end va_arg va_copy*/
@@ -445,12 +446,12 @@ static ast* parserFactor (parserCtx* ctx) {
 
     /*Identifier*/
     } else if (tokenIsIdent(ctx)) {
-        sym* Symbol = symFind(ctx->scope, (char*) ctx->lexer->buffer);
+        sym* Symbol = symFind(ctx->scope, tokenGetAtom(ctx));
 
         /*Valid symbol?*/
         if (Symbol) {
             Node = astCreateLiteral(ctx->location, literalIdent);
-            Node->literal = (char*) tokenDupMatch(ctx);
+            Node->literal = (void*) tokenMatchAtom(ctx);
             Node->symbol = Symbol;
 
         } else {
@@ -473,7 +474,7 @@ static ast* parserFactor (parserCtx* ctx) {
 /**
  * ElementInit = [   (   ( "." <Ident> )
  *                     | ( "[" Value "]" ) DesignatedInit )
- *                 | AssignValue ]
+ *                 | Lambda | AssignValue ]
  */
 static ast* parserElementInit (parserCtx* ctx) {
     debugEnter("ElementInit");
@@ -488,7 +489,7 @@ static ast* parserElementInit (parserCtx* ctx) {
     /*Struct designated initializer*/
     else if (tokenTryMatchPunct(ctx, punctPeriod)) {
         ast* field = astCreateLiteral(loc, literalIdent);
-        field->literal = (void*) strdup(ctx->lexer->buffer);
+        field->literal = (void*) tokenGetAtom(ctx);
 
         if (tokenIsIdent(ctx))
             tokenMatch(ctx);
@@ -498,19 +499,16 @@ static ast* parserElementInit (parserCtx* ctx) {
 
         Node = parserDesignatedInit(ctx, field, false);
 
-    /*Array designated initializer, or the beginning of a lambda*/
-    } else if (tokenTryMatchPunct(ctx, punctLBracket)) {
-        /*Lambda*/
-        if (tokenIsPunct(ctx, punctRBracket))
-            Node = parserLambda(ctx, true);
+    /*Lambda, which starts "[]" where a designator can't*/
+    } else if (tokenIsPunct(ctx, punctLBracket) && tokenPeekIsPunct(ctx, 1, punctRBracket))
+        Node = parserLambda(ctx);
 
-        /*Designated initializer*/
-        else {
-            ast* element = parserValue(ctx);
-            tokenMatchPunct(ctx, punctRBracket);
+    /*Array designated initializer*/
+    else if (tokenTryMatchPunct(ctx, punctLBracket)) {
+        ast* element = parserValue(ctx);
+        tokenMatchPunct(ctx, punctRBracket);
 
-            Node = parserDesignatedInit(ctx, element, true);
-        }
+        Node = parserDesignatedInit(ctx, element, true);
 
     /*Regular value*/
     } else
@@ -544,7 +542,7 @@ static ast* parserDesignatedInit (parserCtx* ctx, ast* element, bool array) {
  * Lambda = "[" "]" ParamList
  *          ( "{" Code "}" ) | ( "(" Value ")" )
  */
-static ast* parserLambda (parserCtx* ctx, bool partial) {
+static ast* parserLambda (parserCtx* ctx) {
     debugEnter("Lambda");
 
     ast* Node = astCreateLiteral(ctx->location, literalLambda);
@@ -553,9 +551,7 @@ static ast* parserLambda (parserCtx* ctx, bool partial) {
 
     /*Capture (not supported yet)*/
 
-    if (!partial)
-        tokenMatchPunct(ctx, punctLBracket);
-
+    tokenMatchPunct(ctx, punctLBracket);
     tokenMatchPunct(ctx, punctRBracket);
 
     /*Params*/
@@ -616,11 +612,11 @@ static ast* parserVA (parserCtx* ctx) {
         /*va_start takes a parameter name
           Validate it as an ident but don't validate the symbol*/
         if (tag == astVAStart) {
-            sym* Symbol = symFind(ctx->scope, (char*) ctx->lexer->buffer);
+            sym* Symbol = symFind(ctx->scope, tokenGetAtom(ctx));
 
             if (tokenIsIdent(ctx) && Symbol) {
                 Node->r = astCreateLiteral(ctx->location, literalIdent);
-                Node->r->literal = (char*) tokenDupMatch(ctx);
+                Node->r->literal = (void*) tokenMatchAtom(ctx);
                 Node->r->symbol = Symbol;
 
             } else {
@@ -8,10 +8,24 @@
 
 #include "../inc/compiler.h"
 #include "../inc/lexer.h"
+#include "../inc/arena.h"
+#include "../inc/module.h"
 
 #include "stdlib.h"
 #include "string.h"
 
+static parserResult parserFile (const char* filename, const char* initialPath, compilerCtx* comp, bool used);
+static parserResult parserParseFile (const char* filename, const char* fullname, sym* scope, compilerCtx* comp, bool used);
+
+static bool parserImageIsValid (compilerCtx* comp, const char* fullname);
+static bool parserLoadImage (parserResult* res, const char* filename, const char* fullname,
+                             sym* scope, compilerCtx* comp, moduleCacheEntry* entry);
+static void parserSaveImage (parserCtx* ctx, const ast* Module, int lines);
+
+static void parserReach (compilerCtx* comp, ast* tree, intset/*<const ast*>*/* trees, ast* Node);
+static parserResult* parserGetModule (compilerCtx* comp, const ast* Node);
+static const parserResult* parserBody (compilerCtx* comp, ast* FnImpl);
+
 static ast* parserModule (parserCtx* ctx);
 static ast* parserUsing (parserCtx* ctx);
 
@@ -22,9 +36,15 @@ static ast* parserWhile (parserCtx* ctx);
 static ast* parserDoWhile (parserCtx* ctx);
 static ast* parserFor (parserCtx* ctx);
 
-static void parserInit (parserCtx* ctx, sym* scope, char* filename, char* fullname, compilerCtx* comp) {
-    ctx->lexer = lexerInit(fullname);
-    ctx->location = (tokenLocation) {0, 0, 0};
+static void parserInit (parserCtx* ctx, sym* scope, char* filename, const char* fullname, compilerCtx* comp) {
+    ctx->lexer = lexerInit(fullname, &comp->atoms);
+
+    /*Give the file its range of locations before any tokens are made*/
+    ctx->file = sourceAddFile(&comp->sources, filename, ctx->lexer->stream->buffer, ctx->lexer->stream->length);
+    ctx->lexer->base = sourceGetLocation(&comp->sources, ctx->file, 0);
+
+    lexerTokenize(ctx->lexer);
+    ctx->location = 0;
 
     ctx->filename = filename;
     ctx->fullname = fullname;
@@ -37,6 +57,9 @@ static void parserInit (parserCtx* ctx, sym* scope, char* filename, char* fullna
 
     ctx->breakLevel = 0;
 
+    ctx->interface = false;
+    ctx->skipped = 0;
+
     ctx->errors = 0;
     ctx->warnings = 0;
 
@@ -50,7 +73,9 @@ static void parserEnd (parserCtx* ctx) {
     free(ctx->path);
     ctx->path = 0;
 
-    lexerEnd(ctx->lexer);
+    if (ctx->lexer)
+        lexerEnd(ctx->lexer);
+
     ctx->lexer = 0;
 }
 
@@ -90,24 +115,53 @@ static char* parserFindFile (const char* filename, const char* initialPath, cons
 }
 
 parserResult parser (const char* filename, const char* initialPath, compilerCtx* comp) {
+    return parserFile(filename, initialPath, comp, false);
+}
+
+static parserResult parserFile (const char* filename, const char* initialPath, compilerCtx* comp, bool used) {
     char* fullname = parserFindFile(filename, initialPath, comp->searchPaths);
 
     if (fullname) {
         parserResult* module = hashmapMap(&comp->modules, fullname);
 
         if (!module) {
+            /*Everything the module creates lives in its own arena,
+              switch back for whoever is using it*/
+            arena* moduleArena = arenaInit(malloc(sizeof(arena)), 64*1024);
+            arena* oldArena = arenaSetCurrent(moduleArena);
+
             sym* scope = symCreateScope(comp->global);
 
-            parserCtx ctx;
-            parserInit(&ctx, scope, fstripname(filename, malloc), fullname, comp);
-            ast* Module = parserModule(&ctx);
-            parserEnd(&ctx);
+            /*A used module might have an image to load instead*/
+            moduleCacheEntry* entry =   used && comp->moduleCache.dir
+                                      ? moduleCacheGetEntry(&comp->moduleCache, fullname) : 0;
+
+            parserResult res;
+
+            if (   !entry || !parserImageIsValid(comp, fullname)
+                || !parserLoadImage(&res, filename, fullname, scope, comp, entry))
+                res = parserParseFile(filename, fullname, scope, comp, used);
+
+            /*The source was only kept to be hashed and, if loaded, located*/
+            if (entry) {
+                free(entry->source);
+                entry->source = 0;
+            }
+
+            symModuleExport(scope);
+
+            arenaSetCurrent(oldArena);
+
+            res.arena = moduleArena;
+            res.fullname = fullname;
 
             module = malloc(sizeof(parserResult));
             hashmapAdd(&comp->modules, fullname, module);
+            vectorPush(&comp->moduleList, module);
 
-            *module = (parserResult) {Module, scope, ctx.filename, ctx.errors, ctx.warnings, false, false};
-            return    (parserResult) {Module, scope, ctx.filename, ctx.errors, ctx.warnings, true, false};
+            *module = res;
+            res.firsttime = true;
+            return res;
 
         } else {
             free(fullname);
@@ -115,12 +169,290 @@ parserResult parser (const char* filename, const char* initialPath, compilerCtx*
         }
 
     } else
-        return (parserResult) {astCreateInvalid((tokenLocation) {0, 0, 0}), 0,
-                               0, 0, 0, false, true};
+        return (parserResult) {astCreateInvalid(0), 0,
+                               0, 0, 0, false, true, 0, 0, 0, 0, 0};
+}
+
+static parserResult parserParseFile (const char* filename, const char* fullname, sym* scope, compilerCtx* comp, bool used) {
+    parserCtx ctx;
+    parserInit(&ctx, scope, fstripname(filename, malloc), fullname, comp);
+    ctx.interface = used && comp->interfaces;
+    ast* Module = parserModule(&ctx);
+
+    /*The EOF token is on the last line, or just after it*/
+    sourceLocation eof = sourceDecode(&comp->sources, ctx.location);
+    int lines = eof.line - (eof.lineChar == 1 ? 1 : 0);
+
+    if (used && comp->moduleCache.dir && !ctx.errors && !ctx.warnings)
+        parserSaveImage(&ctx, Module, lines);
+
+    /*Keep the tokens for the bodies skipped*/
+    lexerCtx* lexer = ctx.skipped ? ctx.lexer : 0;
+
+    if (lexer)
+        ctx.lexer = 0;
+
+    parserEnd(&ctx);
+
+    return (parserResult) {Module, scope, ctx.filename, ctx.errors, ctx.warnings, false, false, 0, lines,
+                           ctx.file, 0, lexer};
+}
+
+/*==== Module images ====*/
+
+/*An image can be loaded in place of the module only if the module and
+  every module it uses, all the way down, are as they were when it was
+  made: then the parser would do exactly as it did then*/
+static bool parserImageIsValid (compilerCtx* comp, const char* fullname) {
+    moduleCacheEntry* entry = moduleCacheGetEntry(&comp->moduleCache, fullname);
+
+    if (!entry)
+        return false;
+
+    /*Checking already, so this is a cycle, which is never valid*/
+    if (entry->state == moduleChecking)
+        return false;
+
+    else if (entry->state != moduleUnchecked)
+        return entry->state == moduleValid;
+
+    entry->state = moduleChecking;
+    entry->image = moduleImageRead(&comp->moduleCache, entry->hash, comp);
+
+    bool valid = entry->image != 0;
+    char* path = fgetpath(fullname, malloc);
+
+    for (int n = 0; valid && n < moduleImageGetDepNo(entry->image); n++) {
+        char* depFullname = parserFindFile(moduleImageGetDepName(entry->image, n), path, comp->searchPaths);
+
+        valid =    depFullname && parserImageIsValid(comp, depFullname)
+                &&    moduleCacheGetEntry(&comp->moduleCache, depFullname)->hash
+                   == moduleImageGetDepHash(entry->image, n);
+
+        free(depFullname);
+    }
+
+    free(path);
+
+    if (!valid) {
+        moduleImageFree(entry->image);
+        entry->image = 0;
+    }
+
+    entry->state = valid ? moduleValid : moduleInvalid;
+    return valid;
+}
+
+/*Build the module from its image, first doing what its using statements
+  would have*/
+static bool parserLoadImage (parserResult* res, const char* filename, const char* fullname,
+                             sym* scope, compilerCtx* comp, moduleCacheEntry* entry) {
+    const moduleImage* image = entry->image;
+    int depNo = moduleImageGetDepNo(image);
+
+    parserResult* used = malloc(sizeof(parserResult)*depNo);
+    moduleDep* deps = malloc(sizeof(moduleDep)*depNo);
+    bool found = true;
+
+    char* path = fgetpath(fullname, malloc);
+
+    for (int n = 0; n < depNo; n++) {
+        const char* name = moduleImageGetDepName(image, n);
+        used[n] = parserFile(name, path, comp, true);
+        deps[n] = (moduleDep) {name, moduleImageGetDepHash(image, n), used[n].scope};
+        found &= !used[n].notfound;
+    }
+
+    free(path);
+
+    /*The file still gets its range of locations, for errors from the analyzer*/
+    int file = sourceAddFile(&comp->sources, filename, entry->source, entry->length);
+    ast* Module = found ? moduleImageLoad(image, comp, scope, deps, sourceGetLocation(&comp->sources, file, 0)) : 0;
+
+    if (Module) {
+        *res = (parserResult) {Module, scope, fstripname(filename, malloc), 0, 0, false, false, 0,
+                               moduleImageGetLines(image), file, 0, 0};
+
+        /*Give the trees of modules used for the first time to the using
+          statements, as parserUsing does*/
+        for (int i = 0, n = 0; i < Module->children; i++) {
+            ast* Using = Module->child[i];
+
+            if (Using->tag != astUsing || !((char*) Using->literal)[0])
+                continue;
+
+            if (used[n].firsttime) {
+                res->errors += used[n].errors;
+                res->warnings += used[n].warnings;
+                Using->r = used[n].tree;
+            }
+
+            n++;
+        }
+
+    } else
+        debugError("parserLoadImage", "image of '%s' doesn't fit the modules it uses", fullname);
+
+    free(used);
+    free(deps);
+
+    return Module != 0;
+}
+
+static void parserSaveImage (parserCtx* ctx, const ast* Module, int lines) {
+    compilerCtx* comp = ctx->comp;
+    moduleCacheEntry* entry = moduleCacheGetEntry(&comp->moduleCache, ctx->fullname);
+
+    if (!entry)
+        return;
+
+    /*What each using statement found*/
+    moduleDep* deps = malloc(sizeof(moduleDep)*Module->children);
+    int depNo = 0;
+    bool found = true;
+
+    for (int i = 0; found && i < Module->children; i++) {
+        const ast* Using = Module->child[i];
+
+        if (Using->tag != astUsing || !((char*) Using->literal)[0])
+            continue;
+
+        char* fullname = parserFindFile(Using->literal, ctx->path, comp->searchPaths);
+        const parserResult* used = fullname ? hashmapMap(&comp->modules, fullname) : 0;
+        const moduleCacheEntry* usedEntry = fullname ? moduleCacheGetEntry(&comp->moduleCache, fullname) : 0;
+
+        if (used && usedEntry)
+            deps[depNo++] = (moduleDep) {Using->literal, usedEntry->hash, used->scope};
+
+        else
+            found = false;
+
+        free(fullname);
+    }
+
+    if (found)
+        moduleImageWrite(&comp->moduleCache, entry->hash, comp, Module, ctx->module,
+                         sourceGetLocation(&comp->sources, ctx->file, 0), lines, deps, depNo);
+
+    free(deps);
+}
+
+/*==== Skipped bodies ====*/
+
+void parserBodies (compilerCtx* comp, ast* tree) {
+    /*The trees of used modules that are part of this one*/
+    intset/*<const ast*>*/ trees;
+    intsetInit(&trees, 64);
+
+    parserReach(comp, tree, &trees, tree);
+
+    intsetFree(&trees);
+}
+
+/*Parse the bodies of the functions referred to within a node*/
+static void parserReach (compilerCtx* comp, ast* tree, intset/*<const ast*>*/* trees, ast* Node) {
+    if (!Node)
+        return;
+
+    /*A module's tree always comes before anything that uses it*/
+    if (Node->tag == astModule)
+        intsetAdd(trees, (intptr_t) Node);
+
+    else if (Node->tag == astLiteral && Node->litTag == literalIdent && Node->symbol) {
+        ast* impl = (ast*) Node->symbol->impl;
+
+        const parserResult* module;
+
+        if (impl && impl->tag == astFnImpl && !impl->r && (module = parserBody(comp, impl))) {
+            if (!intsetTest(trees, (intptr_t) module->tree))
+                astAddChild(tree, impl);
+
+            parserReach(comp, tree, trees, impl->r);
+        }
+    }
+
+    /*The identifiers being declared aren't references, only initializers*/
+    else if (Node->tag == astFnImpl) {
+        parserReach(comp, tree, trees, Node->r);
+        return;
+
+    } else if (Node->tag == astDecl) {
+        for (int i = 0; i < Node->children; i++) {
+            const ast* Current = Node->child[i];
+
+            if (Current->tag == astBOP && Current->o == opAssign)
+                parserReach(comp, tree, trees, Current->r);
+        }
+
+        return;
+    }
+
+    parserReach(comp, tree, trees, Node->l);
+    parserReach(comp, tree, trees, Node->r);
+
+    for (int i = 0; i < Node->children; i++)
+        parserReach(comp, tree, trees, Node->child[i]);
+}
+
+/*The module that a node was parsed from*/
+static parserResult* parserGetModule (compilerCtx* comp, const ast* Node) {
+    int file = sourceFindFile(&comp->sources, Node->location);
+
+    for (int i = 0; i < comp->moduleList.length; i++) {
+        parserResult* module = vectorGet(&comp->moduleList, i);
+
+        if (module->file == file)
+            return module;
+    }
+
+    debugError("parserGetModule", "no module for file %d", file);
+    return 0;
+}
+
+/*Parse a skipped function body, in place, as parserFnImpl would have,
+  returning the module it is from*/
+static const parserResult* parserBody (compilerCtx* comp, ast* FnImpl) {
+    parserResult* module = parserGetModule(comp, FnImpl);
+
+    if (!module)
+        return 0;
+
+    /*Loaded from an image, so never lexed*/
+    if (!module->lexer) {
+        module->lexer = lexerInit(module->fullname, &comp->atoms);
+        module->lexer->base = sourceGetLocation(&comp->sources, module->file, 0);
+        lexerTokenize(module->lexer);
+    }
+
+    parserCtx ctx = {
+        .lexer = module->lexer,
+        .filename = module->filename, .file = module->file, .fullname = module->fullname,
+        .comp = comp,
+        .module = (sym*) module->scope, .scope = FnImpl->symbol
+    };
+
+    lexerSeek(ctx.lexer, FnImpl->location);
+    ctx.location = ctx.lexer->location;
+
+    /*Into the module's arena, with the rest of it*/
+    arena* oldArena = arenaSetCurrent(module->arena);
+
+    FnImpl->r = parserCode(&ctx);
+
+    arenaSetCurrent(oldArena);
+
+    comp->errors += ctx.errors;
+    comp->warnings += ctx.warnings;
+
+    return module;
 }
 
 void parserResultDestroy (parserResult* result) {
-    astDestroy(result->tree);
+    if (result->lexer)
+        lexerEnd(result->lexer);
+
+    arenaFree(result->arena);
+    free(result->arena);
 
     free(result->filename);
     free(result);
@@ -164,7 +496,7 @@ static ast* parserUsing (parserCtx* ctx) {
     ast* Node = astCreateUsing(loc, name);
 
     if (name[0]) {
-        parserResult res = parser(name, ctx->path, ctx->comp);
+        parserResult res = parserFile(name, ctx->path, ctx->comp, true);
 
         if (res.notfound)
             errorFileNotFound(ctx, name);
@@ -1,13 +1,16 @@
 #include "../inc/reg.h"
 
 #include "../inc/debug.h"
+#include "../inc/arena.h"
+
+#include "stdio.h"
 
 /*Indexes correspond to regXXX definitions
   Note rsp and rbp always used*/
 reg regs[regMax] = {
     {1, {"undefined", "undefined", "undefined", "undefined"}, 0},
     {1, {"al", "ax", "eax", "rax"}, 0},
-    {1, {"al", "bx", "ebx", "rbx"}, 0},
+    {1, {"bl", "bx", "ebx", "rbx"}, 0},
     {1, {"cl", "cx", "ecx", "rcx"}, 0},
     {1, {"dl", "dx", "edx", "rdx"}, 0},
     {2, {0, "si", "esi", "rsi"}, 0},
@@ -24,8 +27,11 @@ reg regs[regMax] = {
     {2, {0, "sp", "esp", "rsp"}, 0}
 };
 
+/*Sizes the physical registers are allocated as, by this thread*/
+static _Thread_local int regSizes[regMax];
+
 bool regIsUsed (regIndex r) {
-    return regs[r].allocatedAs != 0;
+    return regSizes[r] != 0;
 }
 
 const reg* regGet (regIndex r) {
@@ -38,8 +44,8 @@ reg* regRequest (regIndex r, int size) {
         size = regs[r].size == 8 ? 8 : 4;
     }
 
-    if (regs[r].allocatedAs == 0 && regs[r].size <= size) {
-        regs[r].allocatedAs = size;
+    if (regSizes[r] == 0 && regs[r].size <= size) {
+        regSizes[r] = size;
         return &regs[r];
 
     } else
@@ -47,25 +53,53 @@ reg* regRequest (regIndex r, int size) {
 }
 
 void regFree (reg* r) {
-    r->allocatedAs = false;
+    regSetSize(r, 0);
+}
+
+int regGetSize (const reg* r) {
+    regIndex index = regGetIndex(r);
+    return index ? regSizes[index] : r->allocatedAs;
 }
 
+void regSetSize (reg* r, int size) {
+    regIndex index = regGetIndex(r);
+
+    if (index)
+        regSizes[index] = size;
+
+    else
+        r->allocatedAs = size;
+}
+
+regIndex regGetIndex (const reg* r) {
+    return r > regs && r < regs+regMax ? (regIndex) (r - regs) : regUndefined;
+}
+
+/*Numbered per thread, which is enough to tell them apart within a function*/
+static _Thread_local int regVirtualNo = 0;
+
 reg* regAlloc (int size) {
     if (size == 0)
         return 0;
 
-    /*Bugger RAX. Functions put their rets in there, so its just a hassle*/
-    for (regIndex r = regRBX; r <= regR15; r++)
-        if (regRequest(r, size) != 0)
-            return &regs[r];
+    enum {nameSize = 16};
+
+    /*The register and its names in one allocation*/
+    reg* r = arenaAlloc(arenaGetCurrent(), sizeof(reg) + 4*nameSize);
+    char* names = (char*) (r+1);
+    int n = regVirtualNo++;
 
-    if (regIsUsed(regRAX))
-        debugError("regAlloc", "no registers left");
+    for (int i = 0; i < 4; i++) {
+        snprintf(names + i*nameSize, nameSize, "%%v%d.%d", n, 1 << i);
+        r->names[i] = names + i*nameSize;
+    }
 
-    return regRequest(regRAX, size);
+    r->size = 1;
+    r->allocatedAs = size;
+    return r;
 }
 
-static const char* regGetName (const reg* r, int size) {
+const char* regGetName (const reg* r, int size) {
     if (size == 1)
         return r->names[0];
 
@@ -89,5 +123,5 @@ const char* regIndexGetName (regIndex r, int size) {
 }
 
 const char* regGetStr (const reg* r) {
-    return regGetName(r, r->allocatedAs);
+    return regGetName(r, regGetSize(r));
 }
@@ -0,0 +1,184 @@
+#include "../inc/scan.h"
+
+#include "../std/std.h"
+
+#include "stdlib.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include "immintrin.h"
+#endif
+
+typedef const char* (*scanWhitespaceFn)(const char* str, const char* end);
+typedef const char* (*scanFindFn)(const char* str, const char* end, char a, char b);
+
+static scanImpl impl = scanScalar;
+static scanWhitespaceFn whitespaceFn;
+static scanFindFn findFn;
+
+static bool isWhitespace (char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*==== Scalar ====*/
+
+static const char* scanWhitespaceScalar (const char* str, const char* end) {
+    while (str < end && isWhitespace(*str))
+        str++;
+
+    return str;
+}
+
+static const char* scanFindScalar (const char* str, const char* end, char a, char b) {
+    while (str < end && *str != a && *str != b && *str != 0)
+        str++;
+
+    return str;
+}
+
+/*==== SSE2 / AVX2 ====
+
+  Compare a whole vector against each character of interest, OR the results
+  and take the index of the first set bit of the mask. Whatever is left at
+  the end, shorter than a vector, goes to the scalar version.*/
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+static const char* scanWhitespaceSSE2 (const char* str, const char* end) {
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                  newline = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+
+    for (; end - str >= 16; str += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) str);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, cr)));
+        unsigned int mask = ~(unsigned int) _mm_movemask_epi8(ws) & 0xFFFF;
+
+        if (mask)
+            return str + __builtin_ctz(mask);
+    }
+
+    return scanWhitespaceScalar(str, end);
+}
+
+__attribute__((target("sse2")))
+static const char* scanFindSSE2 (const char* str, const char* end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), nul = _mm_setzero_si128();
+
+    for (; end - str >= 16; str += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) str);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                   _mm_cmpeq_epi8(chunk, nul));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(hit);
+
+        if (mask)
+            return str + __builtin_ctz(mask);
+    }
+
+    return scanFindScalar(str, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char* scanWhitespaceAVX2 (const char* str, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                  newline = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+
+    for (; end - str >= 32; str += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) str);
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, cr)));
+        unsigned int mask = ~(unsigned int) _mm256_movemask_epi8(ws);
+
+        if (mask)
+            return str + __builtin_ctz(mask);
+    }
+
+    return scanWhitespaceSSE2(str, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scanFindAVX2 (const char* str, const char* end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), nul = _mm256_setzero_si256();
+
+    for (; end - str >= 32; str += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) str);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb)),
+                                      _mm256_cmpeq_epi8(chunk, nul));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(hit);
+
+        if (mask)
+            return str + __builtin_ctz(mask);
+    }
+
+    return scanFindSSE2(str, end, a, b);
+}
+
+#endif
+
+/*==== Selection ====*/
+
+void scanInit (void) {
+    if (!scanSelect(scanAVX2) && !scanSelect(scanSSE2))
+        scanSelect(scanScalar);
+}
+
+bool scanSelect (scanImpl select) {
+    if (select == scanScalar) {
+        whitespaceFn = scanWhitespaceScalar;
+        findFn = scanFindScalar;
+
+#ifdef SCAN_X86
+    } else if (select == scanSSE2) {
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("sse2"))
+            return false;
+
+        whitespaceFn = scanWhitespaceSSE2;
+        findFn = scanFindSSE2;
+
+    } else if (select == scanAVX2) {
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("avx2"))
+            return false;
+
+        whitespaceFn = scanWhitespaceAVX2;
+        findFn = scanFindAVX2;
+#endif
+
+    } else
+        return false;
+
+    impl = select;
+    return true;
+}
+
+scanImpl scanGetImpl (void) {
+    return impl;
+}
+
+const char* scanImplGetStr (scanImpl select) {
+    if (select == scanScalar) return "scalar";
+    else if (select == scanSSE2) return "SSE2";
+    else if (select == scanAVX2) return "AVX2";
+    else return "<unhandled>";
+}
+
+/*==== Dispatch ====*/
+
+const char* scanWhitespace (const char* str, const char* end) {
+    /*Work even if nobody called scanInit*/
+    if (!whitespaceFn)
+        scanSelect(scanScalar);
+
+    return whitespaceFn(str, end);
+}
+
+const char* scanFind (const char* str, const char* end, char a, char b) {
+    if (!findFn)
+        scanSelect(scanScalar);
+
+    return findFn(str, end, a, b);
+}
@@ -0,0 +1,129 @@
+#include "../inc/source.h"
+
+#include "../inc/debug.h"
+#include "../inc/scan.h"
+
+#include "stdlib.h"
+#include "string.h"
+
+sourceManager* sourceManagerInit (sourceManager* mgr) {
+    mgr->fileNo = 0;
+    mgr->fileCapacity = 16;
+    mgr->files = malloc(sizeof(sourceFile)*mgr->fileCapacity);
+
+    /*Zero is reserved for unknown locations*/
+    mgr->next = 1;
+    return mgr;
+}
+
+void sourceManagerFree (sourceManager* mgr) {
+    for (int i = 0; i < mgr->fileNo; i++) {
+        free(mgr->files[i].filename);
+        free(mgr->files[i].lineStarts);
+        free(mgr->files[i].tabs);
+    }
+
+    free(mgr->files);
+    mgr->files = 0;
+    mgr->fileNo = 0;
+}
+
+static void sourcePushOffset (int** offsets, int* length, int* capacity, int offset) {
+    if (*length == *capacity)
+        *offsets = realloc(*offsets, sizeof(int)*(*capacity *= 2));
+
+    (*offsets)[(*length)++] = offset;
+}
+
+int sourceAddFile (sourceManager* mgr, const char* filename, const char* buffer, int length) {
+    debugAssert("sourceAddFile", "location space", (uint64_t) mgr->next + length + 1 <= UINT32_MAX);
+
+    if (mgr->fileNo == mgr->fileCapacity)
+        mgr->files = realloc(mgr->files, sizeof(sourceFile)*(mgr->fileCapacity *= 2));
+
+    sourceFile* file = &mgr->files[mgr->fileNo];
+    file->filename = strdup(filename ? filename : "");
+    file->base = mgr->next;
+    file->length = length;
+
+    int lineCapacity = length/32 + 16, tabCapacity = 16;
+    file->lineStarts = malloc(sizeof(int)*lineCapacity);
+    file->tabs = malloc(sizeof(int)*tabCapacity);
+    file->lineNo = 0;
+    file->tabNo = 0;
+
+    sourcePushOffset(&file->lineStarts, &file->lineNo, &lineCapacity, 0);
+
+    const char *end = buffer+length;
+
+    for (const char* str = scanFind(buffer, end, '\n', '\t');
+         str < end;
+         str = scanFind(str+1, end, '\n', '\t')) {
+        if (*str == '\n')
+            sourcePushOffset(&file->lineStarts, &file->lineNo, &lineCapacity, str-buffer+1);
+
+        else if (*str == '\t')
+            sourcePushOffset(&file->tabs, &file->tabNo, &tabCapacity, str-buffer);
+
+        /*Otherwise a stray NUL, keep going*/
+    }
+
+    /*Room for the EOF token*/
+    mgr->next += length+1;
+    return mgr->fileNo++;
+}
+
+tokenLocation sourceGetLocation (const sourceManager* mgr, int file, int offset) {
+    return mgr->files[file].base + offset;
+}
+
+/*Number of elements of a sorted array that are < value, or <= value*/
+static int sourceCountBelow (const int* array, int length, int value, bool orEqual) {
+    int lower = 0, upper = length;
+
+    while (lower < upper) {
+        int middle = lower + (upper-lower)/2;
+
+        if (array[middle] < value || (orEqual && array[middle] == value))
+            lower = middle+1;
+
+        else
+            upper = middle;
+    }
+
+    return lower;
+}
+
+int sourceFindFile (const sourceManager* mgr, tokenLocation loc) {
+    /*Last file starting at or before the location*/
+    int lower = 0, upper = mgr->fileNo;
+
+    while (upper-lower > 1) {
+        int middle = lower + (upper-lower)/2;
+
+        if (mgr->files[middle].base <= loc)
+            lower = middle;
+
+        else
+            upper = middle;
+    }
+
+    return lower;
+}
+
+sourceLocation sourceDecode (const sourceManager* mgr, tokenLocation loc) {
+    if (loc == 0)
+        return (sourceLocation) {"<unknown>", 0, 0};
+
+    const sourceFile* file = &mgr->files[sourceFindFile(mgr, loc)];
+    int offset = loc - file->base;
+
+    int line = sourceCountBelow(file->lineStarts, file->lineNo, offset, true);
+    int lineStart = file->lineStarts[line-1];
+
+    /*Tabs between the start of the line and the location*/
+    int tabs =   sourceCountBelow(file->tabs, file->tabNo, offset, false)
+               - sourceCountBelow(file->tabs, file->tabNo, lineStart, false);
+
+    return (sourceLocation) {file->filename, line, 1 + offset - lineStart + 3*tabs};
+}
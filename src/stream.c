@@ -6,65 +6,123 @@
 #include "stdlib.h"
 #include "stdio.h"
 
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "fcntl.h"
+#include "unistd.h"
+
+static bool streamMap (streamCtx* ctx, const char* filename);
+static void streamRead (streamCtx* ctx, const char* filename);
+
 streamCtx* streamInit (const char* filename) {
     streamCtx* ctx = malloc(sizeof(streamCtx));
-    ctx->file = fopen(filename, "r");
 
+    if (!streamMap(ctx, filename))
+        streamRead(ctx, filename);
+
+    ctx->pos = 0;
     ctx->current = 0;
-    ctx->line = 1;
-    ctx->lineChar = 0;
 
+    /*Load the first character without moving past it*/
+    ctx->pos = -1;
     streamNext(ctx);
 
     return ctx;
 }
 
 void streamEnd (streamCtx* ctx) {
-    fclose(ctx->file);
+    if (ctx->mapped)
+        munmap((void*) ctx->buffer, ctx->length+1);
+
+    else
+        free((void*) ctx->buffer);
+
     free(ctx);
 }
 
-char streamNext (streamCtx* ctx) {
-    char old = ctx->current;
-    ctx->current = fgetc(ctx->file);
+static bool streamMap (streamCtx* ctx, const char* filename) {
+    int fd = open(filename, O_RDONLY);
 
-    if (feof(ctx->file) || ctx->current == '\255')
-        ctx->current = 0;
+    if (fd < 0)
+        return false;
 
-    ctx->lineChar++;
+    struct stat info;
+    long pagesize = sysconf(_SC_PAGESIZE);
 
-    if (old == '\n') {
-        ctx->line++;
-        ctx->lineChar = 1;
+    /*The mapping needs to be followed by a NUL sentinel. The kernel zero
+      fills the remainder of the last page, so only map when there is one.*/
+    if (   fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+        || info.st_size == 0 || pagesize <= 0 || info.st_size % pagesize == 0) {
+        close(fd);
+        return false;
+    }
 
-    } else if (old == '\t')
-        ctx->lineChar += 3;
+    void* mapping = mmap(0, info.st_size+1, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
 
+    if (mapping == MAP_FAILED)
+        return false;
 
-    //printf("%d\t%c\n", (int) ctx->current, ctx->current);
+    ctx->buffer = mapping;
+    ctx->length = info.st_size;
+    ctx->mapped = true;
+    return true;
+}
 
-    return old;
+static void streamRead (streamCtx* ctx, const char* filename) {
+    FILE* file = fopen(filename, "rb");
+
+    int capacity = 4096, length = 0;
+    char* buffer = malloc(capacity);
+
+    if (file) {
+        int read;
+
+        while ((read = fread(buffer+length, 1, capacity-length-1, file)) > 0) {
+            length += read;
+
+            if (length+1 == capacity)
+                buffer = realloc(buffer, capacity *= 2);
+        }
+
+        fclose(file);
+    }
+
+    buffer[length] = 0;
+
+    ctx->buffer = buffer;
+    ctx->length = length;
+    ctx->mapped = false;
 }
 
-char streamPrev (streamCtx* ctx) {
+char streamNext (streamCtx* ctx) {
     char old = ctx->current;
 
-    fseek(ctx->file, -2, SEEK_CUR);
-    streamNext(ctx);
+    if (ctx->pos < ctx->length)
+        ctx->pos++;
 
-    ctx->lineChar--;
+    ctx->current = ctx->buffer[ctx->pos];
+    return old;
+}
 
-    if (ctx->current == '\n') {
-        ctx->line--;
-        /*Since it would be such a hassle to go back and count chars
-          (or keep track of them for all lines), we'll just start
-          using Python indices (-1 = last char, -2 = second last etc)*/
-        ctx->lineChar = -1;
+char streamPrev (streamCtx* ctx) {
+    char old = ctx->current;
 
-    } else if (ctx->current == '\t')
-        ctx->lineChar -= 3;
+    if (ctx->pos > 0)
+        ctx->current = ctx->buffer[--ctx->pos];
 
     return old;
+}
 
+const char* streamGetPtr (const streamCtx* ctx) {
+    return ctx->buffer + ctx->pos;
 }
 
+const char* streamGetEnd (const streamCtx* ctx) {
+    return ctx->buffer + ctx->length;
+}
+
+void streamSkipTo (streamCtx* ctx, const char* ptr) {
+    ctx->pos = ptr - ctx->buffer;
+    ctx->current = *ptr;
+}
@@ -2,33 +2,78 @@
 
 #include "../inc/debug.h"
 #include "../inc/type.h"
+#include "../inc/arena.h"
+#include "../inc/hashmap.h"
 
 #include "stdio.h"
 #include "string.h"
 #include "stdlib.h"
+#include "stdint.h"
+
+/**
+ * Open addressed table of symbols by ident, see symGetKey. Atoms are
+ * unique, so the pointers are what is hashed and compared.
+ */
+typedef struct symTable {
+    int size, elements;
+    sym** slots;
+} symTable;
+
+/**
+ * Hash index of a scope's children, see symChild.
+ *
+ * Only children that symChild can match outright are hashed: named
+ * symbols, and links to named symbols (under the linked ident). The
+ * rest that symChild must look inside, anonymous records, module links
+ * and other links, are listed in order in transparent.
+ */
+struct symIndex {
+    ///Children of the scope, possibly symLinks. Only the first child with
+    ///a given ident is held.
+    symTable names;
+    vector/*<sym*>*/ transparent;
+};
+
+/**
+ * Everything symChild can find in a module scope, through any number of
+ * module links, flattened. @see symModuleExport
+ */
+struct symExports {
+    ///The symbols themselves, never links
+    symTable names;
+    ///Every module scope whose symbols are included
+    vector/*<const sym*>*/ modules;
+};
 
 static sym* symCreate (symTag tag);
-static sym* symCreateParented (symTag tag, sym* Parent);
-static void symDestroy (sym* Symbol);
+static sym* symCreateParented (symTag tag, sym* Parent, const char* ident);
 
 static sym* symCreateLink (sym* Symbol);
 
-static void symAddChild (sym* Parent, sym* Child);
+static const char* symGetKey (const sym* Child);
+
+static void symTableInit (symTable* table, int size, arena* a);
+static sym** symTableSlot (const symTable* table, const char* look);
+static void symTableAdd (symTable* table, sym* Symbol, arena* a);
+
+static void symIndexCreate (sym* Scope);
+static void symIndexAdd (sym* Scope, sym* Child);
+static void symIndexReplace (sym* Scope, const sym* Old, sym* New);
+
+static void symExportsAdd (symExports* exports, const sym* Scope, intset* visited, arena* a);
+static void symExportsAddModule (symExports* exports, const sym* Module, intset* visited, arena* a);
 
 sym* symInit () {
     return symCreate(symScope);
 }
 
-void symEnd (sym* Global) {
-    symDestroy(Global);
-}
-
 static sym* symCreate (symTag tag) {
-    sym* Symbol = malloc(sizeof(sym));
+    arena* a = arenaGetCurrent();
+    sym* Symbol = arenaAlloc(a, sizeof(sym));
     Symbol->tag = tag;
     Symbol->ident = 0;
 
-    vectorInit(&Symbol->decls, 2);
+    vectorInitArena(&Symbol->decls, 2, a);
     Symbol->impl = 0;
 
     Symbol->storage = storageUndefined;
@@ -38,8 +83,10 @@ static sym* symCreate (symTag tag) {
     Symbol->typeMask = typeNone;
     Symbol->complete = false;
 
-    vectorInit(&Symbol->children, 4);
+    vectorInitArena(&Symbol->children, 4, a);
     Symbol->parent = 0;
+    Symbol->index = 0;
+    Symbol->exports = 0;
 
     Symbol->label = 0;
     Symbol->offset = 0;
@@ -49,43 +96,26 @@ static sym* symCreate (symTag tag) {
     return Symbol;
 }
 
-static sym* symCreateParented (symTag tag, sym* Parent) {
+static sym* symCreateParented (symTag tag, sym* Parent, const char* ident) {
     sym* Symbol = symCreate(tag);
+    /*Named before being added, for the parent's index*/
+    Symbol->ident = ident;
     symAddChild(Parent, Symbol);
     return Symbol;
 }
 
-static void symDestroy (sym* Symbol) {
-    free(Symbol->ident);
-
-    vectorFree(&Symbol->decls);
-
-    if (Symbol->tag != symModuleLink && Symbol->tag != symLink)
-        vectorFreeObjs(&Symbol->children, (vectorDtor) symDestroy);
-
-    else
-        vectorFree(&Symbol->children);
-
-    if (   (   Symbol->tag == symId
-            || Symbol->tag == symParam
-            || Symbol->tag == symEnumConstant
-            || Symbol->tag == symTypedef)
-        && Symbol->dt)
-        typeDestroy(Symbol->dt);
-
-    if (   Symbol->tag == symId
-        && (Symbol->storage == storageStatic || Symbol->storage == storageExtern))
-        free(Symbol->label);
-
-    free(Symbol);
+sym* symCreateUnparented (symTag tag, const char* ident) {
+    sym* Symbol = symCreate(tag);
+    Symbol->ident = ident;
+    return Symbol;
 }
 
 sym* symCreateScope (sym* Parent) {
-    return symCreateParented(symScope, Parent);
+    return symCreateParented(symScope, Parent, 0);
 }
 
 sym* symCreateModuleLink (sym* parent, const sym* module) {
-    sym* Symbol = symCreateParented(symModuleLink, parent);
+    sym* Symbol = symCreateParented(symModuleLink, parent, 0);
     vectorPush(&Symbol->children, (sym*) module);
     return Symbol;
 }
@@ -97,8 +127,7 @@ static sym* symCreateLink (sym* Symbol) {
 }
 
 sym* symCreateType (sym* Parent, const char* ident, int size, symTypeMask typeMask) {
-    sym* Symbol = symCreateParented(symType, Parent);
-    Symbol->ident = strdup(ident);
+    sym* Symbol = symCreateParented(symType, Parent, ident);
     Symbol->size = size;
     Symbol->typeMask = typeMask;
     Symbol->complete = true;
@@ -106,8 +135,7 @@ sym* symCreateType (sym* Parent, const char* ident, int size, symTypeMask typeMa
 }
 
 sym* symCreateNamed (symTag tag, sym* Parent, const char* ident) {
-    sym* Symbol = symCreateParented(tag, Parent);
-    Symbol->ident = strdup(ident);
+    sym* Symbol = symCreateParented(tag, Parent, ident);
 
     if (tag == symStruct)
         Symbol->typeMask = typeStruct;
@@ -121,20 +149,213 @@ sym* symCreateNamed (symTag tag, sym* Parent, const char* ident) {
     return Symbol;
 }
 
-static void symAddChild (sym* Parent, sym* Child) {
+void symAddChild (sym* Parent, sym* Child) {
     Child->parent = Parent;
     Child->nthChild = vectorPush(&Parent->children, Child);
+
+    if (Parent->index)
+        symIndexAdd(Parent, Child);
+
+    else if (Parent->children.length > symIndexThreshold)
+        symIndexCreate(Parent);
 }
 
 void symChangeParent (sym* Symbol, sym* parent) {
-    /*Replace it in the old parent's vector with a link*/
-    vectorSet(&Symbol->parent->children, Symbol->nthChild,
-              symCreateLink(Symbol));
+    /*Replace it in the old parent's vector with a link, in the same place*/
+    sym* Link = symCreateLink(Symbol);
+    Link->parent = Symbol->parent;
+    Link->nthChild = Symbol->nthChild;
+
+    vectorSet(&Link->parent->children, Link->nthChild, Link);
+
+    if (Link->parent->index)
+        symIndexReplace(Link->parent, Symbol, Link);
 
     /*Add it to the new parent*/
     symAddChild(parent, Symbol);
 }
 
+/*The ident that symChild would match a child by directly, if any*/
+static const char* symGetKey (const sym* Child) {
+    if (Child->tag == symLink) {
+        const sym* linked = Child->children.buffer[0];
+
+        if (   linked->tag != symModuleLink && linked->tag != symLink
+            && linked->ident && linked->ident[0])
+            return linked->ident;
+
+        return 0;
+
+    } else if (Child->ident && Child->ident[0])
+        return Child->ident;
+
+    else
+        return 0;
+}
+
+/*Does symChild need to look inside this child? Mirrors symChildInside*/
+static bool symIsTransparent (const sym* Scope, const sym* Child) {
+    return    Child->tag == symModuleLink
+           || (Child->tag == symLink && !symGetKey(Child))
+           || (   Child->ident && !Child->ident[0]
+               && (Scope->tag == symStruct || Scope->tag == symUnion));
+}
+
+static unsigned int symHash (const char* ident) {
+    /*Atoms are unique, so hash the pointer*/
+    uintptr_t hash = (uintptr_t) ident >> 3;
+    hash ^= hash >> 15;
+    hash *= 0x9E3779B1u;
+    return (unsigned int) (hash ^ (hash >> 16));
+}
+
+static void symTableInit (symTable* table, int size, arena* a) {
+    table->size = size;
+    table->elements = 0;
+    table->slots = arenaAlloc(a, size*sizeof(sym*));
+}
+
+/*The slot holding look, or the empty slot where it would go*/
+static sym** symTableSlot (const symTable* table, const char* look) {
+    unsigned int mask = table->size-1;
+
+    for (unsigned int i = symHash(look) & mask;; i = (i+1) & mask) {
+        sym** slot = &table->slots[i];
+
+        if (!*slot || symGetKey(*slot) == look)
+            return slot;
+    }
+}
+
+/*Add a symbol unless one by that name is already held: the earlier
+  shadows the later*/
+static void symTableAdd (symTable* table, sym* Symbol, arena* a) {
+    sym** slot = symTableSlot(table, symGetKey(Symbol));
+
+    if (*slot)
+        return;
+
+    *slot = Symbol;
+
+    /*Keep it at most half full. The old slots are left to the arena.*/
+    if (++table->elements*2 > table->size) {
+        sym** old = table->slots;
+        int oldSize = table->size;
+
+        table->size *= 2;
+        table->slots = arenaAlloc(a, table->size*sizeof(sym*));
+
+        for (int i = 0; i < oldSize; i++)
+            if (old[i])
+                *symTableSlot(table, symGetKey(old[i])) = old[i];
+    }
+}
+
+static void symIndexCreate (sym* Scope) {
+    /*Allocated with the scope's vectors rather than the current arena,
+      as modules add to scopes that are not their own*/
+    arena* a = Scope->children.arena;
+
+    symIndex* index = arenaAlloc(a, sizeof(symIndex));
+    symTableInit(&index->names, 4*symIndexThreshold, a);
+    vectorInitArena(&index->transparent, 4, a);
+
+    Scope->index = index;
+
+    for (int n = 0; n < Scope->children.length; n++)
+        symIndexAdd(Scope, vectorGet(&Scope->children, n));
+}
+
+static void symIndexAdd (sym* Scope, sym* Child) {
+    if (symGetKey(Child))
+        symTableAdd(&Scope->index->names, Child, Scope->children.arena);
+
+    else if (symIsTransparent(Scope, Child))
+        vectorPush(&Scope->index->transparent, Child);
+}
+
+static void symIndexReplace (sym* Scope, const sym* Old, sym* New) {
+    symIndex* index = Scope->index;
+    const char* key = symGetKey(Old);
+
+    if (key) {
+        sym** slot = symTableSlot(&index->names, key);
+
+        if (*slot == Old)
+            *slot = New;
+
+    } else
+        for (int n = 0; n < index->transparent.length; n++)
+            if (vectorGet(&index->transparent, n) == Old)
+                vectorSet(&index->transparent, n, New);
+}
+
+void symModuleExport (sym* Module) {
+    arena* a = Module->children.arena;
+
+    symExports* exports = arenaAlloc(a, sizeof(symExports));
+    symTableInit(&exports->names, 4*symIndexThreshold, a);
+    vectorInitArena(&exports->modules, 4, a);
+
+    intset visited;
+    intsetInit(&visited, 64);
+    intsetAdd(&visited, (intptr_t) Module);
+
+    symExportsAdd(exports, Module, &visited, a);
+
+    intsetFree(&visited);
+
+    Module->exports = exports;
+}
+
+/*Add what symChild would find in a scope, in the order it would*/
+static void symExportsAdd (symExports* exports, const sym* Scope, intset* visited, arena* a) {
+    for (int n = 0; n < Scope->children.length; n++) {
+        sym* Current = vectorGet(&Scope->children, n);
+
+        if (Current->ident && Current->ident[0])
+            symTableAdd(&exports->names, Current, a);
+
+        /*Anonymous inside a struct/union?*/
+        if (   Current->ident && !Current->ident[0]
+            && (   Current->parent->tag == symStruct
+                || Current->parent->tag == symUnion))
+            symExportsAdd(exports, Current, visited, a);
+
+        /*Included module?*/
+        if (Current->tag == symModuleLink)
+            symExportsAddModule(exports, Current->children.buffer[0], visited, a);
+
+        /*Reparented symbol?*/
+        else if (Current->tag == symLink)
+            symExportsAdd(exports, Current, visited, a);
+    }
+}
+
+static void symExportsAddModule (symExports* exports, const sym* Module, intset* visited, arena* a) {
+    /*Reached again through another path (a diamond): everything it has
+      was added the first time, and first found wins*/
+    if (intsetAdd(visited, (intptr_t) Module))
+        return;
+
+    vectorPush(&exports->modules, (sym*) Module);
+
+    /*Already flattened? Take the lot*/
+    if (Module->exports) {
+        const symExports* used = Module->exports;
+
+        for (int n = 0; n < used->modules.length; n++)
+            if (!intsetAdd(visited, (intptr_t) vectorGet(&used->modules, n)))
+                vectorPush(&exports->modules, vectorGet(&used->modules, n));
+
+        for (int i = 0; i < used->names.size; i++)
+            if (used->names.slots[i])
+                symTableAdd(&exports->names, used->names.slots[i], a);
+
+    } else
+        symExportsAdd(exports, Module, visited, a);
+}
+
 bool symIsFunction (const sym* Symbol) {
     return    Symbol->tag == symId && typeIsFunction(Symbol->dt)
            && (Symbol->storage == storageStatic || Symbol->storage == storageExtern);
@@ -154,42 +375,71 @@ const sym* symGetNthParam (const sym* fn, int n) {
     return 0;
 }
 
+/*Look inside a child that isn't the symbol itself, as symChild does*/
+static sym* symChildInside (const sym* Current, const char* look) {
+    /*Anonymous inside a struct/union?*/
+    if (   Current->ident && !Current->ident[0]
+        && (   Current->parent->tag == symStruct
+            || Current->parent->tag == symUnion)) {
+        sym* Found = symChild(Current, look);
+
+        if (Found)
+            return Found;
+    }
+
+    /*Included module? If it has been finished, its exports are flat*/
+    if (Current->tag == symModuleLink) {
+        const sym* Module = Current->children.buffer[0];
+
+        if (Module->exports)
+            return *symTableSlot(&Module->exports->names, look);
+
+        return symChild(Module, look);
+    }
+
+    /*Reparented symbol?*/
+    else if (Current->tag == symLink)
+        return symChild(Current, look);
+
+    return 0;
+}
+
 sym* symChild (const sym* Scope, const char* look) {
-    //printf("searching: %s\n", Scope->ident);
+    /*Large scope: hash straight to the first child of that name, and only
+      look inside the transparent children declared before it*/
+    if (Scope->index) {
+        sym* Found = *symTableSlot(&Scope->index->names, look);
+        int before = Found ? Found->nthChild : Scope->children.length;
 
-    for (int n = 0; n < Scope->children.length; n++) {
-        sym* Current = vectorGet(&Scope->children, n);
-        //reportSymbol(Current);
-        //getchar();
+        for (int n = 0; n < Scope->index->transparent.length; n++) {
+            const sym* Current = vectorGet(&Scope->index->transparent, n);
 
-        /*Found it?*/
-        if (Current->ident && !strcmp(Current->ident, look))
-            return Current;
+            if (Current->nthChild >= before)
+                break;
 
-        /*Anonymous inside a struct/union?*/
-        if (   Current->ident && !Current->ident[0]
-            && (   Current->parent->tag == symStruct
-                || Current->parent->tag == symUnion)) {
-            sym* Found = symChild(Current, look);
+            sym* Inside = symChildInside(Current, look);
 
-            if (Found)
-                return Found;
+            if (Inside)
+                return Inside;
         }
 
-        /*Included module?*/
-        if (Current->tag == symModuleLink) {
-            sym* Found = symChild(Current->children.buffer[0], look);
+        if (Found && Found->tag == symLink)
+            return Found->children.buffer[0];
 
-            if (Found)
-                return Found;
+        return Found;
+    }
 
-        /*Reparented symbol?*/
-        } else if (Current->tag == symLink) {
-            sym* Found = symChild(Current, look);
+    for (int n = 0; n < Scope->children.length; n++) {
+        sym* Current = vectorGet(&Scope->children, n);
 
-            if (Found)
-                return Found;
-        }
+        /*Found it? Atoms are unique, so compare the pointers*/
+        if (Current->ident == look)
+            return Current;
+
+        sym* Found = symChildInside(Current, look);
+
+        if (Found)
+            return Found;
     }
 
     return 0;
@@ -4,19 +4,22 @@
 #include "../inc/sym.h"
 
 #include "../inc/architecture.h"
+#include "../inc/arena.h"
 
 #include "stdlib.h"
 #include "string.h"
 #include "stdio.h"
+#include "stdint.h"
+#include "stdatomic.h"
 #include "assert.h"
 
 static typeQualifiers typeQualifiersCreate (void);
-static type* typeCreate (typeTag tag);
+static const type* typeIntern (type model);
 
 /**
  * Jump through (immediate) typedefs, possibly recursively, to actual type
  */
-static type* typeTryThroughTypedef (const type* DT);
+static const type* typeTryThroughTypedef (const type* DT);
 
 /**
  * As above, but collects qualifiers, e.g.
@@ -28,130 +31,199 @@ static type* typeTryThroughTypedef (const type* DT);
  * ->
  *    TryThroughTypedefQual(z) == {volatile x*, const}
  */
-static type* typeTryThroughTypedefQual (const type* DT, typeQualifiers* qualOut);
+static const type* typeTryThroughTypedefQual (const type* DT, typeQualifiers* qualOut);
 
 static bool typeQualIsEqual (typeQualifiers L, typeQualifiers R);
 
 static char* typeQualifiersToStr (typeQualifiers qual, const char* embedded);
 
-/*==== Ctors/dtors ====*/
+/*==== Hash-cons table ====*/
 
-static typeQualifiers typeQualifiersCreate () {
-    return (typeQualifiers) {false};
+/*Per thread, as each parallel job has its own table*/
+static _Thread_local typeTable* current = 0;
+
+typeTable* typeTableInit (typeTable* table) {
+    table->size = 1024;
+    table->elements = 0;
+    table->slots = calloc(table->size, sizeof(type*));
+    arenaInit(&table->types, 64*1024);
+    return table;
 }
 
-static type* typeCreate (typeTag tag) {
-    type* DT = malloc(sizeof(type));
-    DT->tag = tag;
-    DT->qual.isConst = false;
+void typeTableFree (typeTable* table) {
+    free(table->slots);
+    table->slots = 0;
+    arenaFree(&table->types);
+}
 
-    DT->basic = 0;
+typeTable* typeTableSetCurrent (typeTable* table) {
+    typeTable* old = current;
+    current = table;
+    return old;
+}
 
-    DT->base = 0;
-    DT->array = 0;
+static unsigned int typeHash (const type* DT) {
+    /*Children are interned already, so their pointers identify them*/
+    uintptr_t hash = DT->tag*31 + DT->qual.isConst;
 
-    DT->returnType = 0;
-    DT->paramTypes = 0;
-    DT->params = 0;
-    DT->variadic = false;
+    if (DT->tag == typeBasic)
+        hash = hash*31 + ((uintptr_t) DT->basic >> 3);
 
-    return DT;
-}
+    else if (DT->tag == typePtr || DT->tag == typeArray)
+        hash = (hash*31 + ((uintptr_t) DT->base >> 3))*31 + (unsigned int) DT->array;
 
-type* typeCreateBasic (const sym* basic) {
-    type* DT = typeCreate(typeBasic);
-    DT->basic = basic;
-    return DT;
-}
+    else if (DT->tag == typeFunction) {
+        hash = (hash*31 + ((uintptr_t) DT->returnType >> 3))*31 + DT->params*2 + DT->variadic;
 
-type* typeCreatePtr (type* base) {
-    type* DT = typeCreate(typePtr);
-    DT->base = base;
-    return DT;
+        for (int i = 0; i < DT->params; i++)
+            hash = hash*31 + ((uintptr_t) DT->paramTypes[i] >> 3);
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x9E3779B1u;
+    return (unsigned int) (hash ^ (hash >> 16));
 }
 
-type* typeCreateArray (type* base, int size) {
-    type* DT = typeCreate(typeArray);
-    DT->base = base;
-    DT->array = size;
-    return DT;
+static bool typeIsIdentical (const type* L, const type* R) {
+    if (L->tag != R->tag || L->qual.isConst != R->qual.isConst)
+        return false;
+
+    else if (L->tag == typeBasic)
+        return L->basic == R->basic;
+
+    else if (L->tag == typePtr || L->tag == typeArray)
+        return L->base == R->base && L->array == R->array;
+
+    else if (L->tag == typeFunction) {
+        if (   L->returnType != R->returnType || L->params != R->params
+            || L->variadic != R->variadic)
+            return false;
+
+        for (int i = 0; i < L->params; i++)
+            if (L->paramTypes[i] != R->paramTypes[i])
+                return false;
+
+        return true;
+
+    } else
+        return true;
 }
 
-type* typeCreateFunction (type* returnType, type** paramTypes, int params, bool variadic) {
-    type* DT = typeCreate(typeFunction);
-    DT->returnType = returnType;
-    DT->paramTypes = paramTypes;
-    DT->params = params;
-    DT->variadic = variadic;
-    return DT;
+/*The slot holding a type identical to the model, or the empty slot
+  where it would go*/
+static const type** typeTableSlot (const typeTable* table, const type* model, unsigned int hash) {
+    unsigned int mask = table->size-1;
+
+    for (unsigned int i = hash & mask;; i = (i+1) & mask) {
+        const type** slot = &table->slots[i];
+
+        if (!*slot || typeIsIdentical(*slot, model))
+            return slot;
+    }
 }
 
-type* typeCreateInvalid () {
-    return typeCreate(typeInvalid);
+static void typeTableGrow (typeTable* table) {
+    const type** old = table->slots;
+    int oldSize = table->size;
+
+    table->size *= 2;
+    table->slots = calloc(table->size, sizeof(type*));
+
+    for (int i = 0; i < oldSize; i++)
+        if (old[i])
+            *typeTableSlot(table, old[i], typeHash(old[i])) = old[i];
+
+    free(old);
 }
 
-void typeDestroy (type* DT) {
-    if (DT->tag == typeBasic || DT->tag == typeInvalid)
-        ;
+/*Find the type identical to the model, making it if there is none*/
+static const type* typeIntern (type model) {
+    debugAssert("typeIntern", "current table", current != 0);
 
-    else if (DT->tag == typePtr || DT->tag == typeArray)
-        typeDestroy(DT->base);
+    /*A model derived from an array brings its cached size along, which
+      might not be right for the new type*/
+    if (model.tag == typeArray)
+        model.size = 0;
 
-    else if (DT->tag == typeFunction) {
-        typeDestroy(DT->returnType);
+    const type** slot = typeTableSlot(current, &model, typeHash(&model));
 
-        for (int i = 0; i < DT->params; i++)
-            typeDestroy(DT->paramTypes[i]);
+    if (*slot)
+        return *slot;
+
+    type* DT = arenaAlloc(&current->types, sizeof(type));
+    *DT = model;
 
-        free(DT->paramTypes);
+    if (model.tag == typeFunction && model.params) {
+        DT->paramTypes = arenaAlloc(&current->types, model.params*sizeof(type*));
+        memcpy(DT->paramTypes, model.paramTypes, model.params*sizeof(type*));
     }
 
-    free(DT);
-}
+    *slot = DT;
 
-type* typeDeepDuplicate (const type* DT) {
-    type* copy;
+    /*Keep it at most half full*/
+    if (++current->elements*2 > current->size)
+        typeTableGrow(current);
 
-    if (DT->tag == typeInvalid)
-        copy = typeCreateInvalid();
+    return DT;
+}
 
-    else if (DT->tag == typeBasic)
-        copy = typeCreateBasic(DT->basic);
+/*==== Ctors ====*/
 
-    else if (DT->tag == typePtr)
-        copy = typeCreatePtr(typeDeepDuplicate(DT->base));
+static typeQualifiers typeQualifiersCreate () {
+    return (typeQualifiers) {false};
+}
 
-    else if (DT->tag == typeArray)
-        copy = typeCreateArray(typeDeepDuplicate(DT->base), DT->array);
+static type typeCreateModel (typeTag tag) {
+    type model;
+    memset(&model, 0, sizeof(type));
+    model.tag = tag;
+    model.qual = typeQualifiersCreate();
+    return model;
+}
 
-    else if (DT->tag == typeFunction) {
-        type** paramTypes = calloc(DT->params, sizeof(type*));
+const type* typeCreateBasic (const sym* basic) {
+    type model = typeCreateModel(typeBasic);
+    model.basic = basic;
+    return typeIntern(model);
+}
 
-        for (int i = 0; i < DT->params; i++)
-            paramTypes[i] = typeDeepDuplicate(DT->paramTypes[i]);
+const type* typeCreatePtr (const type* base) {
+    type model = typeCreateModel(typePtr);
+    model.base = base;
+    return typeIntern(model);
+}
 
-        copy = typeCreateFunction(typeDeepDuplicate(DT->returnType), paramTypes, DT->params, DT->variadic);
+const type* typeCreateArray (const type* base, int size) {
+    type model = typeCreateModel(typeArray);
+    model.base = base;
+    model.array = size;
+    return typeIntern(model);
+}
 
-    } else {
-        debugErrorUnhandled("typeDeepDuplicate", "type tag", typeTagGetStr(DT->tag));
-        copy = typeCreateInvalid();
-    }
+const type* typeCreateFunction (const type* returnType, const type** paramTypes, int params, bool variadic) {
+    type model = typeCreateModel(typeFunction);
+    model.returnType = returnType;
+    model.paramTypes = paramTypes;
+    model.params = params;
+    model.variadic = variadic;
+    return typeIntern(model);
+}
 
-    copy->qual = DT->qual;
-    return copy;
+const type* typeCreateInvalid () {
+    return typeIntern(typeCreateModel(typeInvalid));
 }
 
 /*==== Misc. helpers ====*/
 
-static type* typeTryThroughTypedef (const type* DT) {
+static const type* typeTryThroughTypedef (const type* DT) {
     if (DT->tag == typeBasic && DT->basic && DT->basic->tag == symTypedef)
         return typeTryThroughTypedef(DT->basic->dt);
 
     else
-        return (type*) DT;
+        return DT;
 }
 
-static type* typeTryThroughTypedefQual (const type* DT, typeQualifiers* qualOut) {
+static const type* typeTryThroughTypedefQual (const type* DT, typeQualifiers* qualOut) {
     if (qualOut)
         qualOut->isConst |= DT->qual.isConst;
 
@@ -159,7 +231,7 @@ static type* typeTryThroughTypedefQual (const type* DT, typeQualifiers* qualOut)
         return typeTryThroughTypedefQual(DT->basic->dt, qualOut);
 
     else
-        return (type*) DT;
+        return DT;
 }
 
 const sym* typeGetBasic (const type* DT) {
@@ -214,31 +286,20 @@ int typeGetArraySize (const type* DT) {
     return DT->tag == typeArray && DT->array != arraySizeError ? DT->array : 0;
 }
 
-/*==== Modification ====*/
+/*==== Derivation ====*/
 
-bool typeSetArraySize (type* DT, int size) {
-    DT = typeTryThroughTypedef(DT);
-
-    if (DT->tag != typeArray)
-        return false;
+/*Types are shared, so deriving an unmodified type is free*/
 
-    DT->array = size;
-    return true;
-}
-
-/*==== Derivation (deep copies with modifications) ====*/
-
-type* typeDeriveFrom (const type* DT) {
-    type* New = typeDeepDuplicate(DT);
-    return New;
+const type* typeDeriveFrom (const type* DT) {
+    return DT;
 }
 
-type* typeDeriveFromTwo (const type* L, const type* R) {
+const type* typeDeriveFromTwo (const type* L, const type* R) {
     if (typeIsInvalid(L))
-        return typeDeepDuplicate(R);
+        return R;
 
     else if (typeIsInvalid(R))
-        return typeDeepDuplicate(L);
+        return L;
 
     else {
         assert(typeIsCompatible(L, R));
@@ -246,25 +307,25 @@ type* typeDeriveFromTwo (const type* L, const type* R) {
     }
 }
 
-type* typeDeriveUnified (const type* L, const type* R) {
+const type* typeDeriveUnified (const type* L, const type* R) {
     if (typeIsInvalid(L))
-        return typeDeepDuplicate(R);
+        return R;
 
     else if (typeIsInvalid(R))
-        return typeDeepDuplicate(L);
+        return L;
 
     else {
         assert(typeIsCompatible(L, R));
 
         if (typeIsEqual(L, R))
-            return typeDeepDuplicate(L); //== R
+            return L; //== R
 
         else
             return typeDeriveFromTwo(L, R);
     }
 }
 
-type* typeDeriveBase (const type* DT) {
+const type* typeDeriveBase (const type* DT) {
     DT = typeTryThroughTypedef(DT);
 
     if (   typeIsInvalid(DT)
@@ -272,25 +333,54 @@ type* typeDeriveBase (const type* DT) {
         return typeCreateInvalid();
 
     else
-        return typeDeepDuplicate(DT->base);
+        return DT->base;
 }
 
-type* typeDerivePtr (const type* base) {
-    return typeCreatePtr(typeDeepDuplicate(base));
+const type* typeDerivePtr (const type* base) {
+    return typeCreatePtr(base);
 }
 
-type* typeDeriveArray (const type* base, int size) {
-    return typeCreateArray(typeDeepDuplicate(base), size);
+const type* typeDeriveArray (const type* base, int size) {
+    return typeCreateArray(base, size);
 }
 
-type* typeDeriveReturn (const type* fn) {
+const type* typeDeriveReturn (const type* fn) {
     fn = typeGetCallable(fn);
 
     if (debugAssert("typeDeriveReturn", "callable param", fn != 0))
         return typeCreateInvalid();
 
     else
-        return typeDeepDuplicate(fn->returnType);
+        return fn->returnType;
+}
+
+const type* typeDeriveConst (const type* DT) {
+    if (DT->qual.isConst)
+        return DT;
+
+    type model = *DT;
+    model.qual.isConst = true;
+    return typeIntern(model);
+}
+
+const type* typeDeriveArraySize (const type* DT, int size) {
+    const type* array = typeTryThroughTypedef(DT);
+
+    if (array->tag != typeArray)
+        return DT;
+
+    type model = *array;
+    model.array = size;
+    return typeIntern(model);
+}
+
+const type* typeDeriveReturning (const type* fn, const type* returnType) {
+    if (debugAssert("typeDeriveReturning", "function", fn->tag == typeFunction))
+        return typeCreateInvalid();
+
+    type model = *fn;
+    model.returnType = returnType;
+    return typeIntern(model);
 }
 
 /*==== Type classification ====*/
@@ -405,6 +495,10 @@ bool typeIsCondition (const type* DT) {
 /*==== Comparisons ====*/
 
 bool typeIsCompatible (const type* DT, const type* Model) {
+    /*Identical types are one and the same*/
+    if (DT == Model)
+        return true;
+
     DT = typeTryThroughTypedef(DT);
     Model = typeTryThroughTypedef(Model);
 
@@ -462,6 +556,11 @@ static bool typeQualIsEqual (typeQualifiers L, typeQualifiers R) {
 }
 
 bool typeIsEqual (const type* L, const type* R) {
+    /*Identical types are one and the same. Otherwise they may still be
+      equal through typedefs or unspecified array sizes.*/
+    if (L == R)
+        return true;
+
     typeQualifiers Lqual = typeQualifiersCreate(),
                    Rqual = typeQualifiersCreate();
     L = typeTryThroughTypedefQual(L, &Lqual);
@@ -515,14 +614,25 @@ int typeGetSize (const architecture* arch, const type* DT) {
     if (typeIsInvalid(DT))
         return 0;
 
-    else if (typeIsArray(DT))
+    else if (typeIsArray(DT)) {
         if (DT->array < 0)
             return 0;
 
-        else
-            return DT->array * typeGetSize(arch, DT->base);
+        int size = atomic_load_explicit(&DT->size, memory_order_relaxed);
+
+        if (size)
+            return size;
+
+        size = DT->array * typeGetSize(arch, DT->base);
+
+        /*Types are otherwise immutable, but the cache isn't part of what
+          identifies them, and the size can't change once complete*/
+        if (typeIsComplete(DT->base))
+            atomic_store_explicit(&((type*) DT)->size, size, memory_order_relaxed);
+
+        return size;
 
-    else if (typeIsPtr(DT) || typeIsFunction(DT))
+    } else if (typeIsPtr(DT) || typeIsFunction(DT))
         return arch->wordsize;
 
     else {
@@ -544,7 +654,7 @@ char* typeToStrEmbed (const type* DT, const char* embedded) {
 
     /*Basic type or invalid*/
     if (DT->tag == typeInvalid || DT->tag == typeBasic) {
-        char* basicStr = typeIsInvalid(DT)
+        const char* basicStr = typeIsInvalid(DT)
                             ? "<invalid>"
                             : (DT->basic->ident && DT->basic->ident[0])
                                 ? DT->basic->ident
@@ -2,6 +2,8 @@
 
 #include "../std/std.h"
 
+#include "../inc/arena.h"
+
 #include "stdlib.h"
 #include "string.h"
 
@@ -9,11 +11,22 @@ vector* vectorInit (vector* v, int initialCapacity) {
     v->length = 0;
     v->capacity = initialCapacity;
     v->buffer = malloc(initialCapacity*sizeof(void*));
+    v->arena = 0;
+    return v;
+}
+
+vector* vectorInitArena (vector* v, int initialCapacity, arena* a) {
+    v->length = 0;
+    v->capacity = initialCapacity;
+    v->buffer = arenaAlloc(a, initialCapacity*sizeof(void*));
+    v->arena = a;
     return v;
 }
 
 void vectorFree (vector* v) {
-    free(v->buffer);
+    if (!v->arena)
+        free(v->buffer);
+
     v->length = 0;
     v->capacity = 0;
     v->buffer = 0;
@@ -27,7 +40,14 @@ void vectorFreeObjs (vector* v, vectorDtor dtor) {
 
 static void vectorResize (vector* v, int size) {
     v->capacity = size;
-    v->buffer = realloc(v->buffer, v->capacity*sizeof(void*));
+
+    if (v->arena) {
+        void** old = v->buffer;
+        v->buffer = arenaAlloc(v->arena, v->capacity*sizeof(void*));
+        memcpy(v->buffer, old, v->length*sizeof(void*));
+
+    } else
+        v->buffer = realloc(v->buffer, v->capacity*sizeof(void*));
 }
 
 int vectorPush (vector* v, void* item) {
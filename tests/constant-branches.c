@@ -0,0 +1,47 @@
+using "stdio.h";
+
+enum {debug = 0, checked = 1};
+
+int count (int n) {
+	int total = 0;
+
+	/*Both guards are known, one way each*/
+	for (int i = 0; i < n; i++) {
+		if (debug && i > 2)
+			total += 100;
+
+		if (checked || i)
+			total += 1;
+	}
+
+	/*Folded, even once k is read back from its slot
+	  asm-not: ^imul
+	*/
+	int k = 3;
+	int m = k*4 + 1;
+
+	if (m != 13)
+		return -1;
+
+	return total;
+}
+
+int pick (int x) {
+	int y = checked ? 7 : x;
+	int z = -y;
+
+	while (1) {
+		if (z < 0)
+			return z + x;
+
+		z--;
+	}
+}
+
+int main () {
+	printf("5: %d\n", count(5));
+	printf("-4: %d\n", pick(3));
+
+	bool both = checked && !debug;
+	return both ? 0 : 1;
+}
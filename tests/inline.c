@@ -0,0 +1,68 @@
+using "stdio.h";
+
+typedef struct pt {
+	int x, y;
+} pt;
+
+static int getX (pt* p) {
+	return p->x;
+}
+
+static int getY (pt* p) {
+	return p->y;
+}
+
+static int area (pt* p) {
+	/*Inlines within an inline*/
+	return getX(p) * getY(p);
+}
+
+static void setX (pt* p, int x) {
+	if (x < 0)
+		return;
+
+	p->x = x;
+}
+
+static char low (int x) {
+	return x;
+}
+
+static int sum (int* xs) {
+	int total = 0;
+
+	for (int i = 0; i < 4; i++)
+		total += xs[i];
+
+	return total;
+}
+
+static int apply (int (*f)(int), int x) {
+	return f(f(x));
+}
+
+static int fact (int n) {
+	/*Never inlined into itself*/
+	return n <= 1 ? 1 : n*fact(n-1);
+}
+
+int main () {
+	pt p = {3, 4};
+	printf("12: %d\n", area(&p));
+
+	setX(&p, -1);
+	printf("3: %d\n", getX(&p));
+	setX(&p, 5);
+	printf("5: %d\n", getX(&p));
+
+	printf("1: %d\n", (int) low(257));
+
+	int xs[4] = {1, 2, 3, 4};
+	printf("10: %d\n", sum(xs));
+
+	printf("12: %d\n", apply([](int x)(x*2), 3));
+	printf("120: %d\n", fact(5));
+	printf("7: %d\n", ([](int x, int y)(x+y))(3, 4));
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+using "stdio.h";
+
+typedef struct pt {
+	int x, y;
+} pt;
+
+int scaled (pt* p, int n, int k) {
+	/*p->x * k is the same on every iteration, so is worked out once before
+	  the loop, leaving only the + i in it*/
+	int total = 0;
+
+	for (int i = 0; i < n; i++)
+		total += p->x * k + i;
+
+	return total;
+}
+
+int aliased (int* a, int* b, int n) {
+	/*The store may change *a, so it isn't hoisted*/
+	int total = 0;
+
+	for (int i = 0; i < n; i++) {
+		total += *a;
+		*b = *b + 1;
+	}
+
+	return total;
+}
+
+int never (pt* p, int n) {
+	/*The loop never runs, so p is never read*/
+	int total = 0;
+
+	for (int i = 0; i < n; i++)
+		total += p->y;
+
+	return total;
+}
+
+int main () {
+	pt p = {3, 4};
+	printf("66: %d\n", scaled(&p, 4, 5));
+
+	int n = 1;
+	printf("6: %d\n", aliased(&n, &n, 3));
+	printf("0: %d\n", never(0, 0));
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+using "stdio.h";
+
+int sumTo (int n, int total) {
+	/*A million deep, so only runs in bounded stack. Adds the last digits,
+	  keeping the total in range*/
+	if (n == 0)
+		return total;
+
+	return sumTo(n-1, total + n%10);
+}
+
+int isOdd (int n);
+
+int isEven (int n) {
+	if (n == 0)
+		return 1;
+
+	return isOdd(n-1);
+}
+
+int isOdd (int n) {
+	if (n == 0)
+		return 0;
+
+	return isEven(n-1);
+}
+
+int addTwo (int* xs) {
+	return xs[0] + xs[1];
+}
+
+int first (int* xs, int n) {
+	/*The array in the frame must outlive the call, so this is a normal call*/
+	int copy[2] = {xs[0], n};
+	return addTwo(copy);
+}
+
+int main () {
+	printf("4500000: %d\n", sumTo(1000000, 0));
+	printf("1: %d\n", isEven(1000000));
+	printf("0: %d\n", isOdd(1000000));
+
+	int xs[1] = {5};
+	printf("7: %d\n", first(xs, 2));
+
+	return 0;
+}
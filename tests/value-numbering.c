@@ -0,0 +1,45 @@
+using "stdio.h";
+
+typedef struct pt {
+	int x, y;
+} pt;
+
+int total;
+
+int sum (pt* a, int i) {
+	/*The address of a[i] is worked out once*/
+	return a[i].x + a[i].y;
+}
+
+int aliased (int* a, int* b) {
+	/*b may be a, so the store comes between the loads*/
+	int before = *a;
+	*b = 10;
+	return before + *a;
+}
+
+int escaped (void) {
+	int x = 1;
+	int* p = &x;
+	int before = x;
+	*p = 5;
+	return before + x;
+}
+
+int global (int* p) {
+	total = 3;
+	*p = 4;
+	return total;
+}
+
+int main () {
+	pt a[3] = {{1, 2}, {3, 4}, {5, 6}};
+	printf("7: %d\n", sum(a, 1));
+
+	int n = 1;
+	printf("11: %d\n", aliased(&n, &n));
+	printf("6: %d\n", escaped());
+	printf("4: %d\n", global(&total));
+
+	return 0;
+}